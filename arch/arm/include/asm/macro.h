@@ -11,6 +11,9 @@
 #ifdef CONFIG_ARM64
 #include <asm/system.h>
 #endif
+#ifdef CONFIG_RELOC_RELR
+#include <u-boot/relr.h>
+#endif
 
 #ifdef __ASSEMBLY__
 
@@ -324,6 +327,74 @@ lr	.req	x30
 	eret
 .endm
 
+/*
+ * Apply the relative relocations in .rela.dyn, which runs from \start to
+ * \end. Each word to fix up is at its link address plus \off, and is set to
+ * the addend plus \off. With RELOC_RELR, tools/relocate-rela may have put a
+ * RELR table in place of the entries (see <u-boot/relr.h>). The words then
+ * already hold their values for where the image is running, so \run_off is
+ * added to each. Unlike the rela fix-up, this must only be applied once to
+ * each copy of the image.
+ *
+ * The caller must include <elf.h>.
+ * Corrupts x0, x1, x4, x5, \start and \end
+ */
+.macro	fixup_rela_dyn, start, end, off, run_off
+	cmp	\start, \end
+	b.hs	fixup_done_\@
+#ifdef CONFIG_RELOC_RELR
+	ldr	x0, [\start]
+	mov	w1, #(RELR_MAGIC & 0xffff)
+	movk	w1, #(RELR_MAGIC >> 16), lsl #16
+	cmp	w0, w1
+	b.ne	fixup_rela_\@
+	lsr	x0, x0, #32		/* x0 <- number of RELR entries */
+	add	\start, \start, #8
+	add	\end, \start, x0, lsl #3
+	mov	x5, xzr
+fixup_relr_\@:
+	cmp	\start, \end
+	b.hs	fixup_done_\@
+	ldr	x0, [\start], #8
+	tbnz	x0, #0, fixup_bitmap_\@
+	/* address entry: fix up one word */
+	add	x5, x0, #8		/* x5 <- link address after the word */
+	add	x1, x0, \off
+	ldr	x4, [x1]
+	add	x4, x4, \run_off
+	str	x4, [x1]
+	b	fixup_relr_\@
+fixup_bitmap_\@:
+	/* bitmap entry: fix up the words after x5 whose bits are set */
+	add	x1, x5, \off
+	add	x5, x5, #(63 * 8)
+	lsr	x0, x0, #1
+fixup_bit_\@:
+	tbz	x0, #0, fixup_bit_next_\@
+	ldr	x4, [x1]
+	add	x4, x4, \run_off
+	str	x4, [x1]
+fixup_bit_next_\@:
+	add	x1, x1, #8
+	lsr	x0, x0, #1
+	cbnz	x0, fixup_bit_\@
+	b	fixup_relr_\@
+#endif
+fixup_rela_\@:
+	ldp	x0, x1, [\start], #16	/* (x0, x1) <- (link location, fixup) */
+	ldr	x4, [\start], #8	/* x4 <- addend */
+	cmp	w1, #R_AARCH64_RELATIVE
+	b.ne	fixup_next_\@
+	/* relative fix: store addend plus offset at dest location */
+	add	x0, x0, \off
+	add	x4, x4, \off
+	str	x4, [x0]
+fixup_next_\@:
+	cmp	\start, \end
+	b.lo	fixup_rela_\@
+fixup_done_\@:
+.endm
+
 #if defined(CONFIG_GICV3)
 .macro gic_wait_for_interrupt_m xreg1
 0 :	wfi
@@ -24,9 +24,23 @@ extern void * memcpy(void *, const void *, __kernel_size_t);
 #endif
 extern void * memmove(void *, const void *, __kernel_size_t);
 
+#if CONFIG_IS_ENABLED(USE_ARCH_MEMCHR)
+#define __HAVE_ARCH_MEMCHR
+#else
 #undef __HAVE_ARCH_MEMCHR
+#endif
 extern void * memchr(const void *, int, __kernel_size_t);
 
+#if CONFIG_IS_ENABLED(USE_ARCH_MEMCMP)
+#define __HAVE_ARCH_MEMCMP
+#endif
+extern int memcmp(const void *, const void *, __kernel_size_t);
+
+#if CONFIG_IS_ENABLED(USE_ARCH_STRLEN)
+#define __HAVE_ARCH_STRLEN
+#endif
+extern __kernel_size_t strlen(const char *);
+
 #undef __HAVE_ARCH_MEMZERO
 #if CONFIG_IS_ENABLED(USE_ARCH_MEMSET)
 #define __HAVE_ARCH_MEMSET
@@ -52,6 +52,9 @@ static void announce_and_cleanup(int fake)
 
 	board_quiesce_devices();
 
+	/* Write out any console output which is still buffered */
+	flush();
+
 	/*
 	 * Call remove function of all devices with a removal flag set.
 	 * This may be useful for last-stage operations, like cancelling
@@ -0,0 +1,27 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+
+#ifndef __ASM_SANDBOX_ATOMIC_H
+#define __ASM_SANDBOX_ATOMIC_H
+
+/* sandbox is single-threaded, so plain accesses are enough */
+
+typedef struct { volatile int counter; } atomic_t;
+typedef struct { volatile long counter; } atomic64_t;
+
+#define ATOMIC_INIT(i)	{ (i) }
+
+#define atomic_read(v)		((v)->counter)
+#define atomic_set(v, i)	((v)->counter = (i))
+#define atomic_add(i, v)	((v)->counter += (i))
+#define atomic_sub(i, v)	((v)->counter -= (i))
+#define atomic_inc(v)		atomic_add(1, v)
+#define atomic_dec(v)		atomic_sub(1, v)
+
+#define atomic64_read(v)	atomic_read(v)
+#define atomic64_set(v, i)	atomic_set(v, i)
+#define atomic64_add(i, v)	atomic_add(i, v)
+#define atomic64_sub(i, v)	atomic_sub(i, v)
+#define atomic64_inc(v)		atomic_inc(v)
+#define atomic64_dec(v)		atomic_dec(v)
+
+#endif
@@ -38,6 +38,15 @@ size_t sandbox_serial_written(void);
  */
 void sandbox_serial_endisable(bool enabled);
 
+/**
+ * sandbox_serial_set_room() - Limit the number of characters which can be sent
+ * @room: Number of characters which can be written before the device reports
+ *	that it is busy (-EAGAIN), or -1 for no limit
+ *
+ * This allows tests to act as a slow UART, for testing the TX buffer.
+ */
+void sandbox_serial_set_room(int room);
+
 /**
  * struct sandbox_serial_priv - Private data for this driver
  *
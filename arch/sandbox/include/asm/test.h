@@ -119,6 +119,45 @@ long sandbox_i2c_rtc_get_set_base_time(struct udevice *dev, long base_time);
 
 int sandbox_usb_keyb_add_string(struct udevice *dev, const char *str);
 
+/**
+ * struct sandbox_flash_stats - Transfer statistics of a sandbox USB flash stick
+ *
+ * The bus time is modelled on a high-speed link, where each bulk transfer
+ * has a fixed cost on top of the time taken to move its data. The flash
+ * needs some time to get ready for each read or write command before its
+ * data can move. With UAS this overlaps with the data of earlier commands,
+ * since the stick gets the next commands before that data has moved.
+ *
+ * @cmds: Number of commands received
+ * @max_queued: Largest number of UAS commands waiting at once
+ * @max_xfer: Largest number of bytes moved for one command
+ * @data_bytes: Number of bytes of data moved
+ * @bus_ns: Modelled time taken by all transfers, in nanoseconds
+ */
+struct sandbox_flash_stats {
+	ulong cmds;
+	uint max_queued;
+	uint max_xfer;
+	ulong data_bytes;
+	u64 bus_ns;
+};
+
+/**
+ * sandbox_flash_get_stats() - Get the statistics of a sandbox USB flash stick
+ *
+ * @dev: Emulator device to check
+ * @stats: Returns the statistics since the stick was probed or last reset
+ */
+void sandbox_flash_get_stats(struct udevice *dev,
+			     struct sandbox_flash_stats *stats);
+
+/**
+ * sandbox_flash_reset_stats() - Reset the statistics of a USB flash stick
+ *
+ * @dev: Emulator device to reset
+ */
+void sandbox_flash_reset_stats(struct udevice *dev);
+
 /**
  * sandbox_osd_get_mem() - get the internal memory of a sandbox OSD
  *
@@ -239,6 +278,44 @@ uint sandbox_spi_get_speed(struct udevice *dev);
  */
 uint sandbox_spi_get_mode(struct udevice *dev);
 
+/**
+ * struct sandbox_spi_stats - Transfer statistics of a sandbox spi bus
+ *
+ * The bus time is modelled on a controller which moves data through a FIFO
+ * by programmed I/O over a single data line, but which can also map a memory
+ * device and read from it over all the lines of the op, without the CPU
+ * touching each byte.
+ *
+ * @xfers: Number of transfers made through spi_xfer()
+ * @xfer_bytes: Number of bytes moved through spi_xfer()
+ * @dirmap_reads: Number of reads made through a direct mapping
+ * @dirmap_bytes: Number of bytes read through a direct mapping
+ * @bus_ns: Modelled time taken by all of these, in nanoseconds
+ */
+struct sandbox_spi_stats {
+	ulong xfers;
+	ulong xfer_bytes;
+	ulong dirmap_reads;
+	ulong dirmap_bytes;
+	u64 bus_ns;
+};
+
+/**
+ * sandbox_spi_get_stats() - Get the transfer statistics of a sandbox spi bus
+ *
+ * @dev: Device to check
+ * @stats: Returns the statistics since the bus was probed or last reset
+ */
+void sandbox_spi_get_stats(struct udevice *dev,
+			   struct sandbox_spi_stats *stats);
+
+/**
+ * sandbox_spi_reset_stats() - Reset the transfer statistics of a spi bus
+ *
+ * @dev: Device to reset
+ */
+void sandbox_spi_reset_stats(struct udevice *dev);
+
 /**
  * sandbox_get_pch_spi_protect() - Get the PCI SPI protection status
  *
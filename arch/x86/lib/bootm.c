@@ -45,6 +45,9 @@ void bootm_announce_and_cleanup(void)
 	bootstage_report();
 #endif
 
+	/* Write out any console output which is still buffered */
+	flush();
+
 	/*
 	 * Call remove function of all devices with a removal flag set.
 	 * This may be useful for last-stage operations, like cancelling
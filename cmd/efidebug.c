@@ -512,6 +512,26 @@ static int do_efi_show_images(struct cmd_tbl *cmdtp, int flag,
 	return CMD_RET_SUCCESS;
 }
 
+/**
+ * do_efi_show_disks() - show UEFI disk statistics
+ *
+ * @cmdtp:	Command table
+ * @flag:	Command flag
+ * @argc:	Number of arguments
+ * @argv:	Argument array
+ * Return:	CMD_RET_SUCCESS on success, CMD_RET_RET_FAILURE on failure
+ *
+ * Implement efidebug "disks" sub-command.
+ * Show how much data was transferred through each UEFI disk.
+ */
+static int do_efi_show_disks(struct cmd_tbl *cmdtp, int flag,
+			     int argc, char *const argv[])
+{
+	efi_disk_show_stats();
+
+	return CMD_RET_SUCCESS;
+}
+
 static const char * const efi_mem_type_string[] = {
 	[EFI_RESERVED_MEMORY_TYPE] = "RESERVED",
 	[EFI_LOADER_CODE] = "LOADER CODE",
@@ -1504,6 +1524,8 @@ static struct cmd_tbl cmd_efidebug_sub[] = {
 	U_BOOT_CMD_MKENT(capsule, CONFIG_SYS_MAXARGS, 1, do_efi_capsule,
 			 "", ""),
 #endif
+	U_BOOT_CMD_MKENT(disks, CONFIG_SYS_MAXARGS, 1, do_efi_show_disks,
+			 "", ""),
 	U_BOOT_CMD_MKENT(drivers, CONFIG_SYS_MAXARGS, 1, do_efi_show_drivers,
 			 "", ""),
 	U_BOOT_CMD_MKENT(dh, CONFIG_SYS_MAXARGS, 1, do_efi_show_handles,
@@ -1595,6 +1617,8 @@ U_BOOT_LONGHELP(efidebug,
 #endif
 	"\n"
 #endif
+	"efidebug disks\n"
+	"  - show UEFI disk transfer statistics\n"
 	"efidebug drivers\n"
 	"  - show UEFI drivers\n"
 	"efidebug dh\n"
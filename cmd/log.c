@@ -375,6 +375,24 @@ static int do_log_rec(struct cmd_tbl *cmdtp, int flag, int argc,
 	return 0;
 }
 
+static int __maybe_unused do_log_dump(struct cmd_tbl *cmdtp, int flag,
+				      int argc, char *const argv[])
+{
+	bool clear = false;
+
+	if (argc > 1) {
+		if (strcmp(argv[1], "-c"))
+			return CMD_RET_USAGE;
+		clear = true;
+	}
+	if (log_binary_dump(clear)) {
+		printf("No binary log records\n");
+		return CMD_RET_FAILURE;
+	}
+
+	return 0;
+}
+
 U_BOOT_LONGHELP(log,
 	"level [<level>] - get/set log level\n"
 	"categories - list log categories\n"
@@ -404,7 +422,12 @@ U_BOOT_LONGHELP(log,
 	"\tc=category, l=level, F=file, L=line number, f=function, m=msg\n"
 	"\tor 'default', or 'all' for all\n"
 	"log rec <category> <level> <file> <line> <func> <message> - "
-		"output a log record");
+		"output a log record"
+#if CONFIG_IS_ENABLED(LOG_BINARY)
+	"\nlog dump [-c] - show the records in the binary log\n"
+	"\t-c - Remove the records once they have been shown"
+#endif
+	);
 
 U_BOOT_CMD_WITH_SUBCMDS(log, "log system", log_help_text,
 	U_BOOT_SUBCMD_MKENT(level, 2, 1, do_log_level),
@@ -416,4 +439,7 @@ U_BOOT_CMD_WITH_SUBCMDS(log, "log system", log_help_text,
 	U_BOOT_SUBCMD_MKENT(filter-remove, 4, 1, do_log_filter_remove),
 	U_BOOT_SUBCMD_MKENT(format, 2, 1, do_log_format),
 	U_BOOT_SUBCMD_MKENT(rec, 7, 1, do_log_rec),
+#if CONFIG_IS_ENABLED(LOG_BINARY)
+	U_BOOT_SUBCMD_MKENT(dump, 2, 1, do_log_dump),
+#endif
 );
@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Show statistics about the malloc() heap
+ */
+
+#include <common.h>
+#include <command.h>
+#include <display_options.h>
+#include <malloc.h>
+#include <asm/global_data.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+static void show_classes(struct malloc_info *info)
+{
+	int i;
+
+	printf("\n%-10s %10s %10s %10s\n", "size", "allocs", "frees", "in use");
+	for (i = 0; i < MALLOC_NUM_CLASSES; i++) {
+		struct malloc_class_info *cls = &info->classes[i];
+		ulong size = malloc_class_size(i);
+
+		if (!cls->allocs)
+			continue;
+		if (size)
+			printf("<= %-7lu", size);
+		else
+			printf("> %-8lu", malloc_class_size(i - 1));
+		printf(" %10lu %10lu %10lu\n", cls->allocs, cls->frees,
+		       cls->bytes);
+	}
+}
+
+static void show_callers(struct malloc_info *info)
+{
+	int i;
+
+	if (!info->samples)
+		return;
+	printf("\n%lu samples, %lu replaced\n", info->samples,
+	       info->dropped);
+	printf("%-18s %10s %10s\n", "caller", "count", "bytes");
+	for (i = 0; i < MALLOC_NUM_CALLERS; i++) {
+		struct malloc_caller_info *ent = &info->callers[i];
+
+		if (ent->addr)
+			printf("%-18lx %10lu %10lu\n",
+			       (ulong)ent->addr - gd->reloc_off, ent->count,
+			       ent->bytes);
+	}
+}
+
+static int do_malloc_info(struct cmd_tbl *cmdtp, int flag, int argc,
+			  char *const argv[])
+{
+	struct malloc_info info;
+	int ret;
+
+	ret = malloc_get_info(&info);
+	if (ret) {
+		printf("Cannot get malloc() statistics (err=%d)\n", ret);
+		return CMD_RET_FAILURE;
+	}
+
+	printf("heap:      %lx-%lx, ", mem_malloc_start, mem_malloc_end);
+	print_size(mem_malloc_end - mem_malloc_start, "\n");
+	printf("brk:       ");
+	print_size(info.brk, ", peak ");
+	print_size(info.max_brk, "\n");
+	printf("in use:    ");
+	print_size(info.in_use, ", peak ");
+	print_size(info.max_in_use, "\n");
+	printf("free:      ");
+	print_size(info.free, "");
+	printf(" in %lu chunks (%lu in fast bins), largest ",
+	       info.free_chunks, info.fast_chunks);
+	print_size(info.largest_free, "\n");
+	printf("fragments: %lu%%\n", info.free ?
+	       (info.free - info.largest_free) * 100 / info.free : 0);
+	printf("fast hits: %lu\n", info.fast_hits);
+	show_classes(&info);
+	show_callers(&info);
+
+	return 0;
+}
+
+U_BOOT_LONGHELP(malloc,
+	"info - show heap usage, allocation counts and callers");
+
+U_BOOT_CMD_WITH_SUBCMDS(malloc, "malloc() heap", malloc_help_text,
+	U_BOOT_SUBCMD_MKENT(info, 1, 1, do_malloc_info));
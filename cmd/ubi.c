@@ -16,6 +16,7 @@
 #include <env.h>
 #include <exports.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <memalign.h>
 #include <mtd.h>
 #include <nand.h>
@@ -548,7 +549,7 @@ static int ubi_set_skip_check(char *volume, bool skip_check)
 	return ubi_change_vtbl_record(ubi, vol->vol_id, &vtbl_rec);
 }
 
-static int ubi_detach(void)
+static void ubi_unmount(void)
 {
 #ifdef CONFIG_CMD_UBIFS
 	/*
@@ -559,11 +560,28 @@ static int ubi_detach(void)
 	if (ubifs_is_mounted())
 		cmd_ubifs_umount();
 #endif
+}
+
+/* Check whether any UBI device is attached, whether selected or not */
+static bool ubi_attached(void)
+{
+	int i;
+
+	for (i = 0; i < UBI_MAX_DEVICES; i++)
+		if (ubi_devices[i])
+			return true;
+
+	return false;
+}
+
+static int ubi_detach(void)
+{
+	ubi_unmount();
 
 	/*
 	 * Call ubi_exit() before re-initializing the UBI subsystem
 	 */
-	if (ubi)
+	if (ubi_attached())
 		ubi_exit();
 
 	ubi = NULL;
@@ -571,6 +589,70 @@ static int ubi_detach(void)
 	return 0;
 }
 
+#ifdef CONFIG_CMD_UBI_PART_CACHE
+/* Same format as the VID header offset of ubi_mtd_param_parse() */
+static int ubi_parse_vid_offset(const char *vid_header_offset)
+{
+	char *endp;
+
+	if (!vid_header_offset)
+		return 0;
+
+	return ustrtoul(vid_header_offset, &endp, 0);
+}
+
+/*
+ * Find the UBI device which @part_name is attached to. A device attached with
+ * another VID header offset than requested is detached.
+ */
+static int ubi_find_attached(const char *part_name,
+			     const char *vid_header_offset)
+{
+	struct ubi_device *dev;
+	int i;
+
+	for (i = 0; i < UBI_MAX_DEVICES; i++) {
+		dev = ubi_devices[i];
+		if (!dev || strcmp(dev->mtd->name, part_name))
+			continue;
+		if (vid_header_offset &&
+		    ubi_parse_vid_offset(vid_header_offset) !=
+		    dev->vid_hdr_offset) {
+			/* Do not leave the selected device dangling */
+			if (dev == ubi)
+				ubi = NULL;
+			ubi_detach_mtd_dev(i, 1);
+			return -ENOENT;
+		}
+
+		return i;
+	}
+
+	return -ENOENT;
+}
+
+/*
+ * Attach @mtd as another UBI device, next to those which are attached
+ * already. Returns the UBI device number.
+ */
+static int ubi_dev_attach(struct mtd_info *mtd, const char *vid_header_offset)
+{
+	int ret;
+
+	/* UBI keeps this reference until the device is detached */
+	mtd = get_mtd_device_nm(mtd->name);
+	if (IS_ERR(mtd))
+		return PTR_ERR(mtd);
+
+	ret = ubi_attach_mtd_dev(mtd, UBI_DEV_NUM_AUTO,
+				 ubi_parse_vid_offset(vid_header_offset), 0);
+	if (ret < 0)
+		put_mtd_device(mtd);
+
+	return ret;
+}
+#endif
+
 int ubi_part(char *part_name, const char *vid_header_offset)
 {
 	struct mtd_info *mtd;
@@ -581,6 +663,45 @@ int ubi_part(char *part_name, const char *vid_header_offset)
 		return 0;
 	}
 
+#ifdef CONFIG_CMD_UBI_PART_CACHE
+	/*
+	 * Keep the current device attached, so that selecting it again does
+	 * not scan the flash. The selected device is always ubi0, as UBIFS
+	 * volume names such as "ubi0:rootfs" expect.
+	 */
+	if (ubi) {
+		int num;
+
+		/* On failure, the current device stays selected */
+		ubi_unmount();
+		num = ubi_find_attached(part_name, vid_header_offset);
+		if (num < 0) {
+			mtd_probe_devices();
+			mtd = get_mtd_device_nm(part_name);
+			if (IS_ERR(mtd)) {
+				printf("Partition %s not found!\n", part_name);
+				return 1;
+			}
+			put_mtd_device(mtd);
+
+			num = ubi_dev_attach(mtd, vid_header_offset);
+			if (num < 0) {
+				printf("UBI attach error %d\n", num);
+				return -num;
+			}
+		}
+
+		err = ubi_swap_devices(0, num);
+		if (err) {
+			printf("UBI device %d is busy\n", num);
+			return -err;
+		}
+		ubi = ubi_devices[0];
+
+		return 0;
+	}
+#endif
+
 	ubi_detach();
 
 	mtd_probe_devices();
@@ -739,6 +860,7 @@ static int do_ubi(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 	}
 
 	if (strncmp(argv[1], "write", 5) == 0) {
+		void *buf;
 		int ret;
 
 		if (argc < 5) {
@@ -748,21 +870,23 @@ static int do_ubi(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 
 		addr = hextoul(argv[2], NULL);
 		size = hextoul(argv[4], NULL);
+		buf = map_sysmem(addr, size);
 
 		if (strlen(argv[1]) == 10 &&
 		    strncmp(argv[1] + 5, ".part", 5) == 0) {
 			if (argc < 6) {
 				ret = ubi_volume_continue_write(argv[3],
-						(void *)addr, size);
+						buf, size);
 			} else {
 				size_t full_size;
 				full_size = hextoul(argv[5], NULL);
 				ret = ubi_volume_begin_write(argv[3],
-						(void *)addr, size, full_size);
+						buf, size, full_size);
 			}
 		} else {
-			ret = ubi_volume_write(argv[3], (void *)addr, size);
+			ret = ubi_volume_write(argv[3], buf, size);
 		}
+		unmap_sysmem(buf);
 		if (!ret) {
 			printf("%lld bytes written to volume %s\n", size,
 			       argv[3]);
@@ -787,7 +911,13 @@ static int do_ubi(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 		}
 
 		if (argc == 3) {
-			return ubi_volume_read(argv[3], (char *)addr, size);
+			void *buf = map_sysmem(addr, size);
+			int ret;
+
+			ret = ubi_volume_read(argv[3], buf, size);
+			unmap_sysmem(buf);
+
+			return ret;
 		}
 	}
 
@@ -195,8 +195,8 @@ static int initr_malloc(void)
 	ulong start;
 
 #if CONFIG_IS_ENABLED(SYS_MALLOC_F)
-	debug("Pre-reloc malloc() used %#lx bytes (%ld KB)\n", gd->malloc_ptr,
-	      gd->malloc_ptr / 1024);
+	debug("Pre-reloc malloc() used %#lx bytes (%ld KB), peak %ld KB\n",
+	      gd->malloc_ptr, gd->malloc_ptr / 1024, gd_malloc_peak() / 1024);
 #endif
 	/* The malloc area is immediately below the monitor copy in DRAM */
 	/*
@@ -214,7 +214,13 @@ int do_run(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[])
 			return 1;
 		}
 
-		ret = run_command(arg, flag | CMD_FLAG_ENV);
+		if (IS_ENABLED(CONFIG_HUSH_PARSE_CACHE) && use_hush_old())
+			ret = parse_string_outer_cached(argv[i], arg,
+							FLAG_PARSE_SEMICOLON |
+							FLAG_EXIT_FROM_LOOP |
+							FLAG_CONT_ON_NEWLINE);
+		else
+			ret = run_command(arg, flag | CMD_FLAG_ENV);
 		if (ret)
 			return ret;
 	}
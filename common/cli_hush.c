@@ -85,6 +85,7 @@
 #include <cli_hush.h>
 #include <command.h>        /* find_cmd */
 #include <asm/global_data.h>
+#include <u-boot/crc.h>
 #endif
 #ifndef __U_BOOT__
 #include <ctype.h>     /* isalpha, isdigit */
@@ -1550,6 +1551,7 @@ static int run_pipe_real(struct pipe *pi)
 	int flag = do_repeat ? CMD_FLAG_REPEAT : 0;
 	struct child_prog *child;
 	char *p;
+	int sp;
 # if __GNUC__
 	/* Avoid longjmp clobbering */
 	(void) &i;
@@ -1616,6 +1618,7 @@ static int run_pipe_real(struct pipe *pi)
 			}
 			return EXIT_SUCCESS;   /* don't worry about errors in set_local_var() yet */
 		}
+		sp = child->sp;
 		for (i = 0; is_assignment(child->argv[i]); i++) {
 			p = insert_var_value(child->argv[i]);
 #ifndef __U_BOOT__
@@ -1624,11 +1627,11 @@ static int run_pipe_real(struct pipe *pi)
 			set_local_var(p, 0);
 #endif
 			if (p != child->argv[i]) {
-				child->sp--;
+				sp--;
 				free(p);
 			}
 		}
-		if (child->sp) {
+		if (sp) {
 			char * str = NULL;
 
 			str = make_string(child->argv + i,
@@ -1762,6 +1765,7 @@ static int run_list_real(struct pipe *pi)
 	char **list = NULL;
 	char **save_list = NULL;
 	struct pipe *rpipe;
+	struct pipe *for_pipe = NULL;
 	int flag_rep = 0;
 #ifndef __U_BOOT__
 	int save_num_progs;
@@ -1800,7 +1804,8 @@ static int run_list_real(struct pipe *pi)
 				/* check Ctrl-C */
 				ctrlc();
 				if ((had_ctrlc())) {
-					return 1;
+					rcode = 1;
+					goto out;
 				}
 #endif
 				flag_restore = 0;
@@ -1830,6 +1835,7 @@ static int run_list_real(struct pipe *pi)
 					pi->progs->argv[0]);
 				save_list = list;
 				save_name = pi->progs->argv[0];
+				for_pipe = pi;
 				pi->progs->argv[0] = NULL;
 				flag_rep = 1;
 			}
@@ -1899,7 +1905,8 @@ static int run_list_real(struct pipe *pi)
 #else
 		if (rcode < -1) {
 			last_return_code = -rcode - 2;
-			return -2;	/* exit */
+			rcode = -2;	/* exit */
+			goto out;
 		}
 		last_return_code = rcode;
 #endif
@@ -1919,6 +1926,17 @@ static int run_list_real(struct pipe *pi)
 		checkjobs(NULL);
 #endif
 	}
+#ifdef __U_BOOT__
+out:
+	if (list) {
+		/* left a "for" loop early: put the pipe back as parsed */
+		while (*list)
+			free(*list++);
+		free(for_pipe->progs->argv[0]);
+		free(save_list);
+		for_pipe->progs->argv[0] = save_name;
+	}
+#endif
 	return rcode;
 }
 
@@ -3287,6 +3305,177 @@ int parse_string_outer(const char *s, int flag)
 #endif
 }
 
+#ifdef CONFIG_HUSH_PARSE_CACHE
+/*
+ * Cache of parsed scripts run from environment variables. A script is
+ * looked up by the name of its variable and is only reused while the
+ * variable still holds the same text, so changing the environment drops
+ * the parsed copy the next time the script is run.
+ */
+struct parse_cache_ent {
+	char *name;
+	char *text;
+	size_t len;
+	u32 hash;
+	int flag;
+	int busy;			/* nesting depth of running copies */
+	ulong used;			/* for LRU replacement */
+	struct pipe *list;
+};
+
+static struct parse_cache_ent parse_cache[CONFIG_HUSH_PARSE_CACHE_ENTRIES];
+static ulong parse_cache_clock;
+static struct hush_parse_cache_stats parse_cache_stats;
+
+static void parse_cache_drop(struct parse_cache_ent *ent)
+{
+	free_pipe_list(ent->list, 0);
+	free(ent->name);
+	free(ent->text);
+	memset(ent, '\0', sizeof(*ent));
+}
+
+/* Parse the whole of @s into a single pipe list, without running it */
+static struct pipe *parse_cache_parse(const char *s, size_t len, int flag)
+{
+	struct p_context ctx;
+	o_string temp = NULL_O_STRING;
+	struct in_str input;
+	char *p;
+	int rcode;
+
+	p = xmalloc(len + 2);
+	memcpy(p, s, len);
+	strcpy(p + len, "\n");
+	setup_string_in_str(&input, p);
+
+	ctx.type = flag;
+	initialize_context(&ctx);
+	update_ifs_map();
+	input.promptmode = 1;
+	rcode = parse_stream(&temp, &ctx, &input, -1);
+	if (rcode != 1 && ctx.old_flag == 0) {
+		done_word(&temp, &ctx);
+		done_pipe(&ctx, PIPE_SEQ);
+	} else {
+		/* let parse_string_outer() report the error */
+		if (ctx.old_flag != 0)
+			free(ctx.stack);
+		free_pipe_list(ctx.list_head, 0);
+		ctx.list_head = NULL;
+	}
+	b_free(&temp);
+	free(p);
+
+	return ctx.list_head;
+}
+
+static struct parse_cache_ent *parse_cache_lookup(const char *name,
+						  const char *s, int flag)
+{
+	struct parse_cache_ent *ent, *slot = NULL;
+	size_t len = strlen(s);
+	u32 hash = crc32(0, (const uchar *)s, len);
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(parse_cache); i++) {
+		ent = &parse_cache[i];
+		if (!ent->name) {
+			if (!slot || slot->name)
+				slot = ent;
+			continue;
+		}
+		if (strcmp(ent->name, name)) {
+			if (!ent->busy && (!slot || (slot->name &&
+						     ent->used < slot->used)))
+				slot = ent;
+			continue;
+		}
+		/* a running copy cannot be shared, since 'for' modifies it */
+		if (ent->busy)
+			return NULL;
+		if (ent->hash == hash && ent->len == len && ent->flag == flag &&
+		    !memcmp(ent->text, s, len)) {
+			parse_cache_stats.hits++;
+			ent->used = ++parse_cache_clock;
+			return ent;
+		}
+		/* the variable changed since it was parsed */
+		parse_cache_stats.stale++;
+		slot = ent;
+		break;
+	}
+	if (!slot)
+		return NULL;
+
+	if (slot->name) {
+		parse_cache_drop(slot);
+		parse_cache_stats.evictions++;
+	}
+	slot->list = parse_cache_parse(s, len, flag);
+	if (!slot->list)
+		return NULL;
+	slot->name = strdup(name);
+	slot->text = malloc(len);
+	if (!slot->name || !slot->text) {
+		parse_cache_drop(slot);
+		return NULL;
+	}
+	memcpy(slot->text, s, len);
+	slot->len = len;
+	slot->hash = hash;
+	slot->flag = flag;
+	slot->used = ++parse_cache_clock;
+	parse_cache_stats.misses++;
+
+	return slot;
+}
+
+int parse_string_outer_cached(const char *name, const char *s, int flag)
+{
+	struct parse_cache_ent *ent;
+	int code;
+
+	if (!s)
+		return 1;
+	if (!*s)
+		return 0;
+	/* IFS changes how the text is split, so only cache the default */
+	if (!(flag & FLAG_CONT_ON_NEWLINE) || env_get("IFS"))
+		return parse_string_outer(s, flag);
+
+	ent = parse_cache_lookup(name, s, flag);
+	if (!ent)
+		return parse_string_outer(s, flag);
+
+	ent->busy++;
+	code = run_list_real(ent->list);
+	ent->busy--;
+
+	if (code == -2)		/* exit */
+		return last_return_code;
+	if (code == -1)
+		flag_repeat = 0;
+
+	return code != 0 ? 1 : 0;
+}
+
+void hush_parse_cache_flush(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(parse_cache); i++) {
+		if (parse_cache[i].name && !parse_cache[i].busy)
+			parse_cache_drop(&parse_cache[i]);
+	}
+}
+
+void hush_parse_cache_get_stats(struct hush_parse_cache_stats *stats)
+{
+	*stats = parse_cache_stats;
+}
+#endif /* CONFIG_HUSH_PARSE_CACHE */
+
 #ifndef __U_BOOT__
 static int parse_file_outer(FILE *f)
 #else
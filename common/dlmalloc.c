@@ -13,11 +13,14 @@
 #endif
 
 #include <common.h>
+#include <errno.h>
 #include <log.h>
 #include <asm/global_data.h>
 
 #include <malloc.h>
 #include <asm/io.h>
+#include <linux/bitops.h>
+#include <linux/kernel.h>
 #include <valgrind/memcheck.h>
 
 #ifdef DEBUG
@@ -681,6 +684,40 @@ void mem_malloc_init(ulong start, ulong size)
 #define clear_binblock(ii)  (binblocks_w = (mbinptr)(binblocks_r & ~(idx2binblock(ii))))
 
 
+/*
+    Fast bins hold recently freed small chunks. They stay marked as in
+    use, so that neighbouring chunks do not coalesce with them, and are
+    singly linked through fd. malloc hands them back last-in first-out
+    without splitting or unlinking anything. Driver model, the live tree
+    and the environment allocate and free many small objects of a few
+    sizes, so most of those requests never reach the normal bins.
+
+    The chunks are merged back into the heap by malloc_consolidate()
+    before a large request is served and before the heap is grown.
+*/
+
+#define FASTBIN_MAX_SIZE    256   /* largest chunk kept in a fast bin */
+#define fastbin_index(sz)   (((unsigned long)(sz)) >> 3)
+#define NFASTBINS           (fastbin_index(FASTBIN_MAX_SIZE) + 1)
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_FASTBINS)
+static mchunkptr fastbins[NFASTBINS];
+static bool have_fastchunks;
+
+static void malloc_consolidate(void);
+#endif
+
+static void free_impl(Void_t *mem);
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_STATS)
+/* Statistics gathered by the allocator; the rest is added by malloc_get_info() */
+static struct malloc_info minfo;
+#if CONFIG_IS_ENABLED(SYS_MALLOC_PROFILE)
+static ulong malloc_sample_tick;
+#endif
+#endif
+
+
 
 
 
@@ -747,6 +784,13 @@ static void malloc_init(void)
 #ifdef DEBUG
 	memset((void *)&current_mallinfo, 0, sizeof(struct mallinfo));
 #endif
+#if CONFIG_IS_ENABLED(SYS_MALLOC_FASTBINS)
+	memset(fastbins, '\0', sizeof(fastbins));
+	have_fastchunks = false;
+#endif
+#if CONFIG_IS_ENABLED(SYS_MALLOC_STATS)
+	memset(&minfo, '\0', sizeof(minfo));
+#endif
 }
 #endif
 
@@ -1192,7 +1236,7 @@ static void malloc_extend_top(nb) INTERNAL_SIZE_T nb;
 	SIZE_SZ|PREV_INUSE;
       /* If possible, release the rest. */
       if (old_top_size >= MINSIZE)
-	fREe(chunk2mem(old_top));
+	free_impl(chunk2mem(old_top));
     }
   }
 
@@ -1208,6 +1252,119 @@ static void malloc_extend_top(nb) INTERNAL_SIZE_T nb;
 
 
 
+/*
+  Statistics
+
+    The public routines count what they hand out and take back, by the
+    size of the chunk. The internal routines do not, since realloc and
+    memalign split and free parts of chunks which the caller never saw.
+*/
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_STATS)
+
+/* Check whether a chunk came from this allocator rather than malloc_simple() */
+static bool malloc_counted(Void_t *mem)
+{
+	if (!mem)
+		return false;
+#if CONFIG_IS_ENABLED(SYS_MALLOC_F)
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return false;
+#endif
+
+	return !chunk_is_mmapped(mem2chunk(mem));
+}
+
+/* Get the size class of a chunk, see malloc_class_size() */
+static int malloc_class(INTERNAL_SIZE_T sz)
+{
+	return min(fls((sz - 1) >> 4), MALLOC_NUM_CLASSES - 1);
+}
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_PROFILE)
+/*
+ * Count a sample against its caller. When the table is full the caller with the
+ * fewest samples is replaced and the new one inherits its count, so that
+ * frequent callers are always present and their counts are never too low.
+ */
+static void malloc_sample(void *caller, size_t bytes)
+{
+	struct malloc_caller_info *ent, *min = NULL;
+	int i;
+
+	minfo.samples++;
+	for (i = 0; i < MALLOC_NUM_CALLERS; i++) {
+		ent = &minfo.callers[i];
+		if (ent->addr == caller || !ent->addr) {
+			ent->addr = caller;
+			ent->count++;
+			ent->bytes += bytes;
+			return;
+		}
+		if (!min || ent->count < min->count)
+			min = ent;
+	}
+	min->addr = caller;
+	min->count++;
+	min->bytes = bytes;
+	minfo.dropped++;
+}
+#endif
+
+static void malloc_count_alloc(Void_t *mem, size_t bytes, void *caller)
+{
+	struct malloc_class_info *cls;
+	INTERNAL_SIZE_T sz;
+
+	if (!malloc_counted(mem))
+		return;
+	sz = chunksize(mem2chunk(mem));
+	cls = &minfo.classes[malloc_class(sz)];
+	cls->allocs++;
+	cls->bytes += sz;
+	minfo.in_use += sz;
+	if (minfo.in_use > minfo.max_in_use)
+		minfo.max_in_use = minfo.in_use;
+#if CONFIG_IS_ENABLED(SYS_MALLOC_PROFILE)
+	if (!(++malloc_sample_tick % CONFIG_SYS_MALLOC_PROFILE_RATE))
+		malloc_sample(caller, bytes);
+#endif
+}
+
+static INTERNAL_SIZE_T malloc_counted_size(Void_t *mem)
+{
+	return malloc_counted(mem) ? chunksize(mem2chunk(mem)) : 0;
+}
+
+static void malloc_count_free(INTERNAL_SIZE_T sz)
+{
+	struct malloc_class_info *cls;
+
+	if (!sz)
+		return;
+	cls = &minfo.classes[malloc_class(sz)];
+	cls->frees++;
+	cls->bytes -= sz;
+	minfo.in_use -= sz;
+}
+
+#else
+
+static inline void malloc_count_alloc(Void_t *mem, size_t bytes, void *caller)
+{
+}
+
+static inline INTERNAL_SIZE_T malloc_counted_size(Void_t *mem)
+{
+	return 0;
+}
+
+static inline void malloc_count_free(INTERNAL_SIZE_T sz)
+{
+}
+
+#endif /* SYS_MALLOC_STATS */
+
 /* Main public routines */
 
 
@@ -1271,9 +1428,9 @@ static void malloc_extend_top(nb) INTERNAL_SIZE_T nb;
 */
 
 #if __STD_C
-Void_t* mALLOc(size_t bytes)
+static Void_t* malloc_impl(size_t bytes)
 #else
-Void_t* mALLOc(bytes) size_t bytes;
+static Void_t* malloc_impl(bytes) size_t bytes;
 #endif
 {
   mchunkptr victim;                  /* inspected/selected chunk */
@@ -1311,6 +1468,33 @@ Void_t* mALLOc(bytes) size_t bytes;
 
   nb = request2size(bytes);  /* padded request size; */
 
+#if CONFIG_IS_ENABLED(SYS_MALLOC_FASTBINS)
+  /* Reuse a recently freed chunk of exactly this size */
+
+  if (nb <= FASTBIN_MAX_SIZE)
+  {
+    idx = fastbin_index(nb);
+    victim = fastbins[idx];
+    if (victim)
+    {
+      fastbins[idx] = victim->fd;
+      check_inuse_chunk(victim);
+#if CONFIG_IS_ENABLED(SYS_MALLOC_STATS)
+      minfo.fast_hits++;
+#endif
+      VALGRIND_MALLOCLIKE_BLOCK(chunk2mem(victim), bytes, SIZE_SZ, false);
+      return chunk2mem(victim);
+    }
+  }
+
+  /* Large requests may fit in space held by fast bins once it is merged */
+
+  if (!is_small_request(nb) && have_fastchunks)
+    malloc_consolidate();
+
+ retry:
+#endif
+
   /* Check for exact match in a bin */
 
   if (is_small_request(nb))  /* Faster version for small requests */
@@ -1514,6 +1698,15 @@ Void_t* mALLOc(bytes) size_t bytes;
       return chunk2mem(victim);
 #endif
 
+#if CONFIG_IS_ENABLED(SYS_MALLOC_FASTBINS)
+    /* Merge the fast bins and look again before growing the heap */
+    if (have_fastchunks)
+    {
+      malloc_consolidate();
+      goto retry;
+    }
+#endif
+
     /* Try to extend */
     malloc_extend_top(nb);
     if ( (remainder_size = chunksize(top) - nb) < (long)MINSIZE)
@@ -1530,6 +1723,15 @@ Void_t* mALLOc(bytes) size_t bytes;
 
 }
 
+Void_t *mALLOc(size_t bytes)
+{
+	Void_t *mem = malloc_impl(bytes);
+
+	malloc_count_alloc(mem, bytes, __builtin_return_address(0));
+
+	return mem;
+}
+
 
 
 
@@ -1548,7 +1750,10 @@ Void_t* mALLOc(bytes) size_t bytes;
 	  topmost memory exceeds the trim threshold, malloc_trim is
 	  called.
 
-       4. Other chunks are consolidated as they arrive, and
+       4. Small chunks which do not border the top are placed in a fast
+	  bin, if CONFIG_SYS_MALLOC_FASTBINS is enabled.
+
+       5. Other chunks are consolidated as they arrive, and
 	  placed in corresponding bins. (This includes the case of
 	  consolidating with the current `last_remainder').
 
@@ -1556,13 +1761,12 @@ Void_t* mALLOc(bytes) size_t bytes;
 
 
 #if __STD_C
-void fREe(Void_t* mem)
+static void free_chunk(mchunkptr p)
 #else
-void fREe(mem) Void_t* mem;
+static void free_chunk(p) mchunkptr p;
 #endif
 {
-  mchunkptr p;         /* chunk corresponding to mem */
-  INTERNAL_SIZE_T hd;  /* its head field */
+  INTERNAL_SIZE_T hd = p->size; /* its head field */
   INTERNAL_SIZE_T sz;  /* its size */
   int       idx;       /* its bin index */
   mchunkptr next;      /* next contiguous chunk */
@@ -1572,34 +1776,9 @@ void fREe(mem) Void_t* mem;
   mchunkptr fwd;       /* misc temp for linking */
   int       islr;      /* track whether merging with last_remainder */
 
-#if CONFIG_IS_ENABLED(SYS_MALLOC_F)
-	/* free() is a no-op - all the memory will be freed on relocation */
-	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT)) {
-		VALGRIND_FREELIKE_BLOCK(mem, SIZE_SZ);
-		return;
-	}
-#endif
-
-  if (mem == NULL)                              /* free(0) has no effect */
-    return;
-
-  p = mem2chunk(mem);
-  hd = p->size;
-
-#if HAVE_MMAP
-  if (hd & IS_MMAPPED)                       /* release mmapped memory. */
-  {
-    munmap_chunk(p);
-    return;
-  }
-#endif
-
-  check_inuse_chunk(p);
-
   sz = hd & ~PREV_INUSE;
   next = chunk_at_offset(p, sz);
   nextsz = chunksize(next);
-  VALGRIND_FREELIKE_BLOCK(mem, SIZE_SZ);
 
   if (next == top)                            /* merge with top */
   {
@@ -1656,6 +1835,85 @@ void fREe(mem) Void_t* mem;
     frontlink(p, sz, idx, bck, fwd);
 }
 
+/* Release a chunk, placing it in a fast bin if possible */
+
+#if __STD_C
+static void free_impl(Void_t* mem)
+#else
+static void free_impl(mem) Void_t* mem;
+#endif
+{
+  mchunkptr p;         /* chunk corresponding to mem */
+#if CONFIG_IS_ENABLED(SYS_MALLOC_FASTBINS)
+  INTERNAL_SIZE_T sz;  /* its size */
+  int       idx;       /* its fast bin index */
+#endif
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_F)
+	/* free() is a no-op - all the memory will be freed on relocation */
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT)) {
+		VALGRIND_FREELIKE_BLOCK(mem, SIZE_SZ);
+		return;
+	}
+#endif
+
+  if (mem == NULL)                              /* free(0) has no effect */
+    return;
+
+  p = mem2chunk(mem);
+
+#if HAVE_MMAP
+  if (chunk_is_mmapped(p))                   /* release mmapped memory. */
+  {
+    munmap_chunk(p);
+    return;
+  }
+#endif
+
+  check_inuse_chunk(p);
+  VALGRIND_FREELIKE_BLOCK(mem, SIZE_SZ);
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_FASTBINS)
+  sz = chunksize(p);
+  if (sz <= FASTBIN_MAX_SIZE && chunk_at_offset(p, sz) != top)
+  {
+    idx = fastbin_index(sz);
+    p->fd = fastbins[idx];
+    fastbins[idx] = p;
+    have_fastchunks = true;
+    return;
+  }
+#endif
+
+  free_chunk(p);
+}
+
+void fREe(Void_t *mem)
+{
+	malloc_count_free(malloc_counted_size(mem));
+	free_impl(mem);
+}
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_FASTBINS)
+/* Move the chunks in the fast bins back into the normal bins or the top */
+static void malloc_consolidate(void)
+{
+	mchunkptr p, next;
+	int i;
+
+	/* Each list is detached first, since freeing may trim the heap */
+	have_fastchunks = false;
+	for (i = 0; i < NFASTBINS; i++) {
+		p = fastbins[i];
+		fastbins[i] = NULL;
+		for (; p; p = next) {
+			next = p->fd;
+			free_chunk(p);
+		}
+	}
+}
+#endif
+
 
 
 
@@ -1697,9 +1955,9 @@ void fREe(mem) Void_t* mem;
 
 
 #if __STD_C
-Void_t* rEALLOc(Void_t* oldmem, size_t bytes)
+static Void_t* realloc_impl(Void_t* oldmem, size_t bytes)
 #else
-Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
+static Void_t* realloc_impl(oldmem, bytes) Void_t* oldmem; size_t bytes;
 #endif
 {
   INTERNAL_SIZE_T    nb;      /* padded request size */
@@ -1725,7 +1983,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
 
 #ifdef REALLOC_ZERO_BYTES_FREES
   if (!bytes) {
-	fREe(oldmem);
+	free_impl(oldmem);
 	return NULL;
   }
 #endif
@@ -1733,7 +1991,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
   if ((long)bytes < 0) return NULL;
 
   /* realloc of null is supposed to be same as malloc */
-  if (oldmem == NULL) return mALLOc(bytes);
+  if (oldmem == NULL) return malloc_impl(bytes);
 
 #if CONFIG_IS_ENABLED(SYS_MALLOC_F)
 	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT)) {
@@ -1758,7 +2016,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
     /* Note the extra SIZE_SZ overhead. */
     if(oldsize - SIZE_SZ >= nb) return oldmem; /* do nothing */
     /* Must alloc, copy, free. */
-    newmem = mALLOc(bytes);
+    newmem = malloc_impl(bytes);
     if (!newmem)
 	return NULL; /* propagate failure */
     MALLOC_COPY(newmem, oldmem, oldsize - 2*SIZE_SZ);
@@ -1869,7 +2127,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
 
     /* Must allocate */
 
-    newmem = mALLOc (bytes);
+    newmem = malloc_impl(bytes);
 
     if (newmem == NULL)  /* propagate failure */
       return NULL;
@@ -1886,7 +2144,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
 
     /* Otherwise copy, free, and exit */
     MALLOC_COPY(newmem, oldmem, oldsize - SIZE_SZ);
-    fREe(oldmem);
+    free_impl(oldmem);
     return newmem;
   } else {
     VALGRIND_RESIZEINPLACE_BLOCK(oldmem, 0, bytes, SIZE_SZ);
@@ -1905,7 +2163,7 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
     set_inuse_bit_at_offset(remainder, remainder_size);
     VALGRIND_MALLOCLIKE_BLOCK(chunk2mem(remainder), remainder_size, SIZE_SZ,
 			      false);
-    fREe(chunk2mem(remainder)); /* let free() deal with it */
+    free_impl(chunk2mem(remainder)); /* let free() deal with it */
   }
   else
   {
@@ -1917,6 +2175,19 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
   return chunk2mem(newp);
 }
 
+Void_t *rEALLOc(Void_t *oldmem, size_t bytes)
+{
+	INTERNAL_SIZE_T oldsize = malloc_counted_size(oldmem);
+	Void_t *mem = realloc_impl(oldmem, bytes);
+
+	if (mem) {
+		malloc_count_free(oldsize);
+		malloc_count_alloc(mem, bytes, __builtin_return_address(0));
+	}
+
+	return mem;
+}
+
 
 
 
@@ -1940,9 +2211,9 @@ Void_t* rEALLOc(oldmem, bytes) Void_t* oldmem; size_t bytes;
 
 
 #if __STD_C
-Void_t* mEMALIGn(size_t alignment, size_t bytes)
+static Void_t* memalign_impl(size_t alignment, size_t bytes)
 #else
-Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
+static Void_t* memalign_impl(alignment, bytes) size_t alignment; size_t bytes;
 #endif
 {
   INTERNAL_SIZE_T    nb;      /* padded  request size */
@@ -1965,7 +2236,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
 
   /* If need less alignment than we give anyway, just relay to malloc */
 
-  if (alignment <= MALLOC_ALIGNMENT) return mALLOc(bytes);
+  if (alignment <= MALLOC_ALIGNMENT) return malloc_impl(bytes);
 
   /* Otherwise, ensure that it is at least a minimum chunk size */
 
@@ -1974,7 +2245,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
   /* Call malloc with worst case padding to hit alignment. */
 
   nb = request2size(bytes);
-  m  = (char*)(mALLOc(nb + alignment + MINSIZE));
+  m  = (char*)(malloc_impl(nb + alignment + MINSIZE));
 
   /*
   * The attempt to over-allocate (with a size large enough to guarantee the
@@ -1990,7 +2261,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
      * Use bytes not nb, since mALLOc internally calls request2size too, and
      * each call increases the size to allocate, to account for the header.
      */
-    m  = (char*)(mALLOc(bytes));
+    m  = (char*)(malloc_impl(bytes));
     /* Aligned -> return it */
     if ((((unsigned long)(m)) % alignment) == 0)
       return m;
@@ -1998,10 +2269,10 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
      * Otherwise, try again, requesting enough extra space to be able to
      * acquire alignment.
      */
-    fREe(m);
+    free_impl(m);
     /* Add in extra bytes to match misalignment of unexpanded allocation */
     extra = alignment - (((unsigned long)(m)) % alignment);
-    m  = (char*)(mALLOc(bytes + extra));
+    m  = (char*)(malloc_impl(bytes + extra));
     /*
      * m might not be the same as before. Validate that the previous value of
      * extra still works for the current value of m.
@@ -2010,7 +2281,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
     if (m) {
       extra2 = alignment - (((unsigned long)(m)) % alignment);
       if (extra2 > extra) {
-        fREe(m);
+        free_impl(m);
         m = NULL;
       }
     }
@@ -2060,7 +2331,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
     set_head(newp, newsize | PREV_INUSE);
     set_inuse_bit_at_offset(newp, newsize);
     set_head_size(p, leadsize);
-    fREe(chunk2mem(p));
+    free_impl(chunk2mem(p));
     p = newp;
     VALGRIND_MALLOCLIKE_BLOCK(chunk2mem(p), bytes, SIZE_SZ, false);
 
@@ -2078,7 +2349,7 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
     set_head_size(p, nb);
     VALGRIND_MALLOCLIKE_BLOCK(chunk2mem(remainder), remainder_size, SIZE_SZ,
 			      false);
-    fREe(chunk2mem(remainder));
+    free_impl(chunk2mem(remainder));
   }
 
   check_inuse_chunk(p);
@@ -2086,6 +2357,15 @@ Void_t* mEMALIGn(alignment, bytes) size_t alignment; size_t bytes;
 
 }
 
+Void_t *mEMALIGn(size_t alignment, size_t bytes)
+{
+	Void_t *mem = memalign_impl(alignment, bytes);
+
+	malloc_count_alloc(mem, bytes, __builtin_return_address(0));
+
+	return mem;
+}
+
 
 
 
@@ -2127,9 +2407,9 @@ Void_t* pvALLOc(bytes) size_t bytes;
 */
 
 #if __STD_C
-Void_t* cALLOc(size_t n, size_t elem_size)
+static Void_t* calloc_impl(size_t n, size_t elem_size)
 #else
-Void_t* cALLOc(n, elem_size) size_t n; size_t elem_size;
+static Void_t* calloc_impl(n, elem_size) size_t n; size_t elem_size;
 #endif
 {
   mchunkptr p;
@@ -2145,7 +2425,7 @@ Void_t* cALLOc(n, elem_size) size_t n; size_t elem_size;
   INTERNAL_SIZE_T oldtopsize = chunksize(top);
 #endif
 #endif
-  Void_t* mem = mALLOc (sz);
+  Void_t* mem = malloc_impl(sz);
 
   if ((long)n < 0) return NULL;
 
@@ -2186,6 +2466,15 @@ Void_t* cALLOc(n, elem_size) size_t n; size_t elem_size;
   }
 }
 
+Void_t *cALLOc(size_t n, size_t elem_size)
+{
+	Void_t *mem = calloc_impl(n, elem_size);
+
+	malloc_count_alloc(mem, n * elem_size, __builtin_return_address(0));
+
+	return mem;
+}
+
 /*
 
   cfree just calls free. It is needed/defined on some systems
@@ -2355,6 +2644,18 @@ static void malloc_update_mallinfo(void)
     }
   }
 
+#if CONFIG_IS_ENABLED(SYS_MALLOC_FASTBINS)
+  for (i = 0; i < NFASTBINS; ++i)
+  {
+    for (p = fastbins[i]; p; p = p->fd)
+    {
+      check_inuse_chunk(p);
+      avail += chunksize(p);
+      navail++;
+    }
+  }
+#endif
+
   current_mallinfo.ordblks = navail;
   current_mallinfo.uordblks = sbrked_mem - avail;
   current_mallinfo.fordblks = avail;
@@ -2411,6 +2712,53 @@ struct mallinfo mALLINFo(void)
 }
 #endif	/* DEBUG */
 
+int malloc_get_info(struct malloc_info *info)
+{
+#if CONFIG_IS_ENABLED(SYS_MALLOC_STATS)
+	ulong top_free;
+	mchunkptr p;
+	mbinptr b;
+	int i;
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_F)
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return -EPERM;
+#endif
+	*info = minfo;
+	info->brk = sbrked_mem;
+	info->max_brk = max_sbrked_mem;
+
+	/* The top chunk can grow into the rest of the malloc() region */
+	top_free = chunksize(top) + mem_malloc_end - mem_malloc_brk;
+	info->free = top_free;
+	info->largest_free = top_free;
+	info->free_chunks = 0;
+	info->fast_chunks = 0;
+	for (i = 1; i < NAV; i++) {
+		b = bin_at(i);
+		for (p = last(b); p != b; p = p->bk) {
+			info->free += chunksize(p);
+			info->largest_free = max_t(ulong, info->largest_free,
+						   chunksize(p));
+			info->free_chunks++;
+		}
+	}
+#if CONFIG_IS_ENABLED(SYS_MALLOC_FASTBINS)
+	for (i = 0; i < NFASTBINS; i++) {
+		for (p = fastbins[i]; p; p = p->fd) {
+			info->free += chunksize(p);
+			info->fast_chunks++;
+		}
+	}
+	info->free_chunks += info->fast_chunks;
+#endif
+
+	return 0;
+#else
+	return -ENOSYS;
+#endif
+}
+
 
 
 
@@ -2459,6 +2807,7 @@ int initf_malloc(void)
 	assert(gd->malloc_base);	/* Set up by crt0.S */
 	gd->malloc_limit = CONFIG_VAL(SYS_MALLOC_F_LEN);
 	gd->malloc_ptr = 0;
+	gd->malloc_peak = 0;
 #endif
 
 	return 0;
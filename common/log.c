@@ -207,6 +207,7 @@ static int log_dispatch(struct log_rec *rec, const char *fmt, va_list args)
 {
 	struct log_device *ldev;
 	char buf[CONFIG_SYS_CBSIZE];
+	va_list copy;
 
 	/*
 	 * When a log driver writes messages (e.g. via the network stack) this
@@ -221,10 +222,22 @@ static int log_dispatch(struct log_rec *rec, const char *fmt, va_list args)
 	list_for_each_entry(ldev, &gd->log_head, sibling_node) {
 		if ((ldev->flags & LOGDF_ENABLE) &&
 		    log_passes_filters(ldev, rec)) {
+			/* Binary devices record the arguments, not the message */
+			if (ldev->flags & LOGDF_BINARY) {
+				va_copy(copy, args);
+				rec->fmt = fmt;
+				rec->args = &copy;
+				ldev->drv->emit(ldev, rec);
+				rec->args = NULL;
+				va_end(copy);
+				continue;
+			}
 			if (!rec->msg) {
 				int len;
 
-				len = vsnprintf(buf, sizeof(buf), fmt, args);
+				va_copy(copy, args);
+				len = vsnprintf(buf, sizeof(buf), fmt, copy);
+				va_end(copy);
 				rec->msg = buf;
 				gd->log_cont = len && buf[len - 1] != '\n';
 			}
@@ -261,6 +274,8 @@ int _log(enum log_category_t cat, enum log_level_t level, const char *file,
 	rec.line = line;
 	rec.func = func;
 	rec.msg = NULL;
+	rec.fmt = NULL;
+	rec.args = NULL;
 
 	if (!(gd->flags & GD_FLG_LOG_READY)) {
 		gd->log_drop_count++;
@@ -458,6 +473,11 @@ int log_init(void)
 	gd->flags |= GD_FLG_LOG_READY;
 	if (!gd->default_log_level)
 		gd->default_log_level = CONFIG_LOG_DEFAULT_LEVEL;
+
+#if CONFIG_IS_ENABLED(LOG_BINARY)
+	/* The binary log keeps more detail than is shown on the console */
+	log_add_filter("binary", NULL, CONFIG_LOG_BINARY_LEVEL, NULL);
+#endif
 	gd->log_fmt = log_get_default_format();
 	gd->logc_prev = LOGC_NONE;
 	gd->logl_prev = LOGL_INFO;
@@ -0,0 +1,527 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Log driver which keeps records in binary form
+ *
+ * Formatting a message is the most expensive part of logging it. This driver
+ * stores the format string pointer and the raw arguments of each record in a
+ * ring buffer instead, and only formats the messages when they are shown with
+ * 'log dump'. The file and function names, and strings passed as arguments,
+ * are copied into the record, since they may not be around later.
+ */
+
+#include <common.h>
+#include <log.h>
+#include <malloc.h>
+#include <membuff.h>
+#include <asm/global_data.h>
+#include <linux/ctype.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/* Largest record, so that one message cannot push out the whole log */
+#define LOG_BIN_MAX_REC		256
+
+/* Record flag, in addition to enum log_rec_flags: arguments did not fit */
+#define LOG_BINF_TRUNC		BIT(7)
+
+/**
+ * struct log_bin_hdr - Header of a binary log record
+ *
+ * The file and function names follow the header, as nul-terminated strings
+ * which are empty if there is no name. Then come the arguments, in the order
+ * in which @fmt uses them
+ *
+ * @size: Size of the record in bytes, including this header
+ * @line: Line number where the log record was generated
+ * @cat: Category, see struct log_rec
+ * @level: Severity level
+ * @flags: Flags for the record (enum log_rec_flags, LOG_BINF_TRUNC)
+ * @fmt: Format string for the message
+ */
+struct log_bin_hdr {
+	u16 size;
+	u16 line;
+	u16 cat;
+	u8 level;
+	u8 flags;
+	const char *fmt;
+};
+
+/**
+ * struct log_bin_priv - Private data for the binary log driver
+ *
+ * @mb: Ring buffer holding the records
+ * @lost: Number of records dropped to make space for newer ones
+ * @buf: Space for the ring buffer
+ */
+struct log_bin_priv {
+	struct membuff mb;
+	uint lost;
+	char buf[];
+};
+
+/**
+ * enum log_bin_arg - How an argument is stored in a record
+ *
+ * @LOG_BIN_NONE: No argument, e.g. for %%
+ * @LOG_BIN_INT: int
+ * @LOG_BIN_LONG: long, size_t or ptrdiff_t
+ * @LOG_BIN_LLONG: long long
+ * @LOG_BIN_PTR: Pointer which is shown as an address
+ * @LOG_BIN_STR: String, which is copied into the record
+ * @LOG_BIN_NOW: Pointer to data which must be formatted when recording, e.g.
+ *	for %pU, stored as a string
+ * @LOG_BIN_SKIP: Pointer which is not stored (%n)
+ */
+enum log_bin_arg {
+	LOG_BIN_NONE,
+	LOG_BIN_INT,
+	LOG_BIN_LONG,
+	LOG_BIN_LLONG,
+	LOG_BIN_PTR,
+	LOG_BIN_STR,
+	LOG_BIN_NOW,
+	LOG_BIN_SKIP,
+};
+
+/**
+ * struct log_bin_spec - A conversion in a format string
+ *
+ * @start: Pointer to the '%'
+ * @end: Pointer to the character after the conversion
+ * @stars: Number of int arguments for the width and precision (0 to 2)
+ * @arg: How the argument is stored
+ */
+struct log_bin_spec {
+	const char *start;
+	const char *end;
+	int stars;
+	enum log_bin_arg arg;
+};
+
+/**
+ * log_bin_parse() - Parse a conversion in a format string
+ *
+ * This follows the syntax accepted by vsnprintf()
+ *
+ * @p: Pointer to the '%' starting the conversion
+ * @spec: Returns information about the conversion
+ * Return: pointer to the character after the conversion
+ */
+static const char *log_bin_parse(const char *p, struct log_bin_spec *spec)
+{
+	char qual = 0;
+
+	spec->start = p++;
+	spec->stars = 0;
+	while (*p && strchr("-+ #0", *p))
+		p++;
+	if (*p == '*') {
+		spec->stars++;
+		p++;
+	}
+	while (isdigit(*p))
+		p++;
+	if (*p == '.') {
+		if (*++p == '*') {
+			spec->stars++;
+			p++;
+		}
+		while (isdigit(*p))
+			p++;
+	}
+	if (*p && strchr("hlLZzt", *p)) {
+		qual = *p++;
+		if (qual == 'l' && *p == 'l') {
+			qual = 'L';
+			p++;
+		}
+	}
+
+	switch (*p) {
+	case 'c':
+		spec->arg = LOG_BIN_INT;
+		break;
+	case 'd':
+		if (p[1] == 'E')
+			p++;
+		fallthrough;
+	case 'i':
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+		if (qual == 'L')
+			spec->arg = LOG_BIN_LLONG;
+		else if (qual && strchr("lZzt", qual))
+			spec->arg = LOG_BIN_LONG;
+		else
+			spec->arg = LOG_BIN_INT;
+		break;
+	case 's':
+		/* Leave UTF-16 strings to vsnprintf() */
+		spec->arg = qual == 'l' ? LOG_BIN_NOW : LOG_BIN_STR;
+		break;
+	case 'p':
+		spec->arg = isalnum(p[1]) ? LOG_BIN_NOW : LOG_BIN_PTR;
+		while (isalnum(p[1]))
+			p++;
+		break;
+	case 'n':
+		spec->arg = LOG_BIN_SKIP;
+		break;
+	default:
+		spec->arg = LOG_BIN_NONE;
+		break;
+	}
+	if (*p)
+		p++;
+	spec->end = p;
+
+	return p;
+}
+
+/**
+ * log_bin_spec_text() - Get the text of a conversion, without any '*'
+ *
+ * @spec: Conversion to process
+ * @star: Values to use for the width and precision given by '*'
+ * @buf: Returns the conversion as a nul-terminated string
+ * @size: Size of @buf
+ */
+static void log_bin_spec_text(const struct log_bin_spec *spec, const int *star,
+			      char *buf, int size)
+{
+	const char *p;
+	int len = 0;
+
+	for (p = spec->start; p < spec->end && len < size - 12; p++) {
+		if (*p != '*') {
+			buf[len++] = *p;
+			continue;
+		}
+		/* A negative precision is the same as none */
+		if (p[-1] == '.' && *star < 0)
+			len += sprintf(buf + len, "0");
+		else
+			len += sprintf(buf + len, "%d", *star);
+		star++;
+	}
+	buf[len] = '\0';
+}
+
+/* Add data to a record, returning false if there is no space */
+static bool log_bin_put(char **outp, char *end, const void *data, int len)
+{
+	if (*outp + len > end)
+		return false;
+	memcpy(*outp, data, len);
+	*outp += len;
+
+	return true;
+}
+
+/* Add a string to a record, truncating it if there is not enough space */
+static bool log_bin_put_str(char **outp, char *end, const char *str)
+{
+	int len, room = end - *outp;
+
+	if (room < 1)
+		return false;
+	len = min((int)strlen(str), room - 1);
+	memcpy(*outp, str, len);
+	(*outp)[len] = '\0';
+	*outp += len + 1;
+
+	return true;
+}
+
+/**
+ * log_bin_encode() - Store the arguments of a record
+ *
+ * If there is not enough space, the arguments up to the first one which does
+ * not fit are kept
+ *
+ * @fmt: Format string for the record
+ * @args: Arguments for @fmt
+ * @outp: Place to store the arguments, updated to point after them
+ * @end: End of the space for the arguments
+ * Return: true if all the arguments were stored, false if not
+ */
+static bool log_bin_encode(const char *fmt, va_list *args, char **outp,
+			   char *end)
+{
+	char *out = *outp;
+	char text[32], str[CONFIG_SYS_CBSIZE];
+	struct log_bin_spec spec;
+	int star[2], i;
+	long long llval;
+	void *ptr;
+	long lval;
+	int ival;
+	bool ok;
+
+	for (fmt = strchr(fmt, '%'); fmt; fmt = strchr(fmt, '%')) {
+		fmt = log_bin_parse(fmt, &spec);
+		for (i = 0; i < spec.stars; i++) {
+			star[i] = va_arg(*args, int);
+			ok = log_bin_put(&out, end, &star[i], sizeof(star[i]));
+			if (!ok)
+				goto done;
+		}
+
+		switch (spec.arg) {
+		case LOG_BIN_INT:
+			ival = va_arg(*args, int);
+			ok = log_bin_put(&out, end, &ival, sizeof(ival));
+			break;
+		case LOG_BIN_LONG:
+			lval = va_arg(*args, long);
+			ok = log_bin_put(&out, end, &lval, sizeof(lval));
+			break;
+		case LOG_BIN_LLONG:
+			llval = va_arg(*args, long long);
+			ok = log_bin_put(&out, end, &llval, sizeof(llval));
+			break;
+		case LOG_BIN_PTR:
+			ptr = va_arg(*args, void *);
+			ok = log_bin_put(&out, end, &ptr, sizeof(ptr));
+			break;
+		case LOG_BIN_STR:
+			ptr = va_arg(*args, char *);
+			ok = log_bin_put_str(&out, end, ptr ? ptr : "<NULL>");
+			break;
+		case LOG_BIN_NOW:
+			log_bin_spec_text(&spec, star, text, sizeof(text));
+			snprintf(str, sizeof(str), text, va_arg(*args, void *));
+			ok = log_bin_put_str(&out, end, str);
+			break;
+		case LOG_BIN_SKIP:
+			va_arg(*args, void *);
+			fallthrough;
+		default:
+			ok = true;
+			break;
+		}
+		if (!ok)
+			goto done;
+	}
+	ok = true;
+done:
+	*outp = out;
+
+	return ok;
+}
+
+/* Get data from a record, returning false if there is none left */
+static bool log_bin_get(const char **inp, const char *end, void *data, int len)
+{
+	if (*inp + len > end)
+		return false;
+	memcpy(data, *inp, len);
+	*inp += len;
+
+	return true;
+}
+
+/* Get a string from a record, returning NULL if it is empty or missing */
+static const char *log_bin_get_str(const char **inp, const char *end)
+{
+	const char *str = *inp;
+
+	if (str >= end)
+		return NULL;
+	*inp += strnlen(str, end - str) + 1;
+
+	return *str ? str : NULL;
+}
+
+/**
+ * log_bin_format() - Format the message for a record
+ *
+ * If the arguments were truncated, the message stops at the first conversion
+ * whose argument is missing
+ *
+ * @fmt: Format string for the record
+ * @in: Arguments for @fmt, as written by log_bin_encode()
+ * @end: End of the arguments
+ * @buf: Returns the message
+ * @size: Size of @buf
+ */
+static void log_bin_format(const char *fmt, const char *in, const char *end,
+			   char *buf, int size)
+{
+	struct log_bin_spec spec;
+	char *out = buf, *out_end = buf + size;
+	char text[32];
+	int star[2], i, len;
+	long long llval;
+	void *ptr;
+	long lval;
+	int ival;
+
+	while (*fmt && out < out_end - 1) {
+		if (*fmt != '%') {
+			*out++ = *fmt++;
+			continue;
+		}
+		fmt = log_bin_parse(fmt, &spec);
+		for (i = 0; i < spec.stars; i++) {
+			if (!log_bin_get(&in, end, &star[i], sizeof(star[i])))
+				goto done;
+		}
+		log_bin_spec_text(&spec, star, text, sizeof(text));
+
+		switch (spec.arg) {
+		case LOG_BIN_INT:
+			if (!log_bin_get(&in, end, &ival, sizeof(ival)))
+				goto done;
+			len = snprintf(out, out_end - out, text, ival);
+			break;
+		case LOG_BIN_LONG:
+			if (!log_bin_get(&in, end, &lval, sizeof(lval)))
+				goto done;
+			len = snprintf(out, out_end - out, text, lval);
+			break;
+		case LOG_BIN_LLONG:
+			if (!log_bin_get(&in, end, &llval, sizeof(llval)))
+				goto done;
+			len = snprintf(out, out_end - out, text, llval);
+			break;
+		case LOG_BIN_PTR:
+			if (!log_bin_get(&in, end, &ptr, sizeof(ptr)))
+				goto done;
+			len = snprintf(out, out_end - out, text, ptr);
+			break;
+		case LOG_BIN_STR:
+		case LOG_BIN_NOW:
+			if (in >= end)
+				goto done;
+			if (spec.arg == LOG_BIN_NOW)
+				strcpy(text, "%s");
+			len = snprintf(out, out_end - out, text, in);
+			in += strnlen(in, end - in) + 1;
+			break;
+		case LOG_BIN_SKIP:
+			len = 0;
+			break;
+		default:
+			len = snprintf(out, out_end - out, text);
+			break;
+		}
+		out += min(len, (int)(out_end - out) - 1);
+	}
+done:
+	*out = '\0';
+}
+
+/* Drop the oldest record in the buffer */
+static void log_bin_drop(struct log_bin_priv *priv)
+{
+	struct log_bin_hdr hdr;
+	char *data;
+	int len, n;
+
+	membuff_get(&priv->mb, (char *)&hdr, sizeof(hdr));
+	for (len = hdr.size - sizeof(hdr); len > 0; len -= n) {
+		n = membuff_getraw(&priv->mb, len, true, &data);
+		if (!n)
+			break;
+	}
+	priv->lost++;
+}
+
+static int log_binary_emit(struct log_device *ldev, struct log_rec *rec)
+{
+	struct log_bin_priv *priv = ldev->priv;
+	char buf[LOG_BIN_MAX_REC] __aligned(sizeof(long));
+	struct log_bin_hdr *hdr = (struct log_bin_hdr *)buf;
+	char *end, *buf_end = buf + sizeof(buf);
+
+	/* Leave the small pre-relocation malloc() area alone */
+	if (!priv) {
+		if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+			return 0;
+		priv = calloc(1, sizeof(*priv) + CONFIG_LOG_BINARY_SIZE);
+		if (!priv)
+			return -ENOMEM;
+		membuff_init(&priv->mb, priv->buf, CONFIG_LOG_BINARY_SIZE);
+		ldev->priv = priv;
+	}
+
+	hdr->line = rec->line;
+	hdr->cat = rec->cat;
+	hdr->level = rec->level;
+	hdr->flags = rec->flags;
+	hdr->fmt = rec->fmt;
+	end = buf + sizeof(*hdr);
+	if (!log_bin_put_str(&end, buf_end, rec->file ? rec->file : "") ||
+	    !log_bin_put_str(&end, buf_end, rec->func ? rec->func : "") ||
+	    !log_bin_encode(rec->fmt, rec->args, &end, buf_end))
+		hdr->flags |= LOG_BINF_TRUNC;
+	hdr->size = end - buf;
+
+	if (hdr->size >= membuff_size(&priv->mb))
+		return -ENOSPC;
+	while (membuff_free(&priv->mb) < hdr->size)
+		log_bin_drop(priv);
+	membuff_put(&priv->mb, buf, hdr->size);
+
+	return 0;
+}
+
+int log_binary_dump(bool clear)
+{
+	struct log_device *ldev = log_device_find_by_name("binary");
+	char buf[LOG_BIN_MAX_REC], msg[CONFIG_SYS_CBSIZE];
+	struct log_bin_priv *priv;
+	struct log_bin_hdr hdr;
+	struct membuff mb;
+	struct log_rec rec;
+	const char *in;
+	int len;
+
+	if (!ldev || !ldev->priv)
+		return -ENOENT;
+	priv = ldev->priv;
+	if (priv->lost)
+		printf("(%u older records lost)\n", priv->lost);
+
+	/* Work on a copy, so that the records stay in the buffer */
+	mb = priv->mb;
+	while (membuff_get(&mb, (char *)&hdr, sizeof(hdr)) == sizeof(hdr)) {
+		len = hdr.size - sizeof(hdr);
+		if (membuff_get(&mb, buf, len) != len)
+			break;
+
+		memset(&rec, '\0', sizeof(rec));
+		in = buf;
+		rec.file = log_bin_get_str(&in, buf + len);
+		rec.func = log_bin_get_str(&in, buf + len);
+		log_bin_format(hdr.fmt, in, buf + len, msg, sizeof(msg));
+		rec.cat = hdr.cat;
+		rec.level = hdr.level;
+		rec.line = hdr.line;
+		rec.flags = hdr.flags & ~LOG_BINF_TRUNC;
+		rec.msg = msg;
+		if (CONFIG_IS_ENABLED(LOG_CONSOLE))
+			LOG_GET_DRIVER(console)->emit(ldev, &rec);
+		else
+			puts(msg);
+		if (hdr.flags & LOG_BINF_TRUNC)
+			puts("...\n");
+	}
+
+	if (clear) {
+		membuff_purge(&priv->mb);
+		priv->lost = 0;
+	}
+
+	return 0;
+}
+
+LOG_DRIVER(binary) = {
+	.name	= "binary",
+	.emit	= log_binary_emit,
+	.flags	= LOGDF_ENABLE | LOGDF_BINARY,
+};
@@ -86,8 +86,27 @@ void free_simple(void *ptr)
 #endif
 #endif
 
+ulong malloc_simple_mark(void)
+{
+	return gd->malloc_base + gd->malloc_ptr;
+}
+
+void malloc_simple_release(ulong mark)
+{
+	ulong end = gd->malloc_base + gd->malloc_ptr;
+
+	if (mark < gd->malloc_base || mark > end) {
+		log_debug("mark %lx is outside the region\n", mark);
+		return;
+	}
+	log_debug("release %lx bytes\n", end - mark);
+	gd->malloc_peak = gd_malloc_peak();
+	gd->malloc_ptr = mark - gd->malloc_base;
+}
+
 void malloc_simple_info(void)
 {
-	log_info("malloc_simple: %lx bytes used, %lx remain\n", gd->malloc_ptr,
-		 CONFIG_VAL(SYS_MALLOC_F_LEN) - gd->malloc_ptr);
+	log_info("malloc_simple: %lx bytes used, %lx remain, peak %lx\n",
+		 gd->malloc_ptr, CONFIG_VAL(SYS_MALLOC_F_LEN) - gd->malloc_ptr,
+		 gd_malloc_peak());
 }
@@ -465,6 +465,7 @@ static int spl_common_init(bool setup_malloc)
 #endif
 		gd->malloc_limit = CONFIG_VAL(SYS_MALLOC_F_LEN);
 		gd->malloc_ptr = 0;
+		gd->malloc_peak = 0;
 	}
 #endif
 	ret = bootstage_init(u_boot_first_phase());
@@ -782,8 +783,9 @@ void board_init_r(gd_t *dummy1, ulong dummy2)
 	}
 	if (CONFIG_IS_ENABLED(SYS_MALLOC_F) &&
 	    !IS_ENABLED(CONFIG_SPL_SYS_MALLOC_SIZE))
-		debug("SPL malloc() used 0x%lx bytes (%ld KB)\n",
-		      gd_malloc_ptr(), gd_malloc_ptr() / 1024);
+		debug("SPL malloc() used 0x%lx bytes (%ld KB), peak %ld KB\n",
+		      gd_malloc_ptr(), gd_malloc_ptr() / 1024,
+		      gd_malloc_peak() / 1024);
 
 	bootstage_mark_name(get_bootstage_id(false), "end phase");
 	ret = bootstage_stash_default();
@@ -893,12 +895,14 @@ ulong spl_relocate_stack_gd(void)
 
 #if defined(CONFIG_SPL_SYS_MALLOC_SIMPLE) && CONFIG_IS_ENABLED(SYS_MALLOC_F)
 	if (CONFIG_SPL_STACK_R_MALLOC_SIMPLE_LEN) {
-		debug("SPL malloc() before relocation used 0x%lx bytes (%ld KB)\n",
-		      gd->malloc_ptr, gd->malloc_ptr / 1024);
+		debug("SPL malloc() before relocation used 0x%lx bytes (%ld KB), peak %ld KB\n",
+		      gd->malloc_ptr, gd->malloc_ptr / 1024,
+		      gd_malloc_peak() / 1024);
 		ptr -= CONFIG_SPL_STACK_R_MALLOC_SIMPLE_LEN;
 		gd->malloc_base = ptr;
 		gd->malloc_limit = CONFIG_SPL_STACK_R_MALLOC_SIMPLE_LEN;
 		gd->malloc_ptr = 0;
+		gd->malloc_peak = 0;
 	}
 #endif
 	/* Get stack position: use 8-byte alignment for ABI compliance */
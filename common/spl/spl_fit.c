@@ -5,11 +5,13 @@
  */
 
 #include <common.h>
+#include <bootstage.h>
 #include <errno.h>
 #include <fpga.h>
 #include <gzip.h>
 #include <image.h>
 #include <log.h>
+#include <malloc.h>
 #include <memalign.h>
 #include <mapmem.h>
 #include <spl.h>
@@ -18,14 +20,44 @@
 #include <asm/io.h>
 #include <linux/libfdt.h>
 #include <linux/printk.h>
+#include <linux/sizes.h>
+#include <u-boot/lz4.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
+/* Most images whose reads are planned in one go */
+#define SPL_FIT_MAX_EXTENTS	16
+
+/* Largest gap between images which is read over rather than skipped */
+#define SPL_FIT_MERGE_GAP	SZ_4K
+
+/**
+ * struct spl_fit_extent - external data of an image, read ahead of loading
+ *
+ * @node:	FDT offset of the image node
+ * @offset:	Offset of the data from the start of the FIT, in bytes
+ * @size:	Size of the data in bytes
+ * @buf:	Data, once read, or NULL if it must be read when loading
+ * @run:	Buffer holding @buf and the data of the other images read with
+ *		it, to be freed once they are all loaded
+ */
+struct spl_fit_extent {
+	int node;
+	int offset;
+	int size;
+	void *buf;
+	void *run;
+};
+
 struct spl_fit_info {
 	const void *fit;	/* Pointer to a valid FIT blob */
 	size_t ext_data_offset;	/* Offset to FIT external data (end of FIT) */
 	int images_node;	/* FDT offset to "/images" node */
 	int conf_node;		/* FDT offset to selected configuration node */
+	struct spl_fit_extent *extents;	/* Planned reads, or NULL if none */
+	int extent_count;	/* Number of entries in @extents */
+	ulong malloc_mark;	/* malloc_simple() mark before the planned reads */
+	ulong malloc_end;	/* malloc_simple() mark after the planned reads */
 };
 
 __weak int board_spl_fit_post_load(const void *fit, struct spl_image_info *spl_image)
@@ -196,6 +228,280 @@ static int get_aligned_image_size(struct spl_load_info *info, int data_size,
 	return ALIGN(data_size, spl_get_bl_len(info));
 }
 
+/**
+ * spl_fit_get_ext_data() - Find where the external data of an image is
+ *
+ * @ctx:	FIT context
+ * @node:	Offset of the image node
+ * @offsetp:	Returns the offset of the data from the start of the FIT
+ * @lenp:	Returns the size of the data
+ * Return: 0 if OK, -ENOENT if the image has no external data (or no size)
+ */
+static int spl_fit_get_ext_data(const struct spl_fit_info *ctx, int node,
+				int *offsetp, int *lenp)
+{
+	if (!fit_image_get_data_position(ctx->fit, node, offsetp)) {
+		/* already relative to the start of the FIT */
+	} else if (!fit_image_get_data_offset(ctx->fit, node, offsetp)) {
+		*offsetp += ctx->ext_data_offset;
+	} else {
+		return -ENOENT;
+	}
+
+	if (fit_image_get_data_size(ctx->fit, node, lenp))
+		return -ENOENT;
+
+	return 0;
+}
+
+/*
+ * Check if an image can be decompressed in place, i.e. it is an lz4 image and
+ * has the sizes needed to place the compressed data at the end of its load area
+ */
+static bool spl_fit_get_inplace(const void *fit, int node, ulong *uncomp_sizep,
+				ulong *marginp)
+{
+	uint8_t image_comp = IH_COMP_NONE;
+	const fdt32_t *size, *margin;
+
+	if (!IS_ENABLED(CONFIG_SPL_LZ4))
+		return false;
+
+	fit_image_get_comp(fit, node, &image_comp);
+	size = fdt_getprop(fit, node, FIT_UNCOMP_SIZE_PROP, NULL);
+	margin = fdt_getprop(fit, node, FIT_DECOMP_MARGIN_PROP, NULL);
+	if (image_comp != IH_COMP_LZ4 || !size || !margin)
+		return false;
+	*uncomp_sizep = fdt32_to_cpu(*size);
+	*marginp = fdt32_to_cpu(*margin);
+
+	return true;
+}
+
+/**
+ * spl_fit_inplace_addr() - Find where to read an image decompressed in place
+ *
+ * The read ends at the end of the load area, so the blocks read after the
+ * data move it down by up to a block, and rounding the address down by up to
+ * ARCH_DMA_MINALIGN more. This must fit in the part of the margin which binman
+ * leaves for it.
+ *
+ * @end:	End of the load area, i.e. load address + uncomp-size + margin
+ * @size:	Number of bytes to read, in whole blocks
+ * @tail:	Number of bytes read after the data
+ * @addrp:	Returns the address to read to
+ * Return: true if OK, false if the read needs more slack than there is
+ */
+static bool spl_fit_inplace_addr(ulong end, ulong size, ulong tail,
+				 ulong *addrp)
+{
+	ulong addr = ALIGN_DOWN(end - size, ARCH_DMA_MINALIGN);
+
+	if (end - size - addr + tail > FIT_DECOMP_READ_SLACK)
+		return false;
+	*addrp = addr;
+
+	return true;
+}
+
+/*
+ * Check if an image is read straight to its load address, i.e. it is not
+ * compressed and both its offset and its load address are suitably aligned, or
+ * it is decompressed in place
+ */
+static bool spl_fit_reads_direct(const struct spl_fit_info *ctx,
+				 struct spl_load_info *info, int node,
+				 int offset)
+{
+	uint8_t image_comp = IH_COMP_NONE;
+	ulong load_addr, uncomp_size, margin;
+
+	/* This is read to the end of its load area instead */
+	if (spl_fit_get_inplace(ctx->fit, node, &uncomp_size, &margin))
+		return true;
+
+	if (spl_decompression_enabled())
+		fit_image_get_comp(ctx->fit, node, &image_comp);
+
+	return image_comp == IH_COMP_NONE &&
+		!get_aligned_image_overhead(info, offset) &&
+		!fit_image_get_load(ctx->fit, node, &load_addr) &&
+		IS_ALIGNED(load_addr, ARCH_DMA_MINALIGN);
+}
+
+/**
+ * spl_fit_free_reads() - Free what is left of the reads planned for a FIT
+ *
+ * This frees the buffers holding images which were not loaded, e.g. after an
+ * error, along with the plan itself. Since free() does nothing with
+ * malloc_simple(), the space is handed back with malloc_simple_release() too,
+ * provided that nothing else has been allocated since the reads were planned.
+ *
+ * @ctx:	FIT context
+ */
+static void spl_fit_free_reads(struct spl_fit_info *ctx)
+{
+	struct spl_fit_extent *ext = ctx->extents;
+	int i, j;
+
+	for (i = 0; i < ctx->extent_count; i++) {
+		if (!ext[i].buf)
+			continue;
+		/* Free each buffer once, whichever images are still in it */
+		for (j = i + 1; j < ctx->extent_count; j++) {
+			if (ext[j].run == ext[i].run)
+				ext[j].buf = NULL;
+		}
+		free(ext[i].run);
+	}
+	free(ext);
+	ctx->extents = NULL;
+	ctx->extent_count = 0;
+
+	if (malloc_simple_mark() == ctx->malloc_end)
+		malloc_simple_release(ctx->malloc_mark);
+	ctx->malloc_end = 0;
+}
+
+/**
+ * spl_fit_plan_reads() - Read the data of images which lie close together
+ *
+ * Each image is normally read on its own, which costs a separate command on
+ * most devices. This finds the images in the selected configuration and reads
+ * those which lie within SPL_FIT_MERGE_GAP of each other with a single read
+ * into a buffer, so that load_simple_fit() only has to copy them into place.
+ * Images which can be read straight to their load address are left alone,
+ * since that avoids the copy.
+ *
+ * This is only an optimisation; any image which is not read here is read when
+ * it is loaded, as before.
+ *
+ * @ctx:	FIT context
+ * @info:	Device to read from
+ * @fit_offset:	Offset of the FIT on the device
+ */
+static void spl_fit_plan_reads(struct spl_fit_info *ctx,
+			       struct spl_load_info *info, ulong fit_offset)
+{
+	static const char *const props[] = {
+		FIT_FIRMWARE_PROP, FIT_KERNEL_PROP, FIT_FDT_PROP,
+		FIT_LOADABLE_PROP,
+	};
+	struct spl_fit_extent *ext;
+	int i, j, n, node, offset, len;
+	int first, start, end, reads = 0;
+	void *buf;
+
+	ctx->malloc_mark = malloc_simple_mark();
+	ext = calloc(SPL_FIT_MAX_EXTENTS, sizeof(*ext));
+	if (!ext)
+		return;
+
+	/* Collect the external images, sorted by offset */
+	for (i = 0, n = 0; i < ARRAY_SIZE(props); i++) {
+		for (j = 0; n < SPL_FIT_MAX_EXTENTS; j++) {
+			int k;
+
+			node = spl_fit_get_image_node(ctx, props[i], j);
+			if (node < 0)
+				break;
+			if (spl_fit_get_ext_data(ctx, node, &offset, &len) ||
+			    !len || spl_fit_reads_direct(ctx, info, node, offset))
+				continue;
+			for (k = 0; k < n && ext[k].node != node; k++)
+				;
+			if (k < n)
+				continue;
+			for (k = n++; k && ext[k - 1].offset > offset; k--)
+				ext[k] = ext[k - 1];
+			ext[k].node = node;
+			ext[k].offset = offset;
+			ext[k].size = len;
+		}
+	}
+
+	/* Read each run of two or more nearby images in one go */
+	for (first = 0; first < n; first = i) {
+		start = get_aligned_image_offset(info, ext[first].offset);
+		end = ext[first].offset + ext[first].size;
+		for (i = first + 1; i < n &&
+		     ext[i].offset <= end + SPL_FIT_MERGE_GAP; i++)
+			end = max(end, ext[i].offset + ext[i].size);
+		if (i - first < 2)
+			continue;
+
+		len = get_aligned_image_size(info, end - start, 0);
+		buf = malloc_cache_aligned(len);
+		if (!buf)
+			continue;
+		if (info->read(info, fit_offset + start, len, buf) <
+		    end - start) {
+			free(buf);
+			continue;
+		}
+		reads++;
+		for (j = first; j < i; j++) {
+			ext[j].buf = buf + ext[j].offset - start;
+			ext[j].run = buf;
+		}
+		debug("%s: read %d images at %x, size %x\n", __func__,
+		      i - first, start, len);
+	}
+	debug("%s: %d images in %d reads\n", __func__, n, reads);
+
+	/* Drop the images which are still to be read separately */
+	for (i = 0, j = 0; i < n; i++) {
+		if (ext[i].buf)
+			ext[j++] = ext[i];
+	}
+	ctx->extents = ext;
+	ctx->extent_count = j;
+	ctx->malloc_end = malloc_simple_mark();
+	if (!j)
+		spl_fit_free_reads(ctx);
+}
+
+/**
+ * spl_fit_take_data() - Get the data of an image read by spl_fit_plan_reads()
+ *
+ * @ctx:	FIT context
+ * @node:	Offset of the image node
+ * @runp:	Returns the buffer to pass to spl_fit_release_run() once the data
+ *		has been used
+ * Return: the data, or NULL if the image must be read
+ */
+static void *spl_fit_take_data(const struct spl_fit_info *ctx, int node,
+			       void **runp)
+{
+	struct spl_fit_extent *ext = ctx->extents;
+	void *buf;
+	int i;
+
+	for (i = 0; i < ctx->extent_count; i++) {
+		if (ext[i].node == node && ext[i].buf) {
+			buf = ext[i].buf;
+			ext[i].buf = NULL;
+			*runp = ext[i].run;
+			return buf;
+		}
+	}
+
+	return NULL;
+}
+
+/* Free a buffer from spl_fit_plan_reads() once all its images are loaded */
+static void spl_fit_release_run(const struct spl_fit_info *ctx, void *run)
+{
+	struct spl_fit_extent *ext = ctx->extents;
+	int i;
+
+	for (i = 0; i < ctx->extent_count; i++) {
+		if (ext[i].run == run && ext[i].buf)
+			return;
+	}
+	free(run);
+}
+
 #if defined(CONFIG_DUAL_BOOTLOADER) && defined(CONFIG_IMX_TRUSTY_OS)
 __weak int get_tee_load(ulong *load)
 {
@@ -231,10 +537,14 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 	void *load_ptr;
 	void *src;
 	ulong overhead;
+	ulong uncomp_size, margin;
+	bool inplace;
 	uint8_t image_comp = -1, type = -1;
 	const void *data;
 	const void *fit = ctx->fit;
 	bool external_data = false;
+	void *run = NULL;
+	int ret = 0;
 
 	if (IS_ENABLED(CONFIG_SPL_FPGA) ||
 	    (IS_ENABLED(CONFIG_SPL_OS_BOOT) && spl_decompression_enabled())) {
@@ -248,6 +558,7 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 		fit_image_get_comp(fit, node, &image_comp);
 		debug("%s ", genimg_get_comp_name(image_comp));
 	}
+	inplace = spl_fit_get_inplace(fit, node, &uncomp_size, &margin);
 
 	if (fit_image_get_load(fit, node, &load_addr)) {
 		if (!image_info->load_addr) {
@@ -273,20 +584,14 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 	}
 #endif
 
-	if (!fit_image_get_data_position(fit, node, &offset)) {
+	if (!spl_fit_get_ext_data(ctx, node, &offset, &len))
 		external_data = true;
-	} else if (!fit_image_get_data_offset(fit, node, &offset)) {
-		offset += ctx->ext_data_offset;
-		external_data = true;
-	}
 
 	if (external_data) {
+		ulong src_addr;
 		void *src_ptr;
 
 		/* External data */
-		if (fit_image_get_data_size(fit, node, &len))
-			return -ENOENT;
-
 		/* Dont bother to copy 0 byte data, but warn, though */
 		if (!len) {
 			log_warning("%s: Skip load '%s': image size is 0!\n",
@@ -294,25 +599,44 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 			return 0;
 		}
 
-		if (spl_decompression_enabled() &&
-		    (image_comp == IH_COMP_GZIP || image_comp == IH_COMP_LZMA))
-			src_ptr = map_sysmem(ALIGN(CONFIG_SYS_LOAD_ADDR, ARCH_DMA_MINALIGN), len);
-		else
-			src_ptr = map_sysmem(ALIGN(load_addr, ARCH_DMA_MINALIGN), len);
 		length = len;
+		src = spl_fit_take_data(ctx, node, &run);
+		if (!src) {
+			overhead = get_aligned_image_overhead(info, offset);
+			size = get_aligned_image_size(info, length, offset);
 
-		overhead = get_aligned_image_overhead(info, offset);
-		size = get_aligned_image_size(info, length, offset);
-
-		if (info->read(info,
-			       fit_offset +
-			       get_aligned_image_offset(info, offset), size,
-			       src_ptr) < length)
-			return -EIO;
+			/*
+			 * Read to the end of the load area, so the data is
+			 * decompressed over itself
+			 */
+			if (inplace &&
+			    spl_fit_inplace_addr(load_addr + uncomp_size +
+						 margin, size,
+						 size - overhead - length,
+						 &src_addr))
+				src_ptr = map_sysmem(src_addr, size);
+			else if (spl_decompression_enabled() &&
+				 (image_comp == IH_COMP_GZIP ||
+				  image_comp == IH_COMP_LZMA ||
+				  image_comp == IH_COMP_LZ4))
+				src_ptr = map_sysmem(ALIGN(CONFIG_SYS_LOAD_ADDR,
+							   ARCH_DMA_MINALIGN),
+						     len);
+			else
+				src_ptr = map_sysmem(ALIGN(load_addr,
+							   ARCH_DMA_MINALIGN),
+						     len);
+
+			if (info->read(info,
+				       fit_offset +
+				       get_aligned_image_offset(info, offset),
+				       size, src_ptr) < length)
+				return -EIO;
+			src = src_ptr + overhead;
+		}
 
-		debug("External data: dst=%p, offset=%x, size=%lx\n",
-		      src_ptr, offset, (unsigned long)length);
-		src = src_ptr + overhead;
+		debug("External data: src=%p, offset=%x, size=%lx\n",
+		      src, offset, (unsigned long)length);
 	} else {
 		/* Embedded data */
 		if (fit_image_get_data(fit, node, &data, &length)) {
@@ -328,8 +652,10 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 		printf("## Checking hash(es) for Image %s ... ",
 		       fit_get_name(fit, node, NULL));
 		if (!fit_image_verify_with_data(fit, node, gd_fdt_blob(), src,
-						length))
-			return -EPERM;
+						length)) {
+			ret = -EPERM;
+			goto out;
+		}
 		puts("OK\n");
 	}
 
@@ -341,7 +667,8 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 		size = length;
 		if (gunzip(load_ptr, CONFIG_SYS_BOOTM_LEN, src, &size)) {
 			puts("Uncompressing error\n");
-			return -EIO;
+			ret = -EIO;
+			goto out;
 		}
 		length = size;
 	} else if (IS_ENABLED(CONFIG_SPL_LZMA) && image_comp == IH_COMP_LZMA) {
@@ -351,12 +678,27 @@ static int load_simple_fit(struct spl_load_info *info, ulong fit_offset,
 		if (image_decomp(IH_COMP_LZMA, CONFIG_SYS_LOAD_ADDR, 0, 0,
 				 load_ptr, src, length, size, &loadEnd)) {
 			puts("Uncompressing error\n");
-			return -EIO;
+			ret = -EIO;
+			goto out;
 		}
 		length = loadEnd - CONFIG_SYS_LOAD_ADDR;
-	} else {
+	} else if (IS_ENABLED(CONFIG_SPL_LZ4) && image_comp == IH_COMP_LZ4) {
+		size_t unc_len = inplace ? uncomp_size : CONFIG_SYS_BOOTM_LEN;
+
+		if (ulz4fn(src, length, load_ptr, &unc_len)) {
+			puts("Uncompressing error\n");
+			ret = -EIO;
+			goto out;
+		}
+		length = unc_len;
+	} else if (load_ptr != src) {
 		memcpy(load_ptr, src, length);
 	}
+out:
+	if (run)
+		spl_fit_release_run(ctx, run);
+	if (ret)
+		return ret;
 
 	if (image_info) {
 		ulong entry_point;
@@ -429,6 +771,7 @@ static int spl_fit_append_fdt(struct spl_image_info *spl_image,
 		ret = load_simple_fit(info, offset, ctx, node, &image_info);
 		if (ret < 0)
 			return ret;
+		bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "fit_fdt");
 
 		spl_image->fdt_addr = phys_to_virt(image_info.load_addr);
 	}
@@ -437,6 +780,8 @@ static int spl_fit_append_fdt(struct spl_image_info *spl_image,
 		return 0;
 
 #if CONFIG_IS_ENABLED(LOAD_FIT_APPLY_OVERLAY)
+		/* The overlays are only needed until they have been applied */
+		ulong mark = malloc_simple_mark();
 		void *tmpbuffer = NULL;
 
 		for (; ; index++) {
@@ -481,6 +826,7 @@ static int spl_fit_append_fdt(struct spl_image_info *spl_image,
 					      &image_info);
 			if (ret < 0)
 				break;
+			bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "fit_overlay");
 
 			/* Make room in FDT for changes from the overlay */
 			ret = fdt_increase_size(spl_image->fdt_addr,
@@ -500,6 +846,7 @@ static int spl_fit_append_fdt(struct spl_image_info *spl_image,
 			      fit_get_name(ctx->fit, node, NULL));
 		}
 		free(tmpbuffer);
+		malloc_simple_release(mark);
 		if (ret)
 			return ret;
 #endif
@@ -674,6 +1021,7 @@ static int spl_fit_load_fpga(struct spl_fit_info *ctx,
 		printf("%s: Cannot load the FPGA: %i\n", __func__, ret);
 		return ret;
 	}
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "fit_fpga");
 
 	return spl_fit_upload_fpga(ctx, node, &fpga_image);
 }
@@ -742,7 +1090,7 @@ int spl_load_simple_fit(struct spl_image_info *spl_image,
 			struct spl_load_info *info, ulong offset, void *fit)
 {
 	struct spl_image_info image_info;
-	struct spl_fit_info ctx;
+	struct spl_fit_info ctx = { };
 	int node = -1;
 	int ret;
 	int index = 0;
@@ -775,6 +1123,11 @@ int spl_load_simple_fit(struct spl_image_info *spl_image,
 		spl_image->rbindex = rbindex;
 #endif
 
+	if (CONFIG_IS_ENABLED(FIT_READ_PLAN)) {
+		spl_fit_plan_reads(&ctx, info, offset);
+		bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "fit_read_plan");
+	}
+
 	if (IS_ENABLED(CONFIG_SPL_FPGA))
 		spl_fit_load_fpga(&ctx, info, offset);
 
@@ -802,13 +1155,15 @@ int spl_load_simple_fit(struct spl_image_info *spl_image,
 	if (node < 0) {
 		debug("%s: Cannot find u-boot image node: %d\n",
 		      __func__, node);
-		return -1;
+		ret = -1;
+		goto out;
 	}
 
 	/* Load the image and set up the spl_image structure */
 	ret = load_simple_fit(info, offset, &ctx, node, spl_image);
 	if (ret)
-		return ret;
+		goto out;
+	bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "fit_firmware");
 
 	/*
 	 * For backward compatibility, we treat the first node that is
@@ -826,7 +1181,7 @@ int spl_load_simple_fit(struct spl_image_info *spl_image,
 	if (os_takes_devicetree(spl_image->os)) {
 		ret = spl_fit_append_fdt(spl_image, info, offset, &ctx);
 		if (ret < 0 && spl_image->os != IH_OS_U_BOOT)
-			return ret;
+			goto out;
 	}
 
 	firmware_node = node;
@@ -851,8 +1206,9 @@ int spl_load_simple_fit(struct spl_image_info *spl_image,
 		if (ret < 0) {
 			printf("%s: can't load image loadables index %d (ret = %d)\n",
 			       __func__, index, ret);
-			return ret;
+			goto out;
 		}
+		bootstage_mark_name(BOOTSTAGE_ID_ALLOC, "fit_loadable");
 
 		if (spl_fit_image_is_fpga(ctx.fit, node))
 			spl_fit_upload_fpga(&ctx, node, &image_info);
@@ -889,8 +1245,14 @@ int spl_load_simple_fit(struct spl_image_info *spl_image,
 		spl_image->entry_point = spl_image->load_addr;
 
 	spl_image->flags |= SPL_FIT_FOUND;
+	spl_fit_free_reads(&ctx);
 
 	return board_spl_fit_post_load(ctx.fit, spl_image);
+
+out:
+	spl_fit_free_reads(&ctx);
+
+	return ret;
 }
 
 /* Parse and load full fitImage in SPL */
@@ -87,7 +87,7 @@ int spl_load_legacy_lzma(struct spl_image_info *spl_image,
 {
 	SizeT lzma_len = LZMA_LEN;
 	void *src;
-	ulong dataptr, overhead, size;
+	ulong dataptr, overhead, size, mark;
 	int ret;
 
 	/* dataptr points to compressed payload  */
@@ -99,6 +99,8 @@ int spl_load_legacy_lzma(struct spl_image_info *spl_image,
 
 	debug("LZMA: Decompressing %08lx to %08lx\n",
 	      dataptr, spl_image->load_addr);
+	/* The compressed data and the decoder state are only needed here */
+	mark = malloc_simple_mark();
 	src = malloc(size);
 	if (!src) {
 		printf("Unable to allocate %d bytes for LZMA\n",
@@ -110,6 +112,8 @@ int spl_load_legacy_lzma(struct spl_image_info *spl_image,
 	ret = lzmaBuffToBuffDecompress(map_sysmem(spl_image->load_addr,
 						  spl_image->size), &lzma_len,
 				       src + overhead, spl_image->size);
+	free(src);
+	malloc_simple_release(mark);
 	if (ret) {
 		printf("LZMA decompression error: %d\n", ret);
 		return ret;
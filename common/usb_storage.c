@@ -44,9 +44,11 @@
 #include <asm/byteorder.h>
 #include <asm/cache.h>
 #include <asm/processor.h>
+#include <asm/unaligned.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
 #include <linux/delay.h>
+#include <linux/usb/uas.h>
 
 #include <part.h>
 #include <usb.h>
@@ -88,6 +90,8 @@ struct us_data {
 	unsigned char	ep_in;			/* in endpoint */
 	unsigned char	ep_out;			/* out ....... */
 	unsigned char	ep_int;			/* interrupt . */
+	unsigned char	ep_cmd;			/* UAS command */
+	unsigned char	ep_status;		/* UAS status */
 	unsigned char	subclass;		/* as in overview */
 	unsigned char	protocol;		/* .............. */
 	unsigned char	attention_done;		/* force attn on first cmd */
@@ -177,6 +181,10 @@ static unsigned int usb_get_max_lun(struct us_data *us)
 {
 	int len;
 	ALLOC_CACHE_ALIGN_BUFFER(unsigned char, result, 1);
+
+	/* This is a Bulk-Only request; only LUN 0 is used with UAS */
+	if (us->protocol == US_PR_UAS)
+		return 0;
 	len = usb_control_msg(us->pusb_dev,
 			      usb_rcvctrlpipe(us->pusb_dev, 0),
 			      US_BBB_GET_MAX_LUN,
@@ -956,6 +964,282 @@ do_retry:
 	return USB_STOR_TRANSPORT_FAILED;
 }
 
+#ifdef CONFIG_USB_STORAGE_UAS
+/*
+ * USB Attached SCSI
+ *
+ * Without streams the device announces the data phase of each command with
+ * a Read Ready or Write Ready IU on the status pipe, carrying the tag of the
+ * command, and finishes it with a Sense IU. So several commands can be sent
+ * before collecting their status, letting the device prepare the data for
+ * one while the data for another is transferred.
+ */
+
+/* Number of commands to queue on the device at once */
+#define USB_STOR_UAS_QUEUE	4
+
+static int usb_stor_UAS_send(struct us_data *us, void *iu, int len)
+{
+	int actlen;
+
+	return usb_bulk_msg(us->pusb_dev,
+			    usb_sndbulkpipe(us->pusb_dev, us->ep_cmd), iu, len,
+			    &actlen, USB_CNTL_TIMEOUT * 5);
+}
+
+static int usb_stor_UAS_get_status(struct us_data *us, struct sense_iu *iu)
+{
+	int actlen, result;
+
+	result = usb_bulk_msg(us->pusb_dev,
+			      usb_rcvbulkpipe(us->pusb_dev, us->ep_status), iu,
+			      sizeof(*iu), &actlen, USB_CNTL_TIMEOUT * 5);
+	if (result < 0)
+		return result;
+
+	return actlen < sizeof(struct iu) ? -EIO : actlen;
+}
+
+/*
+ * Abort everything queued on the device with a logical unit reset, then
+ * clear any stalls which that leaves on the pipes
+ */
+static int usb_stor_UAS_reset(struct us_data *us)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct task_mgmt_iu, tmf, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(struct sense_iu, iu, 1);
+	struct usb_device *udev = us->pusb_dev;
+	int result;
+
+	debug("UAS reset\n");
+	memset(tmf, '\0', sizeof(*tmf));
+	tmf->iu_id = IU_ID_TASK_MGMT;
+	tmf->tag = cpu_to_be16(USB_STOR_UAS_QUEUE + 1);
+	tmf->function = TMF_LOGICAL_UNIT_RESET;
+	result = usb_stor_UAS_send(us, tmf, sizeof(*tmf));
+	if (result >= 0)
+		result = usb_stor_UAS_get_status(us, iu);
+	if (result >= 0 && iu->iu_id != IU_ID_RESPONSE)
+		result = -EIO;
+
+	usb_clear_halt(udev, usb_sndbulkpipe(udev, us->ep_cmd));
+	usb_clear_halt(udev, usb_rcvbulkpipe(udev, us->ep_status));
+	usb_clear_halt(udev, usb_rcvbulkpipe(udev, us->ep_in));
+	usb_clear_halt(udev, usb_sndbulkpipe(udev, us->ep_out));
+
+	return result < 0 ? result : 0;
+}
+
+/**
+ * usb_stor_UAS_queue() - Run a number of commands on a UAS device
+ *
+ * The commands are all sent to the device before waiting for any of them.
+ * Sense data for a failed command is left in its sense_buf.
+ *
+ * @srbs: Commands to run
+ * @count: Number of commands, at most USB_STOR_UAS_QUEUE
+ * @us: Device to use
+ * @donep: Returns the number of commands at the start of @srbs which
+ *	completed successfully
+ * Return: USB_STOR_TRANSPORT_GOOD if all commands completed successfully,
+ *	else USB_STOR_TRANSPORT_FAILED
+ */
+static int usb_stor_UAS_queue(struct scsi_cmd *srbs, int count,
+			      struct us_data *us, int *donep)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(struct command_iu, cmd, 1);
+	ALLOC_CACHE_ALIGN_BUFFER(struct sense_iu, iu, 1);
+	struct usb_device *udev = us->pusb_dev;
+	int status[USB_STOR_UAS_QUEUE];
+	int i, tag, pending, len, result;
+	struct scsi_cmd *srb;
+	unsigned int pipe;
+
+	for (i = 0; i < count; i++)
+		status[i] = -EINPROGRESS;
+	for (i = 0; i < count; i++) {
+		srb = &srbs[i];
+		memset(cmd, '\0', sizeof(*cmd));
+		cmd->iu_id = IU_ID_COMMAND;
+		cmd->tag = cpu_to_be16(i + 1);
+		cmd->prio_attr = UAS_SIMPLE_TAG;
+		cmd->lun[1] = srb->lun;
+		memcpy(cmd->cdb, srb->cmd, min_t(int, srb->cmdlen,
+						 sizeof(cmd->cdb)));
+		if (usb_stor_UAS_send(us, cmd, sizeof(*cmd)) < 0) {
+			debug("UAS: cannot send command %d\n", i + 1);
+			goto reset;
+		}
+	}
+
+	for (pending = count; pending;) {
+		len = usb_stor_UAS_get_status(us, iu);
+		if (len < 0)
+			goto reset;
+		tag = be16_to_cpu(iu->tag);
+		if (tag < 1 || tag > count || status[tag - 1] != -EINPROGRESS) {
+			debug("UAS: bad tag %d\n", tag);
+			goto reset;
+		}
+		srb = &srbs[tag - 1];
+
+		switch (iu->iu_id) {
+		case IU_ID_READ_READY:
+		case IU_ID_WRITE_READY:
+			if (iu->iu_id == IU_ID_READ_READY)
+				pipe = usb_rcvbulkpipe(udev, us->ep_in);
+			else
+				pipe = usb_sndbulkpipe(udev, us->ep_out);
+			result = usb_bulk_msg(udev, pipe, srb->pdata,
+					      srb->datalen, &len,
+					      USB_CNTL_TIMEOUT * 5);
+			if (result < 0) {
+				debug("UAS: data error, tag %d\n", tag);
+				goto reset;
+			}
+			break;
+		case IU_ID_STATUS:
+			if (len < UAS_SENSE_IU_HDR_SIZE)
+				goto reset;
+			status[tag - 1] = iu->status;
+			if (iu->status) {
+				len = min_t(int, be16_to_cpu(iu->len),
+					    len - UAS_SENSE_IU_HDR_SIZE);
+				len = min_t(int, len, sizeof(srb->sense_buf));
+				memset(srb->sense_buf, '\0',
+				       sizeof(srb->sense_buf));
+				memcpy(srb->sense_buf, iu->sense, len);
+				debug("UAS: tag %d status %x sense %02x\n",
+				      tag, iu->status, srb->sense_buf[2]);
+			}
+			pending--;
+			break;
+		default:
+			/* A Response IU means the command was not accepted */
+			debug("UAS: unexpected IU %x, tag %d\n", iu->iu_id,
+			      tag);
+			goto reset;
+		}
+	}
+	for (i = 0; i < count && !status[i]; i++)
+		;
+	*donep = i;
+
+	return i == count ? USB_STOR_TRANSPORT_GOOD :
+		USB_STOR_TRANSPORT_FAILED;
+
+reset:
+	usb_stor_UAS_reset(us);
+	for (i = 0; i < count && !status[i]; i++)
+		;
+	*donep = i;
+
+	return USB_STOR_TRANSPORT_FAILED;
+}
+
+static int usb_stor_UAS_transport(struct scsi_cmd *srb, struct us_data *us)
+{
+	int done;
+
+	return usb_stor_UAS_queue(srb, 1, us, &done);
+}
+
+static bool usb_stor_UAS_have_pipes(const u8 *eps)
+{
+	return eps[CMD_PIPE_ID] && eps[STATUS_PIPE_ID] &&
+		eps[DATA_IN_PIPE_ID] && eps[DATA_OUT_PIPE_ID];
+}
+
+/**
+ * usb_stor_UAS_find() - Find the UAS alternate setting of an interface
+ *
+ * The configuration parsed at enumeration keeps the descriptor of the first
+ * setting of each interface, with the endpoints of all the settings added to
+ * it and no record of which setting they belong to. So this goes back to the
+ * descriptors. The endpoints are identified by the pipe usage descriptor which
+ * follows each of them.
+ *
+ * @dev: Device to check
+ * @iface: Interface to look for
+ * @us: Returns the endpoints of the setting
+ * @maxp: Returns the maximum packet size of each endpoint, indexed by pipe ID
+ * Return: alternate setting, or -ve on error
+ */
+static int usb_stor_UAS_find(struct usb_device *dev,
+			     struct usb_interface *iface, struct us_data *us,
+			     u16 *maxp)
+{
+	struct usb_endpoint_descriptor *ep = NULL;
+	struct usb_interface_descriptor *idesc;
+	struct usb_pipe_usage_descriptor *pipe;
+	struct usb_descriptor_header *head;
+	u8 eps[DATA_OUT_PIPE_ID + 1] = {};
+	int len, upto, alt = -1;
+	u8 *buf;
+
+	/* Streams are needed at SuperSpeed, and are not supported */
+	if (dev->speed >= USB_SPEED_SUPER)
+		return -ENOTSUPP;
+
+	len = usb_get_configuration_len(dev, 0);
+	if (len < 0)
+		return len;
+	buf = malloc_cache_aligned(len);
+	if (!buf)
+		return -ENOMEM;
+	len = usb_get_configuration_no(dev, 0, buf, len);
+
+	for (upto = 0; upto + 2 <= len; upto += head->bLength) {
+		if (alt >= 0 && usb_stor_UAS_have_pipes(eps))
+			break;
+		head = (struct usb_descriptor_header *)(buf + upto);
+		if (head->bLength < 2 || upto + head->bLength > len)
+			break;
+		switch (head->bDescriptorType) {
+		case USB_DT_INTERFACE:
+			idesc = (struct usb_interface_descriptor *)head;
+			alt = -1;
+			if (head->bLength >= USB_DT_INTERFACE_SIZE &&
+			    idesc->bInterfaceNumber ==
+			    iface->desc.bInterfaceNumber &&
+			    idesc->bInterfaceClass == USB_CLASS_MASS_STORAGE &&
+			    idesc->bInterfaceSubClass == US_SC_SCSI &&
+			    idesc->bInterfaceProtocol == US_PR_UAS)
+				alt = idesc->bAlternateSetting;
+			memset(eps, '\0', sizeof(eps));
+			ep = NULL;
+			break;
+		case USB_DT_ENDPOINT:
+			ep = (struct usb_endpoint_descriptor *)head;
+			break;
+		case USB_DT_PIPE_USAGE:
+			pipe = (struct usb_pipe_usage_descriptor *)head;
+			if (ep && pipe->bPipeID >= CMD_PIPE_ID &&
+			    pipe->bPipeID <= DATA_OUT_PIPE_ID) {
+				eps[pipe->bPipeID] = ep->bEndpointAddress &
+					USB_ENDPOINT_NUMBER_MASK;
+				maxp[pipe->bPipeID] =
+					get_unaligned_le16(&ep->wMaxPacketSize);
+			}
+			ep = NULL;
+			break;
+		}
+	}
+	free(buf);
+	if (alt < 0 || !usb_stor_UAS_have_pipes(eps))
+		return -ENOENT;
+
+	us->ep_cmd = eps[CMD_PIPE_ID];
+	us->ep_status = eps[STATUS_PIPE_ID];
+	us->ep_in = eps[DATA_IN_PIPE_ID];
+	us->ep_out = eps[DATA_OUT_PIPE_ID];
+	debug("UAS: alt %d, command %d status %d in %d out %d\n", alt,
+	      us->ep_cmd, us->ep_status, us->ep_in, us->ep_out);
+
+	return alt;
+}
+#endif /* CONFIG_USB_STORAGE_UAS */
+
 static void usb_stor_set_max_xfer_blk(struct usb_device *udev,
 				      struct us_data *us)
 {
@@ -975,9 +1259,15 @@ static void usb_stor_set_max_xfer_blk(struct usb_device *udev,
 	 * Windows 7 limiting transfers to 128 sectors for both USB2 and USB3
 	 * and Apple Mac OS X 10.11 limiting transfers to 256 sectors for USB2
 	 * and 2048 for USB3 devices.
+	 *
+	 * Devices connected at SuperSpeed, and those using UAS, are recent
+	 * enough not to have this problem, so allow larger transfers there.
 	 */
 	unsigned short blk = 240;
 
+	if (udev->speed >= USB_SPEED_SUPER || us->protocol == US_PR_UAS)
+		blk = CONFIG_USB_STORAGE_MAX_XFER_BLK;
+
 #if CONFIG_IS_ENABLED(DM_USB)
 	size_t size;
 	int ret;
@@ -1083,11 +1373,12 @@ static int usb_read_capacity(struct scsi_cmd *srb, struct us_data *ss)
 	return -1;
 }
 
-static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
-		       unsigned long start, unsigned short blocks)
+static void usb_setup_rw_10(struct scsi_cmd *srb, struct us_data *ss,
+			    unsigned char opcode, unsigned long start,
+			    unsigned short blocks)
 {
 	memset(&srb->cmd[0], 0, 12);
-	srb->cmd[0] = SCSI_READ10;
+	srb->cmd[0] = opcode;
 	srb->cmd[1] = srb->lun << 5;
 	srb->cmd[2] = ((unsigned char) (start >> 24)) & 0xff;
 	srb->cmd[3] = ((unsigned char) (start >> 16)) & 0xff;
@@ -1096,6 +1387,12 @@ static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
 	srb->cmd[7] = ((unsigned char) (blocks >> 8)) & 0xff;
 	srb->cmd[8] = (unsigned char) blocks & 0xff;
 	srb->cmdlen = ss->cmd12 ? 12 : 10;
+}
+
+static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
+		       unsigned long start, unsigned short blocks)
+{
+	usb_setup_rw_10(srb, ss, SCSI_READ10, start, blocks);
 	debug("read10: start %lx blocks %x\n", start, blocks);
 	return ss->transport(srb, ss);
 }
@@ -1103,20 +1400,63 @@ static int usb_read_10(struct scsi_cmd *srb, struct us_data *ss,
 static int usb_write_10(struct scsi_cmd *srb, struct us_data *ss,
 			unsigned long start, unsigned short blocks)
 {
-	memset(&srb->cmd[0], 0, 12);
-	srb->cmd[0] = SCSI_WRITE10;
-	srb->cmd[1] = srb->lun << 5;
-	srb->cmd[2] = ((unsigned char) (start >> 24)) & 0xff;
-	srb->cmd[3] = ((unsigned char) (start >> 16)) & 0xff;
-	srb->cmd[4] = ((unsigned char) (start >> 8)) & 0xff;
-	srb->cmd[5] = ((unsigned char) (start)) & 0xff;
-	srb->cmd[7] = ((unsigned char) (blocks >> 8)) & 0xff;
-	srb->cmd[8] = (unsigned char) blocks & 0xff;
-	srb->cmdlen = ss->cmd12 ? 12 : 10;
+	usb_setup_rw_10(srb, ss, SCSI_WRITE10, start, blocks);
 	debug("write10: start %lx blocks %x\n", start, blocks);
 	return ss->transport(srb, ss);
 }
 
+#ifdef CONFIG_USB_STORAGE_UAS
+/**
+ * usb_stor_UAS_rw() - Read or write blocks with queued commands
+ *
+ * This stops at the first command which fails, leaving the caller to carry
+ * on from there one command at a time, with its usual retries.
+ *
+ * @ss: Device to use
+ * @block_dev: Block device to read or write
+ * @start: First block
+ * @blkcnt: Number of blocks
+ * @buf_addr: Address of buffer
+ * @write: true to write, false to read
+ * Return: number of blocks transferred
+ */
+static lbaint_t usb_stor_UAS_rw(struct us_data *ss,
+				struct blk_desc *block_dev, lbaint_t start,
+				lbaint_t blkcnt, uintptr_t buf_addr, bool write)
+{
+	struct scsi_cmd srbs[USB_STOR_UAS_QUEUE];
+	lbaint_t done = 0, queued, blks;
+	int count, ok, i, ret;
+
+	while (done < blkcnt) {
+		queued = done;
+		for (count = 0; count < USB_STOR_UAS_QUEUE && queued < blkcnt;
+		     count++) {
+			struct scsi_cmd *srb = &srbs[count];
+
+			blks = min_t(lbaint_t, blkcnt - queued,
+				     ss->max_xfer_blk);
+			srb->lun = block_dev->lun;
+			srb->datalen = block_dev->blksz * blks;
+			srb->pdata = (unsigned char *)buf_addr +
+				queued * block_dev->blksz;
+			usb_setup_rw_10(srb, ss,
+					write ? SCSI_WRITE10 : SCSI_READ10,
+					start + queued, blks);
+			queued += blks;
+		}
+		usb_show_progress();
+		ret = usb_stor_UAS_queue(srbs, count, ss, &ok);
+		for (i = 0; i < ok; i++)
+			done += srbs[i].datalen / block_dev->blksz;
+		if (ret != USB_STOR_TRANSPORT_GOOD)
+			break;
+	}
+
+	return done;
+}
+#endif
+
 
 #ifdef CONFIG_USB_BIN_FIXUP
 /*
@@ -1151,7 +1491,7 @@ static unsigned long usb_stor_read(struct blk_desc *block_dev, lbaint_t blknr,
 {
 	lbaint_t start, blks;
 	uintptr_t buf_addr;
-	unsigned short smallblks;
+	unsigned short smallblks = 0;
 	struct usb_device *udev;
 	struct us_data *ss;
 	int retry;
@@ -1187,7 +1527,18 @@ static unsigned long usb_stor_read(struct blk_desc *block_dev, lbaint_t blknr,
 	debug("\nusb_read: dev %d startblk " LBAF ", blccnt " LBAF " buffer %lx\n",
 	      block_dev->devnum, start, blks, buf_addr);
 
-	do {
+#ifdef CONFIG_USB_STORAGE_UAS
+	if (ss->protocol == US_PR_UAS) {
+		lbaint_t done;
+
+		done = usb_stor_UAS_rw(ss, block_dev, start, blks, buf_addr,
+				       false);
+		start += done;
+		blks -= done;
+		buf_addr += done * block_dev->blksz;
+	}
+#endif
+	while (blks) {
 		/* XXX need some comment here */
 		retry = 2;
 		srb->pdata = (unsigned char *)buf_addr;
@@ -1212,7 +1563,7 @@ retry_it:
 		start += smallblks;
 		blks -= smallblks;
 		buf_addr += srb->datalen;
-	} while (blks != 0);
+	}
 
 	debug("usb_read: end startblk " LBAF ", blccnt %x buffer %lx\n",
 	      start, smallblks, buf_addr);
@@ -1234,7 +1585,7 @@ static unsigned long usb_stor_write(struct blk_desc *block_dev, lbaint_t blknr,
 {
 	lbaint_t start, blks;
 	uintptr_t buf_addr;
-	unsigned short smallblks;
+	unsigned short smallblks = 0;
 	struct usb_device *udev;
 	struct us_data *ss;
 	int retry;
@@ -1272,7 +1623,18 @@ static unsigned long usb_stor_write(struct blk_desc *block_dev, lbaint_t blknr,
 	debug("\nusb_write: dev %d startblk " LBAF ", blccnt " LBAF " buffer %lx\n",
 	      block_dev->devnum, start, blks, buf_addr);
 
-	do {
+#ifdef CONFIG_USB_STORAGE_UAS
+	if (ss->protocol == US_PR_UAS) {
+		lbaint_t done;
+
+		done = usb_stor_UAS_rw(ss, block_dev, start, blks, buf_addr,
+				       true);
+		start += done;
+		blks -= done;
+		buf_addr += done * block_dev->blksz;
+	}
+#endif
+	while (blks) {
 		/* If write fails retry for max retry count else
 		 * return with number of blocks written successfully.
 		 */
@@ -1299,7 +1661,7 @@ retry_it:
 		start += smallblks;
 		blks -= smallblks;
 		buf_addr += srb->datalen;
-	} while (blks != 0);
+	}
 
 	debug("usb_write: end startblk " LBAF ", blccnt %x buffer %lx\n",
 	      start, smallblks, buf_addr);
@@ -1320,6 +1682,9 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 	int i;
 	struct usb_endpoint_descriptor *ep_desc;
 	unsigned int flags = 0;
+#ifdef CONFIG_USB_STORAGE_UAS
+	u16 maxp[DATA_OUT_PIPE_ID + 1] = {};
+#endif
 
 	/* let's examine the device now */
 	iface = &dev->config.if_desc[ifnum];
@@ -1346,6 +1711,27 @@ int usb_storage_probe(struct usb_device *dev, unsigned int ifnum,
 	ss->subclass = iface->desc.bInterfaceSubClass;
 	ss->protocol = iface->desc.bInterfaceProtocol;
 
+#ifdef CONFIG_USB_STORAGE_UAS
+	/* Prefer UAS, which may be offered as an alternate setting */
+	i = usb_stor_UAS_find(dev, iface, ss, maxp);
+	if (i >= 0 && !usb_set_interface(dev, iface->desc.bInterfaceNumber,
+					 i)) {
+		debug("Transport: UAS\n");
+		/* usb_set_maxpacket() only covered the first setting */
+		dev->epmaxpacketout[ss->ep_cmd] = maxp[CMD_PIPE_ID];
+		dev->epmaxpacketin[ss->ep_status] = maxp[STATUS_PIPE_ID];
+		dev->epmaxpacketin[ss->ep_in] = maxp[DATA_IN_PIPE_ID];
+		dev->epmaxpacketout[ss->ep_out] = maxp[DATA_OUT_PIPE_ID];
+		ss->subclass = US_SC_SCSI;
+		ss->protocol = US_PR_UAS;
+		ss->transport = usb_stor_UAS_transport;
+		ss->transport_reset = usb_stor_UAS_reset;
+		usb_stor_set_max_xfer_blk(dev, ss);
+		dev->privptr = (void *)ss;
+		return 1;
+	}
+#endif
+
 	/* set the handler pointers based on the protocol */
 	debug("Transport: ");
 	switch (ss->protocol) {
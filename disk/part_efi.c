@@ -79,6 +79,16 @@ static char *print_efiname(gpt_entry *pte)
 
 static const efi_guid_t system_guid = PARTITION_SYSTEM_GUID;
 
+/*
+ * Reclaim the early malloc() space used while reading the GPT, unless the
+ * block cache has kept some of it
+ */
+static void gpt_release(ulong mark)
+{
+	if (!CONFIG_IS_ENABLED(BLOCK_CACHE))
+		malloc_simple_release(mark);
+}
+
 static int get_bootable(gpt_entry *p)
 {
 	int ret = 0;
@@ -223,16 +233,21 @@ int get_disk_guid(struct blk_desc *desc, char *guid)
 	ALLOC_CACHE_ALIGN_BUFFER_PAD(gpt_header, gpt_head, 1, desc->blksz);
 	gpt_entry *gpt_pte = NULL;
 	unsigned char *guid_bin;
+	ulong mark;
 
 	/* This function validates AND fills in the GPT header and PTE */
-	if (find_valid_gpt(desc, gpt_head, &gpt_pte) != 1)
+	mark = malloc_simple_mark();
+	if (find_valid_gpt(desc, gpt_head, &gpt_pte) != 1) {
+		gpt_release(mark);
 		return -EINVAL;
+	}
 
 	guid_bin = gpt_head->disk_guid.b;
 	uuid_bin_to_str(guid_bin, guid, UUID_STR_FORMAT_GUID);
 
 	/* Remember to free pte */
 	free(gpt_pte);
+	gpt_release(mark);
 	return 0;
 }
 
@@ -285,6 +300,7 @@ int part_get_info_efi(struct blk_desc *desc, int part,
 {
 	ALLOC_CACHE_ALIGN_BUFFER_PAD(gpt_header, gpt_head, 1, desc->blksz);
 	gpt_entry *gpt_pte = NULL;
+	ulong mark;
 
 	/* "part" argument must be at least 1 */
 	if (part < 1) {
@@ -293,14 +309,18 @@ int part_get_info_efi(struct blk_desc *desc, int part,
 	}
 
 	/* This function validates AND fills in the GPT header and PTE */
-	if (find_valid_gpt(desc, gpt_head, &gpt_pte) != 1)
+	mark = malloc_simple_mark();
+	if (find_valid_gpt(desc, gpt_head, &gpt_pte) != 1) {
+		gpt_release(mark);
 		return -EINVAL;
+	}
 
 	if (part > le32_to_cpu(gpt_head->num_partition_entries) ||
 	    !is_pte_valid(&gpt_pte[part - 1])) {
 		log_debug("Invalid partition number %d\n", part);
 #if !(defined(CONFIG_DUAL_BOOTLOADER) || defined(CONFIG_IMX_TRUSTY_OS)) || !defined(CONFIG_SPL_BUILD)
 		free(gpt_pte);
+		gpt_release(mark);
 #endif
 		return -EPERM;
 	}
@@ -337,6 +357,7 @@ int part_get_info_efi(struct blk_desc *desc, int part,
 	 * don't forget to free the memory after use.
 	 */
 	free(gpt_pte);
+	gpt_release(mark);
 #endif
 	return 0;
 }
@@ -206,7 +206,7 @@ const void *of_get_property_by_prop(const struct device_node *np,
 	return property->value;
 }
 
-static const char *of_prop_next_string(struct property *prop, const char *cur)
+const char *of_prop_next_string(struct property *prop, const char *cur)
 {
 	const void *curv = cur;
 
@@ -388,8 +388,13 @@ struct device_node *of_find_node_opts_by_path(struct device_node *root,
 	}
 
 	/* Step down the tree matching path components */
-	if (!np)
+	if (!np) {
+		int len = separator ? separator - path : strlen(path);
+
+		if (!of_index_find_path(root, path, len, &np))
+			return np;
 		np = of_node_get(root);
+	}
 	while (np && *path == '/') {
 		struct device_node *tmp = np;
 
@@ -409,6 +414,10 @@ struct device_node *of_find_compatible_node(struct device_node *from,
 {
 	struct device_node *np;
 
+	if ((!type || !*type) && compatible && *compatible &&
+	    !of_index_find_compatible(from, compatible, &np))
+		return np;
+
 	for_each_of_allnodes_from(from, np)
 		if (of_device_is_compatible(np, compatible, type, NULL) &&
 		    of_node_get(np))
@@ -453,6 +462,9 @@ struct device_node *of_find_node_by_phandle(struct device_node *root,
 	if (!handle)
 		return NULL;
 
+	if (!of_index_find_phandle(root, handle, &np))
+		return np;
+
 	for_each_of_allnodes_from(root, np)
 		if (np->phandle == handle)
 			break;
@@ -947,6 +959,8 @@ int of_write_prop(struct device_node *np, const char *propname, int len,
 
 	for (pp = np->properties; pp; pp = pp->next) {
 		if (strcmp(pp->name, propname) == 0) {
+			if (!strcmp(propname, "compatible"))
+				of_index_invalidate();
 			/* Property exists -> change value */
 			pp->value = (void *)value;
 			pp->length = len;
@@ -956,6 +970,8 @@ int of_write_prop(struct device_node *np, const char *propname, int len,
 	}
 
 	/* Property does not exist -> append new property */
+	if (!strcmp(propname, "compatible"))
+		of_index_invalidate();
 	new = malloc(sizeof(struct property));
 	if (!new)
 		return -ENOMEM;
@@ -1054,6 +1070,8 @@ int __of_remove_property(struct device_node *np, struct property *prop)
 
 	/* found the node */
 	*next = prop->next;
+	if (!strcmp(prop->name, "compatible"))
+		of_index_invalidate();
 
 	return 0;
 }
@@ -1086,6 +1104,7 @@ int of_remove_node(struct device_node *to_remove)
 	}
 	if (!np)
 		return -EFAULT;
+	of_index_invalidate();
 
 	/* if there is a previous node, link it to this one's sibling */
 	if (prev)
@@ -0,0 +1,287 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Hash indexes over the live tree
+ *
+ * Finding a node by phandle, compatible string or path otherwise walks the
+ * whole tree, which adds up when binding and probing devices. The indexes
+ * cover the control tree (gd->of_root) only. They are built on the first
+ * lookup and dropped when the tree is changed in a way which affects them.
+ */
+
+#define LOG_CATEGORY	LOGC_DT
+
+#include <common.h>
+#include <errno.h>
+#include <log.h>
+#include <malloc.h>
+#include <asm/global_data.h>
+#include <dm/of_access.h>
+#include <linux/ctype.h>
+#include <linux/log2.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+/**
+ * struct of_index_ent - Entry in an index
+ *
+ * @np: Node this entry refers to
+ * @key: Compatible string or full path; NULL for phandles
+ * @hash: Hash of the key, or the phandle
+ * @next: Index of the next entry in the same bucket, or -1
+ */
+struct of_index_ent {
+	struct device_node *np;
+	const char *key;
+	u32 hash;
+	int next;
+};
+
+/**
+ * struct of_index_table - Hash table of nodes
+ *
+ * Entries in each bucket are kept in tree order, so that a lookup finds the
+ * same node as a walk of the tree would.
+ *
+ * @buckets: First entry of each bucket, or -1
+ * @ents: Entries, in tree order
+ * @mask: Number of buckets - 1
+ * @count: Number of entries
+ */
+struct of_index_table {
+	int *buckets;
+	struct of_index_ent *ents;
+	uint mask;
+	uint count;
+};
+
+/**
+ * struct of_index - Indexes for one tree
+ *
+ * @root: Root node of the indexed tree, NULL if there is no index
+ * @phandle: Nodes by phandle
+ * @compat: Nodes by each of their compatible strings
+ * @path: Nodes by full path
+ */
+static struct of_index {
+	struct device_node *root;
+	struct of_index_table phandle;
+	struct of_index_table compat;
+	struct of_index_table path;
+} of_index;
+
+/* FNV-1a, folding case if requested since compatible strings ignore it */
+static u32 of_index_hash(const char *str, int len, bool fold)
+{
+	u32 hash = 2166136261U;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= fold ? tolower(str[i]) : (uchar)str[i];
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+static void of_index_free_table(struct of_index_table *tab)
+{
+	free(tab->buckets);
+	free(tab->ents);
+	memset(tab, '\0', sizeof(*tab));
+}
+
+static int of_index_alloc_table(struct of_index_table *tab, uint count)
+{
+	uint size = roundup_pow_of_two(max(count, 1U));
+
+	tab->buckets = malloc(size * sizeof(*tab->buckets));
+	tab->ents = malloc(max(count, 1U) * sizeof(*tab->ents));
+	if (!tab->buckets || !tab->ents)
+		return -ENOMEM;
+	memset(tab->buckets, 0xff, size * sizeof(*tab->buckets));
+	tab->mask = size - 1;
+	tab->count = 0;
+
+	return 0;
+}
+
+static void of_index_add(struct of_index_table *tab, struct device_node *np,
+			 const char *key, u32 hash)
+{
+	struct of_index_ent *ent = &tab->ents[tab->count++];
+
+	ent->np = np;
+	ent->key = key;
+	ent->hash = hash;
+}
+
+/* Chain the entries, inserting in reverse so that buckets are in order */
+static void of_index_link(struct of_index_table *tab)
+{
+	int i;
+
+	for (i = tab->count - 1; i >= 0; i--) {
+		int *head = &tab->buckets[tab->ents[i].hash & tab->mask];
+
+		tab->ents[i].next = *head;
+		*head = i;
+	}
+}
+
+void of_index_invalidate(void)
+{
+	if (!of_index.root)
+		return;
+	of_index_free_table(&of_index.phandle);
+	of_index_free_table(&of_index.compat);
+	of_index_free_table(&of_index.path);
+	of_index.root = NULL;
+}
+
+static int of_index_build(void)
+{
+	struct device_node *np;
+	uint nodes = 0, phandles = 0, compats = 0;
+	struct property *prop;
+	const char *cp;
+	int ret;
+
+	for_each_of_allnodes(np) {
+		nodes++;
+		if (np->phandle)
+			phandles++;
+		prop = of_find_property(np, "compatible", NULL);
+		for (cp = of_prop_next_string(prop, NULL); cp;
+		     cp = of_prop_next_string(prop, cp))
+			compats++;
+	}
+
+	ret = of_index_alloc_table(&of_index.phandle, phandles);
+	if (!ret)
+		ret = of_index_alloc_table(&of_index.compat, compats);
+	if (!ret)
+		ret = of_index_alloc_table(&of_index.path, nodes);
+	if (ret) {
+		of_index.root = gd_of_root();
+		of_index_invalidate();
+		return ret;
+	}
+
+	for_each_of_allnodes(np) {
+		if (np->phandle)
+			of_index_add(&of_index.phandle, np, NULL, np->phandle);
+		prop = of_find_property(np, "compatible", NULL);
+		for (cp = of_prop_next_string(prop, NULL); cp;
+		     cp = of_prop_next_string(prop, cp))
+			of_index_add(&of_index.compat, np, cp,
+				     of_index_hash(cp, strlen(cp), true));
+		of_index_add(&of_index.path, np, np->full_name,
+			     of_index_hash(np->full_name,
+					   strlen(np->full_name), false));
+	}
+	of_index_link(&of_index.phandle);
+	of_index_link(&of_index.compat);
+	of_index_link(&of_index.path);
+	of_index.root = gd_of_root();
+	log_debug("indexed %u nodes, %u phandles, %u compatible strings\n",
+		  nodes, phandles, compats);
+
+	return 0;
+}
+
+/* Make sure there is an index for the control tree */
+static bool of_index_ready(void)
+{
+	if (!gd_of_root())
+		return false;
+	if (of_index.root != gd_of_root()) {
+		of_index_invalidate();
+		if (of_index_build())
+			return false;
+	}
+
+	return true;
+}
+
+int of_index_find_phandle(const struct device_node *root, phandle handle,
+			  struct device_node **npp)
+{
+	struct of_index_table *tab = &of_index.phandle;
+	int i;
+
+	if ((root && root != gd_of_root()) || !of_index_ready())
+		return -EAGAIN;
+
+	for (i = tab->buckets[handle & tab->mask]; i != -1;
+	     i = tab->ents[i].next) {
+		struct of_index_ent *ent = &tab->ents[i];
+
+		/* A walk from @root does not include @root itself */
+		if (ent->hash == handle && ent->np != root) {
+			*npp = ent->np;
+			return 0;
+		}
+	}
+	*npp = NULL;
+
+	return 0;
+}
+
+int of_index_find_compatible(const struct device_node *from,
+			     const char *compat, struct device_node **npp)
+{
+	struct of_index_table *tab = &of_index.compat;
+	bool found_from = !from;
+	u32 hash;
+	int i;
+
+	if (!of_index_ready())
+		return -EAGAIN;
+
+	hash = of_index_hash(compat, strlen(compat), true);
+	for (i = tab->buckets[hash & tab->mask]; i != -1;
+	     i = tab->ents[i].next) {
+		struct of_index_ent *ent = &tab->ents[i];
+
+		if (ent->hash != hash || of_compat_cmp(ent->key, compat, 0))
+			continue;
+		if (ent->np == from) {
+			/* a node may list the same string twice */
+			found_from = true;
+		} else if (found_from) {
+			*npp = ent->np;
+			return 0;
+		}
+	}
+	if (!found_from)
+		return -EAGAIN;	/* @from is not a match, so walk from there */
+	*npp = NULL;
+
+	return 0;
+}
+
+int of_index_find_path(const struct device_node *root, const char *path,
+		       int len, struct device_node **npp)
+{
+	struct of_index_table *tab = &of_index.path;
+	u32 hash;
+	int i;
+
+	if (root != gd_of_root() || !of_index_ready())
+		return -EAGAIN;
+
+	hash = of_index_hash(path, len, false);
+	for (i = tab->buckets[hash & tab->mask]; i != -1;
+	     i = tab->ents[i].next) {
+		struct of_index_ent *ent = &tab->ents[i];
+
+		if (ent->hash == hash && !strncmp(ent->key, path, len) &&
+		    !ent->key[len]) {
+			*npp = ent->np;
+			return 0;
+		}
+	}
+
+	/* Leave unusual spellings, such as a trailing '/', to the walk */
+	return -EAGAIN;
+}
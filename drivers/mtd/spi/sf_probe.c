@@ -104,11 +104,14 @@ static int spi_flash_probe_slave(struct spi_flash *flash)
 	if (CONFIG_IS_ENABLED(SPI_DIRMAP)) {
 		ret = spi_nor_create_read_dirmap(flash);
 		if (ret)
-			return ret;
+			goto err_read_id;
 
 		ret = spi_nor_create_write_dirmap(flash);
-		if (ret)
-			return ret;
+		if (ret) {
+			spi_mem_dirmap_destroy(flash->dirmap.rdesc);
+			flash->dirmap.rdesc = NULL;
+			goto err_read_id;
+		}
 	}
 
 	if (CONFIG_IS_ENABLED(SPI_FLASH_MTD))
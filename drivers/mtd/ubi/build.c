@@ -1382,6 +1382,45 @@ void ubi_exit(void)
 }
 module_exit(ubi_exit);
 
+#ifdef __UBOOT__
+/**
+ * ubi_swap_devices - exchange the numbers of two UBI devices.
+ * @num1: UBI device number
+ * @num2: UBI device number
+ *
+ * The 'ubi part' command keeps the selected device at number 0 and may keep
+ * others attached. This function moves a device to another number, or
+ * exchanges the numbers of two devices. Neither may be in use. Returns zero
+ * in case of success and a negative error code in case of failure.
+ */
+int ubi_swap_devices(int num1, int num2)
+{
+	struct ubi_device *ubi1, *ubi2;
+
+	if (num1 < 0 || num1 >= UBI_MAX_DEVICES ||
+	    num2 < 0 || num2 >= UBI_MAX_DEVICES)
+		return -EINVAL;
+
+	ubi1 = ubi_devices[num1];
+	ubi2 = ubi_devices[num2];
+	if ((ubi1 && ubi1->ref_count) || (ubi2 && ubi2->ref_count))
+		return -EBUSY;
+
+	ubi_devices[num1] = ubi2;
+	ubi_devices[num2] = ubi1;
+	if (ubi1) {
+		ubi1->ubi_num = num2;
+		sprintf(ubi1->ubi_name, UBI_NAME_STR "%d", num2);
+	}
+	if (ubi2) {
+		ubi2->ubi_num = num1;
+		sprintf(ubi2->ubi_name, UBI_NAME_STR "%d", num1);
+	}
+
+	return 0;
+}
+#endif
+
 /**
  * bytes_str_to_int - convert a number of bytes string into an integer.
  * @str: the string to convert
@@ -136,6 +136,12 @@ int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
 	if (err)
 		return err;
 
+	if (ubi->hdr_buf && pnum == ubi->hdr_pnum &&
+	    offset + len <= ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize) {
+		memcpy(buf, ubi->hdr_buf + offset, len);
+		return 0;
+	}
+
 	/*
 	 * Deliberately corrupt the buffer to improve robustness. Indeed, if we
 	 * do not do this, the following may happen:
@@ -211,6 +217,34 @@ retry:
 	return err;
 }
 
+/**
+ * ubi_io_read_hdrs - read both headers of a physical eraseblock at once.
+ * @ubi: UBI device description object
+ * @pnum: physical eraseblock number to read from
+ *
+ * Attaching reads the EC and the VID header of every physical eraseblock.
+ * Both are at the start of the eraseblock, so this function reads them with
+ * one flash read into @ubi->hdr_buf, from where 'ubi_io_read()' returns them.
+ * If the read fails or reports bit-flips, nothing is kept, and the headers
+ * are read from the flash one by one as usual, so that the problem is
+ * reported for the right header.
+ */
+void ubi_io_read_hdrs(struct ubi_device *ubi, int pnum)
+{
+	int len = ubi->vid_hdr_aloffset + ubi->vid_hdr_alsize;
+	size_t read;
+	int err;
+
+	ubi->hdr_pnum = -1;
+	if (!ubi->hdr_buf)
+		return;
+
+	err = mtd_read(ubi->mtd, (loff_t)pnum * ubi->peb_size, len, &read,
+		       ubi->hdr_buf);
+	if (!err && read == len)
+		ubi->hdr_pnum = pnum;
+}
+
 /**
  * ubi_io_write - write data to a physical eraseblock.
  * @ubi: UBI device description object
@@ -527,6 +527,8 @@ struct ubi_debug_info {
  *
  * @peb_buf: a buffer of PEB size used for different purposes
  * @buf_mutex: protects @peb_buf
+ * @hdr_buf: both headers of the PEB being scanned while attaching, or %NULL
+ * @hdr_pnum: PEB whose headers are in @hdr_buf, or %-1
  * @ckvol_mutex: serializes static volume checking when opening
  *
  * @dbg: debugging information for this UBI device
@@ -626,6 +628,8 @@ struct ubi_device {
 
 	void *peb_buf;
 	struct mutex buf_mutex;
+	void *hdr_buf;
+	int hdr_pnum;
 	struct mutex ckvol_mutex;
 
 	struct ubi_debug_info dbg;
@@ -886,6 +890,7 @@ int ubi_ensure_anchor_pebs(struct ubi_device *ubi);
 /* io.c */
 int ubi_io_read(const struct ubi_device *ubi, void *buf, int pnum, int offset,
 		int len);
+void ubi_io_read_hdrs(struct ubi_device *ubi, int pnum);
 int ubi_io_write(struct ubi_device *ubi, const void *buf, int pnum, int offset,
 		 int len);
 int ubi_io_sync_erase(struct ubi_device *ubi, int pnum, int torture);
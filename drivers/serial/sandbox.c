@@ -24,6 +24,7 @@ DECLARE_GLOBAL_DATA_PTR;
 
 static size_t _sandbox_serial_written = 1;
 static bool sandbox_serial_enabled = true;
+static int sandbox_serial_room = -1;
 
 size_t sandbox_serial_written(void)
 {
@@ -35,6 +36,11 @@ void sandbox_serial_endisable(bool enabled)
 	sandbox_serial_enabled = enabled;
 }
 
+void sandbox_serial_set_room(int room)
+{
+	sandbox_serial_room = room;
+}
+
 /**
  * output_ansi_colour() - Output an ANSI colour code
  *
@@ -96,6 +102,11 @@ static int sandbox_serial_putc(struct udevice *dev, const char ch)
 {
 	struct sandbox_serial_priv *priv = dev_get_priv(dev);
 
+	if (!sandbox_serial_room)
+		return -EAGAIN;
+	if (sandbox_serial_room > 0)
+		sandbox_serial_room--;
+
 	if (ch == '\n')
 		priv->start_of_line = true;
 
@@ -113,6 +124,13 @@ static ssize_t sandbox_serial_puts(struct udevice *dev, const char *s,
 	struct sandbox_serial_priv *priv = dev_get_priv(dev);
 	ssize_t ret;
 
+	if (sandbox_serial_room >= 0) {
+		len = min_t(size_t, len, sandbox_serial_room);
+		if (!len)
+			return -EAGAIN;
+		sandbox_serial_room -= len;
+	}
+
 	if (len && s[len - 1] == '\n')
 		priv->start_of_line = true;
 
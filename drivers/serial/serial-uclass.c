@@ -6,6 +6,7 @@
 #define LOG_CATEGORY UCLASS_SERIAL
 
 #include <common.h>
+#include <cyclic.h>
 #include <dm.h>
 #include <env_internal.h>
 #include <errno.h>
@@ -231,10 +232,123 @@ int serial_initialize(void)
 	return serial_init();
 }
 
+#if CONFIG_IS_ENABLED(SERIAL_TX_BUFFER)
+/* Interval at which the cyclic function writes out the TX buffer */
+#define SERIAL_TX_CYCLIC_US	1000
+
+/**
+ * serial_tx_drain() - Write out the TX buffer
+ *
+ * @dev: Device to write to
+ * @wait: true to wait until everything is written, false to stop as soon as
+ *	the device has no room
+ */
+static void serial_tx_drain(struct udevice *dev, bool wait)
+{
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+	struct dm_serial_ops *ops = serial_get_ops(dev);
+	int err;
+
+	/* Output from the driver itself is just added to the buffer */
+	if (upriv->tx_busy)
+		return;
+	upriv->tx_busy = true;
+
+	while (upriv->tx_rd != upriv->tx_wr) {
+		const char *str = upriv->tx_buf + upriv->tx_rd;
+		int len;
+
+		if (!CONFIG_IS_ENABLED(SERIAL_PUTS) || !ops->puts) {
+			err = ops->putc(dev, *str);
+			if (err == -EAGAIN) {
+				if (!wait)
+					break;
+				continue;
+			}
+			upriv->tx_rd++;
+		} else {
+			/* Write up to the end of the buffer at most */
+			if (upriv->tx_wr > upriv->tx_rd)
+				len = upriv->tx_wr - upriv->tx_rd;
+			else
+				len = CONFIG_SERIAL_TX_BUFFER_SIZE - upriv->tx_rd;
+			err = ops->puts(dev, str, len);
+			if (!err || err == -EAGAIN) {
+				if (!wait)
+					break;
+				continue;
+			}
+			/* Drop the output on error, as __serial_puts() does */
+			upriv->tx_rd = err < 0 ? upriv->tx_wr : upriv->tx_rd + err;
+		}
+		upriv->tx_rd %= CONFIG_SERIAL_TX_BUFFER_SIZE;
+	}
+
+	upriv->tx_busy = false;
+}
+
+static void serial_tx_cyclic(void *ctx)
+{
+	serial_tx_drain(ctx, false);
+}
+
+static void serial_tx_putc(struct udevice *dev, char ch)
+{
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+	int next = (upriv->tx_wr + 1) % CONFIG_SERIAL_TX_BUFFER_SIZE;
+
+	/* Only wait for the device when the buffer is full */
+	if (next == upriv->tx_rd) {
+		serial_tx_drain(dev, true);
+		/* Give up if the driver itself is printing */
+		if (next == upriv->tx_rd)
+			return;
+	}
+	upriv->tx_buf[upriv->tx_wr] = ch;
+	upriv->tx_wr = next;
+}
+
+/**
+ * serial_tx_write() - Add output to the TX buffer and write out what fits
+ *
+ * @dev: Device to write to
+ * @buf: Characters to write, which may include NUL
+ * @len: Number of characters in @buf
+ * Return: true if the output was buffered, false if the device has no buffer
+ */
+static bool serial_tx_write(struct udevice *dev, const char *buf, size_t len)
+{
+	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+
+	if (!upriv->tx_buf)
+		return false;
+
+	for (; len; buf++, len--) {
+		if (*buf == '\n')
+			serial_tx_putc(dev, '\r');
+		serial_tx_putc(dev, *buf);
+	}
+	serial_tx_drain(dev, false);
+
+	return true;
+}
+#else
+static inline void serial_tx_drain(struct udevice *dev, bool wait)
+{
+}
+
+static inline bool serial_tx_write(struct udevice *dev, const char *buf,
+				   size_t len)
+{
+	return false;
+}
+#endif /* CONFIG_IS_ENABLED(SERIAL_TX_BUFFER) */
+
 static void _serial_flush(struct udevice *dev)
 {
 	struct dm_serial_ops *ops = serial_get_ops(dev);
 
+	serial_tx_drain(dev, true);
 	if (!ops->pending)
 		return;
 	while (ops->pending(dev, false) > 0)
@@ -246,6 +360,12 @@ static void _serial_putc(struct udevice *dev, char ch)
 	struct dm_serial_ops *ops = serial_get_ops(dev);
 	int err;
 
+	if (serial_tx_write(dev, &ch, 1)) {
+		if (IS_ENABLED(CONFIG_CONSOLE_FLUSH_ON_NEWLINE) && ch == '\n')
+			_serial_flush(dev);
+		return;
+	}
+
 	if (ch == '\n')
 		_serial_putc(dev, '\r');
 
@@ -277,6 +397,13 @@ static void _serial_puts(struct udevice *dev, const char *str)
 {
 	struct dm_serial_ops *ops = serial_get_ops(dev);
 
+	if (serial_tx_write(dev, str, strlen(str))) {
+		if (IS_ENABLED(CONFIG_CONSOLE_FLUSH_ON_NEWLINE) &&
+		    strchr(str, '\n'))
+			_serial_flush(dev);
+		return;
+	}
+
 	if (!CONFIG_IS_ENABLED(SERIAL_PUTS) || !ops->puts) {
 		while (*str)
 			_serial_putc(dev, *str++);
@@ -555,8 +682,10 @@ U_BOOT_ENV_CALLBACK(baudrate, on_baudrate);
 static int serial_post_probe(struct udevice *dev)
 {
 	struct dm_serial_ops *ops = serial_get_ops(dev);
-#if CONFIG_IS_ENABLED(DM_STDIO)
+#if CONFIG_IS_ENABLED(DM_STDIO) || CONFIG_IS_ENABLED(SERIAL_TX_BUFFER)
 	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+#endif
+#if CONFIG_IS_ENABLED(DM_STDIO)
 	struct stdio_dev sdev;
 #endif
 	int ret;
@@ -568,6 +697,16 @@ static int serial_post_probe(struct udevice *dev)
 			return ret;
 	}
 
+#if CONFIG_IS_ENABLED(SERIAL_TX_BUFFER)
+	/* Allocate the TX buffer, which is written out by a cyclic function */
+	if ((gd->flags & GD_FLG_RELOC) && !upriv->tx_buf) {
+		upriv->tx_buf = malloc(CONFIG_SERIAL_TX_BUFFER_SIZE);
+		upriv->tx_cyclic = cyclic_register(serial_tx_cyclic,
+						   SERIAL_TX_CYCLIC_US,
+						   dev->name, dev);
+	}
+#endif
+
 #if CONFIG_IS_ENABLED(DM_STDIO)
 	if (!(gd->flags & GD_FLG_RELOC))
 		return 0;
@@ -594,13 +733,26 @@ static int serial_post_probe(struct udevice *dev)
 
 static int serial_pre_remove(struct udevice *dev)
 {
-#if CONFIG_IS_ENABLED(SYS_STDIO_DEREGISTER)
+#if CONFIG_IS_ENABLED(SYS_STDIO_DEREGISTER) || \
+	CONFIG_IS_ENABLED(SERIAL_TX_BUFFER)
 	struct serial_dev_priv *upriv = dev_get_uclass_priv(dev);
+#endif
 
+#if CONFIG_IS_ENABLED(SYS_STDIO_DEREGISTER)
 	if (stdio_deregister_dev(upriv->sdev, true))
 		return -EPERM;
 #endif
 
+#if CONFIG_IS_ENABLED(SERIAL_TX_BUFFER)
+	/* Make sure nothing is lost when the device goes away */
+	_serial_flush(dev);
+	if (upriv->tx_cyclic)
+		cyclic_unregister(upriv->tx_cyclic);
+	free(upriv->tx_buf);
+	upriv->tx_buf = NULL;
+	upriv->tx_cyclic = NULL;
+#endif
+
 	return 0;
 }
 
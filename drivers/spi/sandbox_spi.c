@@ -16,11 +16,15 @@
 #include <malloc.h>
 #include <spi.h>
 #include <spi_flash.h>
+#include <spi-mem.h>
 #include <os.h>
 
 #include <linux/errno.h>
+#include <linux/math64.h>
+#include <linux/time.h>
 #include <asm/spi.h>
 #include <asm/state.h>
+#include <asm/test.h>
 #include <dm/acpi.h>
 #include <dm/device-internal.h>
 
@@ -35,12 +39,20 @@
  *
  * @speed:	Current bus speed.
  * @mode:	Current bus mode.
+ * @stats:	Transfer statistics, see sandbox_spi_get_stats().
+ * @in_dirmap:	true while a read through a direct mapping is in progress
  */
 struct sandbox_spi_priv {
 	uint speed;
 	uint mode;
+	struct sandbox_spi_stats stats;
+	bool in_dirmap;
 };
 
+/* Bandwidth model, see struct sandbox_spi_stats */
+#define SANDBOX_SPI_SETUP_NS	1000	/* to start each transfer */
+#define SANDBOX_SPI_PIO_NS	20	/* for the CPU to move each FIFO byte */
+
 __weak int sandbox_spi_get_emul(struct sandbox_state *state,
 				struct udevice *bus, struct udevice *slave,
 				struct udevice **emulp)
@@ -62,10 +74,35 @@ uint sandbox_spi_get_mode(struct udevice *dev)
 	return priv->mode;
 }
 
+void sandbox_spi_get_stats(struct udevice *dev,
+			   struct sandbox_spi_stats *stats)
+{
+	struct sandbox_spi_priv *priv = dev_get_priv(dev);
+
+	*stats = priv->stats;
+}
+
+void sandbox_spi_reset_stats(struct udevice *dev)
+{
+	struct sandbox_spi_priv *priv = dev_get_priv(dev);
+
+	memset(&priv->stats, '\0', sizeof(priv->stats));
+}
+
+/* Time taken to clock @bytes over @lanes data lines at the bus speed */
+static u64 sandbox_spi_wire_ns(struct sandbox_spi_priv *priv, u64 bytes,
+			       uint lanes)
+{
+	uint speed = priv->speed ? priv->speed : 1000000;
+
+	return div_u64(bytes * 8 * NSEC_PER_SEC, speed * max(lanes, 1U));
+}
+
 static int sandbox_spi_xfer(struct udevice *slave, unsigned int bitlen,
 			    const void *dout, void *din, unsigned long flags)
 {
 	struct udevice *bus = slave->parent;
+	struct sandbox_spi_priv *priv = dev_get_priv(bus);
 	struct sandbox_state *state = state_get_current();
 	struct dm_spi_emul_ops *ops;
 	struct udevice *emul;
@@ -104,6 +141,14 @@ static int sandbox_spi_xfer(struct udevice *slave, unsigned int bitlen,
 	ops = spi_emul_get_ops(emul);
 	ret = ops->xfer(emul, bitlen, dout, din, flags);
 
+	if (!priv->in_dirmap) {
+		priv->stats.xfers++;
+		priv->stats.xfer_bytes += bytes;
+		priv->stats.bus_ns += SANDBOX_SPI_SETUP_NS +
+			sandbox_spi_wire_ns(priv, bytes, 1) +
+			bytes * SANDBOX_SPI_PIO_NS;
+	}
+
 	log_content("sandbox_spi: xfer: got back %i (that's %s)\n rx:",
 		    ret, ret ? "bad" : "good");
 	if (din) {
@@ -153,12 +198,66 @@ static int sandbox_spi_get_mmap(struct udevice *dev, ulong *map_basep,
 	return 0;
 }
 
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+static int sandbox_spi_dirmap_create(struct spi_mem_dirmap_desc *desc)
+{
+	/* Only reads can go through the mapping */
+	if (desc->info.op_tmpl.data.dir != SPI_MEM_DATA_IN)
+		return -EOPNOTSUPP;
+
+	return 0;
+}
+
+/*
+ * The emulator still sees an ordinary read op, but the transfer is accounted
+ * as a controller would take for it through a memory-mapped window: the
+ * data comes in over all the lanes of the op and the CPU does not touch it.
+ */
+static ssize_t sandbox_spi_dirmap_read(struct spi_mem_dirmap_desc *desc,
+				       u64 offs, size_t len, void *buf)
+{
+	struct sandbox_spi_priv *priv = dev_get_priv(desc->slave->dev->parent);
+	struct spi_mem_op op = desc->info.op_tmpl;
+	int ret;
+
+	if (offs >= desc->info.length)
+		return -EINVAL;
+	len = min_t(u64, len, desc->info.length - offs);
+
+	op.addr.val = desc->info.offset + offs;
+	op.data.nbytes = len;
+	op.data.buf.in = buf;
+	priv->in_dirmap = true;
+	ret = spi_mem_exec_op(desc->slave, &op);
+	priv->in_dirmap = false;
+	if (ret)
+		return ret;
+
+	priv->stats.dirmap_reads++;
+	priv->stats.dirmap_bytes += len;
+	priv->stats.bus_ns += SANDBOX_SPI_SETUP_NS +
+		sandbox_spi_wire_ns(priv, op.cmd.nbytes + op.addr.nbytes +
+				    op.dummy.nbytes, op.addr.buswidth) +
+		sandbox_spi_wire_ns(priv, len, op.data.buswidth);
+
+	return len;
+}
+
+static const struct spi_controller_mem_ops sandbox_spi_mem_ops = {
+	.dirmap_create	= sandbox_spi_dirmap_create,
+	.dirmap_read	= sandbox_spi_dirmap_read,
+};
+#endif
+
 static const struct dm_spi_ops sandbox_spi_ops = {
 	.xfer		= sandbox_spi_xfer,
 	.set_speed	= sandbox_spi_set_speed,
 	.set_mode	= sandbox_spi_set_mode,
 	.cs_info	= sandbox_cs_info,
 	.get_mmap	= sandbox_spi_get_mmap,
+#if CONFIG_IS_ENABLED(SPI_DIRMAP)
+	.mem_ops	= &sandbox_spi_mem_ops,
+#endif
 };
 
 static const struct udevice_id sandbox_spi_ids[] = {
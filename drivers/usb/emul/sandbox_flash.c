@@ -14,20 +14,35 @@
 #include <scsi.h>
 #include <scsi_emul.h>
 #include <usb.h>
+#include <asm/test.h>
+#include <linux/usb/uas.h>
 
 /*
  * This driver emulates a flash stick using the UFI command specification and
  * the BBB (bulk/bulk/bulk) protocol. It supports only a single logical unit
  * number (LUN 0).
+ *
+ * With the "sandbox,uas" property the stick also offers UAS (USB Attached
+ * SCSI) as alternate setting 1, as a high-speed device without streams.
+ * Commands are queued and run in order. The IUs on the status pipe are Read
+ * Ready or Write Ready when a command has data, then Sense.
  */
 
 enum {
 	SANDBOX_FLASH_EP_OUT		= 1,	/* endpoints */
 	SANDBOX_FLASH_EP_IN		= 2,
+	SANDBOX_FLASH_EP_CMD		= 3,	/* UAS only */
+	SANDBOX_FLASH_EP_STATUS		= 4,
 	SANDBOX_FLASH_BLOCK_LEN		= 512,
 	SANDBOX_FLASH_BUF_SIZE		= 512,
+	SANDBOX_FLASH_UAS_QUEUE		= 8,	/* max UAS commands waiting */
 };
 
+/* Bandwidth model, see struct sandbox_flash_stats */
+#define SANDBOX_FLASH_XFER_NS	20000	/* for each bulk transfer */
+#define SANDBOX_FLASH_BYTE_NS	25	/* to move each byte, about 40MB/s */
+#define SANDBOX_FLASH_CMD_NS	250000	/* for the flash to start a read/write */
+
 enum {
 	STRINGID_MANUFACTURER = 1,
 	STRINGID_PRODUCT,
@@ -36,6 +51,19 @@ enum {
 	STRINGID_COUNT,
 };
 
+/**
+ * struct sandbox_flash_uas_cmd - UAS command waiting to be run
+ *
+ * @tag:	Tag of the command, as sent by the host
+ * @cdb:	Command
+ * @ready_ns:	Bus time at which the flash is ready to move its data
+ */
+struct sandbox_flash_uas_cmd {
+	__be16 tag;
+	u8 cdb[16];
+	u64 ready_ns;
+};
+
 /**
  * struct sandbox_flash_priv - private state for this driver
  *
@@ -45,6 +73,16 @@ enum {
  * @fd:		File descriptor of backing file
  * @file_size:	Size of file in bytes
  * @status_buff:	Data buffer for outgoing status
+ * @stats:	Transfer statistics, see sandbox_flash_get_stats()
+ * @ready_ns:	Bus time at which the flash is ready to move the data of the
+ *		current command
+ * @alt:	Current alternate setting of the interface
+ * @uas_queue:	UAS commands waiting to be run, oldest first
+ * @uas_count:	Number of UAS commands waiting
+ * @uas_busy:	true while a UAS command is being run
+ * @uas_tag:	Tag of the UAS command being run
+ * @uas_tmf:	true if a response to a task management function is due
+ * @uas_tmf_tag:	Tag of that task management function
  */
 struct sandbox_flash_priv {
 	struct scsi_emul_info eminfo;
@@ -52,10 +90,27 @@ struct sandbox_flash_priv {
 	u32 tag;
 	int fd;
 	struct umass_bbb_csw status;
+	struct sandbox_flash_stats stats;
+	u64 ready_ns;
+	int alt;
+	struct sandbox_flash_uas_cmd uas_queue[SANDBOX_FLASH_UAS_QUEUE];
+	int uas_count;
+	bool uas_busy;
+	__be16 uas_tag;
+	bool uas_tmf;
+	__be16 uas_tmf_tag;
 };
 
+/**
+ * struct sandbox_flash_plat - platform data for this driver
+ *
+ * @pathname:	Name of backing file
+ * @uas:	true to offer UAS as alternate setting 1
+ * @flash_strings:	USB strings for the device
+ */
 struct sandbox_flash_plat {
 	const char *pathname;
+	bool uas;
 	struct usb_string flash_strings[STRINGID_COUNT];
 };
 
@@ -131,6 +186,138 @@ static void *flash_desc_list[] = {
 	NULL,
 };
 
+/* Configuration of a stick which offers UAS as alternate setting 1 */
+static struct usb_config_descriptor flash_uas_config0 = {
+	.bLength		= sizeof(flash_uas_config0),
+	.bDescriptorType	= USB_DT_CONFIG,
+
+	/* wTotalLength is set up by usb-emul-uclass */
+	.bNumInterfaces		= 1,
+	.bConfigurationValue	= 0,
+	.iConfiguration		= 0,
+	.bmAttributes		= 1 << 7,
+	.bMaxPower		= 50,
+};
+
+static struct usb_interface_descriptor flash_uas_interface0 = {
+	.bLength		= sizeof(flash_uas_interface0),
+	.bDescriptorType	= USB_DT_INTERFACE,
+
+	.bInterfaceNumber	= 0,
+	.bAlternateSetting	= 1,
+	.bNumEndpoints		= 4,
+	.bInterfaceClass	= USB_CLASS_MASS_STORAGE,
+	.bInterfaceSubClass	= US_SC_SCSI,
+	.bInterfaceProtocol	= US_PR_UAS,
+	.iInterface		= 0,
+};
+
+static struct usb_endpoint_descriptor flash_uas_endpoint_cmd = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_FLASH_EP_CMD,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(512),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor flash_uas_pipe_cmd = {
+	.bLength		= sizeof(flash_uas_pipe_cmd),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= CMD_PIPE_ID,
+};
+
+static struct usb_endpoint_descriptor flash_uas_endpoint_status = {
+	.bLength		= USB_DT_ENDPOINT_SIZE,
+	.bDescriptorType	= USB_DT_ENDPOINT,
+
+	.bEndpointAddress	= SANDBOX_FLASH_EP_STATUS | USB_ENDPOINT_DIR_MASK,
+	.bmAttributes		= USB_ENDPOINT_XFER_BULK,
+	.wMaxPacketSize		= __constant_cpu_to_le16(512),
+	.bInterval		= 0,
+};
+
+static struct usb_pipe_usage_descriptor flash_uas_pipe_status = {
+	.bLength		= sizeof(flash_uas_pipe_status),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= STATUS_PIPE_ID,
+};
+
+static struct usb_pipe_usage_descriptor flash_uas_pipe_data_in = {
+	.bLength		= sizeof(flash_uas_pipe_data_in),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= DATA_IN_PIPE_ID,
+};
+
+static struct usb_pipe_usage_descriptor flash_uas_pipe_data_out = {
+	.bLength		= sizeof(flash_uas_pipe_data_out),
+	.bDescriptorType	= USB_DT_PIPE_USAGE,
+	.bPipeID		= DATA_OUT_PIPE_ID,
+};
+
+static void *flash_uas_desc_list[] = {
+	&flash_device_desc,
+	&flash_uas_config0,
+	&flash_interface0,
+	&flash_endpoint0_out,
+	&flash_endpoint1_in,
+	&flash_uas_interface0,
+	&flash_uas_endpoint_cmd,
+	&flash_uas_pipe_cmd,
+	&flash_uas_endpoint_status,
+	&flash_uas_pipe_status,
+	&flash_endpoint1_in,
+	&flash_uas_pipe_data_in,
+	&flash_endpoint0_out,
+	&flash_uas_pipe_data_out,
+	NULL,
+};
+
+void sandbox_flash_get_stats(struct udevice *dev,
+			     struct sandbox_flash_stats *stats)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	*stats = priv->stats;
+}
+
+void sandbox_flash_reset_stats(struct udevice *dev)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	memset(&priv->stats, '\0', sizeof(priv->stats));
+	priv->ready_ns = 0;
+}
+
+/* Work out when the flash can move the data for a command */
+static u64 sandbox_flash_ready_ns(const u8 *cdb, u64 start_ns)
+{
+	if (*cdb != SCSI_READ10 && *cdb != SCSI_WRITE10)
+		return start_ns;
+
+	return start_ns + SANDBOX_FLASH_CMD_NS;
+}
+
+/* Wait for the flash to be ready, then move @len bytes */
+static void sandbox_flash_move_data(struct sandbox_flash_priv *priv, int len)
+{
+	struct sandbox_flash_stats *stats = &priv->stats;
+
+	stats->bus_ns = max(stats->bus_ns, priv->ready_ns) +
+		(u64)len * SANDBOX_FLASH_BYTE_NS;
+	stats->data_bytes += len;
+	stats->max_xfer = max_t(uint, stats->max_xfer, len);
+}
+
+static bool sandbox_flash_is_uas(struct udevice *dev)
+{
+	struct sandbox_flash_plat *plat = dev_get_plat(dev);
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+
+	return plat->uas && priv->alt == flash_uas_interface0.bAlternateSetting;
+}
+
 static int sandbox_flash_control(struct udevice *dev, struct usb_device *udev,
 				 unsigned long pipe, void *buff, int len,
 				 struct devrequest *setup)
@@ -149,6 +336,15 @@ static int sandbox_flash_control(struct udevice *dev, struct usb_device *udev,
 			debug("request=%x\n", setup->request);
 			break;
 		}
+	} else if (pipe == usb_sndctrlpipe(udev, 0) &&
+		   setup->request == USB_REQ_SET_INTERFACE) {
+		priv->alt = le16_to_cpu(setup->value);
+		priv->error = false;
+		priv->eminfo.phase = SCSIPH_START;
+		priv->uas_count = 0;
+		priv->uas_busy = false;
+		priv->uas_tmf = false;
+		return 0;
 	}
 	debug("pipe=%lx\n", pipe);
 
@@ -208,16 +404,78 @@ static int handle_ufi_command(struct sandbox_flash_priv *priv, const void *buff,
 	return 0;
 }
 
-static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
-			      unsigned long pipe, void *buff, int len)
+static int sandbox_flash_data_out(struct sandbox_flash_priv *priv,
+				  const void *buff, int len)
+{
+	struct scsi_emul_info *info = &priv->eminfo;
+
+	log_debug("data out, len=%x, info->write_len=%x\n", len,
+		  info->write_len);
+	if (!info->write_len)
+		return 0;
+	sandbox_flash_move_data(priv, len);
+	if (priv->fd != -1) {
+		ulong bytes_written;
+
+		bytes_written = os_write(priv->fd, buff, len);
+		log_debug("bytes_written=%lx", bytes_written);
+		if (bytes_written != len)
+			return -EIO;
+		info->write_len -= len / info->block_size;
+		if (!info->write_len)
+			info->phase = SCSIPH_STATUS;
+	} else {
+		if (info->alloc_len && len > info->alloc_len)
+			len = info->alloc_len;
+		if (len > SANDBOX_FLASH_BUF_SIZE)
+			len = SANDBOX_FLASH_BUF_SIZE;
+		memcpy(info->buff, buff, len);
+		info->phase = SCSIPH_STATUS;
+	}
+
+	return len;
+}
+
+static int sandbox_flash_data_in(struct sandbox_flash_priv *priv, void *buff,
+				 int len)
+{
+	struct scsi_emul_info *info = &priv->eminfo;
+
+	debug("data in, len=%x, alloc_len=%x, info->read_len=%x\n",
+	      len, info->alloc_len, info->read_len);
+	if (info->read_len) {
+		ulong bytes_read;
+
+		if (priv->fd == -1)
+			return -EIO;
+
+		sandbox_flash_move_data(priv, len);
+		bytes_read = os_read(priv->fd, buff, len);
+		if (bytes_read != len)
+			return -EIO;
+		info->read_len -= len / info->block_size;
+		if (!info->read_len)
+			info->phase = SCSIPH_STATUS;
+	} else {
+		if (info->alloc_len && len > info->alloc_len)
+			len = info->alloc_len;
+		if (len > SANDBOX_FLASH_BUF_SIZE)
+			len = SANDBOX_FLASH_BUF_SIZE;
+		sandbox_flash_move_data(priv, len);
+		memcpy(buff, info->buff, len);
+		info->phase = SCSIPH_STATUS;
+	}
+
+	return len;
+}
+
+static int sandbox_flash_bbb_bulk(struct sandbox_flash_priv *priv,
+				  unsigned long pipe, void *buff, int len)
 {
-	struct sandbox_flash_priv *priv = dev_get_priv(dev);
 	struct scsi_emul_info *info = &priv->eminfo;
 	int ep = usb_pipeendpoint(pipe);
 	struct umass_bbb_cbw *cbw = buff;
 
-	debug("%s: dev=%s, pipe=%lx, ep=%x, len=%x, phase=%d\n", __func__,
-	      dev->name, pipe, ep, len, info->phase);
 	switch (ep) {
 	case SANDBOX_FLASH_EP_OUT:
 		switch (info->phase) {
@@ -235,34 +493,15 @@ static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 				goto err;
 			info->transfer_len = cbw->dCBWDataTransferLength;
 			priv->tag = cbw->dCBWTag;
+			priv->stats.cmds++;
+			priv->ready_ns = sandbox_flash_ready_ns(cbw->CBWCDB,
+							priv->stats.bus_ns);
 			return handle_ufi_command(priv, cbw->CBWCDB,
 						  cbw->bCDBLength);
 		case SCSIPH_DATA:
-			log_debug("data out, len=%x, info->write_len=%x\n", len,
-				  info->write_len);
 			info->transfer_len = cbw->dCBWDataTransferLength;
 			priv->tag = cbw->dCBWTag;
-			if (!info->write_len)
-				return 0;
-			if (priv->fd != -1) {
-				ulong bytes_written;
-
-				bytes_written = os_write(priv->fd, buff, len);
-				log_debug("bytes_written=%lx", bytes_written);
-				if (bytes_written != len)
-					return -EIO;
-				info->write_len -= len / info->block_size;
-				if (!info->write_len)
-					info->phase = SCSIPH_STATUS;
-			} else {
-				if (info->alloc_len && len > info->alloc_len)
-					len = info->alloc_len;
-				if (len > SANDBOX_FLASH_BUF_SIZE)
-					len = SANDBOX_FLASH_BUF_SIZE;
-				memcpy(info->buff, buff, len);
-				info->phase = SCSIPH_STATUS;
-			}
-			return len;
+			return sandbox_flash_data_out(priv, buff, len);
 		default:
 			break;
 		}
@@ -270,29 +509,7 @@ static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
 	case SANDBOX_FLASH_EP_IN:
 		switch (info->phase) {
 		case SCSIPH_DATA:
-			debug("data in, len=%x, alloc_len=%x, info->read_len=%x\n",
-			      len, info->alloc_len, info->read_len);
-			if (info->read_len) {
-				ulong bytes_read;
-
-				if (priv->fd == -1)
-					return -EIO;
-
-				bytes_read = os_read(priv->fd, buff, len);
-				if (bytes_read != len)
-					return -EIO;
-				info->read_len -= len / info->block_size;
-				if (!info->read_len)
-					info->phase = SCSIPH_STATUS;
-			} else {
-				if (info->alloc_len && len > info->alloc_len)
-					len = info->alloc_len;
-				if (len > SANDBOX_FLASH_BUF_SIZE)
-					len = SANDBOX_FLASH_BUF_SIZE;
-				memcpy(buff, info->buff, len);
-				info->phase = SCSIPH_STATUS;
-			}
-			return len;
+			return sandbox_flash_data_in(priv, buff, len);
 		case SCSIPH_STATUS:
 			debug("status in, len=%x\n", len);
 			if (len > sizeof(priv->status))
@@ -310,6 +527,176 @@ err:
 	return 0;
 }
 
+/* Accept a command or task management IU from the host */
+static int sandbox_flash_uas_cmd(struct sandbox_flash_priv *priv,
+				 const void *buff, int len)
+{
+	const struct command_iu *cmd = buff;
+	struct sandbox_flash_uas_cmd *ent;
+	u64 start_ns;
+
+	if (len < sizeof(struct iu))
+		return -EIO;
+	switch (cmd->iu_id) {
+	case IU_ID_COMMAND:
+		if (len < sizeof(*cmd) ||
+		    priv->uas_count == SANDBOX_FLASH_UAS_QUEUE)
+			return -EIO;
+
+		/* The flash gets ready for each command in turn */
+		start_ns = priv->stats.bus_ns;
+		if (priv->uas_count)
+			start_ns = max(start_ns, priv->uas_queue[
+				       priv->uas_count - 1].ready_ns);
+		else if (priv->uas_busy)
+			start_ns = max(start_ns, priv->ready_ns);
+		ent = &priv->uas_queue[priv->uas_count++];
+		ent->tag = cmd->tag;
+		memcpy(ent->cdb, cmd->cdb, sizeof(ent->cdb));
+		ent->ready_ns = sandbox_flash_ready_ns(ent->cdb, start_ns);
+		priv->stats.cmds++;
+		priv->stats.max_queued = max_t(uint, priv->stats.max_queued,
+					       priv->uas_count);
+		return len;
+	case IU_ID_TASK_MGMT:
+		/* Every function is treated as a reset of the unit */
+		priv->uas_count = 0;
+		priv->uas_busy = false;
+		priv->uas_tmf = true;
+		priv->uas_tmf_tag = cmd->tag;
+		return len;
+	}
+
+	return -EIO;
+}
+
+/* Start the next UAS command, returning the IU to send back for it */
+static int sandbox_flash_uas_start(struct sandbox_flash_priv *priv,
+				   struct sense_iu *iu)
+{
+	struct scsi_emul_info *info = &priv->eminfo;
+	struct sandbox_flash_uas_cmd ent;
+
+	if (!priv->uas_count)
+		return -EIO;
+	ent = priv->uas_queue[0];
+	memmove(priv->uas_queue, priv->uas_queue + 1,
+		--priv->uas_count * sizeof(ent));
+	priv->uas_busy = true;
+	priv->uas_tag = ent.tag;
+	priv->ready_ns = ent.ready_ns;
+
+	info->alloc_len = 0;
+	info->read_len = 0;
+	info->write_len = 0;
+	/* There is no transfer length, but let the command have data */
+	info->transfer_len = 1;
+	handle_ufi_command(priv, ent.cdb, sizeof(ent.cdb));
+
+	iu->tag = priv->uas_tag;
+	if (priv->status.bCSWStatus == CSWSTATUS_GOOD &&
+	    info->phase == SCSIPH_DATA && info->buff_used) {
+		iu->iu_id = info->write_len ? IU_ID_WRITE_READY :
+			IU_ID_READ_READY;
+		return sizeof(struct iu);
+	}
+	info->phase = SCSIPH_STATUS;
+
+	return 0;
+}
+
+static int sandbox_flash_uas_status(struct sandbox_flash_priv *priv,
+				    void *buff, int len)
+{
+	struct scsi_emul_info *info = &priv->eminfo;
+	struct sense_iu iu;
+	int size;
+
+	memset(&iu, '\0', sizeof(iu));
+	if (priv->uas_tmf) {
+		struct response_iu *resp = (struct response_iu *)&iu;
+
+		resp->iu_id = IU_ID_RESPONSE;
+		resp->tag = priv->uas_tmf_tag;
+		resp->response_code = RC_TMF_COMPLETE;
+		priv->uas_tmf = false;
+		size = sizeof(*resp);
+	} else {
+		size = 0;
+		if (!priv->uas_busy) {
+			size = sandbox_flash_uas_start(priv, &iu);
+			if (size < 0)
+				return size;
+		} else if (info->phase != SCSIPH_STATUS) {
+			return -EIO;
+		}
+
+		/* Sense IU, to finish the command */
+		if (!size) {
+			iu.iu_id = IU_ID_STATUS;
+			iu.tag = priv->uas_tag;
+			if (priv->status.bCSWStatus != CSWSTATUS_GOOD) {
+				/* Check condition: illegal request */
+				iu.status = 2;
+				iu.len = cpu_to_be16(18);
+				iu.sense[0] = 0x70;
+				iu.sense[2] = 0x05;
+				iu.sense[7] = 10;
+				size = UAS_SENSE_IU_HDR_SIZE + 18;
+			} else {
+				size = UAS_SENSE_IU_HDR_SIZE;
+			}
+			priv->uas_busy = false;
+			info->phase = SCSIPH_START;
+		}
+	}
+	len = min(len, size);
+	memcpy(buff, &iu, len);
+
+	return len;
+}
+
+static int sandbox_flash_uas_bulk(struct sandbox_flash_priv *priv,
+				  unsigned long pipe, void *buff, int len)
+{
+	struct scsi_emul_info *info = &priv->eminfo;
+
+	switch (usb_pipeendpoint(pipe)) {
+	case SANDBOX_FLASH_EP_CMD:
+		return sandbox_flash_uas_cmd(priv, buff, len);
+	case SANDBOX_FLASH_EP_STATUS:
+		return sandbox_flash_uas_status(priv, buff, len);
+	case SANDBOX_FLASH_EP_OUT:
+		if (priv->uas_busy && info->phase == SCSIPH_DATA &&
+		    info->write_len)
+			return sandbox_flash_data_out(priv, buff, len);
+		break;
+	case SANDBOX_FLASH_EP_IN:
+		if (priv->uas_busy && info->phase == SCSIPH_DATA &&
+		    !info->write_len)
+			return sandbox_flash_data_in(priv, buff, len);
+		break;
+	}
+	debug("%s: Detected transfer error\n", __func__);
+
+	return -EIO;
+}
+
+static int sandbox_flash_bulk(struct udevice *dev, struct usb_device *udev,
+			      unsigned long pipe, void *buff, int len)
+{
+	struct sandbox_flash_priv *priv = dev_get_priv(dev);
+	int ep = usb_pipeendpoint(pipe);
+
+	debug("%s: dev=%s, pipe=%lx, ep=%x, len=%x, phase=%d\n", __func__,
+	      dev->name, pipe, ep, len, priv->eminfo.phase);
+	priv->stats.bus_ns += SANDBOX_FLASH_XFER_NS;
+	if (sandbox_flash_is_uas(dev))
+		return sandbox_flash_uas_bulk(priv, pipe, buff, len);
+
+	return sandbox_flash_bbb_bulk(priv, pipe, buff, len);
+}
+
 static int sandbox_flash_of_to_plat(struct udevice *dev)
 {
 	struct sandbox_flash_plat *plat = dev_get_plat(dev);
@@ -331,8 +718,11 @@ static int sandbox_flash_bind(struct udevice *dev)
 	fs[1].s = "flash";
 	fs[2].id = STRINGID_SERIAL;
 	fs[2].s = dev->name;
+	plat->uas = dev_read_bool(dev, "sandbox,uas");
 
-	return usb_emul_setup_device(dev, plat->flash_strings, flash_desc_list);
+	return usb_emul_setup_device(dev, plat->flash_strings,
+				     plat->uas ? flash_uas_desc_list :
+				     flash_desc_list);
 }
 
 static int sandbox_flash_probe(struct udevice *dev)
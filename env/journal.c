@@ -0,0 +1,339 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Environment journal: append changed variables to a log area after the
+ * environment instead of rewriting the whole environment on each 'saveenv'.
+ *
+ * The journal area starts with a header record holding a generation number
+ * and the CRC of the environment it belongs to. Each 'saveenv' appends one
+ * record with the variables changed since the last save, encoded as
+ * "name=value\0" pairs ("name\0" for a deleted variable), protected by its
+ * own CRC and padded to the write granularity of the device. When a record
+ * does not fit, the full environment is written and a new header with the
+ * next generation is written, which invalidates all older records.
+ */
+
+#include <common.h>
+#include <env.h>
+#include <env_internal.h>
+#include <errno.h>
+#include <log.h>
+#include <malloc.h>
+#include <memalign.h>
+#include <search.h>
+#include <asm/cache.h>
+#include <linux/kernel.h>
+#include <u-boot/crc.h>
+
+#define ENV_JOURNAL_HDR_MAGIC	0x4a564e45	/* "ENVJ" */
+#define ENV_JOURNAL_REC_MAGIC	0x52564e45	/* "ENVR" */
+
+/**
+ * struct env_journal_rec - Header of a journal record
+ *
+ * @magic: ENV_JOURNAL_HDR_MAGIC or ENV_JOURNAL_REC_MAGIC
+ * @gen: Generation this record belongs to
+ * @len: Number of data bytes following the header
+ * @crc: CRC32 over @gen, @len and the data
+ */
+struct env_journal_rec {
+	u32 magic;
+	u32 gen;
+	u32 len;
+	u32 crc;
+};
+
+static u32 env_journal_crc(const struct env_journal_rec *rec, const void *data)
+{
+	u32 crc;
+
+	crc = crc32(0, (const void *)&rec->gen, 2 * sizeof(u32));
+
+	return crc32(crc, data, rec->len);
+}
+
+static ulong env_journal_rec_size(struct env_journal *jnl, ulong len)
+{
+	return ALIGN(sizeof(struct env_journal_rec) + len, jnl->align);
+}
+
+/*
+ * Check the record at @buf, which has @avail bytes. Returns a pointer to the
+ * data or NULL if the record is not valid for this generation.
+ */
+static const char *env_journal_check(const struct env_journal_rec *rec,
+				     u32 magic, u32 gen, ulong avail)
+{
+	const char *data = (const char *)(rec + 1);
+
+	if (avail < sizeof(*rec) || rec->magic != magic)
+		return NULL;
+	if (rec->gen != gen || rec->len > avail - sizeof(*rec))
+		return NULL;
+	if (env_journal_crc(rec, data) != rec->crc)
+		return NULL;
+
+	return data;
+}
+
+static bool env_journal_is_erased(const char *buf, ulong len)
+{
+	while (len--) {
+		if (*buf++ != (char)0xff)
+			return false;
+	}
+
+	return true;
+}
+
+int env_journal_load(struct env_journal *jnl, const env_t *base)
+{
+	const struct env_journal_rec *hdr, *rec;
+	const char *data;
+	ulong offset;
+	u32 base_crc;
+	char *buf;
+	int count = 0;
+	int ret;
+
+	jnl->tail = 0;
+	jnl->gen = 0;
+	jnl->valid = false;
+
+	buf = memalign(ARCH_DMA_MINALIGN, jnl->size);
+	if (!buf)
+		return -ENOMEM;
+
+	ret = jnl->read(jnl, 0, jnl->size, buf);
+	if (ret) {
+		pr_err("Cannot read environment journal (err=%d)\n", ret);
+		goto out;
+	}
+
+	hdr = (struct env_journal_rec *)buf;
+	data = env_journal_check(hdr, ENV_JOURNAL_HDR_MAGIC, hdr->gen,
+				 jnl->size);
+	if (!data || hdr->len != sizeof(base_crc)) {
+		debug("No environment journal\n");
+		goto out;
+	}
+	jnl->gen = hdr->gen;
+	jnl->valid = true;
+
+	memcpy(&base_crc, data, sizeof(base_crc));
+	if (base_crc != base->crc) {
+		/* The environment was rewritten after the header */
+		debug("Environment journal is stale\n");
+		goto out;
+	}
+
+	offset = env_journal_rec_size(jnl, hdr->len);
+	while (offset < jnl->size) {
+		rec = (struct env_journal_rec *)(buf + offset);
+		data = env_journal_check(rec, ENV_JOURNAL_REC_MAGIC, jnl->gen,
+					 jnl->size - offset);
+		if (!data)
+			break;
+
+		if (!himport_r(&env_htab, data, rec->len, '\0',
+			       H_NOCLEAR | H_EXTERNAL, 0, 0, NULL)) {
+			pr_err("Cannot import environment journal record at %lx\n",
+			       offset);
+			break;
+		}
+		offset += env_journal_rec_size(jnl, rec->len);
+		count++;
+	}
+	jnl->tail = offset;
+	debug("Replayed %d environment journal records, tail %lx\n",
+		  count, jnl->tail);
+
+	/*
+	 * A save may have been interrupted while writing a record. Flash
+	 * cannot be written again until erased, so start a new journal.
+	 */
+	if (jnl->erased && !env_journal_is_erased(buf + offset,
+						  jnl->size - offset)) {
+		debug("Environment journal has a torn record at %lx\n",
+		      offset);
+		jnl->tail = jnl->size;
+	}
+
+out:
+	free(buf);
+
+	if (!jnl->tail)
+		jnl->tail = jnl->size;	/* force a full write on next save */
+
+	if (CONFIG_IS_ENABLED(SAVEENV)) {
+		/* Remember what is on the device, to diff against on save */
+		free(jnl->saved);
+		jnl->saved = malloc(sizeof(env_t));
+		if (!jnl->saved || env_export(jnl->saved)) {
+			free(jnl->saved);
+			jnl->saved = NULL;
+		}
+	}
+
+	return ret;
+}
+
+#if CONFIG_IS_ENABLED(SAVEENV)
+/* Return the length of the "name=value" pair at @p and of its name */
+static int env_journal_var(const char *p, int *name_lenp)
+{
+	const char *eq = strchr(p, '=');
+	int len = strlen(p);
+
+	*name_lenp = eq ? eq - p : len;
+
+	return len;
+}
+
+/*
+ * Write the variables which differ between @old and @new into @out, which
+ * must be large enough for both. Both lists are sorted by name, as produced
+ * by hexport_r(). Returns the number of bytes written.
+ */
+static ulong env_journal_diff(const char *old, const char *new, char *out)
+{
+	char *p = out;
+
+	while (*old || *new) {
+		int old_len, new_len, old_nlen, new_nlen, cmp;
+
+		old_len = env_journal_var(old, &old_nlen);
+		new_len = env_journal_var(new, &new_nlen);
+		if (!*old) {
+			cmp = 1;
+		} else if (!*new) {
+			cmp = -1;
+		} else {
+			/* same order as strcmp() on the names */
+			cmp = memcmp(old, new, min(old_nlen, new_nlen));
+			if (!cmp)
+				cmp = old_nlen - new_nlen;
+		}
+
+		if (cmp < 0) {
+			/* deleted */
+			memcpy(p, old, old_nlen);
+			p += old_nlen;
+			*p++ = '\0';
+			old += old_len + 1;
+		} else if (cmp > 0 || old_len != new_len ||
+			   memcmp(old, new, new_len)) {
+			/* added or changed */
+			memcpy(p, new, new_len + 1);
+			p += new_len + 1;
+			if (!cmp)
+				old += old_len + 1;
+			new += new_len + 1;
+		} else {
+			old += old_len + 1;
+			new += new_len + 1;
+		}
+	}
+
+	return p - out;
+}
+
+static int env_journal_append(struct env_journal *jnl, const char *data,
+			      ulong len)
+{
+	struct env_journal_rec *rec;
+	ulong size = env_journal_rec_size(jnl, len);
+	int ret;
+
+	rec = memalign(ARCH_DMA_MINALIGN, size);
+	if (!rec)
+		return -ENOMEM;
+
+	memset(rec, '\0', size);
+	rec->magic = ENV_JOURNAL_REC_MAGIC;
+	rec->gen = jnl->gen;
+	rec->len = len;
+	memcpy(rec + 1, data, len);
+	rec->crc = env_journal_crc(rec, data);
+
+	printf("Writing to %s journal... ", jnl->name);
+	ret = jnl->write(jnl, jnl->tail, size, rec);
+	if (ret) {
+		puts("failed\n");
+	} else {
+		puts("done\n");
+		jnl->tail += size;
+	}
+	free(rec);
+
+	return ret;
+}
+
+static int env_journal_compact(struct env_journal *jnl, env_t *env_new)
+{
+	struct env_journal_rec *hdr;
+	ulong size = env_journal_rec_size(jnl, sizeof(env_new->crc));
+	int ret;
+
+	ret = jnl->compact(jnl, env_new);
+	if (ret)
+		return ret;
+
+	hdr = memalign(ARCH_DMA_MINALIGN, size);
+	if (!hdr)
+		return -ENOMEM;
+
+	memset(hdr, '\0', size);
+	hdr->magic = ENV_JOURNAL_HDR_MAGIC;
+	/*
+	 * Without a previous header, old records may still be around, so
+	 * pick a generation that is unlikely to match them
+	 */
+	hdr->gen = jnl->valid ? jnl->gen + 1 : env_new->crc;
+	hdr->len = sizeof(env_new->crc);
+	memcpy(hdr + 1, &env_new->crc, sizeof(env_new->crc));
+	hdr->crc = env_journal_crc(hdr, hdr + 1);
+
+	ret = jnl->write(jnl, 0, size, hdr);
+	if (!ret) {
+		jnl->gen = hdr->gen;
+		jnl->valid = true;
+		jnl->tail = size;
+	}
+	free(hdr);
+
+	return ret;
+}
+
+int env_journal_save(struct env_journal *jnl, env_t *env_new)
+{
+	char *diff;
+	ulong len;
+	int ret;
+
+	if (!jnl->saved) {
+		jnl->saved = calloc(1, sizeof(env_t));
+		if (!jnl->saved)
+			return -ENOMEM;
+		jnl->tail = jnl->size;
+	}
+
+	diff = malloc(2 * ENV_SIZE);
+	if (!diff)
+		return -ENOMEM;
+
+	len = env_journal_diff((char *)jnl->saved->data, (char *)env_new->data,
+			       diff);
+	if (!len && jnl->tail < jnl->size)
+		ret = 0;
+	else if (jnl->tail + env_journal_rec_size(jnl, len) <= jnl->size)
+		ret = env_journal_append(jnl, diff, len);
+	else
+		ret = env_journal_compact(jnl, env_new);
+	free(diff);
+
+	if (!ret)
+		memcpy(jnl->saved, env_new, sizeof(env_t));
+
+	return ret;
+}
+#endif /* SAVEENV */
@@ -87,6 +87,10 @@ static inline int mmc_offset_try_partition(const char *str, int copy, s64 *val)
 
 	/* round up to info.blksz */
 	len = DIV_ROUND_UP(CONFIG_ENV_SIZE, info.blksz);
+#ifdef CONFIG_ENV_JOURNAL
+	/* leave room for the journal after the environment */
+	len += DIV_ROUND_UP(CONFIG_ENV_JOURNAL_SIZE, info.blksz);
+#endif
 
 	/* use the top of the partion for the environment */
 	*val = (info.start + info.size - (1 + copy) * len) * info.blksz;
@@ -239,6 +243,65 @@ static void fini_mmc_for_env(struct mmc *mmc)
 	mmc_set_env_part_restore(mmc);
 }
 
+static inline int read_env(struct mmc *mmc, unsigned long size,
+			   unsigned long offset, const void *buffer)
+{
+	uint blk_start, blk_cnt, n;
+	struct blk_desc *desc = mmc_get_blk_desc(mmc);
+
+	blk_start	= ALIGN(offset, mmc->read_bl_len) / mmc->read_bl_len;
+	blk_cnt		= ALIGN(size, mmc->read_bl_len) / mmc->read_bl_len;
+
+	n = blk_dread(desc, blk_start, blk_cnt, (uchar *)buffer);
+
+	return (n == blk_cnt) ? 0 : -1;
+}
+
+#ifdef CONFIG_ENV_JOURNAL
+static struct env_journal env_mmc_journal;
+static u32 env_mmc_journal_offset;
+static char env_mmc_journal_name[16];
+
+static int env_mmc_journal_read(struct env_journal *jnl, ulong offset,
+				ulong len, void *buf)
+{
+	return read_env(jnl->priv, len, env_mmc_journal_offset + offset, buf);
+}
+
+/* The journal directly follows the environment */
+static int env_mmc_journal_init(struct mmc *mmc)
+{
+	u32 offset;
+
+	if (mmc_get_env_addr(mmc, 0, &offset))
+		return -ENOENT;
+
+	env_mmc_journal_offset = offset + ALIGN(CONFIG_ENV_SIZE,
+						mmc->write_bl_len);
+
+	/*
+	 * A negative offset places the environment relative to the end of
+	 * the device, which may leave no room for the journal after it
+	 */
+	if ((u64)env_mmc_journal_offset + CONFIG_ENV_JOURNAL_SIZE >
+	    mmc->capacity) {
+		printf("No room for the ENV journal in MMC at 0x%x\n",
+		       env_mmc_journal_offset);
+		return -ENOSPC;
+	}
+
+	snprintf(env_mmc_journal_name, sizeof(env_mmc_journal_name),
+		 "MMC(%d)", mmc_get_env_dev());
+	env_mmc_journal.name = env_mmc_journal_name;
+	env_mmc_journal.size = CONFIG_ENV_JOURNAL_SIZE;
+	env_mmc_journal.align = mmc->write_bl_len;
+	env_mmc_journal.read = env_mmc_journal_read;
+	env_mmc_journal.priv = mmc;
+
+	return 0;
+}
+#endif /* CONFIG_ENV_JOURNAL */
+
 #if defined(CONFIG_CMD_SAVEENV) && !defined(CONFIG_SPL_BUILD)
 static inline int write_env(struct mmc *mmc, unsigned long size,
 			    unsigned long offset, const void *buffer)
@@ -254,6 +317,50 @@ static inline int write_env(struct mmc *mmc, unsigned long size,
 	return (n == blk_cnt) ? 0 : -1;
 }
 
+#ifdef CONFIG_ENV_JOURNAL
+static int env_mmc_journal_write(struct env_journal *jnl, ulong offset,
+				 ulong len, const void *buf)
+{
+	return write_env(jnl->priv, len, env_mmc_journal_offset + offset, buf);
+}
+
+static int env_mmc_journal_compact(struct env_journal *jnl, const env_t *env)
+{
+	struct mmc *mmc = jnl->priv;
+	u32 offset;
+
+	if (mmc_get_env_addr(mmc, 0, &offset))
+		return -ENOENT;
+
+	printf("Writing to %s... ", jnl->name);
+	if (write_env(mmc, CONFIG_ENV_SIZE, offset, env)) {
+		puts("failed\n");
+		return -EIO;
+	}
+
+	return 0;
+}
+
+static int env_mmc_journal_save(struct mmc *mmc, env_t *env_new)
+{
+	int ret;
+
+	ret = env_mmc_journal_init(mmc);
+	if (ret)
+		return ret;
+
+	env_mmc_journal.write = env_mmc_journal_write;
+	env_mmc_journal.compact = env_mmc_journal_compact;
+
+	return env_journal_save(&env_mmc_journal, env_new);
+}
+#else
+static int env_mmc_journal_save(struct mmc *mmc, env_t *env_new)
+{
+	return -ENOSYS;
+}
+#endif /* CONFIG_ENV_JOURNAL */
+
 static int env_mmc_save(void)
 {
 	ALLOC_CACHE_ALIGN_BUFFER(env_t, env_new, 1);
@@ -273,6 +380,11 @@ static int env_mmc_save(void)
 	if (ret)
 		goto fini;
 
+	if (IS_ENABLED(CONFIG_ENV_JOURNAL)) {
+		ret = env_mmc_journal_save(mmc, env_new);
+		goto fini;
+	}
+
 	if (IS_ENABLED(CONFIG_SYS_REDUNDAND_ENVIRONMENT)) {
 		if (gd->env_valid == ENV_VALID)
 			copy = 1;
@@ -370,20 +482,6 @@ fini:
 }
 #endif /* CONFIG_CMD_SAVEENV && !CONFIG_SPL_BUILD */
 
-static inline int read_env(struct mmc *mmc, unsigned long size,
-			   unsigned long offset, const void *buffer)
-{
-	uint blk_start, blk_cnt, n;
-	struct blk_desc *desc = mmc_get_blk_desc(mmc);
-
-	blk_start	= ALIGN(offset, mmc->read_bl_len) / mmc->read_bl_len;
-	blk_cnt		= ALIGN(size, mmc->read_bl_len) / mmc->read_bl_len;
-
-	n = blk_dread(desc, blk_start, blk_cnt, (uchar *)buffer);
-
-	return (n == blk_cnt) ? 0 : -1;
-}
-
 #if defined(ENV_IS_EMBEDDED)
 static int env_mmc_load(void)
 {
@@ -479,6 +577,10 @@ static int env_mmc_load(void)
 	if (!ret) {
 		ep = (env_t *)buf;
 		gd->env_addr = (ulong)&ep->data;
+#ifdef CONFIG_ENV_JOURNAL
+		if (!env_mmc_journal_init(mmc))
+			env_journal_load(&env_mmc_journal, ep);
+#endif
 	}
 
 fini:
@@ -189,18 +189,13 @@ out:
 	return ret;
 }
 #else
-static int env_sf_save(void)
+/* Write @env_new, preserving the rest of the sector if it is larger */
+static int env_sf_write(struct spi_flash *env_flash, const env_t *env_new)
 {
 	u32	saved_size = 0, saved_offset = 0, sector;
 	u32	sect_size = CONFIG_ENV_SECT_SIZE;
 	char	*saved_buffer = NULL;
-	int	ret = 1;
-	env_t	env_new;
-	struct spi_flash *env_flash;
-
-	ret = setup_flash_device(&env_flash);
-	if (ret)
-		return ret;
+	int	ret;
 
 	if (IS_ENABLED(CONFIG_ENV_SECT_SIZE_AUTO))
 		sect_size = env_flash->mtd.erasesize;
@@ -221,10 +216,6 @@ static int env_sf_save(void)
 			goto done;
 	}
 
-	ret = env_export(&env_new);
-	if (ret)
-		goto done;
-
 	sector = DIV_ROUND_UP(CONFIG_ENV_SIZE, sect_size);
 
 	puts("Erasing SPI flash...");
@@ -235,7 +226,7 @@ static int env_sf_save(void)
 
 	puts("Writing to SPI flash...");
 	ret = spi_flash_write(env_flash, CONFIG_ENV_OFFSET,
-		CONFIG_ENV_SIZE, &env_new);
+		CONFIG_ENV_SIZE, env_new);
 	if (ret)
 		goto done;
 
@@ -250,14 +241,107 @@ static int env_sf_save(void)
 	puts("done\n");
 
 done:
-	spi_flash_free(env_flash);
-
 	if (saved_buffer)
 		free(saved_buffer);
 
 	return ret;
 }
 
+#ifdef CONFIG_ENV_JOURNAL
+static struct env_journal env_sf_journal;
+
+/* The journal starts at the first sector after the environment */
+static u32 env_sf_journal_offset(struct spi_flash *env_flash)
+{
+	u32 sect_size = CONFIG_ENV_SECT_SIZE;
+
+	if (IS_ENABLED(CONFIG_ENV_SECT_SIZE_AUTO))
+		sect_size = env_flash->mtd.erasesize;
+
+	return CONFIG_ENV_OFFSET + roundup(CONFIG_ENV_SIZE, sect_size);
+}
+
+static int env_sf_journal_read(struct env_journal *jnl, ulong offset,
+			       ulong len, void *buf)
+{
+	struct spi_flash *env_flash = jnl->priv;
+
+	return spi_flash_read(env_flash, env_sf_journal_offset(env_flash) +
+			      offset, len, buf);
+}
+
+static int env_sf_journal_write(struct env_journal *jnl, ulong offset,
+				ulong len, const void *buf)
+{
+	struct spi_flash *env_flash = jnl->priv;
+
+	return spi_flash_write(env_flash, env_sf_journal_offset(env_flash) +
+			       offset, len, buf);
+}
+
+static int env_sf_journal_compact(struct env_journal *jnl, const env_t *env)
+{
+	struct spi_flash *env_flash = jnl->priv;
+	int ret;
+
+	ret = env_sf_write(env_flash, env);
+	if (ret)
+		return ret;
+
+	return spi_flash_erase(env_flash, env_sf_journal_offset(env_flash),
+			       jnl->size);
+}
+
+static void env_sf_journal_init(struct spi_flash *env_flash)
+{
+	env_sf_journal.name = "SPI flash";
+	env_sf_journal.size = CONFIG_ENV_JOURNAL_SIZE;
+	env_sf_journal.align = sizeof(u32);
+	env_sf_journal.erased = true;
+	env_sf_journal.read = env_sf_journal_read;
+	env_sf_journal.write = env_sf_journal_write;
+	env_sf_journal.compact = env_sf_journal_compact;
+	env_sf_journal.priv = env_flash;
+}
+
+static int env_sf_journal_save(struct spi_flash *env_flash, env_t *env_new)
+{
+	env_sf_journal_init(env_flash);
+
+	return env_journal_save(&env_sf_journal, env_new);
+}
+#else
+static int env_sf_journal_save(struct spi_flash *env_flash, env_t *env_new)
+{
+	return -ENOSYS;
+}
+#endif /* CONFIG_ENV_JOURNAL */
+
+static int env_sf_save(void)
+{
+	int	ret;
+	env_t	env_new;
+	struct spi_flash *env_flash;
+
+	ret = setup_flash_device(&env_flash);
+	if (ret)
+		return ret;
+
+	ret = env_export(&env_new);
+	if (ret)
+		goto done;
+
+	if (IS_ENABLED(CONFIG_ENV_JOURNAL))
+		ret = env_sf_journal_save(env_flash, &env_new);
+	else
+		ret = env_sf_write(env_flash, &env_new);
+
+done:
+	spi_flash_free(env_flash);
+
+	return ret;
+}
+
 static int env_sf_load(void)
 {
 	int ret;
@@ -282,8 +366,13 @@ static int env_sf_load(void)
 	}
 
 	ret = env_import(buf, 1, H_EXTERNAL);
-	if (!ret)
+	if (!ret) {
 		gd->env_valid = ENV_VALID;
+#ifdef CONFIG_ENV_JOURNAL
+		env_sf_journal_init(env_flash);
+		env_journal_load(&env_sf_journal, (env_t *)buf);
+#endif
+	}
 
 err_read:
 	spi_flash_free(env_flash);
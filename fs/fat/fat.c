@@ -151,17 +151,88 @@ static void get_name(dir_entry *dirent, char *s_name)
 		*s_name = DELETED_FLAG;
 }
 
-static int flush_dirty_fat_buffer(fsdata *mydata);
+static int flush_fat_window(fsdata *mydata, int win);
 
 #if !CONFIG_IS_ENABLED(FAT_WRITE)
 /* Stub for read only operation */
-int flush_dirty_fat_buffer(fsdata *mydata)
+int flush_fat_window(fsdata *mydata, int win)
 {
 	(void)(mydata);
+	(void)(win);
 	return 0;
 }
 #endif
 
+/*
+ * Allocate the FAT buffer, with all windows empty.
+ * Return 0 on success, -1 otherwise.
+ */
+static int alloc_fat_buffer(fsdata *mydata)
+{
+	int i;
+
+	for (i = 0; i < FATBUFWINDOWS; i++) {
+		mydata->fatwin[i].num = -1;
+		mydata->fatwin[i].dirty = 0;
+		mydata->fatwin[i].used = 0;
+	}
+	mydata->fatwin_clock = 0;
+	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE * FATBUFWINDOWS);
+	if (!mydata->fatbuf) {
+		debug("Error: allocating memory\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * Get the window of the FAT buffer holding block 'bufnum' of the FAT,
+ * reading it into the least recently used window if it is not cached.
+ * Return the index of the window, or -1 on failure.
+ */
+static int get_fat_window(fsdata *mydata, __u32 bufnum)
+{
+	__u32 getsize = FATBUFBLOCKS;
+	__u32 fatlength = mydata->fatlength;
+	__u32 startblock = bufnum * FATBUFBLOCKS;
+	struct fat_window *win;
+	__u8 *bufptr;
+	int i, lru = 0;
+
+	for (i = 0; i < FATBUFWINDOWS; i++) {
+		win = &mydata->fatwin[i];
+		if (win->num == (int)bufnum)
+			goto found;
+		if (win->used < mydata->fatwin[lru].used)
+			lru = i;
+	}
+	i = lru;
+	win = &mydata->fatwin[i];
+
+	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
+	if (startblock + getsize > fatlength)
+		getsize = fatlength - startblock;
+
+	startblock += mydata->fat_sect;	/* Offset from start of disk */
+
+	/* Write back the window to the disk */
+	if (flush_fat_window(mydata, i) < 0)
+		return -1;
+
+	win->num = -1;
+	bufptr = mydata->fatbuf + i * FATBUFSIZE;
+	if (disk_read(startblock, getsize, bufptr) < 0) {
+		debug("Error reading FAT blocks\n");
+		return -1;
+	}
+	win->num = bufnum;
+found:
+	win->used = ++mydata->fatwin_clock;
+
+	return i;
+}
+
 /*
  * Get the entry at index 'entry' in a FAT (12/16/32) table.
  * On failure 0x00 is returned.
@@ -171,6 +242,8 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	__u32 bufnum;
 	__u32 offset, off8;
 	__u32 ret = 0x00;
+	__u8 *fatbuf;
+	int win;
 
 	if (CHECK_CLUST(entry, mydata->fatsize)) {
 		log_err("Invalid FAT entry: %#08x\n", entry);
@@ -199,42 +272,24 @@ static __u32 get_fatent(fsdata *mydata, __u32 entry)
 	debug("FAT%d: entry: 0x%08x = %d, offset: 0x%04x = %d\n",
 	       mydata->fatsize, entry, entry, offset, offset);
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		__u32 getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
-
-		startblock += mydata->fat_sect;	/* Offset from start of disk */
-
-		/* Write back the fatbuf to the disk */
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return ret;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	/* Get the block of FAT entries from the cache */
+	win = get_fat_window(mydata, bufnum);
+	if (win < 0)
+		return ret;
+	fatbuf = mydata->fatbuf + win * FATBUFSIZE;
 
 	/* Get the actual entry from the table */
 	switch (mydata->fatsize) {
 	case 32:
-		ret = FAT2CPU32(((__u32 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU32(((__u32 *)fatbuf)[offset]);
 		break;
 	case 16:
-		ret = FAT2CPU16(((__u16 *) mydata->fatbuf)[offset]);
+		ret = FAT2CPU16(((__u16 *)fatbuf)[offset]);
 		break;
 	case 12:
 		off8 = (offset * 3) / 2;
 		/* fatbut + off8 may be unaligned, read in byte granularity */
-		ret = mydata->fatbuf[off8] + (mydata->fatbuf[off8 + 1] << 8);
+		ret = fatbuf[off8] + (fatbuf[off8 + 1] << 8);
 
 		if (offset & 0x1)
 			ret >>= 4;
@@ -309,6 +364,69 @@ get_cluster(fsdata *mydata, __u32 clustnum, __u8 *buffer, unsigned long size)
 	return 0;
 }
 
+/**
+ * struct fat_run - run of consecutive clusters in a cluster chain
+ *
+ * @clust:	first cluster of the run
+ * @count:	number of clusters in the run
+ */
+struct fat_run {
+	__u32 clust;
+	__u32 count;
+};
+
+/**
+ * get_runs() - resolve a cluster chain into runs of consecutive clusters
+ *
+ * Following the whole chain first keeps the accesses to the FAT together,
+ * and lets each run be read from the disk in one go.
+ *
+ * @mydata:	file system description
+ * @clust:	first cluster of the chain
+ * @count:	number of clusters to resolve
+ * @runsp:	returns the runs, which the caller must free
+ * Return:	number of runs, or -1 on error
+ */
+static int get_runs(fsdata *mydata, __u32 clust, __u32 count,
+		    struct fat_run **runsp)
+{
+	struct fat_run *runs = NULL, *tmp;
+	int nr = 0, max = 0;
+
+	while (count) {
+		if (CHECK_CLUST(clust, mydata->fatsize)) {
+			debug("curclust: 0x%x\n", clust);
+			printf("Invalid FAT entry\n");
+			goto err;
+		}
+		if (nr && clust == runs[nr - 1].clust + runs[nr - 1].count) {
+			runs[nr - 1].count++;
+		} else {
+			if (nr == max) {
+				max = max ? max * 2 : 8;
+				tmp = realloc(runs, max * sizeof(*runs));
+				if (!tmp) {
+					debug("Error: allocating buffer\n");
+					goto err;
+				}
+				runs = tmp;
+			}
+			runs[nr].clust = clust;
+			runs[nr].count = 1;
+			nr++;
+		}
+		if (--count)
+			clust = get_fatent(mydata, clust);
+	}
+	*runsp = runs;
+
+	return nr;
+err:
+	free(runs);
+
+	return -1;
+}
+
 /**
  * get_contents() - read from file
  *
@@ -329,9 +447,11 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 {
 	loff_t filesize = FAT2CPU32(dentptr->size);
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
-	__u32 curclust = START(dentptr);
-	__u32 endclust, newclust;
+	struct fat_run *runs;
+	__u32 clust, skip;
 	loff_t actsize;
+	int nr, i;
+	int ret = -1;
 
 	*gotsize = 0;
 	debug("Filesize: %llu bytes\n", filesize);
@@ -346,101 +466,69 @@ static int get_contents(fsdata *mydata, dir_entry *dentptr, loff_t pos,
 
 	debug("%llu bytes\n", filesize);
 
-	actsize = bytesperclust;
+	/* FAT file sizes are 32-bit, so 32-bit arithmetic is enough here */
+	nr = get_runs(mydata, START(dentptr),
+		      ((__u32)filesize - 1) / bytesperclust + 1, &runs);
+	if (nr < 0)
+		return -1;
 
 	/* go to cluster at pos */
-	while (actsize <= pos) {
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize += bytesperclust;
-	}
-
-	/* actsize > pos */
-	actsize -= bytesperclust;
-	filesize -= actsize;
-	pos -= actsize;
-
-	/* align to beginning of next cluster if any */
-	if (pos) {
+	clust = (__u32)pos / bytesperclust;
+	skip = (__u32)pos % bytesperclust;
+	for (i = 0; clust >= runs[i].count; i++)
+		clust -= runs[i].count;
+	filesize -= pos;
+
+	/* read up to the beginning of the next cluster if any */
+	if (skip) {
 		__u8 *tmp_buffer;
 
-		actsize = min(filesize, (loff_t)bytesperclust);
+		actsize = min(filesize + skip, (loff_t)bytesperclust);
 		tmp_buffer = malloc_cache_aligned(actsize);
 		if (!tmp_buffer) {
 			debug("Error: allocating buffer\n");
-			return -1;
+			goto out;
 		}
 
-		if (get_cluster(mydata, curclust, tmp_buffer, actsize) != 0) {
+		if (get_cluster(mydata, runs[i].clust + clust, tmp_buffer,
+				actsize) != 0) {
 			printf("Error reading cluster\n");
 			free(tmp_buffer);
-			return -1;
+			goto out;
 		}
-		filesize -= actsize;
-		actsize -= pos;
-		memcpy(buffer, tmp_buffer + pos, actsize);
+		actsize -= skip;
+		memcpy(buffer, tmp_buffer + skip, actsize);
 		free(tmp_buffer);
 		*gotsize += actsize;
-		if (!filesize)
-			return 0;
+		filesize -= actsize;
 		buffer += actsize;
 
-		curclust = get_fatent(mydata, curclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
+		if (++clust == runs[i].count) {
+			clust = 0;
+			i++;
 		}
 	}
 
-	actsize = bytesperclust;
-	endclust = curclust;
-
-	do {
-		/* search for consecutive clusters */
-		while (actsize < filesize) {
-			newclust = get_fatent(mydata, endclust);
-			if ((newclust - 1) != endclust)
-				goto getit;
-			if (CHECK_CLUST(newclust, mydata->fatsize)) {
-				debug("curclust: 0x%x\n", newclust);
-				printf("Invalid FAT entry\n");
-				return -1;
-			}
-			endclust = newclust;
-			actsize += bytesperclust;
-		}
-
-		/* get remaining bytes */
-		actsize = filesize;
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
+	/* read the rest a run at a time, straight into the buffer */
+	while (filesize) {
+		actsize = min(filesize,
+			      (loff_t)(runs[i].count - clust) * bytesperclust);
+		if (get_cluster(mydata, runs[i].clust + clust, buffer,
+				actsize) != 0) {
 			printf("Error reading cluster\n");
-			return -1;
+			goto out;
 		}
 		*gotsize += actsize;
-		return 0;
-getit:
-		if (get_cluster(mydata, curclust, buffer, (int)actsize) != 0) {
-			printf("Error reading cluster\n");
-			return -1;
-		}
-		*gotsize += (int)actsize;
 		filesize -= actsize;
 		buffer += actsize;
+		clust = 0;
+		i++;
+	}
+	ret = 0;
+out:
+	free(runs);
 
-		curclust = get_fatent(mydata, endclust);
-		if (CHECK_CLUST(curclust, mydata->fatsize)) {
-			debug("curclust: 0x%x\n", curclust);
-			printf("Invalid FAT entry\n");
-			return -1;
-		}
-		actsize = bytesperclust;
-		endclust = curclust;
-	} while (1);
+	return ret;
 }
 
 /*
@@ -684,13 +772,16 @@ static int get_fs_info(fsdata *mydata)
 		mydata->root_cluster = 0;
 	}
 
-	mydata->fatbufnum = -1;
-	mydata->fat_dirty = 0;
-	mydata->fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (mydata->fatbuf == NULL) {
-		debug("Error: allocating memory\n");
+	mydata->fsinfo_sect = 0;
+	if (mydata->fatsize == 32 && bs.info_sector != 0xffff)
+		mydata->fsinfo_sect = bs.info_sector;
+	mydata->free_change = 0;
+	mydata->clust_map = NULL;
+	mydata->clust_max = 0;
+	mydata->clust_pending = 0;
+
+	if (alloc_fat_buffer(mydata))
 		return -1;
-	}
 
 	debug("FAT%d, fat_sect: %d, fatlength: %d\n",
 	       mydata->fatsize, mydata->fat_sect, mydata->fatlength);
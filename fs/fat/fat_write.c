@@ -213,19 +213,19 @@ static int disk_write(__u32 block, __u32 nr_blocks, void *buf)
 }
 
 /*
- * Write fat buffer into block device
+ * Write a window of the fat buffer into block device
  */
-static int flush_dirty_fat_buffer(fsdata *mydata)
+static int flush_fat_window(fsdata *mydata, int win)
 {
 	int getsize = FATBUFBLOCKS;
 	__u32 fatlength = mydata->fatlength;
-	__u8 *bufptr = mydata->fatbuf;
-	__u32 startblock = mydata->fatbufnum * FATBUFBLOCKS;
+	__u8 *bufptr = mydata->fatbuf + win * FATBUFSIZE;
+	__u32 startblock = mydata->fatwin[win].num * FATBUFBLOCKS;
 
-	debug("debug: evicting %d, dirty: %d\n", mydata->fatbufnum,
-	      (int)mydata->fat_dirty);
+	debug("debug: evicting %d, dirty: %d\n", mydata->fatwin[win].num,
+	      (int)mydata->fatwin[win].dirty);
 
-	if ((!mydata->fat_dirty) || (mydata->fatbufnum == -1))
+	if (!mydata->fatwin[win].dirty || mydata->fatwin[win].num == -1)
 		return 0;
 
 	/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
@@ -248,7 +248,288 @@ static int flush_dirty_fat_buffer(fsdata *mydata)
 			return -1;
 		}
 	}
-	mydata->fat_dirty = 0;
+	mydata->fatwin[win].dirty = 0;
+
+	return 0;
+}
+
+/*
+ * Write all modified windows of the fat buffer into block device
+ */
+static int flush_dirty_fat_buffer(fsdata *mydata)
+{
+	int i;
+
+	for (i = 0; i < FATBUFWINDOWS; i++) {
+		if (flush_fat_window(mydata, i) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+/*
+ * The clusters in use are tracked in a bitmap, so that runs of free clusters
+ * can be found without going through the FAT entry by entry. The bitmap is
+ * filled in from the FAT as far as allocations need it, through the FAT
+ * buffer, and then kept up to date by set_fatent_value(). It lasts for one
+ * write, mkdir or rm. Where it would be larger than FAT_CLUST_MAP_MAX, or
+ * cannot be allocated, free clusters are looked up in the FAT buffer instead.
+ */
+
+/* First cluster to allocate, as find_empty_cluster() always did */
+#define FAT_FIRST_ALLOC		3
+
+/* Largest bitmap to allocate, which covers 4M clusters */
+#define FAT_CLUST_MAP_MAX	(512 << 10)
+
+/* Number of FAT entries in one window of the FAT cache */
+static __u32 clust_per_win(fsdata *mydata)
+{
+	switch (mydata->fatsize) {
+	case 32:
+		return FAT32BUFSIZE;
+	case 16:
+		return FAT16BUFSIZE;
+	default:
+		return FAT12BUFSIZE;
+	}
+}
+
+/* Check whether the bits for the window holding 'clust' have been read */
+static bool clust_map_done(fsdata *mydata, __u32 clust)
+{
+	__u32 win = clust / clust_per_win(mydata);
+
+	return mydata->clust_map_done[win / BITS_PER_LONG] &
+		BIT(win % BITS_PER_LONG);
+}
+
+/* Check whether 'clust' is in use, from the bitmap or else from the FAT */
+static bool clust_used(fsdata *mydata, __u32 clust)
+{
+	if (!mydata->clust_map)
+		return clust == mydata->clust_pending ||
+			get_fatent(mydata, clust);
+
+	return mydata->clust_map[clust / BITS_PER_LONG] &
+		BIT(clust % BITS_PER_LONG);
+}
+
+/*
+ * Update the bitmap after the FAT entry of 'clust' changes. Windows which
+ * have not been read yet pick up the change from the FAT cache later.
+ */
+static void clust_map_set(fsdata *mydata, __u32 clust, bool used)
+{
+	if (clust == mydata->clust_pending)
+		mydata->clust_pending = 0;
+	if (!mydata->clust_map || clust > mydata->clust_max ||
+	    !clust_map_done(mydata, clust))
+		return;
+	if (used)
+		mydata->clust_map[clust / BITS_PER_LONG] |=
+			BIT(clust % BITS_PER_LONG);
+	else
+		mydata->clust_map[clust / BITS_PER_LONG] &=
+			~BIT(clust % BITS_PER_LONG);
+}
+
+/*
+ * Work out the highest cluster and allocate an empty bitmap covering every
+ * cluster, if it is small enough
+ */
+static void clust_map_init(fsdata *mydata)
+{
+	u64 ents = (u64)mydata->fatlength * mydata->sect_size * 8;
+	__u32 max, words, size;
+
+	/* Highest cluster both on the disk and in the FAT */
+	max = (mydata->total_sect - mydata->data_begin) /
+		mydata->clust_size - 1;
+	max = min_t(u64, max, div_u64(ents, mydata->fatsize) - 1);
+	if (mydata->fatsize == 12)
+		max = min(max, 0xfefU);
+	else if (mydata->fatsize == 16)
+		max = min(max, 0xffefU);
+	else
+		max = min(max, 0xfffffefU);
+	mydata->clust_max = max;
+
+	words = BITS_TO_LONGS(max + 1);
+	size = (words + BITS_TO_LONGS(max / clust_per_win(mydata) + 1)) *
+		sizeof(long);
+	if (size > FAT_CLUST_MAP_MAX)
+		return;
+	mydata->clust_map = calloc(size, 1);
+	if (!mydata->clust_map) {
+		debug("Cannot allocate cluster map, using FAT\n");
+		return;
+	}
+	mydata->clust_map_done = mydata->clust_map + words;
+}
+
+/*
+ * Read the window of the FAT holding 'clust' and fill in the bitmap from it,
+ * so that only the parts of the FAT which are searched get read.
+ * Return 0 on success, -1 otherwise.
+ */
+static int clust_map_fill(fsdata *mydata, __u32 clust)
+{
+	__u32 per_win = clust_per_win(mydata);
+	__u32 win = clust / per_win;
+	__u32 c, end;
+
+	if (clust > mydata->clust_max ||
+	    (mydata->clust_map && clust_map_done(mydata, clust)))
+		return 0;
+
+	if (get_fat_window(mydata, win) < 0)
+		return -1;
+	if (!mydata->clust_map)
+		return 0;
+	end = min((win + 1) * per_win, mydata->clust_max + 1);
+	for (c = max(win * per_win, 2U); c < end; c++) {
+		if (get_fatent(mydata, c))
+			mydata->clust_map[c / BITS_PER_LONG] |=
+				BIT(c % BITS_PER_LONG);
+	}
+	mydata->clust_map_done[win / BITS_PER_LONG] |= BIT(win % BITS_PER_LONG);
+
+	return 0;
+}
+
+/*
+ * Find the first cluster in ['clust', 'end') which is free, or in use if
+ * 'used' is set, filling in the bitmap as needed.
+ * Return the cluster, 'end' if there is none, or 0 on error.
+ */
+static __u32 clust_map_find(fsdata *mydata, __u32 clust, __u32 end, bool used)
+{
+	unsigned long skip = used ? 0 : ~0UL;
+	__u32 win_end = 0;
+
+	end = min(end, mydata->clust_max + 1);
+	for (; clust < end; clust++) {
+		if (clust >= win_end) {
+			if (clust_map_fill(mydata, clust))
+				return 0;
+			win_end = roundup(clust + 1, clust_per_win(mydata));
+		}
+		/* Skip whole words of the bitmap where possible */
+		if (mydata->clust_map && !(clust % BITS_PER_LONG) &&
+		    clust + BITS_PER_LONG <= min(end, win_end) &&
+		    mydata->clust_map[clust / BITS_PER_LONG] == skip) {
+			clust += BITS_PER_LONG - 1;
+			continue;
+		}
+		if (clust_used(mydata, clust) == used)
+			return clust;
+	}
+
+	return end;
+}
+
+/*
+ * Allocate a free cluster, preferring 'hint' and those after it. The cluster
+ * is only marked as used here; the caller sets its FAT entry before
+ * allocating another one.
+ * Return the cluster, or 0 if the filesystem is full or on error.
+ */
+static __u32 alloc_cluster(fsdata *mydata, __u32 hint)
+{
+	__u32 clust;
+
+	if (!mydata->clust_max)
+		clust_map_init(mydata);
+	if (hint < FAT_FIRST_ALLOC || hint > mydata->clust_max)
+		hint = FAT_FIRST_ALLOC;
+
+	clust = clust_map_find(mydata, hint, mydata->clust_max + 1, false);
+	if (clust > mydata->clust_max) {
+		/* Wrap around to the start of the FAT */
+		clust = clust_map_find(mydata, FAT_FIRST_ALLOC, hint, false);
+		if (clust == hint)
+			return 0;
+	}
+	if (!clust)
+		return 0;
+	clust_map_set(mydata, clust, true);
+	if (!mydata->clust_map)
+		mydata->clust_pending = clust;
+
+	return clust;
+}
+
+/*
+ * Find the start of a run of at least 'count' free clusters, or of the
+ * longest run if there is none that long, so that large files are written
+ * contiguously. Without a bitmap this would read the whole FAT, so the
+ * first free cluster is used instead, as before.
+ * Return the first cluster of the run, or 0 if the filesystem is full, on
+ * error, or without a bitmap.
+ */
+static __u32 find_free_run(fsdata *mydata, __u32 count)
+{
+	__u32 start, end, best = 0, best_len = 0;
+
+	if (!mydata->clust_max)
+		clust_map_init(mydata);
+	if (!mydata->clust_map)
+		return 0;
+
+	for (start = FAT_FIRST_ALLOC; ; start = end) {
+		start = clust_map_find(mydata, start, mydata->clust_max + 1,
+				       false);
+		if (!start || start > mydata->clust_max)
+			break;
+		end = clust_map_find(mydata, start, start + count, true);
+		if (!end)
+			return 0;
+		if (end - start >= count)
+			return start;
+		if (end - start > best_len) {
+			best = start;
+			best_len = end - start;
+		}
+	}
+
+	return best;
+}
+
+/*
+ * Write the change in the number of free clusters to the FAT32 FSInfo
+ * sector, once the FAT has been written
+ */
+static int flush_fsinfo(fsdata *mydata)
+{
+	ALLOC_CACHE_ALIGN_BUFFER(__u8, block, mydata->sect_size);
+	__u32 free_count;
+
+	if (!mydata->fsinfo_sect || !mydata->free_change)
+		return 0;
+
+	if (disk_read(mydata->fsinfo_sect, 1, block) != 1) {
+		debug("Error: reading FSInfo sector\n");
+		return -1;
+	}
+	if (get_unaligned_le32(block) != FSINFO_LEAD_SIG ||
+	    get_unaligned_le32(block + FSINFO_STRUC_SIG_OFF) !=
+	    FSINFO_STRUC_SIG)
+		return 0;
+
+	/* Leave an unknown count for the next fsck to work out */
+	free_count = get_unaligned_le32(block + FSINFO_FREE_OFF);
+	if (free_count != FSINFO_UNKNOWN) {
+		free_count += mydata->free_change;
+		put_unaligned_le32(free_count, block + FSINFO_FREE_OFF);
+	}
+
+	if (disk_write(mydata->fsinfo_sect, 1, block) != 1) {
+		debug("Error: writing FSInfo sector\n");
+		return -1;
+	}
+	mydata->free_change = 0;
 
 	return 0;
 }
@@ -440,8 +721,10 @@ fill_dir_slot(fat_itr *itr, const char *l_name, const char *shortname)
  */
 static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 {
-	__u32 bufnum, offset, off16;
+	__u32 bufnum, offset, off16, old_value;
 	__u16 val1, val2;
+	__u8 *fatbuf;
+	int win;
 
 	switch (mydata->fatsize) {
 	case 32:
@@ -461,39 +744,30 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 		return -1;
 	}
 
-	/* Read a new block of FAT entries into the cache. */
-	if (bufnum != mydata->fatbufnum) {
-		int getsize = FATBUFBLOCKS;
-		__u8 *bufptr = mydata->fatbuf;
-		__u32 fatlength = mydata->fatlength;
-		__u32 startblock = bufnum * FATBUFBLOCKS;
-
-		/* Cap length if fatlength is not a multiple of FATBUFBLOCKS */
-		if (startblock + getsize > fatlength)
-			getsize = fatlength - startblock;
+	/* Keep track of clusters being allocated and freed */
+	old_value = get_fatent(mydata, entry);
+	if (!old_value && entry_value)
+		mydata->free_change--;
+	else if (old_value && !entry_value)
+		mydata->free_change++;
+	clust_map_set(mydata, entry, entry_value);
 
-		if (flush_dirty_fat_buffer(mydata) < 0)
-			return -1;
-
-		startblock += mydata->fat_sect;
-
-		if (disk_read(startblock, getsize, bufptr) < 0) {
-			debug("Error reading FAT blocks\n");
-			return -1;
-		}
-		mydata->fatbufnum = bufnum;
-	}
+	/* Get the block of FAT entries from the cache */
+	win = get_fat_window(mydata, bufnum);
+	if (win < 0)
+		return -1;
+	fatbuf = mydata->fatbuf + win * FATBUFSIZE;
 
 	/* Mark as dirty */
-	mydata->fat_dirty = 1;
+	mydata->fatwin[win].dirty = 1;
 
 	/* Set the actual entry */
 	switch (mydata->fatsize) {
 	case 32:
-		((__u32 *) mydata->fatbuf)[offset] = cpu_to_le32(entry_value);
+		((__u32 *)fatbuf)[offset] = cpu_to_le32(entry_value);
 		break;
 	case 16:
-		((__u16 *) mydata->fatbuf)[offset] = cpu_to_le16(entry_value);
+		((__u16 *)fatbuf)[offset] = cpu_to_le16(entry_value);
 		break;
 	case 12:
 		off16 = (offset * 3) / 4;
@@ -501,33 +775,33 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 		switch (offset & 0x3) {
 		case 0:
 			val1 = cpu_to_le16(entry_value) & 0xfff;
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xfff;
-			((__u16 *)mydata->fatbuf)[off16] |= val1;
+			((__u16 *)fatbuf)[off16] &= ~0xfff;
+			((__u16 *)fatbuf)[off16] |= val1;
 			break;
 		case 1:
 			val1 = cpu_to_le16(entry_value) & 0xf;
 			val2 = (cpu_to_le16(entry_value) >> 4) & 0xff;
 
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xf000;
-			((__u16 *)mydata->fatbuf)[off16] |= (val1 << 12);
+			((__u16 *)fatbuf)[off16] &= ~0xf000;
+			((__u16 *)fatbuf)[off16] |= (val1 << 12);
 
-			((__u16 *)mydata->fatbuf)[off16 + 1] &= ~0xff;
-			((__u16 *)mydata->fatbuf)[off16 + 1] |= val2;
+			((__u16 *)fatbuf)[off16 + 1] &= ~0xff;
+			((__u16 *)fatbuf)[off16 + 1] |= val2;
 			break;
 		case 2:
 			val1 = cpu_to_le16(entry_value) & 0xff;
 			val2 = (cpu_to_le16(entry_value) >> 8) & 0xf;
 
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xff00;
-			((__u16 *)mydata->fatbuf)[off16] |= (val1 << 8);
+			((__u16 *)fatbuf)[off16] &= ~0xff00;
+			((__u16 *)fatbuf)[off16] |= (val1 << 8);
 
-			((__u16 *)mydata->fatbuf)[off16 + 1] &= ~0xf;
-			((__u16 *)mydata->fatbuf)[off16 + 1] |= val2;
+			((__u16 *)fatbuf)[off16 + 1] &= ~0xf;
+			((__u16 *)fatbuf)[off16 + 1] |= val2;
 			break;
 		case 3:
 			val1 = cpu_to_le16(entry_value) & 0xfff;
-			((__u16 *)mydata->fatbuf)[off16] &= ~0xfff0;
-			((__u16 *)mydata->fatbuf)[off16] |= (val1 << 4);
+			((__u16 *)fatbuf)[off16] &= ~0xfff0;
+			((__u16 *)fatbuf)[off16] |= (val1 << 4);
 			break;
 		default:
 			break;
@@ -544,20 +818,18 @@ static int set_fatent_value(fsdata *mydata, __u32 entry, __u32 entry_value)
 /*
  * Determine the next free cluster after 'entry' in a FAT (12/16/32) table
  * and link it to 'entry'. EOC marker is not set on returned entry.
+ * Return 0 if there is no free cluster.
  */
 static __u32 determine_fatent(fsdata *mydata, __u32 entry)
 {
-	__u32 next_fat, next_entry = entry + 1;
+	__u32 next_entry;
 
-	while (1) {
-		next_fat = get_fatent(mydata, next_entry);
-		if (next_fat == 0) {
-			/* found free entry, link to entry */
-			set_fatent_value(mydata, entry, next_entry);
-			break;
-		}
-		next_entry++;
-	}
+	next_entry = alloc_cluster(mydata, entry + 1);
+	if (!next_entry)
+		return 0;
+
+	/* found free entry, link to entry */
+	set_fatent_value(mydata, entry, next_entry);
 	debug("FAT%d: entry: %08x, entry_value: %04x\n",
 	       mydata->fatsize, entry, next_entry);
 
@@ -800,27 +1072,19 @@ get_set_cluster(fsdata *mydata, __u32 clustnum, loff_t pos, __u8 *buffer,
 }
 
 /*
- * Find the first empty cluster
+ * Find the first empty cluster, and reserve it.
+ * Return 0 if there is none.
  */
 static int find_empty_cluster(fsdata *mydata)
 {
-	__u32 fat_val, entry = 3;
-
-	while (1) {
-		fat_val = get_fatent(mydata, entry);
-		if (fat_val == 0)
-			break;
-		entry++;
-	}
-
-	return entry;
+	return alloc_cluster(mydata, FAT_FIRST_ALLOC);
 }
 
 /**
  * new_dir_table() - allocate a cluster for additional directory entries
  *
  * @itr:	directory iterator
- * Return:	0 on success, -EIO otherwise
+ * Return:	0 on success, -ENOSPC if the filesystem is full, -EIO otherwise
  */
 static int new_dir_table(fat_itr *itr)
 {
@@ -830,6 +1094,8 @@ static int new_dir_table(fat_itr *itr)
 	unsigned int bytesperclust = mydata->clust_size * mydata->sect_size;
 
 	dir_newclust = find_empty_cluster(mydata);
+	if (!dir_newclust)
+		return -ENOSPC;
 
 	/*
 	 * Flush before updating FAT to ensure valid directory structure
@@ -1071,14 +1337,26 @@ set_clusters:
 
 	/* Assure that curclust is valid */
 	if (!curclust) {
-		curclust = find_empty_cluster(mydata);
+		/* Start where the whole file fits in one run, if possible */
+		curclust = find_free_run(mydata,
+					 div_u64(filesize + bytesperclust - 1,
+						 bytesperclust));
+		curclust = alloc_cluster(mydata, curclust);
+		if (!curclust) {
+			printf("Error: no space left: %llu\n", filesize);
+			return -1;
+		}
 		set_start_cluster(mydata, dentptr, curclust);
 	} else {
 		newclust = get_fatent(mydata, curclust);
 
 		if (IS_LAST_CLUST(newclust, mydata->fatsize)) {
 			newclust = determine_fatent(mydata, curclust);
-			set_fatent_value(mydata, curclust, newclust);
+			if (!newclust) {
+				printf("Error: no space left: %llu\n",
+				       filesize);
+				return -1;
+			}
 			curclust = newclust;
 		} else {
 			debug("error: something wrong\n");
@@ -1098,6 +1376,11 @@ set_clusters:
 		/* search for consecutive clusters */
 		while (actsize < filesize) {
 			newclust = determine_fatent(mydata, endclust);
+			if (!newclust) {
+				printf("Error: no space left: %llu\n",
+				       filesize);
+				return -1;
+			}
 
 			if ((newclust - 1) != endclust)
 				/* write to <curclust..endclust> */
@@ -1420,6 +1703,8 @@ int file_fat_write_at(const char *filename, loff_t pos, void *buffer,
 
 	/* Flush fat buffer */
 	ret = flush_dirty_fat_buffer(mydata);
+	if (!ret)
+		ret = flush_fsinfo(mydata);
 	if (ret) {
 		printf("Error: flush fat buffer\n");
 		ret = -EIO;
@@ -1432,6 +1717,7 @@ int file_fat_write_at(const char *filename, loff_t pos, void *buffer,
 exit:
 	free(filename_copy);
 	free(mydata->fatbuf);
+	free(mydata->clust_map);
 	free(itr);
 	return ret;
 }
@@ -1445,8 +1731,7 @@ int file_fat_write(const char *filename, void *buffer, loff_t offset,
 static int fat_dir_entries(fat_itr *itr)
 {
 	fat_itr *dirs;
-	fsdata fsdata = { .fatbuf = NULL, }, *mydata = &fsdata;
-						/* for FATBUFSIZE */
+	fsdata fsdata = { .fatbuf = NULL, };
 	int count;
 
 	dirs = malloc_cache_aligned(sizeof(fat_itr));
@@ -1456,18 +1741,22 @@ static int fat_dir_entries(fat_itr *itr)
 		goto exit;
 	}
 
-	/* duplicate fsdata */
+	/* duplicate fsdata, which reads the FAT through its own buffer */
+	if (flush_dirty_fat_buffer(itr->fsdata) < 0) {
+		count = -EIO;
+		goto exit;
+	}
 	fat_itr_child(dirs, itr);
 	fsdata = *dirs->fsdata;
+	fsdata.clust_map = NULL;
+	fsdata.clust_max = 0;
+	fsdata.clust_pending = 0;
 
 	/* allocate local fat buffer */
-	fsdata.fatbuf = malloc_cache_aligned(FATBUFSIZE);
-	if (!fsdata.fatbuf) {
-		debug("Error: allocating memory\n");
+	if (alloc_fat_buffer(&fsdata)) {
 		count = -ENOMEM;
 		goto exit;
 	}
-	fsdata.fatbufnum = -1;
 	dirs->fsdata = &fsdata;
 
 	for (count = 0; fat_itr_next(dirs); count++)
@@ -1619,6 +1908,8 @@ int fat_unlink(const char *filename)
 	}
 
 	ret = delete_dentry_long(itr);
+	if (!ret && flush_fsinfo(&fsdata))
+		ret = -EIO;
 
 exit:
 	free(fsdata.fatbuf);
@@ -1754,6 +2045,8 @@ int fat_mkdir(const char *dirname)
 
 	/* Flush fat buffer */
 	ret = flush_dirty_fat_buffer(mydata);
+	if (!ret)
+		ret = flush_fsinfo(mydata);
 	if (ret) {
 		printf("Error: flush fat buffer\n");
 		ret = -EIO;
@@ -1766,6 +2059,7 @@ int fat_mkdir(const char *dirname)
 exit:
 	free(dirname_copy);
 	free(mydata->fatbuf);
+	free(mydata->clust_map);
 	free(itr);
 	free(dotdent);
 	return ret;
@@ -1405,6 +1405,12 @@ static int mount_ubifs(struct ubifs_info *c)
 	}
 #endif
 
+#ifdef __UBOOT__
+	/* There are no mount options in U-Boot, so use the configured default */
+	if (!c->mount_opts.bulk_read)
+		c->bulk_read = IS_ENABLED(CONFIG_UBIFS_BULK_READ);
+#endif
+
 	if (c->bulk_read == 1)
 		bu_init(c);
 
@@ -1758,7 +1764,8 @@ void ubifs_umount(struct ubifs_info *c)
 	kfree(c->bottom_up_buf);
 	ubifs_debugging_exit(c);
 #ifdef __UBOOT__
-	ubi_close_volume(c->ubi);
+	if (c->ubi)
+		ubi_close_volume(c->ubi);
 	mutex_unlock(&c->umount_mutex);
 	/* Finally free U-Boot's global copy of superblock */
 	if (ubifs_sb != NULL) {
@@ -2512,6 +2519,10 @@ static struct dentry *ubifs_mount(struct file_system_type *fs_type, int flags,
 	ubi_close_volume(ubi);
 
 #ifdef __UBOOT__
+	/* Each U-Boot operation opens the volume for itself */
+	c = sb->s_fs_info;
+	ubi_close_volume(c->ubi);
+	c->ubi = NULL;
 	ubifs_sb = sb;
 	return 0;
 #else
@@ -16,6 +16,7 @@
 #include <gzip.h>
 #include <log.h>
 #include <malloc.h>
+#include <mapmem.h>
 #include <memalign.h>
 #include <asm/global_data.h>
 #include "ubifs.h"
@@ -26,6 +27,7 @@
 #include <linux/compat.h>
 #include <linux/err.h>
 #include <linux/lzo.h>
+#include <linux/zstd.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
@@ -42,6 +44,35 @@ static int gzip_decompress(const unsigned char *in, size_t in_len,
 		      (unsigned long *)out_len, 0, 0);
 }
 
+#if IS_ENABLED(CONFIG_ZSTD)
+/* Workspace for the zstd decompressor, kept from one node to the next */
+static void *zstd_workspace;
+
+static int zstd_decompress_node(const unsigned char *in, size_t in_len,
+				unsigned char *out, size_t *out_len)
+{
+	size_t wsize = zstd_dctx_workspace_bound();
+	zstd_dctx *ctx;
+	size_t ret;
+
+	if (!zstd_workspace) {
+		zstd_workspace = malloc(wsize);
+		if (!zstd_workspace)
+			return -ENOMEM;
+	}
+
+	ctx = zstd_init_dctx(zstd_workspace, wsize);
+	if (!ctx)
+		return -EINVAL;
+	ret = zstd_decompress_dctx(ctx, out, *out_len, in, in_len);
+	if (zstd_is_error(ret))
+		return -EINVAL;
+	*out_len = ret;
+
+	return 0;
+}
+#endif
+
 /* Fake description object for the "none" compressor */
 static struct ubifs_compressor none_compr = {
 	.compr_type = UBIFS_COMPR_NONE,
@@ -71,6 +102,15 @@ static struct ubifs_compressor zlib_compr = {
 	.decompress = gzip_decompress,
 };
 
+static struct ubifs_compressor zstd_compr = {
+	.compr_type = UBIFS_COMPR_ZSTD,
+	.name = "zstd",
+#if IS_ENABLED(CONFIG_ZSTD)
+	.capi_name = "zstd",
+	.decompress = zstd_decompress_node,
+#endif
+};
+
 /* All UBIFS compressors */
 struct ubifs_compressor *ubifs_compressors[UBIFS_COMPR_TYPES_CNT];
 
@@ -232,6 +272,10 @@ int __init ubifs_compressors_init(void)
 	if (err)
 		return err;
 
+	err = compr_init(&zstd_compr);
+	if (err)
+		return err;
+
 	err = compr_init(&none_compr);
 	if (err)
 		return err;
@@ -546,6 +590,39 @@ static unsigned long ubifs_findfile(struct super_block *sb, char *filename)
 	return 0;
 }
 
+/*
+ * Index nodes which have been read stay cached in the TNC while the volume is
+ * mounted, so that later lookups need not read them again. Once more than
+ * CONFIG_UBIFS_TNC_MAX_ZNODES are cached, drop all but the root; lookups read
+ * them back from flash as they need them.
+ */
+static void ubifs_trim_tnc(struct ubifs_info *c)
+{
+	struct ubifs_znode *root = c->zroot.znode;
+	long freed = 0;
+	int n;
+
+	if (!CONFIG_UBIFS_TNC_MAX_ZNODES || !root || !root->level ||
+	    atomic_long_read(&c->clean_zn_cnt) <= CONFIG_UBIFS_TNC_MAX_ZNODES)
+		return;
+
+	for (n = 0; n < root->child_cnt; n++) {
+		if (!root->zbranch[n].znode)
+			continue;
+		freed += ubifs_destroy_tnc_subtree(root->zbranch[n].znode);
+		root->zbranch[n].znode = NULL;
+	}
+	atomic_long_sub(freed, &c->clean_zn_cnt);
+	atomic_long_sub(freed, &ubifs_clean_zn_cnt);
+}
+
+static void ubifs_close_volume(struct ubifs_info *c)
+{
+	ubifs_trim_tnc(c);
+	ubi_close_volume(c->ubi);
+	c->ubi = NULL;
+}
+
 int ubifs_set_blk_dev(struct blk_desc *rbdd, struct disk_partition *info)
 {
 	if (rbdd) {
@@ -609,7 +686,7 @@ out_mem:
 		free(dir);
 
 out:
-	ubi_close_volume(c->ubi);
+	ubifs_close_volume(c);
 	return ret;
 }
 
@@ -620,7 +697,7 @@ int ubifs_exists(const char *filename)
 
 	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READONLY);
 	inum = ubifs_findfile(ubifs_sb, (char *)filename);
-	ubi_close_volume(c->ubi);
+	ubifs_close_volume(c);
 
 	return inum != 0;
 }
@@ -651,7 +728,7 @@ int ubifs_size(const char *filename, loff_t *size)
 
 	ubifs_iput(inode);
 out:
-	ubi_close_volume(c->ubi);
+	ubifs_close_volume(c);
 	return err;
 }
 
@@ -666,20 +743,74 @@ static inline void *kmap(struct page *page)
 	return page->addr;
 }
 
+/**
+ * bulk_lookup - look up a data node through the bulk-read buffer
+ * @c: UBIFS file-system description object
+ * @key: key of the data node
+ * @dnp: returns the data node, which is in the bulk-read buffer
+ *
+ * Data nodes of a file usually lie one after the other in the same LEB, so
+ * when @key is not in the buffer, this reads the run of nodes starting with
+ * it in one go, as Linux does for bulk-read. Returns zero on success,
+ * %-ENOENT if the block is a hole and %-EAGAIN if the node must be looked up
+ * on its own.
+ */
+static int bulk_lookup(struct ubifs_info *c, union ubifs_key *key,
+		       struct ubifs_data_node **dnp)
+{
+	struct bu_info *bu = &c->bu;
+	unsigned int block = key_block(c, key);
+	unsigned int first = key_block(c, &bu->key);
+	void *buf;
+	int err, i;
+
+	if (!c->bulk_read)
+		return -EAGAIN;
+
+	if (!bu->cnt || key_inum(c, &bu->key) != key_inum(c, key) ||
+	    block < first || block >= first + bu->blk_cnt) {
+		bu->key = *key;
+		bu->buf_len = c->max_bu_buf_len;
+		err = ubifs_tnc_get_bu_keys(c, bu);
+		if (!err && bu->cnt)
+			err = ubifs_tnc_bulk_read(c, bu);
+		if (err || !bu->cnt) {
+			bu->cnt = 0;
+			return -EAGAIN;
+		}
+		log_debug("bulk-read %d nodes at %d:%d\n", bu->cnt,
+			  bu->zbranch[0].lnum, bu->zbranch[0].offs);
+	}
+
+	buf = bu->buf;
+	for (i = 0; i < bu->cnt; i++) {
+		if (key_block(c, &bu->zbranch[i].key) == block) {
+			*dnp = buf;
+			return 0;
+		}
+		buf += ALIGN(bu->zbranch[i].len, 8);
+	}
+
+	return -ENOENT;
+}
+
 static int read_block(struct inode *inode, void *addr, unsigned int block,
-		      struct ubifs_data_node *dn)
+		      struct ubifs_data_node *dn, int size)
 {
 	struct ubifs_info *c = inode->i_sb->s_fs_info;
 	int err, len, out_len;
 	union ubifs_key key;
 	unsigned int dlen;
+	void *buff = NULL;
 
 	data_key_init(c, &key, inode->i_ino, block);
-	err = ubifs_tnc_lookup(c, &key, dn);
+	err = bulk_lookup(c, &key, &dn);
+	if (err == -EAGAIN)
+		err = ubifs_tnc_lookup(c, &key, dn);
 	if (err) {
 		if (err == -ENOENT)
 			/* Not found, so it must be a hole */
-			memset(addr, 0, UBIFS_BLOCK_SIZE);
+			memset(addr, 0, size);
 		return err;
 	}
 
@@ -689,24 +820,45 @@ static int read_block(struct inode *inode, void *addr, unsigned int block,
 	if (len <= 0 || len > UBIFS_BLOCK_SIZE)
 		goto dump;
 
+	/*
+	 * Decompress straight into the destination unless the block holds
+	 * more data than the caller asked for, which only happens for the
+	 * last block of a read.
+	 */
+	out_len = size;
+	if (len > size) {
+		buff = malloc_cache_aligned(UBIFS_BLOCK_SIZE);
+		if (!buff) {
+			printf("%s: Error, malloc fails!\n", __func__);
+			return -ENOMEM;
+		}
+		out_len = UBIFS_BLOCK_SIZE;
+	}
+
 	dlen = le32_to_cpu(dn->ch.len) - UBIFS_DATA_NODE_SZ;
-	out_len = UBIFS_BLOCK_SIZE;
-	err = ubifs_decompress(c, &dn->data, dlen, addr, &out_len,
-			       le16_to_cpu(dn->compr_type));
+	err = ubifs_decompress(c, &dn->data, dlen, buff ? buff : addr,
+			       &out_len, le16_to_cpu(dn->compr_type));
 	if (err || len != out_len)
 		goto dump;
 
+	if (buff) {
+		memcpy(addr, buff, size);
+		free(buff);
+		return 0;
+	}
+
 	/*
 	 * Data length can be less than a full block, even for blocks that are
 	 * not the last in the file (e.g., as a result of making a hole and
 	 * appending data). Ensure that the remainder is zeroed out.
 	 */
-	if (len < UBIFS_BLOCK_SIZE)
-		memset(addr + len, 0, UBIFS_BLOCK_SIZE - len);
+	if (len < size)
+		memset(addr + len, 0, size - len);
 
 	return 0;
 
 dump:
+	free(buff);
 	ubifs_err(c, "bad data node (block %u, inode %lu)",
 		  block, inode->i_ino);
 	ubifs_dump_node(c, dn);
@@ -741,7 +893,7 @@ static int do_readpage(struct ubifs_info *c, struct inode *inode,
 
 	i = 0;
 	while (1) {
-		int ret;
+		int ret, size = UBIFS_BLOCK_SIZE;
 
 		if (block >= beyond) {
 			/* Reading beyond inode */
@@ -750,54 +902,20 @@ static int do_readpage(struct ubifs_info *c, struct inode *inode,
 		} else {
 			/*
 			 * Reading last block? Make sure to not write beyond
-			 * the requested size in the destination buffer.
+			 * the requested size in the destination buffer, so
+			 * that it is not padded to a multiple of
+			 * UBIFS_BLOCK_SIZE.
 			 */
-			if (((block + 1) == beyond) || last_block_size) {
-				void *buff;
-				int dlen;
-
-				/*
-				 * We need to buffer the data locally for the
-				 * last block. This is to not pad the
-				 * destination area to a multiple of
-				 * UBIFS_BLOCK_SIZE.
-				 */
-				buff = malloc_cache_aligned(UBIFS_BLOCK_SIZE);
-				if (!buff) {
-					printf("%s: Error, malloc fails!\n",
-					       __func__);
-					err = -ENOMEM;
+			if (last_block_size)
+				size = last_block_size;
+			else if (block + 1 == beyond)
+				size = i_size - ((loff_t)block << UBIFS_BLOCK_SHIFT);
+
+			ret = read_block(inode, addr, block, dn, size);
+			if (ret) {
+				err = ret;
+				if (err != -ENOENT)
 					break;
-				}
-
-				/* Read block-size into temp buffer */
-				ret = read_block(inode, buff, block, dn);
-				if (ret) {
-					err = ret;
-					if (err != -ENOENT) {
-						free(buff);
-						break;
-					}
-				}
-
-				if (last_block_size)
-					dlen = last_block_size;
-				else if (ret)
-					dlen = UBIFS_BLOCK_SIZE;
-				else
-					dlen = le32_to_cpu(dn->size);
-
-				/* Now copy required size back to dest */
-				memcpy(addr, buff, dlen);
-
-				free(buff);
-			} else {
-				ret = read_block(inode, addr, block, dn);
-				if (ret) {
-					err = ret;
-					if (err != -ENOENT)
-						break;
-				}
 			}
 		}
 		if (++i >= UBIFS_BLOCKS_PER_PAGE)
@@ -847,6 +965,7 @@ int ubifs_read(const char *filename, void *buf, loff_t offset,
 	}
 
 	c->ubi = ubi_open_volume(c->vi.ubi_num, c->vi.vol_id, UBI_READONLY);
+	c->bu.cnt = 0;
 	/* ubifs_findfile will resolve symlinks, so we know that we get
 	 * the real file here */
 	inum = ubifs_findfile(ubifs_sb, (char *)filename);
@@ -910,7 +1029,7 @@ put_inode:
 	ubifs_iput(inode);
 
 out:
-	ubi_close_volume(c->ubi);
+	ubifs_close_volume(c);
 	return err;
 }
 
@@ -922,11 +1041,14 @@ void ubifs_close(void)
 int ubifs_load(char *filename, unsigned long addr, u32 size)
 {
 	loff_t actread;
+	void *buf;
 	int err;
 
 	printf("Loading file '%s' to addr 0x%08lx...\n", filename, addr);
 
-	err = ubifs_read(filename, (void *)(uintptr_t)addr, 0, size, &actread);
+	buf = map_sysmem(addr, size);
+	err = ubifs_read(filename, buf, 0, size, &actread);
+	unmap_sysmem(buf);
 	if (err == 0) {
 		env_set_hex("filesize", actread);
 		printf("Done\n");
@@ -320,6 +320,11 @@ struct global_data {
 	 * @malloc_ptr: current address of early malloc()
 	 */
 	unsigned long malloc_ptr;
+	/**
+	 * @malloc_peak: highest value of @malloc_ptr before the last
+	 * malloc_simple_release()
+	 */
+	unsigned long malloc_peak;
 #endif
 #ifdef CONFIG_PCI
 	/**
@@ -590,8 +595,10 @@ static_assert(sizeof(struct global_data) == GD_SIZE);
 
 #if CONFIG_VAL(SYS_MALLOC_F_LEN)
 #define gd_malloc_ptr()		gd->malloc_ptr
+#define gd_malloc_peak()	max(gd->malloc_peak, gd->malloc_ptr)
 #else
 #define gd_malloc_ptr()		0L
+#define gd_malloc_peak()	0L
 #endif
 
 /**
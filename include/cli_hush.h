@@ -64,6 +64,47 @@ static inline int set_local_var_modern(char *s, int flg_export)
 }
 #endif
 
+/**
+ * struct hush_parse_cache_stats - Statistics of the hush parse cache
+ *
+ * @hits: Number of scripts run without parsing them again
+ * @misses: Number of scripts parsed and added to the cache
+ * @stale: Number of cached scripts whose variable had changed
+ * @evictions: Number of cached scripts dropped to make room
+ */
+struct hush_parse_cache_stats {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long stale;
+	unsigned long evictions;
+};
+
+/**
+ * parse_string_outer_cached() - Run a script held in an environment variable
+ *
+ * This behaves like parse_string_outer() but keeps the parsed script, so
+ * that running the same variable again skips the parser as long as its
+ * value has not changed.
+ *
+ * @name: Name of the variable holding the script
+ * @str: Script to run
+ * @flag: FLAG_... flags, as for parse_string_outer()
+ * Return: 0 on success, 1 on failure, or the code given to 'exit'
+ */
+int parse_string_outer_cached(const char *name, const char *str, int flag);
+
+/**
+ * hush_parse_cache_flush() - Drop all scripts which are not running
+ */
+void hush_parse_cache_flush(void);
+
+/**
+ * hush_parse_cache_get_stats() - Get the statistics of the parse cache
+ *
+ * @stats: Returns the statistics
+ */
+void hush_parse_cache_get_stats(struct hush_parse_cache_stats *stats);
+
 void unset_local_var(const char *name);
 char *get_local_var(const char *s);
 
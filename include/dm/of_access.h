@@ -18,6 +18,7 @@
 #define _DM_OF_ACCESS_H
 
 #include <dm/of.h>
+#include <linux/errno.h>
 
 /**
  * of_find_all_nodes - Get next node in global list
@@ -143,6 +144,15 @@ const void *of_get_property_by_prop(const struct device_node *np,
 				    const char **name,
 				    int *lenp);
 
+/**
+ * of_prop_next_string() - Get the next string in a string-list property
+ *
+ * @prop: Property to iterate over, or NULL
+ * @cur: Current string, or NULL to get the first one
+ * Return: pointer to the next string, or NULL if there are no more
+ */
+const char *of_prop_next_string(struct property *prop, const char *cur);
+
 /**
  * of_device_is_compatible() - Check if the node matches given constraints
  * @np: Pointer to device node
@@ -615,4 +625,72 @@ int of_remove_property(struct device_node *np, struct property *prop);
  */
 int of_remove_node(struct device_node *to_remove);
 
+#if CONFIG_IS_ENABLED(OF_LIVE_INDEX)
+/**
+ * of_index_find_phandle() - Look up a phandle in the live-tree index
+ *
+ * @root: Root node given to of_find_node_by_phandle(), or NULL
+ * @handle: Phandle to find
+ * @npp: Returns the node, or NULL if there is none with that phandle
+ * Return: 0 if @npp is valid, -EAGAIN if the caller must walk the tree
+ */
+int of_index_find_phandle(const struct device_node *root, phandle handle,
+			  struct device_node **npp);
+
+/**
+ * of_index_find_compatible() - Look up a compatible string in the index
+ *
+ * @from: Node to search after, as for of_find_compatible_node(), or NULL
+ * @compat: Compatible string to find
+ * @npp: Returns the next matching node, or NULL if there are no more
+ * Return: 0 if @npp is valid, -EAGAIN if the caller must walk the tree
+ */
+int of_index_find_compatible(const struct device_node *from,
+			     const char *compat, struct device_node **npp);
+
+/**
+ * of_index_find_path() - Look up a full path in the live-tree index
+ *
+ * @root: Root node of the tree to search
+ * @path: Path to find, starting with '/'
+ * @len: Length of @path
+ * @npp: Returns the node
+ * Return: 0 if found, -EAGAIN if the caller must walk the tree
+ */
+int of_index_find_path(const struct device_node *root, const char *path,
+		       int len, struct device_node **npp);
+
+/**
+ * of_index_invalidate() - Drop the live-tree index after a change
+ *
+ * The index is rebuilt on the next lookup.
+ */
+void of_index_invalidate(void);
+#else
+static inline int of_index_find_phandle(const struct device_node *root,
+					phandle handle,
+					struct device_node **npp)
+{
+	return -EAGAIN;
+}
+
+static inline int of_index_find_compatible(const struct device_node *from,
+					   const char *compat,
+					   struct device_node **npp)
+{
+	return -EAGAIN;
+}
+
+static inline int of_index_find_path(const struct device_node *root,
+				     const char *path, int len,
+				     struct device_node **npp)
+{
+	return -EAGAIN;
+}
+
+static inline void of_index_invalidate(void)
+{
+}
+#endif
+
 #endif
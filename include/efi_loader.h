@@ -1176,6 +1176,8 @@ efi_status_t efi_console_get_u16_string
 		 int row, int col);
 
 efi_status_t efi_disk_get_device_name(const efi_handle_t handle, char *buf, int size);
+/* Print transfer statistics of the EFI disks */
+void efi_disk_show_stats(void);
 
 /**
  * efi_add_known_memory() - add memory banks to EFI memory map
@@ -204,6 +204,72 @@ extern struct hsearch_data env_htab;
  */
 int env_do_env_set(int flag, int argc, char *const argv[], int env_flag);
 
+/**
+ * struct env_journal - Journal of environment changes on a storage device
+ *
+ * The storage driver fills in the geometry and access methods; the remaining
+ * fields are maintained by env/journal.c. Offsets are relative to the start
+ * of the journal area.
+ *
+ * @name: Name of the device, for messages
+ * @size: Size of the journal area in bytes
+ * @align: Write granularity of the device in bytes (e.g. the block size)
+ * @erased: true if the device can only be written where it is erased (0xff),
+ *	as for SPI flash
+ * @read: Read @len bytes at @offset into @buf, returns 0 if OK
+ * @write: Write @len bytes from @buf at @offset, returns 0 if OK. For
+ *	devices which need erasing, this must only touch erased space
+ * @compact: Write @env in full to the environment area and prepare the
+ *	journal area for a new generation (e.g. erase it), returns 0 if OK
+ * @priv: Private data for the storage driver
+ * @gen: Current generation, valid if @valid is true
+ * @valid: true if a valid journal header was found or written
+ * @tail: Offset where the next record is written
+ * @saved: Environment as stored on the device (base plus journal)
+ */
+struct env_journal {
+	const char *name;
+	ulong size;
+	uint align;
+	bool erased;
+	int (*read)(struct env_journal *jnl, ulong offset, ulong len,
+		    void *buf);
+	int (*write)(struct env_journal *jnl, ulong offset, ulong len,
+		     const void *buf);
+	int (*compact)(struct env_journal *jnl, const env_t *env);
+	void *priv;
+
+	u32 gen;
+	bool valid;
+	ulong tail;
+	env_t *saved;
+};
+
+/**
+ * env_journal_load() - Apply the journal to the imported environment
+ *
+ * This must be called after @base has been imported into the environment. It
+ * replays all journal records which belong to @base.
+ *
+ * @jnl: Journal to load
+ * @base: Environment read from the device
+ * Return: 0 if OK (including when there is no journal), -ve on error
+ */
+int env_journal_load(struct env_journal *jnl, const env_t *base);
+
+/**
+ * env_journal_save() - Save the environment using the journal
+ *
+ * Appends a record with the variables which changed since the last load or
+ * save. If there is not enough space left in the journal, the full
+ * environment is written with @jnl->compact and the journal is restarted.
+ *
+ * @jnl: Journal to use
+ * @env_new: Exported environment to save
+ * Return: 0 if OK, -ve on error
+ */
+int env_journal_save(struct env_journal *jnl, env_t *env_new);
+
 /**
  * env_ext4_get_intf() - Provide the interface for env in EXT4
  *
@@ -31,6 +31,15 @@ struct disk_partition;
 #define FAT16BUFSIZE	(FATBUFSIZE/2)
 #define FAT32BUFSIZE	(FATBUFSIZE/4)
 
+/* Number of windows of FATBUFBLOCKS sectors of the FAT to cache */
+#if defined(CONFIG_SPL_BUILD) && defined(CONFIG_SPL_FS_FAT_CACHE_WINDOWS)
+#define FATBUFWINDOWS	CONFIG_SPL_FS_FAT_CACHE_WINDOWS
+#elif !defined(CONFIG_SPL_BUILD) && defined(CONFIG_FS_FAT_CACHE_WINDOWS)
+#define FATBUFWINDOWS	CONFIG_FS_FAT_CACHE_WINDOWS
+#else
+#define FATBUFWINDOWS	1
+#endif
+
 /* Maximum number of entry for long file name according to spec */
 #define MAX_LFN_SLOT	20
 
@@ -110,6 +119,13 @@ typedef struct boot_sector {
 	__u16	reserved2[6];	/* Unused */
 } boot_sector;
 
+/* FAT32 FSInfo sector */
+#define FSINFO_LEAD_SIG		0x41615252
+#define FSINFO_STRUC_SIG	0x61417272
+#define FSINFO_STRUC_SIG_OFF	484
+#define FSINFO_FREE_OFF		488
+#define FSINFO_UNKNOWN		0xffffffff
+
 typedef struct volume_info
 {
 	__u8 drive_number;	/* BIOS drive number */
@@ -155,6 +171,15 @@ typedef struct dir_slot {
 	__u8	name11_12[4];	/* Last 2 characters in name */
 } dir_slot;
 
+/*
+ * Window of the FAT held in the FAT buffer
+ */
+struct fat_window {
+	int	num;		/* Number of the FATBUFBLOCKS block, -1 if none */
+	__u8	dirty;		/* Set if the window has been modified */
+	__u32	used;		/* Time of last use, for LRU replacement */
+};
+
 /*
  * Private filesystem parameters
  *
@@ -162,20 +187,26 @@ typedef struct dir_slot {
  * (see FAT32 accesses)
  */
 typedef struct {
-	__u8	*fatbuf;	/* Current FAT buffer */
+	__u8	*fatbuf;	/* FAT buffer, FATBUFWINDOWS windows */
 	int	fatsize;	/* Size of FAT in bits */
 	__u32	fatlength;	/* Length of FAT in sectors */
 	__u16	fat_sect;	/* Starting sector of the FAT */
-	__u8	fat_dirty;      /* Set if fatbuf has been modified */
 	__u32	rootdir_sect;	/* Start sector of root directory */
 	__u16	sect_size;	/* Size of sectors in bytes */
 	__u16	clust_size;	/* Size of clusters in sectors */
 	int	data_begin;	/* The sector of the first cluster, can be negative */
-	int	fatbufnum;	/* Used by get_fatent, init to -1 */
+	struct fat_window fatwin[FATBUFWINDOWS]; /* Windows in fatbuf */
+	__u32	fatwin_clock;	/* Incremented on each use of a window */
 	int	rootdir_size;	/* Size of root dir for non-FAT32 */
 	__u32	root_cluster;	/* First cluster of root dir for FAT32 */
 	u32	total_sect;	/* Number of sectors */
 	int	fats;		/* Number of FATs */
+	__u16	fsinfo_sect;	/* FSInfo sector for FAT32, 0 if none */
+	int	free_change;	/* Change in the number of free clusters */
+	unsigned long *clust_map; /* Bitmap of clusters in use, for writing */
+	unsigned long *clust_map_done; /* Bitmap of FAT windows in clust_map */
+	__u32	clust_max;	/* Highest cluster, 0 until allocating */
+	__u32	clust_pending;	/* Cluster allocated without clust_map */
 } fsdata;
 
 struct fat_itr;
@@ -1100,6 +1100,13 @@ int booti_setup(ulong image, ulong *relocated_addr, ulong *size,
 #define FIT_COMP_PROP		"compression"
 #define FIT_ENTRY_PROP		"entry"
 #define FIT_LOAD_PROP		"load"
+#define FIT_UNCOMP_SIZE_PROP	"uncomp-size"
+#define FIT_DECOMP_MARGIN_PROP	"decomp-margin"
+/*
+ * Part of decomp-margin left for SPL reading whole blocks of up to 4KiB, to an
+ * address aligned to up to 128 bytes. Binman adds this to every margin.
+ */
+#define FIT_DECOMP_READ_SLACK	(4096 + 128)
 
 /* configuration node */
 #define FIT_KERNEL_PROP		"kernel"
@@ -10,4 +10,40 @@
 /* U-Boot local hacks */
 extern struct fdt_header *working_fdt;  /* Pointer to the working fdt */
 
+#ifndef USE_HOSTCC
+#if CONFIG_IS_ENABLED(OF_LIBFDT_INDEX)
+/**
+ * fdt_index_attach() - Index a device tree to speed up lookups
+ *
+ * This builds a table of node and property offsets for @fdt, which libfdt
+ * then uses to find subnodes and properties without scanning the tree. Any
+ * change to the structure of the tree drops the table, so this should be
+ * called again before the next run of lookups. Only one tree is indexed at
+ * a time, so this replaces any previous index.
+ *
+ * @fdt: Device tree to index
+ * Return: 0 if OK, -ENOMEM if out of memory, -EINVAL if @fdt is not valid
+ */
+int fdt_index_attach(const void *fdt);
+
+/**
+ * fdt_index_detach() - Drop the index of a device tree
+ *
+ * This must be called before the memory holding @fdt is reused.
+ *
+ * @fdt: Device tree which may be indexed
+ */
+void fdt_index_detach(const void *fdt);
+#else
+static inline int fdt_index_attach(const void *fdt)
+{
+	return 0;
+}
+
+static inline void fdt_index_detach(const void *fdt)
+{
+}
+#endif
+#endif /* !USE_HOSTCC */
+
 #endif /* _INCLUDE_LIBFDT_H_ */
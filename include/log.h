@@ -398,6 +398,9 @@ enum log_rec_flags {
  * @file: Name of file where the log record was generated (not allocated)
  * @func: Function where the log record was generated (not allocated)
  * @msg: Log message (allocated)
+ * @fmt: Format string for the message (not allocated). This is only set for
+ *	devices with %LOGDF_BINARY
+ * @args: Arguments for @fmt, only set for devices with %LOGDF_BINARY
  */
 struct log_rec {
 	enum log_category_t cat;
@@ -407,12 +410,15 @@ struct log_rec {
 	const char *file;
 	const char *func;
 	const char *msg;
+	const char *fmt;
+	va_list *args;
 };
 
 struct log_device;
 
 enum log_device_flags {
 	LOGDF_ENABLE		= BIT(0),	/* Device is enabled */
+	LOGDF_BINARY		= BIT(1),	/* Device uses fmt/args, not msg */
 };
 
 /**
@@ -447,6 +453,7 @@ struct log_driver {
  *	decrements
  * @flags: Flags for this filter (enum log_device_flags)
  * @drv: Pointer to driver for this device
+ * @priv: Private data for the driver, or NULL if none
  * @filter_head: List of filters for this device
  * @sibling_node: Next device in the list of all devices
  */
@@ -454,6 +461,7 @@ struct log_device {
 	unsigned short next_filter_num;
 	unsigned short flags;
 	struct log_driver *drv;
+	void *priv;
 	struct list_head filter_head;
 	struct list_head sibling_node;
 };
@@ -586,6 +594,17 @@ enum log_fmt {
 	LOGF_ALL = 0x3f,
 };
 
+/**
+ * log_binary_dump() - Show the records held by the binary log driver
+ *
+ * Each message is formatted from the recorded format string and arguments,
+ * then shown as the console log driver would show it, using gd->log_fmt
+ *
+ * @clear: true to remove the records once they have been shown
+ * Return: 0 if OK, -ENOENT if the binary log driver has no records
+ */
+int log_binary_dump(bool clear);
+
 /* Handle the 'log test' command */
 int do_log_test(struct cmd_tbl *cmdtp, int flag, int argc, char *const argv[]);
 
@@ -956,6 +956,40 @@ int initf_malloc(void);
 void *malloc_simple(size_t size);
 void *memalign_simple(size_t alignment, size_t bytes);
 
+#if CONFIG_IS_ENABLED(SYS_MALLOC_F)
+/**
+ * malloc_simple_mark() - Record the current end of the malloc_simple() region
+ *
+ * Return: value to pass to malloc_simple_release()
+ */
+ulong malloc_simple_mark(void);
+
+/**
+ * malloc_simple_release() - Reclaim all malloc_simple() space used since a mark
+ *
+ * This lets a caller use temporary buffers before relocation, or in SPL,
+ * without using up the early malloc() pool. The buffers should still be
+ * freed as normal, so the code also works with the full malloc().
+ *
+ * Everything allocated by malloc_simple() since the mark is released, so this
+ * must only be used around code which does not keep any of its allocations,
+ * e.g. it must not probe devices. It does nothing once malloc_simple() is no
+ * longer in use, or if the region has been moved since the mark was taken.
+ *
+ * @mark: Value returned by malloc_simple_mark()
+ */
+void malloc_simple_release(ulong mark);
+#else
+static inline ulong malloc_simple_mark(void)
+{
+	return 0;
+}
+
+static inline void malloc_simple_release(ulong mark)
+{
+}
+#endif
+
 #pragma GCC visibility push(hidden)
 # if __STD_C
 
@@ -999,6 +1033,101 @@ extern ulong mem_malloc_brk;
 
 void mem_malloc_init(ulong start, ulong size);
 
+/* Size classes in struct malloc_info: chunks up to 16, 32, ... 64K and above */
+#define MALLOC_NUM_CLASSES	14
+
+/* Number of distinct callers recorded by CONFIG_SYS_MALLOC_PROFILE */
+#define MALLOC_NUM_CALLERS	32
+
+/**
+ * struct malloc_class_info - Allocation counts for one size class
+ *
+ * Sizes are chunk sizes, i.e. the requested size plus overhead, rounded up
+ *
+ * @allocs: Number of chunks allocated
+ * @frees: Number of chunks freed
+ * @bytes: Number of bytes in chunks currently allocated
+ */
+struct malloc_class_info {
+	ulong allocs;
+	ulong frees;
+	ulong bytes;
+};
+
+/**
+ * struct malloc_caller_info - Allocations sampled from one caller
+ *
+ * @addr: Return address of the call to malloc(), calloc(), etc.
+ * @count: Number of samples from this caller
+ * @bytes: Total bytes requested in those samples
+ */
+struct malloc_caller_info {
+	void *addr;
+	ulong count;
+	ulong bytes;
+};
+
+/**
+ * struct malloc_info - Statistics about the malloc() heap
+ *
+ * @in_use: Bytes in allocated chunks
+ * @max_in_use: Highest value reached by @in_use
+ * @brk: Bytes obtained from the heap with sbrk()
+ * @max_brk: Highest value reached by @brk. This is the smallest value of
+ *	CONFIG_SYS_MALLOC_LEN which would have been enough so far
+ * @free: Free bytes, including the space not yet obtained with sbrk()
+ * @largest_free: Largest block which can be allocated without growing the heap
+ *	beyond CONFIG_SYS_MALLOC_LEN
+ * @free_chunks: Number of free chunks, not counting the top of the heap
+ * @fast_chunks: Number of those chunks which are waiting in fast bins
+ * @fast_hits: Number of allocations served from fast bins
+ * @classes: Counts for each size class
+ * @callers: Sampled callers, if CONFIG_SYS_MALLOC_PROFILE is enabled. Unused
+ *	entries have a NULL address
+ * @samples: Number of allocations sampled
+ * @dropped: Number of times the entry with the fewest samples was given to a
+ *	new caller because @callers was full
+ */
+struct malloc_info {
+	ulong in_use;
+	ulong max_in_use;
+	ulong brk;
+	ulong max_brk;
+	ulong free;
+	ulong largest_free;
+	ulong free_chunks;
+	ulong fast_chunks;
+	ulong fast_hits;
+	struct malloc_class_info classes[MALLOC_NUM_CLASSES];
+	struct malloc_caller_info callers[MALLOC_NUM_CALLERS];
+	ulong samples;
+	ulong dropped;
+};
+
+/**
+ * malloc_class_size() - Get the largest chunk size in a size class
+ *
+ * @class: Size class (0 to MALLOC_NUM_CLASSES - 1)
+ * Return: largest chunk size in bytes, or 0 for the last class, which has
+ *	no limit
+ */
+static inline ulong malloc_class_size(int class)
+{
+	return class < MALLOC_NUM_CLASSES - 1 ? 16UL << class : 0;
+}
+
+/**
+ * malloc_get_info() - Get statistics about the malloc() heap
+ *
+ * This walks the free lists, so takes time proportional to the number of free
+ * chunks.
+ *
+ * @info: Returns the statistics
+ * Return: 0 if OK, -ENOSYS if CONFIG_SYS_MALLOC_STATS is not enabled, -EPERM
+ *	if the full malloc() is not set up yet
+ */
+int malloc_get_info(struct malloc_info *info);
+
 #ifdef __cplusplus
 };  /* end of extern "C" */
 #endif
@@ -47,6 +47,17 @@ struct hsearch_data {
 	struct env_entry_node *table;
 	unsigned int size;
 	unsigned int filled;
+	/*
+	 * String pool holding keys and values, used instead of individual
+	 * malloc() calls when CONFIG_ENV_STRING_POOL is enabled. Strings which
+	 * do not fit fall back to malloc().
+	 */
+	char *pool;
+	size_t pool_size;
+	size_t pool_used;
+	/* Entries sorted by key for hexport_r(), NULL when stale */
+	struct env_entry **sorted;
+	unsigned int nsorted;
 /*
  * Callback function which will check whether the given change for variable
  * "item" to "newval" may be applied or not, and possibly apply such change.
@@ -294,6 +294,12 @@ struct dm_serial_ops {
  * @buf:	Pointer to the RX buffer
  * @rd_ptr:	Read pointer in the RX buffer
  * @wr_ptr:	Write pointer in the RX buffer
+ *
+ * @tx_buf:	Pointer to the TX buffer
+ * @tx_rd:	Read pointer in the TX buffer
+ * @tx_wr:	Write pointer in the TX buffer
+ * @tx_busy:	true while the TX buffer is being written to the device
+ * @tx_cyclic:	Cyclic function which writes out the TX buffer
  */
 struct serial_dev_priv {
 	struct stdio_dev *sdev;
@@ -301,6 +307,12 @@ struct serial_dev_priv {
 	char *buf;
 	int rd_ptr;
 	int wr_ptr;
+
+	char *tx_buf;
+	int tx_rd;
+	int tx_wr;
+	bool tx_busy;
+	struct cyclic_info *tx_cyclic;
 };
 
 /* Access the serial operations for a device */
@@ -0,0 +1,59 @@
+/* SPDX-License-Identifier: GPL-2.0+ */
+/*
+ * RELR tables of relative relocations
+ *
+ * A RELR table lists the words which must have the relocation offset added
+ * to them. Each entry is a 64-bit word:
+ *
+ * - an even entry is the address of a word to relocate
+ * - an odd entry is a bitmap: bit n (1 to 63) set means that the word n - 1
+ *   places after the last address covered by the previous entry is relocated
+ *
+ * so runs of relocations take one bit each, rather than 24 bytes for an
+ * Elf64_Rela entry.
+ */
+
+#ifndef _UBOOT_RELR_H
+#define _UBOOT_RELR_H
+
+/*
+ * tools/relocate-rela puts a RELR table in place of the .rela.dyn entries
+ * when CONFIG_RELOC_RELR is enabled. The first word then holds this value in
+ * its bottom 32 bits and the number of entries which follow in its top 32
+ * bits. It cannot be mistaken for the offset of a rela entry, since those
+ * are aligned.
+ */
+#define RELR_MAGIC	0x524c4552
+
+#ifndef __ASSEMBLY__
+
+#include <compiler.h>
+
+/**
+ * relr_encode() - Encode a list of addresses as a RELR table
+ *
+ * @addr: Addresses of the words to relocate, which must be 8-byte aligned,
+ *	in ascending order and without duplicates
+ * @count: Number of addresses
+ * @relr: Returns the RELR entries; this must have space for @count entries
+ * Return: number of entries written, or -EINVAL if @addr is not valid
+ */
+int relr_encode(const uint64_t *addr, int count, uint64_t *relr);
+
+/**
+ * relr_apply() - Apply the relocations in a RELR table
+ *
+ * The word at each address in the table is found by adding @loc_off to the
+ * address, then @val_off is added to the word.
+ *
+ * @relr: RELR entries
+ * @count: Number of entries
+ * @loc_off: Offset from each address in the table to the word to update
+ * @val_off: Offset to add to each word
+ * Return: number of words updated
+ */
+int relr_apply(const uint64_t *relr, int count, long loc_off, long val_off);
+
+#endif /* __ASSEMBLY__ */
+
+#endif /* _UBOOT_RELR_H */
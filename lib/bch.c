@@ -387,30 +387,40 @@ static void compute_syndromes(struct bch_control *bch, uint32_t *ecc,
 			      unsigned int *syn)
 {
 	int i, j, s;
-	unsigned int m;
-	uint32_t poly;
+	unsigned int b, v, pad, nbytes;
 	const int t = GF_T(bch);
 
+	/* extra bits in the last ecc byte must have been cleared */
 	s = bch->ecc_bits;
-
-	/* make sure extra bits in last ecc word are cleared */
-	m = ((unsigned int)s) & 31;
-	if (m)
-		ecc[s/32] &= ~((1u << (32-m))-1);
 	memset(syn, 0, 2*t*sizeof(*syn));
 
-	/* compute v(a^j) for j=1 .. 2t-1 */
-	do {
-		poly = *ecc++;
-		s -= 32;
-		while (poly) {
-			i = deg(poly);
-			for (j = 0; j < 2*t; j += 2)
-				syn[j] ^= a_pow(bch, (j+1)*(i+s));
-
-			poly ^= (1 << i);
+	/*
+	 * compute v(a^j) for j=1 .. 2t-1 with Horner's rule, one byte of ecc
+	 * at a time starting from the highest degree terms; this leaves
+	 * v(a^j) multiplied by a^(j*pad), pad being the number of (zero) bits
+	 * after the last ecc bit in its byte
+	 */
+	nbytes = DIV_ROUND_UP(s, 8);
+	pad = 8*nbytes-s;
+	for (i = 0; i < nbytes; i++) {
+		b = (ecc[i/4] >> (24-8*(i & 3))) & 0xff;
+		for (j = 0; j < t; j++) {
+			v = syn[2*j];
+			if (v)
+				v = bch->a_pow_tab[mod_s(bch, bch->a_log_tab[v]+
+						modulo(bch, 8*(2*j+1)))];
+			syn[2*j] = v^bch->syn_tab[256*j+b];
+		}
+	}
+	if (pad) {
+		for (j = 0; j < t; j++) {
+			v = syn[2*j];
+			if (v)
+				syn[2*j] = bch->a_pow_tab[mod_s(bch,
+						bch->a_log_tab[v]+GF_N(bch)-
+						modulo(bch, (2*j+1)*pad))];
 		}
-	} while (s > 0);
+	}
 
 	/* v(a^(2j)) = v(a^j)^2 */
 	for (j = 0; j < t; j++)
@@ -1037,7 +1047,7 @@ int decode_bch(struct bch_control *bch, const uint8_t *data, unsigned int len,
 	       const unsigned int *syn, unsigned int *errloc)
 {
 	const unsigned int ecc_words = BCH_ECC_WORDS(bch);
-	unsigned int nbits;
+	unsigned int nbits, m;
 	int i, err, nroots;
 	uint32_t sum;
 
@@ -1060,14 +1070,18 @@ int decode_bch(struct bch_control *bch, const uint8_t *data, unsigned int len,
 		if (recv_ecc) {
 			load_ecc8(bch, bch->ecc_buf2, recv_ecc);
 			/* XOR received and calculated ecc */
-			for (i = 0, sum = 0; i < (int)ecc_words; i++) {
+			for (i = 0; i < (int)ecc_words; i++)
 				bch->ecc_buf[i] ^= bch->ecc_buf2[i];
-				sum |= bch->ecc_buf[i];
-			}
-			if (!sum)
-				/* no error found */
-				return 0;
 		}
+		/* make sure extra bits in last ecc word are cleared */
+		m = bch->ecc_bits & 31;
+		if (m)
+			bch->ecc_buf[bch->ecc_bits/32] &= ~((1u << (32-m))-1);
+		for (i = 0, sum = 0; i < DIV_ROUND_UP(bch->ecc_bits, 32); i++)
+			sum |= bch->ecc_buf[i];
+		if (!sum)
+			/* no error found */
+			return 0;
 		compute_syndromes(bch, bch->ecc_buf, bch->syn);
 		syn = bch->syn;
 	}
@@ -1155,6 +1169,25 @@ static void build_mod8_tables(struct bch_control *bch, const uint32_t *g)
 	}
 }
 
+/*
+ * build lookup tables for computing syndromes one byte of ecc at a time:
+ * entry b of table j is b(a^(2j+1)), b being a polynomial of degree < 8
+ */
+static void build_syn_tables(struct bch_control *bch)
+{
+	const int t = GF_T(bch);
+	uint16_t *tab;
+	int i, j;
+
+	for (j = 0; j < t; j++) {
+		tab = bch->syn_tab+256*j;
+		tab[0] = 0;
+		for (i = 1; i < 256; i++)
+			tab[i] = tab[i & ~(1 << deg(i))]^
+				a_pow(bch, (2*j+1)*deg(i));
+	}
+}
+
 /*
  * build a base for factoring degree 2 polynomials
  */
@@ -1347,6 +1380,7 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 	bch->a_pow_tab = bch_alloc((1+bch->n)*sizeof(*bch->a_pow_tab), &err);
 	bch->a_log_tab = bch_alloc((1+bch->n)*sizeof(*bch->a_log_tab), &err);
 	bch->mod8_tab  = bch_alloc(words*1024*sizeof(*bch->mod8_tab), &err);
+	bch->syn_tab   = bch_alloc(t*256*sizeof(*bch->syn_tab), &err);
 	bch->ecc_buf   = bch_alloc(words*sizeof(*bch->ecc_buf), &err);
 	bch->ecc_buf2  = bch_alloc(words*sizeof(*bch->ecc_buf2), &err);
 	bch->xi_tab    = bch_alloc(m*sizeof(*bch->xi_tab), &err);
@@ -1372,6 +1406,8 @@ struct bch_control *init_bch(int m, int t, unsigned int prim_poly)
 	build_mod8_tables(bch, genpoly);
 	kfree(genpoly);
 
+	build_syn_tables(bch);
+
 	err = build_deg2_base(bch);
 	if (err)
 		goto fail;
@@ -1395,6 +1431,7 @@ void free_bch(struct bch_control *bch)
 		kfree(bch->a_pow_tab);
 		kfree(bch->a_log_tab);
 		kfree(bch->mod8_tab);
+		kfree(bch->syn_tab);
 		kfree(bch->ecc_buf);
 		kfree(bch->ecc_buf2);
 		kfree(bch->xi_tab);
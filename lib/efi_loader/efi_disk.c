@@ -18,6 +18,7 @@
 #include <log.h>
 #include <part.h>
 #include <malloc.h>
+#include <asm/cache.h>
 
 struct efi_system_partition efi_system_partition = {
 	.uclass_id = UCLASS_INVALID,
@@ -26,6 +27,21 @@ struct efi_system_partition efi_system_partition = {
 const efi_guid_t efi_block_io_guid = EFI_BLOCK_IO_PROTOCOL_GUID;
 const efi_guid_t efi_system_partition_guid = PARTITION_SYSTEM_GUID;
 
+/**
+ * struct efi_disk_stats - number of bytes transferred by an EFI disk
+ *
+ * @read_direct:	bytes read straight into the caller's buffer
+ * @read_bounced:	bytes read through the bounce buffer
+ * @write_direct:	bytes written straight from the caller's buffer
+ * @write_bounced:	bytes written through the bounce buffer
+ */
+struct efi_disk_stats {
+	u64 read_direct;
+	u64 read_bounced;
+	u64 write_direct;
+	u64 write_bounced;
+};
+
 /**
  * struct efi_disk_obj - EFI disk object
  *
@@ -34,6 +50,7 @@ const efi_guid_t efi_system_partition_guid = PARTITION_SYSTEM_GUID;
  * @media:	block I/O media information
  * @dp:		device path to the block device
  * @volume:	simple file system protocol of the partition
+ * @stats:	transfer statistics
  */
 struct efi_disk_obj {
 	struct efi_object header;
@@ -41,6 +58,7 @@ struct efi_disk_obj {
 	struct efi_block_io_media media;
 	struct efi_device_path *dp;
 	struct efi_simple_file_system_protocol *volume;
+	struct efi_disk_stats stats;
 };
 
 /**
@@ -147,6 +165,73 @@ static efi_status_t efi_disk_rw_blocks(struct efi_block_io *this,
 	return EFI_SUCCESS;
 }
 
+/**
+ * efi_disk_transfer() - transfer blocks, bouncing only where needed
+ *
+ * With CONFIG_EFI_LOADER_BOUNCE_BUFFER, devices may not be able to reach
+ * memory above 4 GiB, where the caller's buffer can be. The transfer then
+ * goes through the bounce buffer, in chunks of its size. Buffers which lie
+ * entirely below 4 GiB are used directly, avoiding the copy.
+ *
+ * @this:	pointer to the BLOCK_IO_PROTOCOL
+ * @media_id:	id of the medium
+ * @lba:	first logical block to transfer
+ * @buffer_size:	number of bytes to transfer
+ * @buffer:	caller's buffer
+ * @direction:	read or write
+ * Return:	status code
+ */
+static efi_status_t efi_disk_transfer(struct efi_block_io *this,
+				      u32 media_id, u64 lba,
+				      unsigned long buffer_size, void *buffer,
+				      enum efi_disk_direction direction)
+{
+	struct efi_disk_obj *diskobj;
+	efi_status_t r;
+
+	diskobj = container_of(this, struct efi_disk_obj, ops);
+
+#ifdef CONFIG_EFI_LOADER_BOUNCE_BUFFER
+	if ((u64)(uintptr_t)buffer + buffer_size > 0x100000000ULL) {
+		unsigned long offset, len;
+
+		for (offset = 0; offset < buffer_size; offset += len) {
+			len = min_t(unsigned long, buffer_size - offset,
+				    EFI_LOADER_BOUNCE_BUFFER_SIZE);
+			if (direction == EFI_DISK_WRITE)
+				memcpy(efi_bounce_buffer, buffer + offset,
+				       len);
+			r = efi_disk_rw_blocks(this, media_id,
+					       lba + offset /
+					       this->media->block_size, len,
+					       efi_bounce_buffer, direction);
+			if (r != EFI_SUCCESS)
+				return r;
+			if (direction == EFI_DISK_READ)
+				memcpy(buffer + offset, efi_bounce_buffer,
+				       len);
+		}
+		if (direction == EFI_DISK_READ)
+			diskobj->stats.read_bounced += buffer_size;
+		else
+			diskobj->stats.write_bounced += buffer_size;
+
+		return EFI_SUCCESS;
+	}
+#endif
+
+	r = efi_disk_rw_blocks(this, media_id, lba, buffer_size, buffer,
+			       direction);
+	if (r == EFI_SUCCESS) {
+		if (direction == EFI_DISK_READ)
+			diskobj->stats.read_direct += buffer_size;
+		else
+			diskobj->stats.write_direct += buffer_size;
+	}
+
+	return r;
+}
+
 /**
  * efi_disk_read_blocks() - reads blocks from device
  *
@@ -166,7 +251,6 @@ static efi_status_t EFIAPI efi_disk_read_blocks(struct efi_block_io *this,
 			u32 media_id, u64 lba, efi_uintn_t buffer_size,
 			void *buffer)
 {
-	void *real_buffer = buffer;
 	efi_status_t r;
 
 	if (!this)
@@ -184,30 +268,11 @@ static efi_status_t EFIAPI efi_disk_read_blocks(struct efi_block_io *this,
 	    (this->media->last_block + 1) * this->media->block_size)
 		return EFI_INVALID_PARAMETER;
 
-#ifdef CONFIG_EFI_LOADER_BOUNCE_BUFFER
-	if (buffer_size > EFI_LOADER_BOUNCE_BUFFER_SIZE) {
-		r = efi_disk_read_blocks(this, media_id, lba,
-			EFI_LOADER_BOUNCE_BUFFER_SIZE, buffer);
-		if (r != EFI_SUCCESS)
-			return r;
-		return efi_disk_read_blocks(this, media_id, lba +
-			EFI_LOADER_BOUNCE_BUFFER_SIZE / this->media->block_size,
-			buffer_size - EFI_LOADER_BOUNCE_BUFFER_SIZE,
-			buffer + EFI_LOADER_BOUNCE_BUFFER_SIZE);
-	}
-
-	real_buffer = efi_bounce_buffer;
-#endif
-
 	EFI_ENTRY("%p, %x, %llx, %zx, %p", this, media_id, lba,
 		  buffer_size, buffer);
 
-	r = efi_disk_rw_blocks(this, media_id, lba, buffer_size, real_buffer,
-			       EFI_DISK_READ);
-
-	/* Copy from bounce buffer to real buffer if necessary */
-	if ((r == EFI_SUCCESS) && (real_buffer != buffer))
-		memcpy(buffer, real_buffer, buffer_size);
+	r = efi_disk_transfer(this, media_id, lba, buffer_size, buffer,
+			      EFI_DISK_READ);
 
 	return EFI_EXIT(r);
 }
@@ -232,7 +297,6 @@ static efi_status_t EFIAPI efi_disk_write_blocks(struct efi_block_io *this,
 			u32 media_id, u64 lba, efi_uintn_t buffer_size,
 			void *buffer)
 {
-	void *real_buffer = buffer;
 	efi_status_t r;
 
 	if (!this)
@@ -252,30 +316,11 @@ static efi_status_t EFIAPI efi_disk_write_blocks(struct efi_block_io *this,
 	    (this->media->last_block + 1) * this->media->block_size)
 		return EFI_INVALID_PARAMETER;
 
-#ifdef CONFIG_EFI_LOADER_BOUNCE_BUFFER
-	if (buffer_size > EFI_LOADER_BOUNCE_BUFFER_SIZE) {
-		r = efi_disk_write_blocks(this, media_id, lba,
-			EFI_LOADER_BOUNCE_BUFFER_SIZE, buffer);
-		if (r != EFI_SUCCESS)
-			return r;
-		return efi_disk_write_blocks(this, media_id, lba +
-			EFI_LOADER_BOUNCE_BUFFER_SIZE / this->media->block_size,
-			buffer_size - EFI_LOADER_BOUNCE_BUFFER_SIZE,
-			buffer + EFI_LOADER_BOUNCE_BUFFER_SIZE);
-	}
-
-	real_buffer = efi_bounce_buffer;
-#endif
-
 	EFI_ENTRY("%p, %x, %llx, %zx, %p", this, media_id, lba,
 		  buffer_size, buffer);
 
-	/* Populate bounce buffer if necessary */
-	if (real_buffer != buffer)
-		memcpy(real_buffer, buffer, buffer_size);
-
-	r = efi_disk_rw_blocks(this, media_id, lba, buffer_size, real_buffer,
-			       EFI_DISK_WRITE);
+	r = efi_disk_transfer(this, media_id, lba, buffer_size, buffer,
+			      EFI_DISK_WRITE);
 
 	return EFI_EXIT(r);
 }
@@ -514,7 +559,12 @@ static efi_status_t efi_disk_add_dev(
 	 */
 	diskobj->media.media_id = 1;
 	diskobj->media.block_size = desc->blksz;
-	diskobj->media.io_align = desc->blksz;
+	/*
+	 * Buffers only need the alignment which DMA needs; the block layer
+	 * bounces for devices which need more. Asking for more makes
+	 * applications copy through aligned buffers of their own.
+	 */
+	diskobj->media.io_align = ARCH_DMA_MINALIGN;
 	if (part)
 		diskobj->media.logical_partition = 1;
 	diskobj->ops.media = &diskobj->media;
@@ -828,6 +878,40 @@ efi_status_t efi_disk_get_device_name(const efi_handle_t handle, char *buf, int
 	return EFI_SUCCESS;
 }
 
+/**
+ * efi_disk_show_stats() - print transfer statistics of the EFI disks
+ *
+ * Show for each disk and partition how much data EFI applications have
+ * read and written, and how much of that went through the bounce buffer.
+ */
+void efi_disk_show_stats(void)
+{
+	struct efi_handler *handler;
+	struct efi_disk_obj *diskobj;
+	struct efi_block_io *io;
+	struct efi_object *obj;
+	char name[32];
+
+	printf("Device       Read      (bounced)  Written   (bounced)\n");
+	printf("============ ========= ========== ========= ==========\n");
+	list_for_each_entry(obj, &efi_obj_list, link) {
+		if (efi_search_protocol(obj, &efi_block_io_guid, &handler))
+			continue;
+		io = handler->protocol_interface;
+		if (io->read_blocks != efi_disk_read_blocks)
+			continue;
+		diskobj = container_of(io, struct efi_disk_obj, ops);
+		if (efi_disk_get_device_name(obj, name, sizeof(name)))
+			strcpy(name, "?");
+		printf("%-12s %9llu %10llu %9llu %10llu\n", name,
+		       diskobj->stats.read_direct + diskobj->stats.read_bounced,
+		       diskobj->stats.read_bounced,
+		       diskobj->stats.write_direct +
+		       diskobj->stats.write_bounced,
+		       diskobj->stats.write_bounced);
+	}
+}
+
 /**
  * efi_disks_register() - ensure all block devices are available in UEFI
  *
@@ -38,10 +38,20 @@ struct file_handle {
 	struct fs_dir_stream *dirs;
 	struct fs_dirent *dent;
 
+	/* for reading a file, valid while gen == efi_file_gen: */
+	uint gen;
+	loff_t size;
+	void *ra_buf;        /* read-ahead buffer */
+	loff_t ra_offset;    /* file position of the read-ahead buffer */
+	loff_t ra_len;       /* number of bytes in the read-ahead buffer */
+
 	char path[0];
 };
 #define to_fh(x) container_of(x, struct file_handle, base)
 
+/* Changed whenever a file is written, to drop what handles have cached */
+static uint efi_file_gen = 1;
+
 static const struct efi_file_handle efi_file_handle_protocol;
 
 static char *basename(struct file_handle *fh)
@@ -151,6 +161,7 @@ static int efi_create_file(struct file_handle *fh, u64 attributes)
 	loff_t actwrite;
 	void *buffer = &actwrite;
 
+	efi_file_gen++;
 	if (attributes & EFI_FILE_DIRECTORY)
 		return fs_mkdir(fh->path);
 	else
@@ -366,6 +377,7 @@ out:
 static efi_status_t file_close(struct file_handle *fh)
 {
 	fs_closedir(fh->dirs);
+	free(fh->ra_buf);
 	free(fh);
 	return EFI_SUCCESS;
 }
@@ -390,6 +402,7 @@ static efi_status_t EFIAPI efi_file_delete(struct efi_file_handle *file)
 
 	EFI_ENTRY("%p", file);
 
+	efi_file_gen++;
 	if (set_blk_dev(fh) || fs_unlink(fh->path))
 		ret = EFI_WARN_DELETE_FAILURE;
 
@@ -407,11 +420,17 @@ static efi_status_t EFIAPI efi_file_delete(struct efi_file_handle *file)
 static efi_status_t efi_get_file_size(struct file_handle *fh,
 				      loff_t *file_size)
 {
-	if (set_blk_dev(fh))
-		return EFI_DEVICE_ERROR;
+	if (fh->gen != efi_file_gen) {
+		/* A file was written, so look the size up again */
+		fh->ra_len = 0;
+		if (set_blk_dev(fh))
+			return EFI_DEVICE_ERROR;
 
-	if (fs_size(fh->path, file_size))
-		return EFI_DEVICE_ERROR;
+		if (fs_size(fh->path, &fh->size))
+			return EFI_DEVICE_ERROR;
+		fh->gen = efi_file_gen;
+	}
+	*file_size = fh->size;
 
 	return EFI_SUCCESS;
 }
@@ -455,6 +474,45 @@ out:
 	return ret;
 }
 
+/**
+ * file_read_ahead() - read from a file through the read-ahead buffer
+ *
+ * The buffer is refilled from the current position when it does not hold
+ * all the bytes requested, so a file read in small sequential chunks is
+ * looked up and read from the filesystem once per CONFIG_EFI_FILE_READ_AHEAD
+ * bytes.
+ *
+ * @fh:		file handle
+ * @len:	number of bytes to read, which must not go past the end of
+ *		the file
+ * @buffer:	buffer to fill
+ * Return:	number of bytes read, or -ve on error
+ */
+static loff_t file_read_ahead(struct file_handle *fh, loff_t len,
+			      void *buffer)
+{
+	loff_t actread;
+
+	if (fh->offset < fh->ra_offset ||
+	    fh->offset + len > fh->ra_offset + fh->ra_len) {
+		if (!fh->ra_buf)
+			fh->ra_buf = malloc(CONFIG_EFI_FILE_READ_AHEAD);
+		if (!fh->ra_buf)
+			return -ENOMEM;
+		fh->ra_len = 0;
+		if (set_blk_dev(fh) ||
+		    fs_read(fh->path, map_to_sysmem(fh->ra_buf), fh->offset,
+			    CONFIG_EFI_FILE_READ_AHEAD, &actread))
+			return -EIO;
+		fh->ra_offset = fh->offset;
+		fh->ra_len = actread;
+	}
+	len = min(len, fh->ra_offset + fh->ra_len - fh->offset);
+	memcpy(buffer, fh->ra_buf + (fh->offset - fh->ra_offset), len);
+
+	return len;
+}
+
 static efi_status_t file_read(struct file_handle *fh, u64 *buffer_size,
 		void *buffer)
 {
@@ -475,11 +533,19 @@ static efi_status_t file_read(struct file_handle *fh, u64 *buffer_size,
 		return ret;
 	}
 
-	if (set_blk_dev(fh))
-		return EFI_DEVICE_ERROR;
-	if (fs_read(fh->path, map_to_sysmem(buffer), fh->offset,
-		    *buffer_size, &actread))
-		return EFI_DEVICE_ERROR;
+	actread = -1;
+	if (*buffer_size < CONFIG_EFI_FILE_READ_AHEAD) {
+		actread = min_t(loff_t, *buffer_size, file_size - fh->offset);
+		if (actread)
+			actread = file_read_ahead(fh, actread, buffer);
+	}
+	if (actread < 0) {
+		if (set_blk_dev(fh))
+			return EFI_DEVICE_ERROR;
+		if (fs_read(fh->path, map_to_sysmem(buffer), fh->offset,
+			    *buffer_size, &actread))
+			return EFI_DEVICE_ERROR;
+	}
 
 	*buffer_size = actread;
 	fh->offset += actread;
@@ -675,6 +741,7 @@ static efi_status_t efi_file_write_int(struct efi_file_handle *this,
 	if (!*buffer_size)
 		goto out;
 
+	efi_file_gen++;
 	if (set_blk_dev(fh)) {
 		ret = EFI_DEVICE_ERROR;
 		goto out;
@@ -15,28 +15,35 @@
 #include <watchdog.h>
 #include <asm/cache.h>
 #include <asm/global_data.h>
-#include <linux/list_sort.h>
+#include <linux/bitops.h>
+#include <linux/log2.h>
 #include <linux/sizes.h>
 
 DECLARE_GLOBAL_DATA_PTR;
 
 /* Magic number identifying memory allocated from pool */
 #define EFI_ALLOC_POOL_MAGIC 0x1fe67ddf6491caa2
+/* Magic number identifying a page holding small pool allocations */
+#define EFI_POOL_SLAB_MAGIC 0x6a5c0e3d2b1f4879
 
-efi_uintn_t efi_memory_map_key;
+/* Smallest and largest objects in slabs, including their header */
+#define EFI_POOL_SLAB_MIN	64
+#define EFI_POOL_SLAB_MAX	1024
+/* Number of object sizes: EFI_POOL_SLAB_MIN << 0 ... EFI_POOL_SLAB_MAX */
+#define EFI_POOL_SLAB_CLASSES	5
 
-struct efi_mem_list {
-	struct list_head link;
-	struct efi_mem_desc desc;
-};
-
-#define EFI_CARVE_NO_OVERLAP		-1
-#define EFI_CARVE_LOOP_AGAIN		-2
-#define EFI_CARVE_OVERLAPS_NONRAM	-3
-#define EFI_CARVE_OUT_OF_RESOURCES	-4
+efi_uintn_t efi_memory_map_key;
 
-/* This list contains all memory map items */
-static LIST_HEAD(efi_mem);
+/*
+ * The memory map, in ascending order of address. Entries do not overlap and
+ * adjacent entries with the same type and attributes are merged, so that
+ * lookups can use a binary search.
+ */
+static struct efi_mem_desc *efi_mem;
+/* Number of entries in the memory map */
+static int efi_mem_count;
+/* Number of entries allocated for the memory map */
+static int efi_mem_size;
 
 #ifdef CONFIG_EFI_LOADER_BOUNCE_BUFFER
 void *efi_bounce_buffer;
@@ -65,6 +72,41 @@ struct efi_pool_allocation {
 	char data[] __aligned(ARCH_DMA_MINALIGN);
 };
 
+/**
+ * struct efi_pool_slab - page holding small pool allocations
+ *
+ * @link:		entry in the list of slabs with the same memory type
+ *			and object size; slabs with free objects come first
+ * @checksum:		checksum calculated by slab_checksum()
+ * @free:		bitmap of the objects which are free
+ * @memory_type:	memory type of the page
+ * @obj_size:		size of each object, including its header
+ *
+ * Allocating a page for each small AllocatePool() request wastes memory
+ * and, when the memory types are mixed, fills the memory map. Instead, small
+ * requests are served from pages of the requested memory type which are
+ * divided into objects of a fixed size. Each object starts with a struct
+ * efi_pool_allocation with @num_pages set to 0, so that FreePool() can check
+ * it as for larger allocations.
+ *
+ * The objects follow this header, at EFI_POOL_SLAB_HDR bytes into the page.
+ * A page is returned to the memory map as soon as all its objects are free.
+ */
+struct efi_pool_slab {
+	struct list_head link;
+	u64 checksum;
+	u64 free;
+	u32 memory_type;
+	u32 obj_size;
+};
+
+#define EFI_POOL_SLAB_HDR	ALIGN(sizeof(struct efi_pool_slab), \
+				      ARCH_DMA_MINALIGN)
+
+/* Slabs by memory type and object size */
+static struct list_head efi_pool_slabs[EFI_MAX_MEMORY_TYPE]
+				      [EFI_POOL_SLAB_CLASSES];
+
 /**
  * checksum() - calculate checksum for memory allocated from pool
  *
@@ -82,30 +124,20 @@ static u64 checksum(struct efi_pool_allocation *alloc)
 }
 
 /**
- * efi_mem_cmp() - comparator function for sorting memory map
- *
- * Sorts the memory list from highest address to lowest address
+ * slab_checksum() - calculate checksum for a slab of pool memory
  *
- * When allocating memory we should always start from the highest
- * address chunk, so sort the memory list such that the first list
- * iterator gets the highest address and goes lower from there.
- *
- * @priv:	unused
- * @a:		first memory area
- * @b:		second memory area
- * Return:	1 if @a is before @b, -1 if @b is before @a, 0 if equal
+ * @slab:	slab header
+ * Return:	checksum, always non-zero
  */
-static int efi_mem_cmp(void *priv, struct list_head *a, struct list_head *b)
+static u64 slab_checksum(struct efi_pool_slab *slab)
 {
-	struct efi_mem_list *mema = list_entry(a, struct efi_mem_list, link);
-	struct efi_mem_list *memb = list_entry(b, struct efi_mem_list, link);
-
-	if (mema->desc.physical_start == memb->desc.physical_start)
-		return 0;
-	else if (mema->desc.physical_start < memb->desc.physical_start)
-		return 1;
-	else
-		return -1;
+	u64 addr = (uintptr_t)slab;
+	u64 ret = (addr >> 32) ^ (addr << 32) ^
+		  ((u64)slab->obj_size << 32 | slab->memory_type) ^
+		  EFI_POOL_SLAB_MAGIC;
+	if (!ret)
+		++ret;
+	return ret;
 }
 
 /**
@@ -120,138 +152,75 @@ static uint64_t desc_get_end(struct efi_mem_desc *desc)
 }
 
 /**
- * efi_mem_sort() - sort memory map
+ * efi_mem_find() - find the first memory map entry ending after an address
  *
- * Sort the memory map and then try to merge adjacent memory areas.
+ * @addr:	address
+ * Return:	index of the entry containing @addr or the first one after it,
+ *		efi_mem_count if there is none
  */
-static void efi_mem_sort(void)
+static int efi_mem_find(u64 addr)
 {
-	struct list_head *lhandle;
-	struct efi_mem_list *prevmem = NULL;
-	bool merge_again = true;
-
-	list_sort(NULL, &efi_mem, efi_mem_cmp);
-
-	/* Now merge entries that can be merged */
-	while (merge_again) {
-		merge_again = false;
-		list_for_each(lhandle, &efi_mem) {
-			struct efi_mem_list *lmem;
-			struct efi_mem_desc *prev = &prevmem->desc;
-			struct efi_mem_desc *cur;
-			uint64_t pages;
-
-			lmem = list_entry(lhandle, struct efi_mem_list, link);
-			if (!prevmem) {
-				prevmem = lmem;
-				continue;
-			}
-
-			cur = &lmem->desc;
-
-			if ((desc_get_end(cur) == prev->physical_start) &&
-			    (prev->type == cur->type) &&
-			    (prev->attribute == cur->attribute)) {
-				/* There is an existing map before, reuse it */
-				pages = cur->num_pages;
-				prev->num_pages += pages;
-				prev->physical_start -= pages << EFI_PAGE_SHIFT;
-				prev->virtual_start -= pages << EFI_PAGE_SHIFT;
-				list_del(&lmem->link);
-				free(lmem);
-
-				merge_again = true;
-				break;
-			}
-
-			prevmem = lmem;
-		}
+	int lo = 0, hi = efi_mem_count;
+
+	while (lo < hi) {
+		int mid = lo + (hi - lo) / 2;
+
+		if (desc_get_end(&efi_mem[mid]) <= addr)
+			lo = mid + 1;
+		else
+			hi = mid;
 	}
+
+	return lo;
 }
 
 /**
- * efi_mem_carve_out() - unmap memory region
- *
- * @map:		memory map
- * @carve_desc:		memory region to unmap
- * @overlap_only_ram:	the carved out region may only overlap RAM
- * Return:		the number of overlapping pages which have been
- *			removed from the map,
- *			EFI_CARVE_NO_OVERLAP, if the regions don't overlap,
- *			EFI_CARVE_OVERLAPS_NONRAM, if the carve and map overlap,
- *			and the map contains anything but free ram
- *			(only when overlap_only_ram is true),
- *			EFI_CARVE_LOOP_AGAIN, if the mapping list should be
- *			traversed again, as it has been altered.
- *
- * Unmaps all memory occupied by the carve_desc region from the list entry
- * pointed to by map.
- *
- * In case of EFI_CARVE_OVERLAPS_NONRAM it is the callers responsibility
- * to re-add the already carved out pages to the mapping.
+ * efi_mem_merge() - merge a memory area into the one before it
+ *
+ * @prev:	memory area
+ * @next:	memory area following @prev
+ * Return:	true if @next was merged into @prev
  */
-static s64 efi_mem_carve_out(struct efi_mem_list *map,
-			     struct efi_mem_desc *carve_desc,
-			     bool overlap_only_ram)
+static bool efi_mem_merge(struct efi_mem_desc *prev, struct efi_mem_desc *next)
 {
-	struct efi_mem_list *newmap;
-	struct efi_mem_desc *map_desc = &map->desc;
-	uint64_t map_start = map_desc->physical_start;
-	uint64_t map_end = map_start + (map_desc->num_pages << EFI_PAGE_SHIFT);
-	uint64_t carve_start = carve_desc->physical_start;
-	uint64_t carve_end = carve_start +
-			     (carve_desc->num_pages << EFI_PAGE_SHIFT);
-
-	/* check whether we're overlapping */
-	if ((carve_end <= map_start) || (carve_start >= map_end))
-		return EFI_CARVE_NO_OVERLAP;
-
-	/* We're overlapping with non-RAM, warn the caller if desired */
-	if (overlap_only_ram && (map_desc->type != EFI_CONVENTIONAL_MEMORY))
-		return EFI_CARVE_OVERLAPS_NONRAM;
-
-	/* Sanitize carve_start and carve_end to lie within our bounds */
-	carve_start = max(carve_start, map_start);
-	carve_end = min(carve_end, map_end);
-
-	/* Carving at the beginning of our map? Just move it! */
-	if (carve_start == map_start) {
-		if (map_end == carve_end) {
-			/* Full overlap, just remove map */
-			list_del(&map->link);
-			free(map);
-		} else {
-			map->desc.physical_start = carve_end;
-			map->desc.virtual_start = carve_end;
-			map->desc.num_pages = (map_end - carve_end)
-					      >> EFI_PAGE_SHIFT;
-		}
+	if (desc_get_end(prev) != next->physical_start ||
+	    prev->type != next->type || prev->attribute != next->attribute)
+		return false;
+	prev->num_pages += next->num_pages;
 
-		return (carve_end - carve_start) >> EFI_PAGE_SHIFT;
-	}
+	return true;
+}
 
-	/*
-	 * Overlapping maps, just split the list map at carve_start,
-	 * it will get moved or removed in the next iteration.
-	 *
-	 * [ map_desc |__carve_start__| newmap ]
-	 */
+/**
+ * efi_mem_replace() - replace a range of memory map entries
+ *
+ * @first:	index of the first entry to replace
+ * @last:	index after the last entry to replace
+ * @descs:	entries to put in their place
+ * @count:	number of entries in @descs
+ * Return:	status code
+ */
+static efi_status_t efi_mem_replace(int first, int last,
+				    struct efi_mem_desc *descs, int count)
+{
+	int new_count = efi_mem_count - (last - first) + count;
+
+	if (new_count > efi_mem_size) {
+		int size = max(new_count, 2 * efi_mem_size);
+		struct efi_mem_desc *map;
+
+		map = realloc(efi_mem, size * sizeof(*map));
+		if (!map)
+			return EFI_OUT_OF_RESOURCES;
+		efi_mem = map;
+		efi_mem_size = size;
+	}
+	memmove(&efi_mem[first + count], &efi_mem[last],
+		(efi_mem_count - last) * sizeof(*efi_mem));
+	memcpy(&efi_mem[first], descs, count * sizeof(*efi_mem));
+	efi_mem_count = new_count;
 
-	/* Create a new map from [ carve_start ... map_end ] */
-	newmap = calloc(1, sizeof(*newmap));
-	if (!newmap)
-		return EFI_CARVE_OUT_OF_RESOURCES;
-	newmap->desc = map->desc;
-	newmap->desc.physical_start = carve_start;
-	newmap->desc.virtual_start = carve_start;
-	newmap->desc.num_pages = (map_end - carve_start) >> EFI_PAGE_SHIFT;
-	/* Insert before current entry (descending address order) */
-	list_add_tail(&newmap->link, &map->link);
-
-	/* Shrink the map to [ map_start ... carve_start ] */
-	map_desc->num_pages = (carve_start - map_start) >> EFI_PAGE_SHIFT;
-
-	return EFI_CARVE_LOOP_AGAIN;
+	return EFI_SUCCESS;
 }
 
 /**
@@ -267,11 +236,12 @@ static efi_status_t efi_add_memory_map_pg(u64 start, u64 pages,
 					  int memory_type,
 					  bool overlap_only_ram)
 {
-	struct list_head *lhandle;
-	struct efi_mem_list *newlist;
-	bool carve_again;
+	struct efi_mem_desc descs[3], *desc;
 	uint64_t carved_pages = 0;
 	struct efi_event *evt;
+	int first, last, count = 0;
+	efi_status_t ret;
+	u64 end;
 
 	EFI_PRINT("%s: 0x%llx 0x%llx %d %s\n", __func__,
 		  start, pages, memory_type, overlap_only_ram ? "yes" : "no");
@@ -283,86 +253,89 @@ static efi_status_t efi_add_memory_map_pg(u64 start, u64 pages,
 		return EFI_SUCCESS;
 
 	++efi_memory_map_key;
-	newlist = calloc(1, sizeof(*newlist));
-	if (!newlist)
-		return EFI_OUT_OF_RESOURCES;
-	newlist->desc.type = memory_type;
-	newlist->desc.physical_start = start;
-	newlist->desc.virtual_start = start;
-	newlist->desc.num_pages = pages;
+	end = start + (pages << EFI_PAGE_SHIFT);
+
+	/* Find the entries which overlap the new area */
+	first = efi_mem_find(start);
+	for (last = first; last < efi_mem_count &&
+	     efi_mem[last].physical_start < end; last++) {
+		desc = &efi_mem[last];
+
+		/*
+		 * The user requested to only have RAM overlaps, but we hit a
+		 * non-RAM region. Error out.
+		 */
+		if (overlap_only_ram && desc->type != EFI_CONVENTIONAL_MEMORY)
+			return EFI_NO_MAPPING;
+		carved_pages += (min(desc_get_end(desc), end) -
+				 max(desc->physical_start, start)) >>
+				EFI_PAGE_SHIFT;
+	}
+
+	if (overlap_only_ram && (carved_pages != pages)) {
+		/*
+		 * The payload wanted to have RAM overlaps, but we overlapped
+		 * with an unallocated region. Error out.
+		 */
+		return EFI_NO_MAPPING;
+	}
+
+	/* Keep the part of the first entry before the new area */
+	if (first < last && efi_mem[first].physical_start < start) {
+		descs[count] = efi_mem[first];
+		descs[count++].num_pages = (start - efi_mem[first].physical_start)
+					   >> EFI_PAGE_SHIFT;
+	}
+
+	desc = &descs[count];
+	desc->type = memory_type;
+	desc->reserved = 0;
+	desc->physical_start = start;
+	desc->virtual_start = start;
+	desc->num_pages = pages;
 
 	switch (memory_type) {
 	case EFI_RUNTIME_SERVICES_CODE:
 	case EFI_RUNTIME_SERVICES_DATA:
-		newlist->desc.attribute = EFI_MEMORY_WB | EFI_MEMORY_RUNTIME;
+		desc->attribute = EFI_MEMORY_WB | EFI_MEMORY_RUNTIME;
 		break;
 	case EFI_MMAP_IO:
-		newlist->desc.attribute = EFI_MEMORY_RUNTIME;
+		desc->attribute = EFI_MEMORY_RUNTIME;
 		break;
 	default:
-		newlist->desc.attribute = EFI_MEMORY_WB;
+		desc->attribute = EFI_MEMORY_WB;
 		break;
 	}
+	if (!count || !efi_mem_merge(&descs[count - 1], desc))
+		count++;
+
+	/* Keep the part of the last entry after the new area */
+	if (first < last && desc_get_end(&efi_mem[last - 1]) > end) {
+		desc = &descs[count];
+		*desc = efi_mem[last - 1];
+		desc->num_pages = (desc_get_end(desc) - end) >> EFI_PAGE_SHIFT;
+		desc->physical_start = end;
+		desc->virtual_start = end;
+		if (!efi_mem_merge(&descs[count - 1], desc))
+			count++;
+	}
 
-	/* Add our new map */
-	do {
-		carve_again = false;
-		list_for_each(lhandle, &efi_mem) {
-			struct efi_mem_list *lmem;
-			s64 r;
-
-			lmem = list_entry(lhandle, struct efi_mem_list, link);
-			r = efi_mem_carve_out(lmem, &newlist->desc,
-					      overlap_only_ram);
-			switch (r) {
-			case EFI_CARVE_OUT_OF_RESOURCES:
-				free(newlist);
-				return EFI_OUT_OF_RESOURCES;
-			case EFI_CARVE_OVERLAPS_NONRAM:
-				/*
-				 * The user requested to only have RAM overlaps,
-				 * but we hit a non-RAM region. Error out.
-				 */
-				free(newlist);
-				return EFI_NO_MAPPING;
-			case EFI_CARVE_NO_OVERLAP:
-				/* Just ignore this list entry */
-				break;
-			case EFI_CARVE_LOOP_AGAIN:
-				/*
-				 * We split an entry, but need to loop through
-				 * the list again to actually carve it.
-				 */
-				carve_again = true;
-				break;
-			default:
-				/* We carved a number of pages */
-				carved_pages += r;
-				carve_again = true;
-				break;
-			}
-
-			if (carve_again) {
-				/* The list changed, we need to start over */
-				break;
-			}
-		}
-	} while (carve_again);
+	/* Merge with the neighbouring entries */
+	if (first > 0) {
+		struct efi_mem_desc prev = efi_mem[first - 1];
 
-	if (overlap_only_ram && (carved_pages != pages)) {
-		/*
-		 * The payload wanted to have RAM overlaps, but we overlapped
-		 * with an unallocated region. Error out.
-		 */
-		free(newlist);
-		return EFI_NO_MAPPING;
+		if (efi_mem_merge(&prev, &descs[0])) {
+			descs[0] = prev;
+			first--;
+		}
 	}
+	if (last < efi_mem_count &&
+	    efi_mem_merge(&descs[count - 1], &efi_mem[last]))
+		last++;
 
-	/* Add our new map */
-        list_add_tail(&newlist->link, &efi_mem);
-
-	/* And make sure memory is listed in descending order */
-	efi_mem_sort();
+	ret = efi_mem_replace(first, last, descs, count);
+	if (ret != EFI_SUCCESS)
+		return ret;
 
 	/* Notify that the memory map was changed */
 	list_for_each_entry(evt, &efi_events, link) {
@@ -416,19 +389,14 @@ efi_status_t efi_add_memory_map(u64 start, u64 size, int memory_type)
  */
 static efi_status_t efi_check_allocated(u64 addr, bool must_be_allocated)
 {
-	struct efi_mem_list *item;
-
-	list_for_each_entry(item, &efi_mem, link) {
-		u64 start = item->desc.physical_start;
-		u64 end = start + (item->desc.num_pages << EFI_PAGE_SHIFT);
-
-		if (addr >= start && addr < end) {
-			if (must_be_allocated ^
-			    (item->desc.type == EFI_CONVENTIONAL_MEMORY))
-				return EFI_SUCCESS;
-			else
-				return EFI_NOT_FOUND;
-		}
+	int i = efi_mem_find(addr);
+
+	if (i < efi_mem_count && addr >= efi_mem[i].physical_start) {
+		if (must_be_allocated ^
+		    (efi_mem[i].type == EFI_CONVENTIONAL_MEMORY))
+			return EFI_SUCCESS;
+		else
+			return EFI_NOT_FOUND;
 	}
 
 	return EFI_NOT_FOUND;
@@ -443,7 +411,7 @@ static efi_status_t efi_check_allocated(u64 addr, bool must_be_allocated)
  */
 static uint64_t efi_find_free_memory(uint64_t len, uint64_t max_addr)
 {
-	struct list_head *lhandle;
+	int i;
 
 	/*
 	 * Prealign input max address, so we simplify our matching
@@ -451,33 +419,21 @@ static uint64_t efi_find_free_memory(uint64_t len, uint64_t max_addr)
 	 */
 	max_addr &= ~EFI_PAGE_MASK;
 
-	list_for_each(lhandle, &efi_mem) {
-		struct efi_mem_list *lmem = list_entry(lhandle,
-			struct efi_mem_list, link);
-		struct efi_mem_desc *desc = &lmem->desc;
-		uint64_t desc_len = desc->num_pages << EFI_PAGE_SHIFT;
-		uint64_t desc_end = desc->physical_start + desc_len;
-		uint64_t curmax = min(max_addr, desc_end);
-		uint64_t ret = curmax - len;
+	/* Start from the highest area which is not above max_addr */
+	for (i = min(efi_mem_find(max_addr), efi_mem_count - 1); i >= 0; i--) {
+		struct efi_mem_desc *desc = &efi_mem[i];
+		uint64_t curmax = min(max_addr, desc_get_end(desc));
 
 		/* We only take memory from free RAM */
 		if (desc->type != EFI_CONVENTIONAL_MEMORY)
 			continue;
 
-		/* Out of bounds for max_addr */
-		if ((ret + len) > max_addr)
-			continue;
-
-		/* Out of bounds for upper map limit */
-		if ((ret + len) > desc_end)
-			continue;
-
 		/* Out of bounds for lower map limit */
-		if (ret < desc->physical_start)
+		if (curmax < desc->physical_start + len)
 			continue;
 
 		/* Return the highest address in this map within bounds */
-		return ret;
+		return curmax - len;
 	}
 
 	return 0;
@@ -636,6 +592,126 @@ void *efi_alloc_aligned_pages(u64 len, int memory_type, size_t align)
 	return (void *)(uintptr_t)aligned_mem;
 }
 
+/**
+ * efi_pool_slab_class() - get the slab object size for a pool allocation
+ *
+ * @size:	number of bytes to be allocated
+ * Return:	index into the object sizes, -1 if too large for a slab
+ */
+static int efi_pool_slab_class(efi_uintn_t size)
+{
+	int i;
+
+	for (i = 0; i < EFI_POOL_SLAB_CLASSES; i++) {
+		uint obj_size = EFI_POOL_SLAB_MIN << i;
+
+		/* Objects must keep the alignment of the data */
+		if (obj_size < 2 * sizeof(struct efi_pool_allocation))
+			continue;
+		if (size <= obj_size - sizeof(struct efi_pool_allocation))
+			return i;
+	}
+
+	return -1;
+}
+
+/* Bitmap with a bit set for each object in a slab */
+static u64 efi_pool_slab_full(u32 obj_size)
+{
+	return GENMASK_ULL((EFI_PAGE_SIZE - EFI_POOL_SLAB_HDR) / obj_size - 1,
+			   0);
+}
+
+/**
+ * efi_pool_slab_alloc() - allocate memory from a slab
+ *
+ * @pool_type:	type of the pool from which memory is to be allocated
+ * @class:	index into the object sizes
+ * @buffer:	allocated memory
+ * Return:	status code
+ */
+static efi_status_t efi_pool_slab_alloc(enum efi_memory_type pool_type,
+					int class, void **buffer)
+{
+	struct list_head *head = &efi_pool_slabs[pool_type][class];
+	struct efi_pool_allocation *alloc;
+	struct efi_pool_slab *slab;
+	efi_status_t r;
+	u64 addr;
+	int i;
+
+	if (!head->next)
+		INIT_LIST_HEAD(head);
+
+	slab = list_first_entry_or_null(head, struct efi_pool_slab, link);
+	if (!slab || !slab->free) {
+		r = efi_allocate_pages(EFI_ALLOCATE_ANY_PAGES, pool_type, 1,
+				       &addr);
+		if (r != EFI_SUCCESS)
+			return r;
+		slab = (struct efi_pool_slab *)(uintptr_t)addr;
+		slab->memory_type = pool_type;
+		slab->obj_size = EFI_POOL_SLAB_MIN << class;
+		slab->free = efi_pool_slab_full(slab->obj_size);
+		slab->checksum = slab_checksum(slab);
+		list_add(&slab->link, head);
+	}
+
+	i = __ffs64(slab->free);
+	slab->free &= ~BIT_ULL(i);
+	if (!slab->free)
+		list_move_tail(&slab->link, head);
+
+	alloc = (void *)slab + EFI_POOL_SLAB_HDR + i * slab->obj_size;
+	alloc->num_pages = 0;
+	alloc->checksum = checksum(alloc);
+	*buffer = alloc->data;
+
+	return EFI_SUCCESS;
+}
+
+/**
+ * efi_pool_slab_free() - free memory allocated from a slab
+ *
+ * @alloc:	allocation header
+ * Return:	status code
+ */
+static efi_status_t efi_pool_slab_free(struct efi_pool_allocation *alloc)
+{
+	struct efi_pool_slab *slab;
+	ulong offset;
+	u64 full;
+	int i;
+
+	slab = (struct efi_pool_slab *)((uintptr_t)alloc & ~EFI_PAGE_MASK);
+	offset = (uintptr_t)alloc - (uintptr_t)slab;
+
+	/* Check that this is an object in use in a valid slab */
+	if (slab->checksum != slab_checksum(slab) ||
+	    offset < EFI_POOL_SLAB_HDR ||
+	    (offset - EFI_POOL_SLAB_HDR) % slab->obj_size)
+		return EFI_INVALID_PARAMETER;
+	i = (offset - EFI_POOL_SLAB_HDR) / slab->obj_size;
+	full = efi_pool_slab_full(slab->obj_size);
+	if (!(full & BIT_ULL(i)) || (slab->free & BIT_ULL(i)) ||
+	    alloc->num_pages || alloc->checksum != checksum(alloc))
+		return EFI_INVALID_PARAMETER;
+	/* Avoid double free */
+	alloc->checksum = 0;
+
+	if (!slab->free)
+		list_move(&slab->link, &efi_pool_slabs[slab->memory_type]
+			  [ilog2(slab->obj_size / EFI_POOL_SLAB_MIN)]);
+	slab->free |= BIT_ULL(i);
+	if (slab->free != full)
+		return EFI_SUCCESS;
+
+	list_del(&slab->link);
+	slab->checksum = 0;
+
+	return efi_free_pages((uintptr_t)slab, 1);
+}
+
 /**
  * efi_allocate_pool - allocate memory from pool
  *
@@ -651,6 +727,7 @@ efi_status_t efi_allocate_pool(enum efi_memory_type pool_type, efi_uintn_t size,
 	struct efi_pool_allocation *alloc;
 	u64 num_pages = efi_size_in_pages(size +
 					  sizeof(struct efi_pool_allocation));
+	int class;
 
 	if (!buffer)
 		return EFI_INVALID_PARAMETER;
@@ -660,6 +737,10 @@ efi_status_t efi_allocate_pool(enum efi_memory_type pool_type, efi_uintn_t size,
 		return EFI_SUCCESS;
 	}
 
+	class = efi_pool_slab_class(size);
+	if (pool_type < EFI_MAX_MEMORY_TYPE && class >= 0)
+		return efi_pool_slab_alloc(pool_type, class, buffer);
+
 	r = efi_allocate_pages(EFI_ALLOCATE_ANY_PAGES, pool_type, num_pages,
 			       &addr);
 	if (r == EFI_SUCCESS) {
@@ -715,15 +796,17 @@ efi_status_t efi_free_pool(void *buffer)
 	alloc = container_of(buffer, struct efi_pool_allocation, data);
 
 	/* Check that this memory was allocated by efi_allocate_pool() */
-	if (((uintptr_t)alloc & EFI_PAGE_MASK) ||
-	    alloc->checksum != checksum(alloc)) {
-		printf("%s: illegal free 0x%p\n", __func__, buffer);
-		return EFI_INVALID_PARAMETER;
+	if ((uintptr_t)alloc & EFI_PAGE_MASK) {
+		ret = efi_pool_slab_free(alloc);
+	} else if (alloc->checksum != checksum(alloc)) {
+		ret = EFI_INVALID_PARAMETER;
+	} else {
+		/* Avoid double free */
+		alloc->checksum = 0;
+		ret = efi_free_pages((uintptr_t)alloc, alloc->num_pages);
 	}
-	/* Avoid double free */
-	alloc->checksum = 0;
-
-	ret = efi_free_pages((uintptr_t)alloc, alloc->num_pages);
+	if (ret == EFI_INVALID_PARAMETER)
+		printf("%s: illegal free 0x%p\n", __func__, buffer);
 
 	return ret;
 }
@@ -746,8 +829,6 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 				uint32_t *descriptor_version)
 {
 	efi_uintn_t map_size = 0;
-	int map_entries = 0;
-	struct list_head *lhandle;
 	efi_uintn_t provided_map_size;
 
 	if (!memory_map_size)
@@ -755,10 +836,7 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 
 	provided_map_size = *memory_map_size;
 
-	list_for_each(lhandle, &efi_mem)
-		map_entries++;
-
-	map_size = map_entries * sizeof(struct efi_mem_desc);
+	map_size = efi_mem_count * sizeof(struct efi_mem_desc);
 
 	*memory_map_size = map_size;
 
@@ -774,16 +852,8 @@ efi_status_t efi_get_memory_map(efi_uintn_t *memory_map_size,
 	if (!memory_map)
 		return EFI_INVALID_PARAMETER;
 
-	/* Copy list into array */
-	/* Return the list in ascending order */
-	memory_map = &memory_map[map_entries - 1];
-	list_for_each(lhandle, &efi_mem) {
-		struct efi_mem_list *lmem;
-
-		lmem = list_entry(lhandle, struct efi_mem_list, link);
-		*memory_map = lmem->desc;
-		memory_map--;
-	}
+	/* The map is kept in ascending order, as it is returned */
+	memcpy(memory_map, efi_mem, map_size);
 
 	if (map_key)
 		*map_key = efi_memory_map_key;
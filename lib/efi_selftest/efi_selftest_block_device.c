@@ -536,6 +536,48 @@ static int execute(void)
 		efi_st_error("Failed to close file\n");
 		return EFI_ST_FAILURE;
 	}
+
+	/* Reads after a write must not return stale data */
+	ret = root->open(root, &file, u"u-boot.txt", EFI_FILE_MODE_READ |
+			 EFI_FILE_MODE_WRITE, 0);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Failed to open file\n");
+		return EFI_ST_FAILURE;
+	}
+	buf_size = 2;
+	ret = file->read(file, &buf_size, buf);
+	if (ret != EFI_SUCCESS || buf_size != 2) {
+		efi_st_error("Failed to read file\n");
+		return EFI_ST_FAILURE;
+	}
+	buf_size = 1;
+	ret = file->write(file, &buf_size, "b");
+	if (ret != EFI_SUCCESS || buf_size != 1) {
+		efi_st_error("Failed to write file\n");
+		return EFI_ST_FAILURE;
+	}
+	ret = file->setpos(file, 0);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("SetPosition failed\n");
+		return EFI_ST_FAILURE;
+	}
+	boottime->set_mem(buf, sizeof(buf), 0);
+	buf_size = sizeof(buf) - 1;
+	ret = file->read(file, &buf_size, buf);
+	if (ret != EFI_SUCCESS || buf_size != 3) {
+		efi_st_error("Failed to read file\n");
+		return EFI_ST_FAILURE;
+	}
+	/* Writing to FAT truncates the file after the bytes written */
+	if (memcmp(buf, "U-b", 4)) {
+		efi_st_error("Unexpected file content %s\n", buf);
+		return EFI_ST_FAILURE;
+	}
+	ret = file->close(file);
+	if (ret != EFI_SUCCESS) {
+		efi_st_error("Failed to close file\n");
+		return EFI_ST_FAILURE;
+	}
 #else
 	efi_st_todo("CONFIG_FAT_WRITE is not set\n");
 #endif /* CONFIG_FAT_WRITE */
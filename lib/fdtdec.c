@@ -1440,6 +1440,7 @@ int fdtdec_add_reserved_memory(void *blob, const char *basename,
 
 	if (compatibles && count > 0) {
 		size_t length = 0, len = 0;
+		ulong mark = malloc_simple_mark();
 		unsigned int i;
 		char *buffer;
 
@@ -1456,6 +1457,7 @@ int fdtdec_add_reserved_memory(void *blob, const char *basename,
 
 		err = fdt_setprop(blob, node, "compatible", buffer, length);
 		free(buffer);
+		malloc_simple_release(mark);
 		if (err < 0)
 			return err;
 	}
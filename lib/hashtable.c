@@ -32,6 +32,7 @@
 #else				/* U-Boot build */
 # include <linux/string.h>
 # include <linux/ctype.h>
+# include <linux/kernel.h>
 #endif
 
 #define USED_FREE 0
@@ -62,6 +63,66 @@ struct env_entry_node {
 static void _hdelete(const char *key, struct hsearch_data *htab,
 		     struct env_entry *ep, int idx);
 
+/*
+ * String pool
+ */
+
+/*
+ * With CONFIG_ENV_STRING_POOL, keys and values are carved out of a single
+ * buffer which is allocated when an environment is imported. Strings in the
+ * pool are never freed individually, the whole pool goes away together with
+ * the table. Once the pool is exhausted we fall back to malloc().
+ */
+static void hpool_create(struct hsearch_data *htab, size_t size)
+{
+	if (!CONFIG_IS_ENABLED(ENV_STRING_POOL) || htab->pool || !size)
+		return;
+
+	/* Leave room for growing the environment up to its storage size */
+	size = max_t(size_t, size, CONFIG_ENV_SIZE);
+
+	htab->pool = malloc(size);
+	if (!htab->pool) {
+		debug("hpool_create: can't malloc %lu bytes\n", (ulong)size);
+		return;
+	}
+	htab->pool_size = size;
+	htab->pool_used = 0;
+}
+
+static char *hstrdup(struct hsearch_data *htab, const char *str)
+{
+	size_t len = strlen(str) + 1;
+	char *p;
+
+	if (htab->pool && htab->pool_size - htab->pool_used >= len) {
+		p = htab->pool + htab->pool_used;
+		htab->pool_used += len;
+		memcpy(p, str, len);
+
+		return p;
+	}
+
+	return strdup(str);
+}
+
+static void hstrfree(struct hsearch_data *htab, const char *str)
+{
+	if (htab->pool && str >= htab->pool &&
+	    str < htab->pool + htab->pool_size)
+		return;
+
+	free((void *)str);
+}
+
+/* Drop the cached sort order, called whenever the set of keys changes */
+static void hsort_invalidate(struct hsearch_data *htab)
+{
+	free(htab->sorted);
+	htab->sorted = NULL;
+	htab->nsorted = 0;
+}
+
 /*
  * hcreate()
  */
@@ -152,11 +213,17 @@ void hdestroy_r(struct hsearch_data *htab)
 		if (htab->table[i].used > 0) {
 			struct env_entry *ep = &htab->table[i].entry;
 
-			free((void *)ep->key);
-			free(ep->data);
+			hstrfree(htab, ep->key);
+			hstrfree(htab, ep->data);
 		}
 	}
 	free(htab->table);
+	hsort_invalidate(htab);
+
+	free(htab->pool);
+	htab->pool = NULL;
+	htab->pool_size = 0;
+	htab->pool_used = 0;
 
 	/* the sign for an existing table is an value != NULL in htable */
 	htab->table = NULL;
@@ -230,6 +297,26 @@ do_callback(const struct env_entry *e, const char *name, const char *value,
 	return 0;
 }
 
+/*
+ * Replace the value of an existing entry. When the string pool is in use, a
+ * new value which is not longer than the old one is copied in place.
+ */
+static char *_overwrite_data(struct hsearch_data *htab, struct env_entry *ep,
+			     const char *data)
+{
+	size_t len = strlen(data);
+
+	if (CONFIG_IS_ENABLED(ENV_STRING_POOL) && len <= strlen(ep->data)) {
+		memmove(ep->data, data, len + 1);
+		return ep->data;
+	}
+
+	hstrfree(htab, ep->data);
+	ep->data = hstrdup(htab, data);
+
+	return ep->data;
+}
+
 /*
  * Compare an existing entry with the desired key, and overwrite if the action
  * is ENV_ENTER.  This is simply a helper function for hsearch_r().
@@ -264,9 +351,8 @@ static inline int _compare_and_overwrite_entry(struct env_entry item,
 				return 0;
 			}
 
-			free(htab->table[idx].entry.data);
-			htab->table[idx].entry.data = strdup(item.data);
-			if (!htab->table[idx].entry.data) {
+			if (!_overwrite_data(htab, &htab->table[idx].entry,
+					     item.data)) {
 				__set_errno(ENOMEM);
 				*retval = NULL;
 				return 0;
@@ -283,19 +369,21 @@ static inline int _compare_and_overwrite_entry(struct env_entry item,
 int hsearch_r(struct env_entry item, enum env_action action,
 	      struct env_entry **retval, struct hsearch_data *htab, int flag)
 {
+	const unsigned char *s;
 	unsigned int hval;
-	unsigned int count;
-	unsigned int len = strlen(item.key);
 	unsigned int idx;
 	unsigned int first_deleted = 0;
 	int ret;
 
-	/* Compute an value for the given string. Perhaps use a better method. */
-	hval = len;
-	count = len;
-	while (count-- > 0) {
-		hval <<= 4;
-		hval += item.key[count];
+	/*
+	 * Compute a value for the given string (FNV-1a). Every character
+	 * contributes to the result, so variables sharing a long common
+	 * prefix (e.g. "bootcmd_mmc0", "bootcmd_mmc1") still spread out.
+	 */
+	hval = 2166136261U;
+	for (s = (const unsigned char *)item.key; *s; s++) {
+		hval ^= *s;
+		hval *= 16777619U;
 	}
 
 	/*
@@ -380,8 +468,8 @@ int hsearch_r(struct env_entry item, enum env_action action,
 			idx = first_deleted;
 
 		htab->table[idx].used = hval;
-		htab->table[idx].entry.key = strdup(item.key);
-		htab->table[idx].entry.data = strdup(item.data);
+		htab->table[idx].entry.key = hstrdup(htab, item.key);
+		htab->table[idx].entry.data = hstrdup(htab, item.data);
 		if (!htab->table[idx].entry.key ||
 		    !htab->table[idx].entry.data) {
 			__set_errno(ENOMEM);
@@ -390,6 +478,7 @@ int hsearch_r(struct env_entry item, enum env_action action,
 		}
 
 		++htab->filled;
+		hsort_invalidate(htab);
 
 		/* This is a new entry, so look up a possible callback */
 		env_callback_init(&htab->table[idx].entry);
@@ -444,12 +533,13 @@ static void _hdelete(const char *key, struct hsearch_data *htab,
 {
 	/* free used entry */
 	debug("hdelete: DELETING key \"%s\"\n", key);
-	free((void *)ep->key);
-	free(ep->data);
+	hstrfree(htab, ep->key);
+	hstrfree(htab, ep->data);
 	ep->flags = 0;
 	htab->table[idx].used = USED_DELETED;
 
 	--htab->filled;
+	hsort_invalidate(htab);
 }
 
 int hdelete_r(const char *key, struct hsearch_data *htab, int flag)
@@ -541,6 +631,43 @@ static int cmpkey(const void *p1, const void *p2)
 	return (strcmp(e1->key, e2->key));
 }
 
+/*
+ * Collect all entries of the table, sorted by key. With
+ * CONFIG_ENV_STRING_POOL the list is cached in the table until a variable is
+ * added or deleted; otherwise the caller has to free it.
+ */
+static struct env_entry **hsort_entries(struct hsearch_data *htab,
+					unsigned int *countp)
+{
+	struct env_entry **list;
+	unsigned int i, n;
+
+	if (htab->sorted) {
+		*countp = htab->nsorted;
+		return htab->sorted;
+	}
+
+	list = malloc(htab->size * sizeof(*list));
+	if (!list)
+		return NULL;
+
+	for (i = 1, n = 0; i <= htab->size; ++i) {
+		if (htab->table[i].used > 0)
+			list[n++] = &htab->table[i].entry;
+	}
+
+	/* Sort list by keys */
+	qsort(list, n, sizeof(struct env_entry *), cmpkey);
+
+	if (CONFIG_IS_ENABLED(ENV_STRING_POOL)) {
+		htab->sorted = list;
+		htab->nsorted = n;
+	}
+	*countp = n;
+
+	return list;
+}
+
 static int match_string(int flag, const char *str, const char *pat, void *priv)
 {
 	switch (flag & H_MATCH_METHOD) {
@@ -604,6 +731,8 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 		 int argc, char *const argv[])
 {
 	struct env_entry *list[htab->size];
+	struct env_entry **sorted;
+	unsigned int nsorted;
 	char *res, *p;
 	size_t totlen;
 	int i, n;
@@ -616,56 +745,59 @@ ssize_t hexport_r(struct hsearch_data *htab, const char sep, int flag,
 
 	debug("EXPORT  table = %p, htab.size = %d, htab.filled = %d, size = %lu\n",
 	      htab, htab->size, htab->filled, (ulong)size);
+	sorted = hsort_entries(htab, &nsorted);
+	if (!sorted) {
+		__set_errno(ENOMEM);
+		return (-1);
+	}
+
 	/*
 	 * Pass 1:
-	 * search used entries,
+	 * search used entries in key order,
 	 * save addresses and compute total length
 	 */
-	for (i = 1, n = 0, totlen = 0; i <= htab->size; ++i) {
-
-		if (htab->table[i].used > 0) {
-			struct env_entry *ep = &htab->table[i].entry;
-			int found = match_entry(ep, flag, argc, argv);
+	for (i = 0, n = 0, totlen = 0; i < nsorted; ++i) {
+		struct env_entry *ep = sorted[i];
+		int found = match_entry(ep, flag, argc, argv);
 
-			if ((argc > 0) && (found == 0))
-				continue;
+		if ((argc > 0) && (found == 0))
+			continue;
 
-			if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
-				continue;
+		if ((flag & H_HIDE_DOT) && ep->key[0] == '.')
+			continue;
 
-			list[n++] = ep;
+		list[n++] = ep;
 
-			totlen += strlen(ep->key);
+		totlen += strlen(ep->key);
 
-			if (sep == '\0') {
-				totlen += strlen(ep->data);
-			} else {	/* check if escapes are needed */
-				char *s = ep->data;
+		if (sep == '\0') {
+			totlen += strlen(ep->data);
+		} else {	/* check if escapes are needed */
+			char *s = ep->data;
 
-				while (*s) {
+			while (*s) {
+				++totlen;
+				/* add room for needed escape chars */
+				if ((*s == sep) || (*s == '\\'))
 					++totlen;
-					/* add room for needed escape chars */
-					if ((*s == sep) || (*s == '\\'))
-						++totlen;
-					++s;
-				}
+				++s;
 			}
-			totlen += 2;	/* for '=' and 'sep' char */
 		}
+		totlen += 2;	/* for '=' and 'sep' char */
 	}
 
+	if (sorted != htab->sorted)
+		free(sorted);
+
 #ifdef DEBUG
-	/* Pass 1a: print unsorted list */
-	printf("Unsorted: n=%d\n", n);
+	/* Pass 1a: print sorted list */
+	printf("Sorted: n=%d\n", n);
 	for (i = 0; i < n; ++i) {
 		printf("\t%3d: %p ==> %-10s => %s\n",
 		       i, list[i], list[i]->key, list[i]->data);
 	}
 #endif
 
-	/* Sort list by keys */
-	qsort(list, n, sizeof(struct env_entry *), cmpkey);
-
 	/* Check if the user supplied buffer size is sufficient */
 	if (size) {
 		if (size < totlen + 1) {	/* provided buffer too small */
@@ -860,6 +992,7 @@ int himport_r(struct hsearch_data *htab,
 			return 0;
 		}
 	}
+	hpool_create(htab, size);
 
 	if (!size) {
 		free(data);
@@ -0,0 +1,390 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Side index for libfdt lookups
+ *
+ * fdt_subnode_offset_namelen() and fdt_get_property_namelen() scan the
+ * structure block, so code which looks up many paths and properties in a
+ * large tree, such as the fixups applied before booting an OS, spends most
+ * of its time there. This keeps hash tables of the subnodes and properties
+ * of each node of one tree, which libfdt consults before scanning.
+ *
+ * Lookups only use the index until the structure of the tree changes. The
+ * wrappers around libfdt in this directory report every change through
+ * fdt_index_changed_(), which drops the index until fdt_index_attach() is
+ * called again, and ask the index before scanning, so libfdt itself is left
+ * as it is.
+ */
+
+#include <common.h>
+#include <errno.h>
+#include <malloc.h>
+#include <linux/libfdt_env.h>
+#include <linux/libfdt.h>
+#include <linux/log2.h>
+#include "libfdt_internal.h"
+
+/* Deepest tree which can be indexed */
+#define FDT_INDEX_MAX_DEPTH	64
+
+/**
+ * struct fdt_index_ent - Subnode or property of a node
+ *
+ * @parent: Offset of the node this belongs to
+ * @offset: Offset of the subnode or property
+ * @hash: Hash of @parent and the name
+ * @next: Next entry in the same bucket, or -1
+ */
+struct fdt_index_ent {
+	int parent;
+	int offset;
+	u32 hash;
+	int next;
+};
+
+/**
+ * struct fdt_index_table - Hash table of names within nodes
+ *
+ * Entries in each bucket are in tree order, so that a lookup finds the same
+ * offset as a scan of the tree would.
+ *
+ * @buckets: First entry of each bucket, or -1
+ * @ents: Entries, in tree order
+ * @mask: Number of buckets - 1
+ * @count: Number of entries
+ */
+struct fdt_index_table {
+	int *buckets;
+	struct fdt_index_ent *ents;
+	uint mask;
+	uint count;
+};
+
+/**
+ * struct fdt_index - Index of one tree
+ *
+ * @fdt: Tree which is indexed, NULL if none
+ * @size_struct: Size of the structure block when the index was built
+ * @size_strings: Size of the strings block when the index was built
+ * @nodes: Offsets of all nodes, in ascending order
+ * @num_nodes: Number of nodes
+ * @subnodes: Nodes by name, and by name without unit address
+ * @props: Properties by name
+ *
+ * This is in .data since lookups check it before relocation, when BSS may
+ * not be usable yet.
+ */
+static struct fdt_index {
+	const void *fdt;
+	u32 size_struct;
+	u32 size_strings;
+	int *nodes;
+	uint num_nodes;
+	struct fdt_index_table subnodes;
+	struct fdt_index_table props;
+} fdt_index __section(".data");
+
+static u32 fdt_index_hash(int parent, const char *name, int len)
+{
+	u32 hash = 2166136261U;
+	int i;
+
+	for (i = 0; i < len; i++) {
+		hash ^= (uchar)name[i];
+		hash *= 16777619U;
+	}
+
+	return hash ^ ((u32)parent * 0x9e3779b1U);
+}
+
+static void fdt_index_free_table(struct fdt_index_table *tab)
+{
+	free(tab->buckets);
+	free(tab->ents);
+	memset(tab, '\0', sizeof(*tab));
+}
+
+static int fdt_index_alloc_table(struct fdt_index_table *tab, uint count)
+{
+	uint size = roundup_pow_of_two(max(count, 1U));
+
+	tab->buckets = malloc(size * sizeof(*tab->buckets));
+	tab->ents = malloc(max(count, 1U) * sizeof(*tab->ents));
+	if (!tab->buckets || !tab->ents)
+		return -ENOMEM;
+	memset(tab->buckets, 0xff, size * sizeof(*tab->buckets));
+	tab->mask = size - 1;
+	tab->count = 0;
+
+	return 0;
+}
+
+static void fdt_index_add(struct fdt_index_table *tab, int parent, int offset,
+			  const char *name, int len)
+{
+	struct fdt_index_ent *ent = &tab->ents[tab->count++];
+
+	ent->parent = parent;
+	ent->offset = offset;
+	ent->hash = fdt_index_hash(parent, name, len);
+}
+
+/* Chain the entries, inserting in reverse so that buckets are in order */
+static void fdt_index_link(struct fdt_index_table *tab)
+{
+	int i;
+
+	for (i = tab->count - 1; i >= 0; i--) {
+		int *head = &tab->buckets[tab->ents[i].hash & tab->mask];
+
+		tab->ents[i].next = *head;
+		*head = i;
+	}
+}
+
+static void fdt_index_free(void)
+{
+	free(fdt_index.nodes);
+	fdt_index_free_table(&fdt_index.subnodes);
+	fdt_index_free_table(&fdt_index.props);
+	memset(&fdt_index, '\0', sizeof(fdt_index));
+}
+
+/*
+ * Walk the tree, counting nodes, subnode names and properties if @fill is
+ * false, or adding them to the index if it is true
+ */
+static int fdt_index_walk(const void *fdt, bool fill, uint *nodesp,
+			  uint *namesp, uint *propsp)
+{
+	int stack[FDT_INDEX_MAX_DEPTH];
+	uint nodes = 0, names = 0, props = 0;
+	int offset, next, depth = 0;
+	const struct fdt_property *prop;
+	const char *name;
+	uint32_t tag;
+	int len;
+
+	for (offset = 0; ; offset = next) {
+		tag = fdt_next_tag(fdt, offset, &next);
+		if (tag == FDT_END)
+			break;
+
+		switch (tag) {
+		case FDT_BEGIN_NODE:
+			if (depth == FDT_INDEX_MAX_DEPTH)
+				return -E2BIG;
+			name = fdt_get_name(fdt, offset, &len);
+			if (!name)
+				return -EINVAL;
+			if (fill) {
+				int parent = depth ? stack[depth - 1] : -1;
+				const char *at = memchr(name, '@', len);
+
+				fdt_index.nodes[nodes] = offset;
+				fdt_index_add(&fdt_index.subnodes, parent,
+					      offset, name, len);
+				if (at)
+					fdt_index_add(&fdt_index.subnodes,
+						      parent, offset, name,
+						      at - name);
+			}
+			names += memchr(name, '@', len) ? 2 : 1;
+			nodes++;
+			stack[depth++] = offset;
+			break;
+		case FDT_END_NODE:
+			if (!depth)
+				return -EINVAL;
+			depth--;
+			break;
+		case FDT_PROP:
+			if (!depth)
+				return -EINVAL;
+			if (fill) {
+				prop = fdt_get_property_by_offset(fdt, offset,
+								  NULL);
+				if (!prop)
+					return -EINVAL;
+				name = fdt_get_string(fdt,
+						fdt32_to_cpu(prop->nameoff),
+						&len);
+				if (!name)
+					return -EINVAL;
+				fdt_index_add(&fdt_index.props,
+					      stack[depth - 1], offset, name,
+					      len);
+			}
+			props++;
+			break;
+		}
+	}
+	if (next < 0 || depth)
+		return -EINVAL;
+
+	*nodesp = nodes;
+	*namesp = names;
+	*propsp = props;
+
+	return 0;
+}
+
+static int fdt_index_build(const void *fdt)
+{
+	uint nodes, names, props;
+	int ret;
+
+	fdt_index_free();
+	if (fdt_check_header(fdt) || fdt_version(fdt) < 0x10)
+		return -EINVAL;
+
+	ret = fdt_index_walk(fdt, false, &nodes, &names, &props);
+	if (ret)
+		return ret;
+
+	fdt_index.nodes = malloc(max(nodes, 1U) * sizeof(int));
+	if (!fdt_index.nodes)
+		ret = -ENOMEM;
+	if (!ret)
+		ret = fdt_index_alloc_table(&fdt_index.subnodes, names);
+	if (!ret)
+		ret = fdt_index_alloc_table(&fdt_index.props, props);
+	if (!ret)
+		ret = fdt_index_walk(fdt, true, &nodes, &names, &props);
+	if (ret) {
+		fdt_index_free();
+		return ret;
+	}
+	fdt_index_link(&fdt_index.subnodes);
+	fdt_index_link(&fdt_index.props);
+
+	fdt_index.fdt = fdt;
+	fdt_index.num_nodes = nodes;
+	fdt_index.size_struct = fdt_size_dt_struct(fdt);
+	fdt_index.size_strings = fdt_size_dt_strings(fdt);
+	debug("fdt_index: %p: %u nodes, %u properties\n", fdt, nodes, props);
+
+	return 0;
+}
+
+int fdt_index_attach(const void *fdt)
+{
+	return fdt_index_build(fdt);
+}
+
+void fdt_index_detach(const void *fdt)
+{
+	if (fdt == fdt_index.fdt)
+		fdt_index_free();
+}
+
+void fdt_index_changed_(const void *fdt)
+{
+	if (fdt == fdt_index.fdt)
+		fdt_index_free();
+}
+
+/* Check whether the index can answer a lookup within the node at @offset */
+static bool fdt_index_usable(const void *fdt, int offset)
+{
+	uint lo, hi;
+
+	if (fdt != fdt_index.fdt)
+		return false;
+	/* The tree was changed without going through libfdt */
+	if (fdt_size_dt_struct(fdt) != fdt_index.size_struct ||
+	    fdt_size_dt_strings(fdt) != fdt_index.size_strings) {
+		fdt_index_free();
+		return false;
+	}
+
+	/* Leave offsets which are not nodes to libfdt to report */
+	for (lo = 0, hi = fdt_index.num_nodes; lo < hi;) {
+		uint mid = (lo + hi) / 2;
+
+		if (fdt_index.nodes[mid] == offset)
+			return true;
+		if (fdt_index.nodes[mid] < offset)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+
+	return false;
+}
+
+/* Same rules as fdt_nodename_eq_(): the unit address may be left out */
+static bool fdt_index_name_eq(const void *fdt, int offset, const char *s,
+			      int len)
+{
+	const char *p;
+	int olen;
+
+	p = fdt_get_name(fdt, offset, &olen);
+	if (!p || olen < len || memcmp(p, s, len))
+		return false;
+
+	return p[len] == '\0' || (p[len] == '@' && !memchr(s, '@', len));
+}
+
+int fdt_index_subnode_(const void *fdt, int parent, const char *name,
+		       int namelen, int *offsetp)
+{
+	struct fdt_index_table *tab = &fdt_index.subnodes;
+	u32 hash;
+	int i;
+
+	if (!fdt_index_usable(fdt, parent))
+		return 0;
+
+	hash = fdt_index_hash(parent, name, namelen);
+	for (i = tab->buckets[hash & tab->mask]; i != -1;
+	     i = tab->ents[i].next) {
+		struct fdt_index_ent *ent = &tab->ents[i];
+
+		if (ent->hash == hash && ent->parent == parent &&
+		    fdt_index_name_eq(fdt, ent->offset, name, namelen)) {
+			*offsetp = ent->offset;
+			return 1;
+		}
+	}
+	*offsetp = -FDT_ERR_NOTFOUND;
+
+	return 1;
+}
+
+int fdt_index_property_(const void *fdt, int nodeoffset, const char *name,
+			int namelen, int *lenp,
+			const struct fdt_property **propp)
+{
+	struct fdt_index_table *tab = &fdt_index.props;
+	u32 hash;
+	int i;
+
+	if (!fdt_index_usable(fdt, nodeoffset))
+		return 0;
+
+	hash = fdt_index_hash(nodeoffset, name, namelen);
+	for (i = tab->buckets[hash & tab->mask]; i != -1;
+	     i = tab->ents[i].next) {
+		struct fdt_index_ent *ent = &tab->ents[i];
+		const struct fdt_property *prop;
+		const char *pname;
+		int len;
+
+		if (ent->hash != hash || ent->parent != nodeoffset)
+			continue;
+		prop = fdt_get_property_by_offset(fdt, ent->offset, lenp);
+		if (!prop)
+			continue;
+		pname = fdt_get_string(fdt, fdt32_to_cpu(prop->nameoff), &len);
+		if (pname && len == namelen && !memcmp(pname, name, len)) {
+			*propp = prop;
+			return 1;
+		}
+	}
+	if (lenp)
+		*lenp = -FDT_ERR_NOTFOUND;
+	*propp = NULL;
+
+	return 1;
+}
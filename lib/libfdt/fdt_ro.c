@@ -1,2 +1,128 @@
 #include <linux/libfdt_env.h>
+
+#if CONFIG_IS_ENABLED(OF_LIBFDT_INDEX)
+/*
+ * U-Boot: build the lookups below under other names, so that the versions
+ * at the end of this file can ask the index in fdt_index.c first and only
+ * scan the tree when it cannot answer
+ */
+#define fdt_subnode_offset_namelen	fdt_subnode_offset_namelen_scan_
+#define fdt_subnode_offset		fdt_subnode_offset_scan_
+#define fdt_path_offset_namelen		fdt_path_offset_namelen_scan_
+#define fdt_path_offset			fdt_path_offset_scan_
+#define fdt_get_property_namelen	fdt_get_property_namelen_scan_
+#define fdt_get_property		fdt_get_property_scan_
+#define fdt_getprop_namelen		fdt_getprop_namelen_scan_
+#define fdt_getprop			fdt_getprop_scan_
+#endif
+
 #include "../../scripts/dtc/libfdt/fdt_ro.c"
+
+#if CONFIG_IS_ENABLED(OF_LIBFDT_INDEX)
+#undef fdt_subnode_offset_namelen
+#undef fdt_subnode_offset
+#undef fdt_path_offset_namelen
+#undef fdt_path_offset
+#undef fdt_get_property_namelen
+#undef fdt_get_property
+#undef fdt_getprop_namelen
+#undef fdt_getprop
+
+#include "libfdt_internal.h"
+
+int fdt_subnode_offset_namelen(const void *fdt, int offset,
+			       const char *name, int namelen)
+{
+	int ret;
+
+	if (fdt_index_subnode_(fdt, offset, name, namelen, &ret))
+		return ret;
+
+	return fdt_subnode_offset_namelen_scan_(fdt, offset, name, namelen);
+}
+
+int fdt_subnode_offset(const void *fdt, int parentoffset, const char *name)
+{
+	return fdt_subnode_offset_namelen(fdt, parentoffset, name,
+					  strlen(name));
+}
+
+int fdt_path_offset_namelen(const void *fdt, const char *path, int namelen)
+{
+	const char *end = path + namelen;
+	const char *p = path;
+	int offset = 0;
+
+	FDT_RO_PROBE(fdt);
+
+	/* Leave aliases to libfdt */
+	if (*path != '/')
+		return fdt_path_offset_namelen_scan_(fdt, path, namelen);
+
+	while (p < end) {
+		const char *q;
+
+		while (*p == '/') {
+			p++;
+			if (p == end)
+				return offset;
+		}
+		q = memchr(p, '/', end - p);
+		if (!q)
+			q = end;
+
+		offset = fdt_subnode_offset_namelen(fdt, offset, p, q - p);
+		if (offset < 0)
+			return offset;
+
+		p = q;
+	}
+
+	return offset;
+}
+
+int fdt_path_offset(const void *fdt, const char *path)
+{
+	return fdt_path_offset_namelen(fdt, path, strlen(path));
+}
+
+const struct fdt_property *fdt_get_property_namelen(const void *fdt,
+						    int offset,
+						    const char *name,
+						    int namelen, int *lenp)
+{
+	const struct fdt_property *prop;
+
+	if (fdt_index_property_(fdt, offset, name, namelen, lenp, &prop))
+		return prop;
+
+	return fdt_get_property_namelen_scan_(fdt, offset, name, namelen,
+					      lenp);
+}
+
+const struct fdt_property *fdt_get_property(const void *fdt,
+					    int nodeoffset,
+					    const char *name, int *lenp)
+{
+	return fdt_get_property_namelen(fdt, nodeoffset, name,
+					strlen(name), lenp);
+}
+
+const void *fdt_getprop_namelen(const void *fdt, int nodeoffset,
+				const char *name, int namelen, int *lenp)
+{
+	const struct fdt_property *prop;
+
+	/* Only version 16 trees are indexed, so there is no realignment */
+	if (fdt_index_property_(fdt, nodeoffset, name, namelen, lenp, &prop))
+		return prop ? prop->data : NULL;
+
+	return fdt_getprop_namelen_scan_(fdt, nodeoffset, name, namelen, lenp);
+}
+
+const void *fdt_getprop(const void *fdt, int nodeoffset,
+			const char *name, int *lenp)
+{
+	return fdt_getprop_namelen(fdt, nodeoffset, name, strlen(name), lenp);
+}
+#endif
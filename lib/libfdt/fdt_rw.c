@@ -1,2 +1,100 @@
 #include <linux/libfdt_env.h>
+
+#if CONFIG_IS_ENABLED(OF_LIBFDT_INDEX)
+/*
+ * U-Boot: build the changes to the structure block under other names, so
+ * that the versions at the end of this file can drop the index in
+ * fdt_index.c. Moving the memory-reservation map or the blocks does not
+ * change offsets within the structure block, so those are left alone.
+ */
+#define fdt_set_name			fdt_set_name_raw_
+#define fdt_setprop_placeholder		fdt_setprop_placeholder_raw_
+#define fdt_setprop			fdt_setprop_raw_
+#define fdt_appendprop			fdt_appendprop_raw_
+#define fdt_delprop			fdt_delprop_raw_
+#define fdt_add_subnode_namelen		fdt_add_subnode_namelen_raw_
+#define fdt_add_subnode			fdt_add_subnode_raw_
+#define fdt_del_node			fdt_del_node_raw_
+#endif
+
 #include "../../scripts/dtc/libfdt/fdt_rw.c"
+
+#if CONFIG_IS_ENABLED(OF_LIBFDT_INDEX)
+#undef fdt_set_name
+#undef fdt_setprop_placeholder
+#undef fdt_setprop
+#undef fdt_appendprop
+#undef fdt_delprop
+#undef fdt_add_subnode_namelen
+#undef fdt_add_subnode
+#undef fdt_del_node
+
+#include "libfdt_internal.h"
+
+int fdt_set_name(void *fdt, int nodeoffset, const char *name)
+{
+	int ret = fdt_set_name_raw_(fdt, nodeoffset, name);
+
+	fdt_index_changed_(fdt);
+	return ret;
+}
+
+int fdt_setprop_placeholder(void *fdt, int nodeoffset, const char *name,
+			    int len, void **prop_data)
+{
+	int ret = fdt_setprop_placeholder_raw_(fdt, nodeoffset, name, len,
+					       prop_data);
+
+	fdt_index_changed_(fdt);
+	return ret;
+}
+
+int fdt_setprop(void *fdt, int nodeoffset, const char *name,
+		const void *val, int len)
+{
+	int ret = fdt_setprop_raw_(fdt, nodeoffset, name, val, len);
+
+	fdt_index_changed_(fdt);
+	return ret;
+}
+
+int fdt_appendprop(void *fdt, int nodeoffset, const char *name,
+		   const void *val, int len)
+{
+	int ret = fdt_appendprop_raw_(fdt, nodeoffset, name, val, len);
+
+	fdt_index_changed_(fdt);
+	return ret;
+}
+
+int fdt_delprop(void *fdt, int nodeoffset, const char *name)
+{
+	int ret = fdt_delprop_raw_(fdt, nodeoffset, name);
+
+	fdt_index_changed_(fdt);
+	return ret;
+}
+
+int fdt_add_subnode_namelen(void *fdt, int parentoffset,
+			    const char *name, int namelen)
+{
+	int ret = fdt_add_subnode_namelen_raw_(fdt, parentoffset, name,
+					       namelen);
+
+	fdt_index_changed_(fdt);
+	return ret;
+}
+
+int fdt_add_subnode(void *fdt, int parentoffset, const char *name)
+{
+	return fdt_add_subnode_namelen(fdt, parentoffset, name, strlen(name));
+}
+
+int fdt_del_node(void *fdt, int nodeoffset)
+{
+	int ret = fdt_del_node_raw_(fdt, nodeoffset);
+
+	fdt_index_changed_(fdt);
+	return ret;
+}
+#endif
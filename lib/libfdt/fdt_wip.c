@@ -1,2 +1,32 @@
 #include <linux/libfdt_env.h>
+
+#if CONFIG_IS_ENABLED(OF_LIBFDT_INDEX)
+/* U-Boot: drop the index in fdt_index.c when nodes or properties go away */
+#define fdt_nop_property		fdt_nop_property_raw_
+#define fdt_nop_node			fdt_nop_node_raw_
+#endif
+
 #include "../../scripts/dtc/libfdt/fdt_wip.c"
+
+#if CONFIG_IS_ENABLED(OF_LIBFDT_INDEX)
+#undef fdt_nop_property
+#undef fdt_nop_node
+
+#include "libfdt_internal.h"
+
+int fdt_nop_property(void *fdt, int nodeoffset, const char *name)
+{
+	int ret = fdt_nop_property_raw_(fdt, nodeoffset, name);
+
+	fdt_index_changed_(fdt);
+	return ret;
+}
+
+int fdt_nop_node(void *fdt, int nodeoffset)
+{
+	int ret = fdt_nop_node_raw_(fdt, nodeoffset);
+
+	fdt_index_changed_(fdt);
+	return ret;
+}
+#endif
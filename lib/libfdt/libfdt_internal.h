@@ -1 +1,13 @@
 #include "../../scripts/dtc/libfdt/libfdt_internal.h"
+
+/* U-Boot: side index for lookups, see fdt_index.c */
+#if CONFIG_IS_ENABLED(OF_LIBFDT_INDEX)
+struct fdt_property;
+
+int fdt_index_subnode_(const void *fdt, int parent, const char *name,
+		       int namelen, int *offsetp);
+int fdt_index_property_(const void *fdt, int nodeoffset, const char *name,
+			int namelen, int *lenp,
+			const struct fdt_property **propp);
+void fdt_index_changed_(const void *fdt);
+#endif
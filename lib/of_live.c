@@ -323,6 +323,7 @@ int of_live_build(const void *fdt_blob, struct device_node **rootp)
 	int ret;
 
 	debug("%s: start\n", __func__);
+	of_index_invalidate();
 	ret = unflatten_device_tree(fdt_blob, rootp);
 	if (ret) {
 		debug("Failed to create live tree: err=%d\n", ret);
@@ -340,6 +341,7 @@ int of_live_build(const void *fdt_blob, struct device_node **rootp)
 
 void of_live_free(struct device_node *root)
 {
+	of_index_invalidate();
 	/* the tree is stored as a contiguous block of memory */
 	free(root);
 }
@@ -0,0 +1,77 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Encoding and decoding of RELR relocation tables, see <u-boot/relr.h>
+ *
+ * This is used by tools/relocate-rela to build the table. ARM64 applies it
+ * in assembly during relocation, so relr_apply() follows the same steps.
+ */
+
+#ifdef USE_HOSTCC
+#include <errno.h>
+#else
+#include <linux/errno.h>
+#endif
+#include <u-boot/relr.h>
+
+#define RELR_WORD	sizeof(uint64_t)
+
+/* Number of words covered by a bitmap entry */
+#define RELR_BITS	63
+
+int relr_encode(const uint64_t *addr, int count, uint64_t *relr)
+{
+	uint64_t base, bits;
+	int i, n;
+
+	for (i = 0; i < count; i++) {
+		if ((addr[i] & (RELR_WORD - 1)) || (i && addr[i] <= addr[i - 1]))
+			return -EINVAL;
+	}
+
+	for (i = 0, n = 0; i < count;) {
+		/* Each run starts with an address... */
+		relr[n++] = addr[i];
+		base = addr[i++] + RELR_WORD;
+
+		/* ...followed by bitmaps while the next address is in reach */
+		for (;;) {
+			for (bits = 0; i < count &&
+			     addr[i] < base + RELR_BITS * RELR_WORD; i++)
+				bits |= 1ULL << ((addr[i] - base) / RELR_WORD);
+			if (!bits)
+				break;
+			relr[n++] = bits << 1 | 1;
+			base += RELR_BITS * RELR_WORD;
+		}
+	}
+
+	return n;
+}
+
+int relr_apply(const uint64_t *relr, int count, long loc_off, long val_off)
+{
+	uint64_t entry, where = 0, *loc;
+	int i, done = 0;
+
+	for (i = 0; i < count; i++) {
+		entry = relr[i];
+		if (!(entry & 1)) {
+			loc = (uint64_t *)(uintptr_t)(entry + loc_off);
+			*loc += val_off;
+			where = entry + RELR_WORD;
+			done++;
+			continue;
+		}
+
+		loc = (uint64_t *)(uintptr_t)(where + loc_off);
+		for (entry >>= 1; entry; entry >>= 1, loc++) {
+			if (entry & 1) {
+				*loc += val_off;
+				done++;
+			}
+		}
+		where += RELR_BITS * RELR_WORD;
+	}
+
+	return done;
+}
@@ -6,6 +6,8 @@
 #ifndef USE_HOSTCC
 #include <fdtdec.h>
 #include <log.h>
+#include <malloc.h>
+#include <asm/global_data.h>
 #include <asm/types.h>
 #include <asm/byteorder.h>
 #include <linux/errno.h>
@@ -19,6 +21,10 @@
 #include <u-boot/rsa.h>
 #include <u-boot/rsa-mod-exp.h>
 
+#ifndef USE_HOSTCC
+DECLARE_GLOBAL_DATA_PTR;
+#endif
+
 #define UINT64_MULT32(v, multby)  (((uint64_t)(v)) * ((uint32_t)(multby)))
 
 #define get_unaligned_be32(a) fdt32_to_cpu(*(uint32_t *)a)
@@ -254,52 +260,404 @@ static void rsa_convert_big_endian(uint32_t *dst, const uint32_t *src, int len)
 		dst[i] = fdt32_to_cpu(src[len - 1 - i]);
 }
 
+/*
+ * With a 128-bit product available, keys are handled in 64-bit words, which
+ * needs a quarter of the multiplications of 32-bit words
+ */
+#ifdef __SIZEOF_INT128__
+#define RSA_64BIT_WORDS
+typedef unsigned __int128 uint128_t;
+#endif
+
+/* Number of prepared keys kept by rsa_mod_exp_sw() */
+#define RSA_KEY_CACHE_SIZE	4
+
+/**
+ * struct rsa_key_ctx - public key prepared for exponentiation
+ *
+ * The key properties are converted to little endian word arrays before use.
+ * Prepared keys are kept so that checking several signatures made with the
+ * same key only does this once.
+ *
+ * @modulus_prop:	Modulus property the key was prepared from
+ * @rr_prop:		R^2 property the key was prepared from
+ * @num_bits:		Key length in bits
+ * @n0inv:		n0inv from the key properties
+ * @exponent:		Public exponent
+ * @exp_bits:		Number of bits in @exponent
+ * @wide:		true to use 64-bit words
+ * @key:		Key in 32-bit words, if !@wide
+ * @len64:		Number of 64-bit words in @modulus, if @wide
+ * @n0inv64:		-1 / modulus[0] mod 2^64, if @wide
+ * @modulus:		Modulus as little endian word array
+ * @rr:			R^2 as little endian word array
+ * @raw:		Copy of the modulus property, to check it is unchanged
+ */
+struct rsa_key_ctx {
+	const void *modulus_prop;
+	const void *rr_prop;
+	uint num_bits;
+	uint32_t n0inv;
+	uint64_t exponent;
+	int exp_bits;
+	bool wide;
+	struct rsa_public_key key;
+	uint len64;
+	uint64_t n0inv64;
+	union {
+		uint32_t w32[RSA_MAX_KEY_BITS / 32];
+		uint64_t w64[RSA_MAX_KEY_BITS / 64];
+	} modulus, rr;
+	uint8_t raw[RSA_MAX_KEY_BITS / 8];
+};
+
+#ifdef RSA_64BIT_WORDS
+/**
+ * subtract_modulus64() - subtract modulus from the given value
+ *
+ * @ctx:	Key containing modulus to subtract
+ * @num:	Number to subtract modulus from, as little endian word array
+ */
+static void subtract_modulus64(const struct rsa_key_ctx *ctx, uint64_t num[])
+{
+	const uint64_t *modulus = ctx->modulus.w64;
+	uint64_t borrow = 0;
+	uint128_t acc;
+	uint i;
+
+	for (i = 0; i < ctx->len64; i++) {
+		acc = (uint128_t)num[i] - modulus[i] - borrow;
+		num[i] = (uint64_t)acc;
+		borrow = (uint64_t)(acc >> 64) & 1;
+	}
+}
+
+/**
+ * greater_equal_modulus64() - check if a value is >= modulus
+ *
+ * @ctx:	Key containing modulus to check
+ * @num:	Number to check against modulus, as little endian word array
+ * Return: 0 if num < modulus, 1 if num >= modulus
+ */
+static int greater_equal_modulus64(const struct rsa_key_ctx *ctx,
+				   const uint64_t num[])
+{
+	const uint64_t *modulus = ctx->modulus.w64;
+	int i;
+
+	for (i = (int)ctx->len64 - 1; i >= 0; i--) {
+		if (num[i] < modulus[i])
+			return 0;
+		if (num[i] > modulus[i])
+			return 1;
+	}
+
+	return 1;  /* equal */
+}
+
+/**
+ * montgomery_mul_add_step64() - Perform montgomery multiply-add step
+ *
+ * This is montgomery_mul_add_step() with 64-bit words.
+ *
+ * @ctx:	RSA key
+ * @result:	Place to put result, as little endian word array
+ * @a:		Multiplier
+ * @b:		Multiplicand, as little endian word array
+ */
+static void montgomery_mul_add_step64(const struct rsa_key_ctx *ctx,
+				      uint64_t result[], const uint64_t a,
+				      const uint64_t b[])
+{
+	const uint64_t *modulus = ctx->modulus.w64;
+	uint128_t acc_a, acc_b;
+	uint64_t d0;
+	uint i;
+
+	acc_a = (uint128_t)a * b[0] + result[0];
+	d0 = (uint64_t)acc_a * ctx->n0inv64;
+	acc_b = (uint128_t)d0 * modulus[0] + (uint64_t)acc_a;
+	for (i = 1; i < ctx->len64; i++) {
+		acc_a = (acc_a >> 64) + (uint128_t)a * b[i] + result[i];
+		acc_b = (acc_b >> 64) + (uint128_t)d0 * modulus[i] +
+				(uint64_t)acc_a;
+		result[i - 1] = (uint64_t)acc_b;
+	}
+
+	acc_a = (acc_a >> 64) + (acc_b >> 64);
+
+	result[i - 1] = (uint64_t)acc_a;
+
+	if (acc_a >> 64)
+		subtract_modulus64(ctx, result);
+}
+
+/**
+ * montgomery_mul64() - Perform montgomery mutitply with 64-bit words
+ *
+ * Operation: montgomery result[] = a[] * b[] / n0inv % modulus
+ *
+ * @ctx:	RSA key
+ * @result:	Place to put result, as little endian word array
+ * @a:		Multiplier, as little endian word array
+ * @b:		Multiplicand, as little endian word array
+ */
+static void montgomery_mul64(const struct rsa_key_ctx *ctx,
+			     uint64_t result[], const uint64_t a[],
+			     const uint64_t b[])
+{
+	uint i;
+
+	for (i = 0; i < ctx->len64; ++i)
+		result[i] = 0;
+	for (i = 0; i < ctx->len64; ++i)
+		montgomery_mul_add_step64(ctx, result, a[i], b);
+}
+
+static void rsa_convert_big_endian64(uint64_t *dst, const uint8_t *src,
+				     int len)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		dst[i] = fdt64_to_cpup(src + (len - 1 - i) * 8);
+}
+
+/**
+ * pow_mod64() - public exponentiation with 64-bit words
+ *
+ * This follows pow_mod(), with the checks on the exponent done when the key
+ * is prepared.
+ *
+ * @ctx:	RSA key
+ * @in:		Big-endian byte array containing value
+ * @out:	Big-endian byte array for the result
+ */
+static void pow_mod64(const struct rsa_key_ctx *ctx, const uint8_t *in,
+		      uint8_t *out)
+{
+	uint64_t val[ctx->len64], acc[ctx->len64], tmp[ctx->len64];
+	uint64_t a_scaled[ctx->len64];
+	const uint64_t *rr = ctx->rr.w64;
+	fdt64_t word;
+	uint i;
+	int j;
+
+	rsa_convert_big_endian64(val, in, ctx->len64);
+
+	/* the bit at e[k-1] is 1 by definition, so start with: C := M */
+	montgomery_mul64(ctx, acc, val, rr); /* acc = a * RR / R mod n */
+	memcpy(a_scaled, acc, sizeof(a_scaled));
+
+	for (j = ctx->exp_bits - 2; j > 0; --j) {
+		montgomery_mul64(ctx, tmp, acc, acc);
+		if (ctx->exponent & (1ULL << j))
+			montgomery_mul64(ctx, acc, tmp, a_scaled);
+		else
+			memcpy(acc, tmp, sizeof(acc));
+	}
+
+	/* the bit at e[0] is always 1 */
+	montgomery_mul64(ctx, tmp, acc, acc);
+	montgomery_mul64(ctx, acc, tmp, val);
+
+	if (greater_equal_modulus64(ctx, acc))
+		subtract_modulus64(ctx, acc);
+
+	for (i = 0; i < ctx->len64; i++) {
+		word = cpu_to_fdt64(acc[ctx->len64 - 1 - i]);
+		memcpy(out + i * 8, &word, sizeof(word));
+	}
+}
+
+/**
+ * rsa_n0inv64() - Calculate -1 / n0 mod 2^64
+ *
+ * Each Newton step doubles the number of correct low bits, starting from
+ * the three bits for which any odd n0 is its own inverse.
+ *
+ * @n0:		Lowest word of the modulus, which must be odd
+ * Return: -1 / n0 mod 2^64
+ */
+static uint64_t rsa_n0inv64(uint64_t n0)
+{
+	uint64_t inv = n0;
+	int i;
+
+	for (i = 0; i < 5; i++)
+		inv *= 2 - n0 * inv;
+
+	return -inv;
+}
+#endif /* RSA_64BIT_WORDS */
+
+/**
+ * rsa_prepare_key() - Convert key properties for use in exponentiation
+ *
+ * @prop:	Key properties, which must include the modulus and R^2
+ * @ctx:	Place to put the prepared key
+ * Return: 0 if OK, -EINVAL if the public exponent is not usable
+ */
+static int rsa_prepare_key(const struct key_prop *prop,
+			   struct rsa_key_ctx *ctx)
+{
+	ctx->modulus_prop = prop->modulus;
+	ctx->rr_prop = prop->rr;
+	ctx->num_bits = prop->num_bits;
+	ctx->n0inv = prop->n0inv;
+	if (!prop->public_exponent)
+		ctx->exponent = RSA_DEFAULT_PUBEXP;
+	else
+		ctx->exponent = fdt64_to_cpup(prop->public_exponent);
+
+	ctx->key.exponent = ctx->exponent;
+	if (num_public_exponent_bits(&ctx->key, &ctx->exp_bits))
+		return -EINVAL;
+	if (ctx->exp_bits < 2) {
+		debug("Public exponent is too short (%d bits, minimum 2)\n",
+		      ctx->exp_bits);
+		return -EINVAL;
+	}
+	if (!(ctx->exponent & 1)) {
+		debug("LSB of RSA public exponent must be set.\n");
+		return -EINVAL;
+	}
+	memcpy(ctx->raw, prop->modulus, ctx->num_bits / 8);
+
+#ifdef RSA_64BIT_WORDS
+	/*
+	 * R is 2^(# key bits) either way, so R^2 from the key properties
+	 * still applies, as long as the key is a whole number of words
+	 */
+	ctx->wide = !(ctx->num_bits % 64);
+	if (ctx->wide) {
+		ctx->len64 = ctx->num_bits / 64;
+		rsa_convert_big_endian64(ctx->modulus.w64, prop->modulus,
+					 ctx->len64);
+		rsa_convert_big_endian64(ctx->rr.w64, prop->rr, ctx->len64);
+		ctx->n0inv64 = rsa_n0inv64(ctx->modulus.w64[0]);
+
+		return 0;
+	}
+#endif
+	ctx->key.n0inv = prop->n0inv;
+	ctx->key.len = ctx->num_bits / 32;
+	ctx->key.modulus = ctx->modulus.w32;
+	ctx->key.rr = ctx->rr.w32;
+	rsa_convert_big_endian(ctx->key.modulus, prop->modulus, ctx->key.len);
+	rsa_convert_big_endian(ctx->key.rr, prop->rr, ctx->key.len);
+
+	return 0;
+}
+
+#ifndef USE_HOSTCC
+static struct rsa_key_ctx *rsa_key_cache[RSA_KEY_CACHE_SIZE];
+static int rsa_key_cache_next;
+
+/**
+ * rsa_find_key() - Find a prepared key, preparing it if needed
+ *
+ * Keys are looked up by the address of their properties, then checked
+ * against the properties in case the devicetree has been changed since.
+ * Keys are only kept once full malloc() is available, since the cache lives
+ * in BSS and must not point into the pre-relocation malloc() area.
+ *
+ * @prop:	Key properties
+ * Return: prepared key, or NULL if it is not in the cache and cannot be
+ * added, in which case the caller must prepare it itself
+ */
+static struct rsa_key_ctx *rsa_find_key(const struct key_prop *prop)
+{
+	struct rsa_key_ctx *ctx;
+	int i;
+
+	if (!(gd->flags & GD_FLG_FULL_MALLOC_INIT))
+		return NULL;
+
+	for (i = 0; i < RSA_KEY_CACHE_SIZE; i++) {
+		ctx = rsa_key_cache[i];
+		if (ctx && ctx->modulus_prop == prop->modulus &&
+		    ctx->rr_prop == prop->rr && ctx->num_bits == prop->num_bits &&
+		    ctx->n0inv == prop->n0inv &&
+		    !memcmp(ctx->raw, prop->modulus, ctx->num_bits / 8) &&
+		    ctx->exponent == (prop->public_exponent ?
+				      fdt64_to_cpup(prop->public_exponent) :
+				      RSA_DEFAULT_PUBEXP))
+			return ctx;
+	}
+
+	i = rsa_key_cache_next;
+	ctx = rsa_key_cache[i];
+	if (!ctx) {
+		ctx = malloc(sizeof(*ctx));
+		if (!ctx)
+			return NULL;
+	}
+	if (rsa_prepare_key(prop, ctx)) {
+		free(ctx);
+		rsa_key_cache[i] = NULL;
+		return NULL;
+	}
+	rsa_key_cache[i] = ctx;
+	rsa_key_cache_next = (i + 1) % RSA_KEY_CACHE_SIZE;
+
+	return ctx;
+}
+#else
+static struct rsa_key_ctx *rsa_find_key(const struct key_prop *prop)
+{
+	return NULL;
+}
+#endif
+
 int rsa_mod_exp_sw(const uint8_t *sig, uint32_t sig_len,
 		struct key_prop *prop, uint8_t *out)
 {
-	struct rsa_public_key key;
+	struct rsa_key_ctx local, *ctx;
 	int ret;
 
 	if (!prop) {
 		debug("%s: Skipping invalid prop", __func__);
 		return -EBADF;
 	}
-	key.n0inv = prop->n0inv;
-	key.len = prop->num_bits;
 
-	if (!prop->public_exponent)
-		key.exponent = RSA_DEFAULT_PUBEXP;
-	else
-		key.exponent = fdt64_to_cpup(prop->public_exponent);
-
-	if (!key.len || !prop->modulus || !prop->rr) {
+	if (!prop->num_bits || !prop->modulus || !prop->rr) {
 		debug("%s: Missing RSA key info", __func__);
 		return -EFAULT;
 	}
 
 	/* Sanity check for stack size */
-	if (key.len > RSA_MAX_KEY_BITS || key.len < RSA_MIN_KEY_BITS) {
+	if (prop->num_bits > RSA_MAX_KEY_BITS ||
+	    prop->num_bits < RSA_MIN_KEY_BITS) {
 		debug("RSA key bits %u outside allowed range %d..%d\n",
-		      key.len, RSA_MIN_KEY_BITS, RSA_MAX_KEY_BITS);
+		      prop->num_bits, RSA_MIN_KEY_BITS, RSA_MAX_KEY_BITS);
 		return -EFAULT;
 	}
-	key.len /= sizeof(uint32_t) * 8;
-	uint32_t key1[key.len], key2[key.len];
-
-	key.modulus = key1;
-	key.rr = key2;
-	rsa_convert_big_endian(key.modulus, (uint32_t *)prop->modulus, key.len);
-	rsa_convert_big_endian(key.rr, (uint32_t *)prop->rr, key.len);
-	if (!key.modulus || !key.rr) {
-		debug("%s: Out of memory", __func__);
-		return -ENOMEM;
+	if (sig_len != prop->num_bits / 8) {
+		debug("%s: Signature length %u does not match key\n", __func__,
+		      sig_len);
+		return -EINVAL;
 	}
 
+	ctx = rsa_find_key(prop);
+	if (!ctx) {
+		ret = rsa_prepare_key(prop, &local);
+		if (ret)
+			return ret;
+		ctx = &local;
+	}
+
+#ifdef RSA_64BIT_WORDS
+	if (ctx->wide) {
+		pow_mod64(ctx, sig, out);
+		return 0;
+	}
+#endif
 	uint32_t buf[sig_len / sizeof(uint32_t)];
 
 	memcpy(buf, sig, sig_len);
 
-	ret = pow_mod(&key, buf);
+	ret = pow_mod(&ctx->key, buf);
 	if (ret)
 		return ret;
 
@@ -0,0 +1,332 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for malloc() statistics, fast bins and malloc_simple() release
+ */
+
+#include <common.h>
+#include <command.h>
+#include <malloc.h>
+#include <mapmem.h>
+#include <rand.h>
+#include <time.h>
+#include <asm/global_data.h>
+#include <test/common.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define NUM_SMALL	100
+#define NUM_FAST	64
+#define NUM_SAMPLES	200
+
+/* Sizes of the boot-time benchmark */
+#define NUM_NODES	2000
+#define NUM_DEVS	500
+#define NUM_VARS	300
+#define NUM_ROUNDS	10
+
+/* Get the size class which holds a chunk with @size usable bytes */
+static int size_class(size_t size)
+{
+	ulong sz = size + sizeof(size_t);
+	int i;
+
+	for (i = 0; i < MALLOC_NUM_CLASSES - 1; i++) {
+		if (sz <= malloc_class_size(i))
+			break;
+	}
+
+	return i;
+}
+
+/* Test that allocations and frees are counted in the right size class */
+static int common_test_malloc_info(struct unit_test_state *uts)
+{
+	struct malloc_info start, info;
+	struct malloc_class_info *cls;
+	void *small[NUM_SMALL], *big;
+	ulong bytes = 0;
+	int i, sc, bc;
+
+	if (!CONFIG_IS_ENABLED(SYS_MALLOC_STATS))
+		return -EAGAIN;
+	ut_assertok(malloc_get_info(&start));
+
+	for (i = 0; i < NUM_SMALL; i++) {
+		small[i] = malloc(40);
+		ut_assertnonnull(small[i]);
+		bytes += malloc_usable_size(small[i]) + sizeof(size_t);
+	}
+	big = calloc(1, 100000);
+	ut_assertnonnull(big);
+	bytes += malloc_usable_size(big) + sizeof(size_t);
+	sc = size_class(malloc_usable_size(small[0]));
+	bc = size_class(malloc_usable_size(big));
+	ut_assert(sc != bc);
+
+	ut_assertok(malloc_get_info(&info));
+	cls = &info.classes[sc];
+	ut_asserteq(start.classes[sc].allocs + NUM_SMALL, cls->allocs);
+	ut_asserteq(start.classes[sc].frees, cls->frees);
+	ut_asserteq(start.classes[bc].allocs + 1, info.classes[bc].allocs);
+	ut_asserteq(start.in_use + bytes, info.in_use);
+	ut_assert(info.max_in_use >= info.in_use);
+	ut_assert(info.max_brk >= info.brk);
+	ut_assert(info.largest_free <= info.free);
+
+	/* Growing a chunk moves it to a larger class */
+	small[0] = realloc(small[0], 4000);
+	ut_assertnonnull(small[0]);
+	ut_assertok(malloc_get_info(&info));
+	ut_asserteq(start.classes[sc].frees + 1, info.classes[sc].frees);
+	bc = size_class(malloc_usable_size(small[0]));
+	ut_assert(info.classes[bc].allocs > start.classes[bc].allocs);
+
+	for (i = 0; i < NUM_SMALL; i++)
+		free(small[i]);
+	free(big);
+
+	ut_assertok(malloc_get_info(&info));
+	ut_asserteq(start.in_use, info.in_use);
+	ut_asserteq(start.classes[sc].frees + NUM_SMALL,
+		    info.classes[sc].frees);
+	ut_assert(info.max_in_use >= start.in_use + bytes);
+
+	return 0;
+}
+COMMON_TEST(common_test_malloc_info, 0);
+
+/* Test that small chunks are reused at once and merged before large requests */
+static int common_test_malloc_fastbin(struct unit_test_state *uts)
+{
+	struct malloc_info start, info;
+	void *ptr[NUM_FAST], *p;
+	int i;
+
+	if (!CONFIG_IS_ENABLED(SYS_MALLOC_FASTBINS))
+		return -EAGAIN;
+
+	for (i = 0; i < NUM_FAST; i++) {
+		ptr[i] = malloc(200);
+		ut_assertnonnull(ptr[i]);
+	}
+	for (i = 0; i < NUM_FAST; i++)
+		free(ptr[i]);
+	if (CONFIG_IS_ENABLED(SYS_MALLOC_STATS)) {
+		ut_assertok(malloc_get_info(&start));
+		/* only a chunk next to the top of the heap is merged at once */
+		ut_assert(start.fast_chunks >= NUM_FAST - 1);
+	}
+
+	/* One of the chunks is handed straight back */
+	p = malloc(200);
+	for (i = 0; i < NUM_FAST && ptr[i] != p; i++)
+		;
+	ut_assert(i < NUM_FAST);
+	if (CONFIG_IS_ENABLED(SYS_MALLOC_STATS)) {
+		ut_assertok(malloc_get_info(&info));
+		ut_asserteq(start.fast_hits + 1, info.fast_hits);
+	}
+	free(p);
+
+	/* A large request empties the fast bins */
+	p = malloc(NUM_FAST * 100);
+	ut_assertnonnull(p);
+	if (CONFIG_IS_ENABLED(SYS_MALLOC_STATS)) {
+		ut_assertok(malloc_get_info(&info));
+		ut_asserteq(0, info.fast_chunks);
+	}
+	free(p);
+
+	return 0;
+}
+COMMON_TEST(common_test_malloc_fastbin, 0);
+
+#if CONFIG_IS_ENABLED(SYS_MALLOC_PROFILE)
+/* Allocate from one place, so the samples all have the same caller */
+static noinline int alloc_samples(struct unit_test_state *uts)
+{
+	void *ptr[NUM_SAMPLES];
+	int i;
+
+	for (i = 0; i < NUM_SAMPLES; i++) {
+		ptr[i] = malloc(24);
+		ut_assertnonnull(ptr[i]);
+	}
+	for (i = 0; i < NUM_SAMPLES; i++)
+		free(ptr[i]);
+
+	return 0;
+}
+
+/* Test that a frequent caller is always recorded */
+static int common_test_malloc_profile(struct unit_test_state *uts)
+{
+	struct malloc_info start, info;
+	ulong offset;
+	int i;
+
+	ut_assertok(malloc_get_info(&start));
+	ut_assertok(alloc_samples(uts));
+	ut_assertok(malloc_get_info(&info));
+	ut_assert(info.samples - start.samples >=
+		  NUM_SAMPLES / CONFIG_SYS_MALLOC_PROFILE_RATE);
+
+	for (i = 0; i < MALLOC_NUM_CALLERS; i++) {
+		offset = (ulong)info.callers[i].addr - (ulong)alloc_samples;
+		if (offset < 0x400)
+			break;
+	}
+	ut_assert(i < MALLOC_NUM_CALLERS);
+	ut_assert(info.callers[i].count >=
+		  NUM_SAMPLES / CONFIG_SYS_MALLOC_PROFILE_RATE);
+
+	return 0;
+}
+COMMON_TEST(common_test_malloc_profile, 0);
+#endif
+
+/* Test that malloc_simple() space can be reclaimed and the peak is kept */
+static int common_test_malloc_simple_release(struct unit_test_state *uts)
+{
+	ulong ptr, peak, mark;
+	void *buf;
+	int i;
+
+	if (!CONFIG_IS_ENABLED(SYS_MALLOC_F))
+		return -EAGAIN;
+	ptr = gd->malloc_ptr;
+	peak = gd->malloc_peak;
+
+	mark = malloc_simple_mark();
+	ut_asserteq(gd->malloc_base + ptr, mark);
+	for (i = 0; i < 3; i++) {
+		buf = malloc_simple(100);
+		ut_assertnonnull(buf);
+	}
+	ut_assert(gd->malloc_ptr >= ptr + 300);
+	malloc_simple_release(mark);
+	ut_asserteq(ptr, gd->malloc_ptr);
+	ut_assert(gd_malloc_peak() >= ptr + 300);
+
+	/* The space is handed out again */
+	ut_asserteq_ptr(map_sysmem(mark, 0), malloc_simple(100));
+	malloc_simple_release(mark);
+
+	/* A mark outside the region is ignored */
+	buf = malloc_simple(100);
+	ut_assertnonnull(buf);
+	malloc_simple_release(gd->malloc_base + gd->malloc_ptr + 8);
+	malloc_simple_release(gd->malloc_base - 8);
+	ut_assert(gd->malloc_ptr >= ptr + 100);
+
+	gd->malloc_ptr = ptr;
+	gd->malloc_peak = peak;
+
+	return 0;
+}
+COMMON_TEST(common_test_malloc_simple_release, 0);
+
+/* Test the 'malloc info' command */
+static int common_test_cmd_malloc(struct unit_test_state *uts)
+{
+	if (!IS_ENABLED(CONFIG_CMD_MALLOC))
+		return -EAGAIN;
+	ut_assertok(run_command("malloc info", 0));
+	ut_assert_nextlinen("heap:");
+	ut_assert_nextlinen("brk:");
+	ut_assert_nextlinen("in use:");
+	ut_assert_nextlinen("free:");
+	ut_assert_nextlinen("fragments:");
+	ut_assert_nextlinen("fast hits:");
+	console_record_reset();
+
+	return 0;
+}
+COMMON_TEST(common_test_cmd_malloc, UT_TESTF_CONSOLE_REC);
+
+/* Random size between @min and @max, weighted towards the small end */
+static size_t bench_size(size_t min, size_t max)
+{
+	return min + (rand() % (max - min + 1)) * (rand() % 4 + 1) / 4;
+}
+
+/*
+ * Time the allocation patterns seen during boot: the live tree allocates many
+ * nodes, properties and names and keeps them; driver model binds devices with
+ * small private data and removes some again; the environment duplicates many
+ * short strings and grows an export buffer.
+ */
+static int common_test_malloc_bench(struct unit_test_state *uts)
+{
+	void **nodes, **devs, **vars, *buf;
+	ulong start, tree_us = 0, dm_us = 0, env_us = 0, free_us = 0;
+	size_t len;
+	int i, n;
+
+	nodes = calloc(NUM_NODES * 3, sizeof(void *));
+	devs = calloc(NUM_DEVS * 3, sizeof(void *));
+	vars = calloc(NUM_VARS, sizeof(void *));
+	ut_assertnonnull(nodes);
+	ut_assertnonnull(devs);
+	ut_assertnonnull(vars);
+
+	srand(0x5eed);
+	for (n = 0; n < NUM_ROUNDS; n++) {
+		start = timer_get_us();
+		for (i = 0; i < NUM_NODES * 3; i += 3) {
+			nodes[i] = malloc(120);
+			nodes[i + 1] = malloc(48);
+			nodes[i + 2] = malloc(bench_size(8, 40));
+		}
+		tree_us += timer_get_us() - start;
+
+		start = timer_get_us();
+		for (i = 0; i < NUM_DEVS * 3; i += 3) {
+			devs[i] = calloc(1, 216);
+			devs[i + 1] = calloc(1, bench_size(16, 256));
+			devs[i + 2] = calloc(1, 64);
+		}
+		for (i = 0; i < NUM_DEVS * 3; i += 6) {
+			free(devs[i + 2]);
+			free(devs[i + 1]);
+			free(devs[i]);
+		}
+		for (i = 0; i < NUM_DEVS * 3; i += 6) {
+			devs[i] = calloc(1, 216);
+			devs[i + 1] = calloc(1, bench_size(16, 256));
+			devs[i + 2] = calloc(1, 64);
+		}
+		dm_us += timer_get_us() - start;
+
+		start = timer_get_us();
+		buf = NULL;
+		for (i = 0, len = 0; i < NUM_VARS; i++) {
+			vars[i] = malloc(bench_size(10, 100));
+			len += 64;
+			buf = realloc(buf, len);
+			ut_assertnonnull(buf);
+		}
+		free(buf);
+		env_us += timer_get_us() - start;
+
+		start = timer_get_us();
+		for (i = 0; i < NUM_VARS; i++)
+			free(vars[i]);
+		for (i = 0; i < NUM_DEVS * 3; i++)
+			free(devs[i]);
+		for (i = 0; i < NUM_NODES * 3; i++)
+			free(nodes[i]);
+		free_us += timer_get_us() - start;
+	}
+	free(vars);
+	free(devs);
+	free(nodes);
+
+	printf("malloc: %d rounds: tree %lu us, dm %lu us, env %lu us, free %lu us\n",
+	       NUM_ROUNDS, tree_us, dm_us, env_us, free_us);
+
+	return 0;
+}
+COMMON_TEST(common_test_malloc_bench, 0);
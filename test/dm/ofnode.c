@@ -20,9 +20,12 @@
 #include <abuf.h>
 #include <dm.h>
 #include <log.h>
+#include <malloc.h>
 #include <of_live.h>
+#include <time.h>
 #include <dm/device-internal.h>
 #include <dm/lists.h>
+#include <dm/of_access.h>
 #include <dm/of_extra.h>
 #include <dm/root.h>
 #include <dm/test.h>
@@ -1522,3 +1525,140 @@ static int dm_test_bool(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_bool, UT_TESTF_SCAN_FDT);
+
+#define INDEX_BUSES	16
+#define INDEX_DEVS	64
+
+/* Build a tree of buses with numbered devices, each with a phandle */
+static int make_index_fdt(struct unit_test_state *uts, void *fdt, int size)
+{
+	char name[30];
+	int bus, dev;
+
+	ut_assertok(fdt_create(fdt, size));
+	ut_assertok(fdt_finish_reservemap(fdt));
+	ut_assert(fdt_begin_node(fdt, "") >= 0);
+	for (bus = 0; bus < INDEX_BUSES; bus++) {
+		snprintf(name, sizeof(name), "bus@%x", bus);
+		ut_assert(fdt_begin_node(fdt, name) >= 0);
+		for (dev = 0; dev < INDEX_DEVS; dev++) {
+			static const char compat[] = "test,dev\0Test,Generic";
+
+			snprintf(name, sizeof(name), "dev@%x", dev);
+			ut_assert(fdt_begin_node(fdt, name) >= 0);
+			ut_assertok(fdt_property_u32(fdt, "phandle",
+						     bus * INDEX_DEVS + dev + 1));
+			ut_assertok(fdt_property(fdt, "compatible",
+						 dev % 8 ? compat + 9 : compat,
+						 dev % 8 ? sizeof(compat) - 9 :
+						 sizeof(compat)));
+			ut_assertok(fdt_end_node(fdt));
+		}
+		ut_assertok(fdt_end_node(fdt));
+	}
+	ut_assertok(fdt_end_node(fdt));
+	ut_assertok(fdt_finish(fdt));
+
+	return 0;
+}
+
+/* Check lookups through the live-tree index against a walk of the tree */
+static int dm_test_ofnode_index(struct unit_test_state *uts)
+{
+	const int count = INDEX_BUSES * INDEX_DEVS;
+	struct device_node *old_root, *root, *np, *walk;
+	ulong start, index_us, walk_us;
+	const int size = SZ_128K;
+	char path[40];
+	ofnode node;
+	void *fdt;
+	int i;
+
+	if (!CONFIG_IS_ENABLED(OF_LIVE_INDEX))
+		return -EAGAIN;
+
+	fdt = malloc(size);
+	ut_assertnonnull(fdt);
+	ut_assertok(make_index_fdt(uts, fdt, size));
+	ut_assertok(unflatten_device_tree(fdt, &root));
+	old_root = gd_of_root();
+	gd_set_of_root(root);
+
+	/* Phandles: the first lookup builds the index */
+	start = timer_get_us();
+	for (i = 1; i <= count; i++) {
+		node = ofnode_get_by_phandle(i);
+		ut_assert(ofnode_valid(node));
+	}
+	index_us = timer_get_us() - start;
+	ut_assert(!ofnode_valid(ofnode_get_by_phandle(count + 1)));
+
+	start = timer_get_us();
+	for (i = 1; i <= count; i++) {
+		for_each_of_allnodes(walk)
+			if (walk->phandle == i)
+				break;
+	}
+	walk_us = timer_get_us() - start;
+
+	for (i = 1; i <= count; i++) {
+		for_each_of_allnodes(walk)
+			if (walk->phandle == i)
+				break;
+		ut_asserteq_ptr(walk, of_find_node_by_phandle(NULL, i));
+	}
+	printf("%d phandles: index %lu us, walk %lu us\n", count, index_us,
+	       walk_us);
+
+	/* Compatible strings: the index must give tree order */
+	walk = NULL;
+	i = 0;
+	ofnode_for_each_compatible_node(node, "TEST,DEV") {
+		for_each_of_allnodes_from(walk, walk)
+			if (of_device_is_compatible(walk, "test,dev", NULL, NULL))
+				break;
+		ut_asserteq_ptr(walk, ofnode_to_np(node));
+		i++;
+	}
+	ut_asserteq(count / 8, i);
+	i = 0;
+	ofnode_for_each_compatible_node(node, "test,generic")
+		i++;
+	ut_asserteq(count, i);
+
+	/* Starting after a node which is not a match still works */
+	np = of_find_node_by_path("/bus@1");
+	ut_assertnonnull(np);
+	ut_asserteq_str("/bus@1/dev@0",
+			of_find_compatible_node(np, NULL, "test,dev")->full_name);
+
+	/* Paths, including options and a trailing '/' left to the walk */
+	snprintf(path, sizeof(path), "/bus@%x/dev@%x", INDEX_BUSES - 1,
+		 INDEX_DEVS - 1);
+	node = ofnode_path(path);
+	ut_assert(ofnode_valid(node));
+	ut_asserteq(count, ofnode_to_np(node)->phandle);
+	strcat(path, ":opt");
+	ut_asserteq_ptr(ofnode_to_np(node), of_find_node_opts_by_path(NULL,
+								      path,
+								      NULL));
+	ut_assert(!ofnode_valid(ofnode_path("/bus@0/dev@40")));
+	ut_assert(!ofnode_valid(ofnode_path("/bus@0/")));
+
+	/* A new compatible string is found after the index is dropped */
+	np = of_find_node_by_path("/bus@0/dev@1");
+	ut_assertnonnull(np);
+	ut_assertok(of_write_prop(np, "compatible", sizeof("test,dev"),
+				  "test,dev"));
+	np = of_find_compatible_node(of_find_node_by_path("/bus@0/dev@0"),
+				     NULL, "test,dev");
+	ut_asserteq_str("/bus@0/dev@1", np->full_name);
+
+	gd_set_of_root(old_root);
+	of_index_invalidate();
+	free(root);
+	free(fdt);
+
+	return 0;
+}
+DM_TEST(dm_test_ofnode_index, UT_TESTF_LIVE_TREE);
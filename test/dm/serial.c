@@ -4,14 +4,19 @@
  */
 
 #include <common.h>
+#include <cyclic.h>
 #include <log.h>
 #include <serial.h>
 #include <dm.h>
+#include <time.h>
+#include <asm/global_data.h>
 #include <asm/serial.h>
 #include <dm/test.h>
 #include <test/test.h>
 #include <test/ut.h>
 
+DECLARE_GLOBAL_DATA_PTR;
+
 static const char test_message[] =
 	"This is a test message\n"
 	"consisting of multiple lines\n";
@@ -90,3 +95,60 @@ static int dm_test_serial(struct unit_test_state *uts)
 }
 
 DM_TEST(dm_test_serial, UT_TESTF_SCAN_FDT);
+
+/* Test that output is buffered while the UART is busy and written later */
+static int dm_test_serial_tx_buffer(struct unit_test_state *uts)
+{
+	size_t start, queued, drained, resumed, flushed;
+	size_t len = sizeof(test_message) + 2;
+	struct udevice *dev, *old_dev = gd->cur_serial_dev;
+	ulong base;
+
+	if (!CONFIG_IS_ENABLED(SERIAL_TX_BUFFER) || !CONFIG_IS_ENABLED(CYCLIC))
+		return -EAGAIN;
+
+	/* Use a device probed by this test, so that its cyclic function runs */
+	ut_assertok(uclass_get_device_by_name(UCLASS_SERIAL, "serial", &dev));
+	gd->cur_serial_dev = dev;
+	sandbox_serial_endisable(false);
+	start = sandbox_serial_written();
+
+	/* Nothing can be written, so it is all buffered */
+	sandbox_serial_set_room(0);
+	serial_puts(test_message);
+	queued = sandbox_serial_written();
+
+	/* The cyclic function writes out as much as there is room for */
+	sandbox_serial_set_room(10);
+	base = get_timer(0);
+	while (sandbox_serial_written() == start && get_timer(base) < 1000)
+		schedule();
+	drained = sandbox_serial_written();
+
+	/* New output goes out in order as soon as there is room */
+	sandbox_serial_set_room(5);
+	serial_putc('x');
+	resumed = sandbox_serial_written();
+
+	/* Flushing writes out everything */
+	sandbox_serial_set_room(-1);
+	serial_flush();
+	flushed = sandbox_serial_written();
+
+	/* A NUL character is buffered like any other */
+	sandbox_serial_set_room(0);
+	serial_putc('\0');
+	sandbox_serial_set_room(-1);
+	serial_flush();
+	gd->cur_serial_dev = old_dev;
+	sandbox_serial_endisable(true);
+
+	ut_asserteq(start, queued);
+	ut_asserteq(start + 10, drained);
+	ut_asserteq(start + 15, resumed);
+	ut_asserteq(start + len, flushed);
+	ut_asserteq(flushed + 1, sandbox_serial_written());
+
+	return 0;
+}
+DM_TEST(dm_test_serial_tx_buffer, UT_TESTF_SCAN_FDT);
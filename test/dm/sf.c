@@ -11,6 +11,7 @@
 #include <os.h>
 #include <spi.h>
 #include <spi_flash.h>
+#include <linux/math64.h>
 #include <asm/state.h>
 #include <asm/test.h>
 #include <dm/test.h>
@@ -102,3 +103,67 @@ static int dm_test_spi_flash_func(struct unit_test_state *uts)
 	return 0;
 }
 DM_TEST(dm_test_spi_flash_func, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Test that reads go through the direct mapping of the controller */
+static int dm_test_spi_flash_dirmap(struct unit_test_state *uts)
+{
+	struct sandbox_spi_stats stats;
+	struct spi_mem_dirmap_desc *rdesc;
+	struct udevice *dev, *bus;
+	int size = 0x200000;
+	struct spi_flash *flash;
+	u64 dirmap_ns;
+	u8 *src, *dst;
+
+	if (!CONFIG_IS_ENABLED(SPI_DIRMAP))
+		return -EAGAIN;
+
+	src = map_sysmem(0x20000, size);
+	ut_assertok(os_write_file("spi.bin", src, size));
+	ut_assertok(uclass_first_device_err(UCLASS_SPI_FLASH, &dev));
+	flash = dev_get_uclass_priv(dev);
+	bus = dev_get_parent(dev);
+	ut_assertnonnull(flash->dirmap.rdesc);
+	ut_assert(!flash->dirmap.rdesc->nodirmap);
+
+	dst = map_sysmem(0x20000 + size, size);
+	memset(dst, '\0', size);
+	sandbox_spi_reset_stats(bus);
+	ut_assertok(spi_flash_read_dm(dev, 0, size, dst));
+	ut_asserteq_mem(src, dst, size);
+	sandbox_spi_get_stats(bus, &stats);
+	ut_asserteq(size, stats.dirmap_bytes);
+	ut_assert(stats.xfer_bytes < 16);
+	dirmap_ns = stats.bus_ns;
+
+	/* Writes do not use the mapping */
+	ut_assertok(spi_flash_erase_dm(dev, 0, 0x10000));
+	sandbox_spi_reset_stats(bus);
+	ut_assertok(spi_flash_write_dm(dev, 0x100, 0x100, src));
+	sandbox_spi_get_stats(bus, &stats);
+	ut_asserteq(0, stats.dirmap_reads);
+	ut_assert(stats.xfer_bytes >= 0x100);
+
+	/* Without the mapping, the same read is done by programmed I/O */
+	rdesc = flash->dirmap.rdesc;
+	flash->dirmap.rdesc = NULL;
+	sandbox_spi_reset_stats(bus);
+	ut_assertok(spi_flash_read_dm(dev, 0, size, dst));
+	flash->dirmap.rdesc = rdesc;
+	ut_asserteq_mem(src + 0x10000, dst + 0x10000, size - 0x10000);
+	sandbox_spi_get_stats(bus, &stats);
+	ut_asserteq(0, stats.dirmap_reads);
+	ut_assert(stats.xfer_bytes >= size);
+	ut_assert(stats.bus_ns > dirmap_ns);
+	printf("read %d bytes: %llu us mapped, %llu us by programmed I/O\n",
+	       size, div_u64(dirmap_ns, 1000), div_u64(stats.bus_ns, 1000));
+
+	/*
+	 * Since we are about to destroy all devices, we must tell sandbox
+	 * to forget the emulation device
+	 */
+	sandbox_sf_unbind_emul(state_get_current(), 0, 0);
+
+	return 0;
+}
+DM_TEST(dm_test_spi_flash_dirmap, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
@@ -6,6 +6,8 @@
 #include <common.h>
 #include <console.h>
 #include <dm.h>
+#include <malloc.h>
+#include <os.h>
 #include <part.h>
 #include <usb.h>
 #include <asm/io.h>
@@ -16,6 +18,8 @@
 #include <dm/uclass-internal.h>
 #include <test/test.h>
 #include <test/ut.h>
+#include <linux/math64.h>
+#include <linux/sizes.h>
 
 struct keyboard_test_data {
 	const char modifiers;
@@ -85,6 +89,151 @@ static int dm_test_usb_flash(struct unit_test_state *uts)
 }
 DM_TEST(dm_test_usb_flash, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
 
+/* Fill a file for a flash stick with a pattern which differs in each block */
+static int setup_flash_file(struct unit_test_state *uts, const char *fname,
+			    int size, u32 **bufp)
+{
+	u32 *buf;
+	int i;
+
+	buf = malloc(size);
+	ut_assertnonnull(buf);
+	for (i = 0; i < size / sizeof(u32); i++)
+		buf[i] = i * 0x9e3779b1;
+	ut_assertok(os_write_file(fname, buf, size));
+	*bufp = buf;
+
+	return 0;
+}
+
+/* Test that a flash stick which offers UAS is used that way */
+static int dm_test_usb_flash_uas(struct unit_test_state *uts)
+{
+	struct udevice *dev, *emul, *blk;
+	struct sandbox_flash_stats stats;
+	struct usb_device *udev;
+	struct blk_desc *desc;
+	int size = SZ_4M, blks;
+	u32 *buf, *cmp;
+
+	if (!IS_ENABLED(CONFIG_USB_STORAGE_UAS))
+		return -EAGAIN;
+
+	ut_assertok(setup_flash_file(uts, "testflash2.bin", size, &buf));
+	blks = size / 512;
+	cmp = malloc(size);
+	ut_assertnonnull(cmp);
+
+	state_set_skip_delays(true);
+	ut_assertok(usb_init());
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 2, &dev));
+	ut_assertok(device_find_first_child_by_uclass(dev, UCLASS_BLK, &blk));
+	ut_assertok(uclass_get_device_by_name(UCLASS_USB_EMUL, "flash-stick@2",
+					      &emul));
+	desc = dev_get_uclass_plat(blk);
+	ut_asserteq(blks, desc->lba);
+
+	/* The UAS endpoints have packet sizes, from their own descriptors */
+	udev = dev_get_parent_priv(dev);
+	ut_asserteq(1024, udev->epmaxpacketout[1]);
+	ut_asserteq(1024, udev->epmaxpacketin[2]);
+	ut_asserteq(512, udev->epmaxpacketout[3]);
+	ut_asserteq(512, udev->epmaxpacketin[4]);
+
+	/* Large reads are split into queued commands */
+	sandbox_flash_reset_stats(emul);
+	ut_asserteq(blks, blk_read(blk, 0, blks, cmp));
+	ut_asserteq_mem(buf, cmp, size);
+	sandbox_flash_get_stats(emul, &stats);
+	ut_asserteq(size, stats.data_bytes);
+	ut_asserteq(CONFIG_USB_STORAGE_MAX_XFER_BLK * 512, stats.max_xfer);
+	ut_assert(stats.max_queued > 1);
+
+	/* Writes too, with a command shorter than the rest at the end */
+	memset(cmp, '\xa5', size);
+	ut_asserteq(blks - 3, blk_write(blk, 1, blks - 3, cmp));
+	memset(cmp, '\0', size);
+	ut_asserteq(blks, blk_read(blk, 0, blks, cmp));
+	ut_asserteq_mem(buf, cmp, 512);
+	ut_asserteq(0xa5a5a5a5, cmp[128]);
+	ut_asserteq(0xa5a5a5a5, cmp[(size - 1024) / 4 - 1]);
+	ut_asserteq_mem(buf + (size - 1024) / 4, cmp + (size - 1024) / 4,
+			1024);
+
+	/* A failed read is reported, and the stick still works afterwards */
+	ut_asserteq(0, blk_read(blk, blks - 2, 4, cmp));
+	memset(cmp, '\0', 1024);
+	ut_asserteq(2, blk_read(blk, 0, 2, cmp));
+	ut_asserteq_mem(buf, cmp, 512);
+
+	ut_assertok(usb_stop());
+	ut_assertok(os_unlink("testflash2.bin"));
+	free(cmp);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_usb_flash_uas, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
+/* Compare the modelled time to read from a stick with BBB and with UAS */
+static int dm_test_usb_flash_bench(struct unit_test_state *uts)
+{
+	struct sandbox_flash_stats bbb, uas;
+	struct udevice *dev, *emul, *blk;
+	int size = SZ_4M, blks = size / 512;
+	u32 *buf, *cmp;
+
+	if (!IS_ENABLED(CONFIG_USB_STORAGE_UAS))
+		return -EAGAIN;
+
+	ut_assertok(setup_flash_file(uts, "testflash1.bin", size, &buf));
+	free(buf);
+	ut_assertok(setup_flash_file(uts, "testflash2.bin", size, &buf));
+	cmp = malloc(size);
+	ut_assertnonnull(cmp);
+
+	state_set_skip_delays(true);
+	ut_assertok(usb_init());
+
+	/* Bulk-Only Transport */
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 1, &dev));
+	ut_assertok(device_find_first_child_by_uclass(dev, UCLASS_BLK, &blk));
+	ut_assertok(uclass_get_device_by_name(UCLASS_USB_EMUL, "flash-stick@1",
+					      &emul));
+	sandbox_flash_reset_stats(emul);
+	ut_asserteq(blks, blk_read(blk, 0, blks, cmp));
+	ut_asserteq_mem(buf, cmp, size);
+	sandbox_flash_get_stats(emul, &bbb);
+
+	/* USB Attached SCSI */
+	ut_assertok(uclass_get_device(UCLASS_MASS_STORAGE, 2, &dev));
+	ut_assertok(device_find_first_child_by_uclass(dev, UCLASS_BLK, &blk));
+	ut_assertok(uclass_get_device_by_name(UCLASS_USB_EMUL, "flash-stick@2",
+					      &emul));
+	sandbox_flash_reset_stats(emul);
+	memset(cmp, '\0', size);
+	ut_asserteq(blks, blk_read(blk, 0, blks, cmp));
+	ut_asserteq_mem(buf, cmp, size);
+	sandbox_flash_get_stats(emul, &uas);
+
+	printf("Read %d MiB: BBB %lu commands, %llu us (%llu MB/s); UAS %lu commands, %llu us (%llu MB/s)\n",
+	       size >> 20, bbb.cmds, div_u64(bbb.bus_ns, 1000),
+	       div_u64((u64)size * 1000, bbb.bus_ns), uas.cmds,
+	       div_u64(uas.bus_ns, 1000),
+	       div_u64((u64)size * 1000, uas.bus_ns));
+	ut_assert(uas.cmds < bbb.cmds);
+	ut_assert(uas.bus_ns < bbb.bus_ns);
+
+	ut_assertok(usb_stop());
+	ut_assertok(os_unlink("testflash1.bin"));
+	ut_assertok(os_unlink("testflash2.bin"));
+	free(cmp);
+	free(buf);
+
+	return 0;
+}
+DM_TEST(dm_test_usb_flash_bench, UT_TESTF_SCAN_PDATA | UT_TESTF_SCAN_FDT);
+
 /* test that we can handle multiple storage devices */
 static int dm_test_usb_multi(struct unit_test_state *uts)
 {
@@ -7,8 +7,11 @@
 #include <common.h>
 #include <command.h>
 #include <log.h>
+#include <malloc.h>
 #include <search.h>
 #include <stdio.h>
+#include <time.h>
+#include <linux/sizes.h>
 #include <test/env.h>
 #include <test/ut.h>
 
@@ -124,3 +127,141 @@ static int env_test_htab_deletes(struct unit_test_state *uts)
 }
 
 ENV_TEST(env_test_htab_deletes, 0);
+
+/* Check that export stays sorted as values are overwritten and keys added */
+static int env_test_htab_export(struct unit_test_state *uts)
+{
+	static const char env[] = "b=22\0a=1\0c=333\0";
+	struct hsearch_data htab;
+	struct env_entry item, *ritem;
+	char *res;
+
+	memset(&htab, 0, sizeof(htab));
+	ut_asserteq(1, himport_r(&htab, env, sizeof(env), '\0', 0, 0, 0,
+				 NULL));
+
+	res = NULL;
+	ut_assert(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	ut_asserteq_str("a=1\nb=22\nc=333\n", res);
+	free(res);
+
+	/* shorter value, may be updated in place */
+	item.key = "c";
+	item.data = "4";
+	ut_assert(hsearch_r(item, ENV_ENTER, &ritem, &htab, 0));
+	ut_asserteq_str("4", ritem->data);
+
+	/* longer value */
+	item.key = "a";
+	item.data = "55555";
+	ut_assert(hsearch_r(item, ENV_ENTER, &ritem, &htab, 0));
+	ut_asserteq_str("55555", ritem->data);
+
+	item.key = "0";
+	item.data = "first";
+	ut_assert(hsearch_r(item, ENV_ENTER, &ritem, &htab, 0));
+
+	res = NULL;
+	ut_assert(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	ut_asserteq_str("0=first\na=55555\nb=22\nc=4\n", res);
+	free(res);
+
+	ut_assertok(hdelete_r("b", &htab, 0));
+	res = NULL;
+	ut_assert(hexport_r(&htab, '\n', 0, &res, 0, 0, NULL) > 0);
+	ut_asserteq_str("0=first\na=55555\nc=4\n", res);
+	free(res);
+
+	hdestroy_r(&htab);
+	return 0;
+}
+
+ENV_TEST(env_test_htab_export, 0);
+
+/*
+ * Build an environment blob of roughly @size bytes in the format used for
+ * storage, i.e. "name=value" pairs separated by '\0'
+ */
+static int htab_bench_env(char *buf, size_t size)
+{
+	char *p = buf;
+	int count = 0;
+
+	while (p - buf + 64 < size) {
+		p += sprintf(p, "bench_var_%05d=value_of_variable_%d", count,
+			     count) + 1;
+		count++;
+	}
+	*p = '\0';
+
+	return count;
+}
+
+static int htab_bench(struct unit_test_state *uts, size_t size)
+{
+	struct hsearch_data htab;
+	struct env_entry item, *ritem;
+	ulong start, import_us, export_us, lookup_us;
+	char key[20], *env, *res;
+	int count, pass, i;
+	ssize_t len;
+
+	env = malloc(size);
+	ut_assertnonnull(env);
+	count = htab_bench_env(env, size);
+
+	memset(&htab, 0, sizeof(htab));
+	ut_asserteq(1, hcreate_r(count * 2, &htab));
+
+	start = timer_get_us();
+	ut_asserteq(1, himport_r(&htab, env, size, '\0', H_NOCLEAR, 0, 0,
+				 NULL));
+	import_us = timer_get_us() - start;
+	ut_asserteq(count, htab.filled);
+
+	start = timer_get_us();
+	for (pass = 0; pass < 10; pass++) {
+		for (i = 0; i < count; i++) {
+			sprintf(key, "bench_var_%05d", i);
+			item.key = key;
+			item.data = NULL;
+			hsearch_r(item, ENV_FIND, &ritem, &htab, 0);
+			ut_assertnonnull(ritem);
+		}
+	}
+	lookup_us = timer_get_us() - start;
+
+	/* The first export sorts the table, the following ones do not */
+	res = NULL;
+	ut_assert(hexport_r(&htab, '\0', 0, &res, 0, 0, NULL) > 0);
+	free(res);
+
+	start = timer_get_us();
+	for (pass = 0; pass < 10; pass++) {
+		res = NULL;
+		len = hexport_r(&htab, '\0', 0, &res, 0, 0, NULL);
+		ut_assert(len > 0);
+		free(res);
+	}
+	export_us = timer_get_us() - start;
+
+	printf("%4lu KiB, %5d vars: import %lu us, lookup %lu ns, export %lu us\n",
+	       (ulong)size / 1024, count, import_us,
+	       lookup_us * 1000 / (count * 10), export_us / 10);
+
+	hdestroy_r(&htab);
+	free(env);
+
+	return 0;
+}
+
+/* Measure import, lookup and export of a 16 KiB and a 128 KiB environment */
+static int env_test_htab_bench(struct unit_test_state *uts)
+{
+	ut_assertok(htab_bench(uts, SZ_16K));
+	ut_assertok(htab_bench(uts, SZ_128K));
+
+	return 0;
+}
+
+ENV_TEST(env_test_htab_bench, 0);
@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the environment journal
+ */
+
+#include <common.h>
+#include <env.h>
+#include <env_internal.h>
+#include <malloc.h>
+#include <search.h>
+#include <test/env.h>
+#include <test/ut.h>
+#include <u-boot/crc.h>
+
+#define JNL_SIZE	1024
+#define JNL_ALIGN	64
+
+/* RAM-backed storage for the environment and its journal */
+struct jnl_test_dev {
+	env_t env;
+	char area[JNL_SIZE];
+	int compactions;
+};
+
+static int jnl_test_read(struct env_journal *jnl, ulong offset, ulong len,
+			 void *buf)
+{
+	struct jnl_test_dev *dev = jnl->priv;
+
+	memcpy(buf, dev->area + offset, len);
+
+	return 0;
+}
+
+static int jnl_test_write(struct env_journal *jnl, ulong offset, ulong len,
+			  const void *buf)
+{
+	struct jnl_test_dev *dev = jnl->priv;
+
+	memcpy(dev->area + offset, buf, len);
+
+	return 0;
+}
+
+static int jnl_test_compact(struct env_journal *jnl, const env_t *env)
+{
+	struct jnl_test_dev *dev = jnl->priv;
+
+	memcpy(&dev->env, env, sizeof(*env));
+	memset(dev->area, 0xff, JNL_SIZE);
+	dev->compactions++;
+
+	return 0;
+}
+
+static int jnl_test_save(struct unit_test_state *uts, struct env_journal *jnl,
+			 env_t *env_new)
+{
+	ut_assertok(env_export(env_new));
+	ut_assertok(env_journal_save(jnl, env_new));
+
+	return 0;
+}
+
+static int env_test_journal_run(struct unit_test_state *uts,
+				struct jnl_test_dev *dev, env_t *env_new)
+{
+	struct env_journal jnl = {
+		.name = "test",
+		.size = JNL_SIZE,
+		.align = JNL_ALIGN,
+		.erased = true,
+		.read = jnl_test_read,
+		.write = jnl_test_write,
+		.compact = jnl_test_compact,
+		.priv = dev,
+	};
+	ulong tail;
+	int i;
+
+	memset(dev, 0xff, sizeof(*dev));
+	dev->compactions = 0;
+
+	/* The first save writes the environment in full */
+	ut_assertok(env_set("jtest_a", "1"));
+	ut_assertok(env_set("jtest_b", "2"));
+	ut_assertok(jnl_test_save(uts, &jnl, env_new));
+	ut_asserteq(1, dev->compactions);
+	ut_asserteq(JNL_ALIGN, jnl.tail);
+
+	/* Then only the changes are appended, as a single record */
+	ut_assertok(env_set("jtest_a", "3"));
+	ut_assertok(env_set("jtest_b", NULL));
+	ut_assertok(env_set("jtest_c", "4"));
+	ut_assertok(jnl_test_save(uts, &jnl, env_new));
+	ut_asserteq(1, dev->compactions);
+	ut_asserteq(2 * JNL_ALIGN, jnl.tail);
+
+	/* Saving without changes does not write anything */
+	ut_assertok(jnl_test_save(uts, &jnl, env_new));
+	ut_asserteq(2 * JNL_ALIGN, jnl.tail);
+
+	/* Reload: the stored environment plus the journal */
+	ut_assertok(env_import((char *)&dev->env, 1, H_EXTERNAL));
+	ut_asserteq_str("1", env_get("jtest_a"));
+	ut_asserteq_str("2", env_get("jtest_b"));
+	ut_assertnull(env_get("jtest_c"));
+
+	ut_assertok(env_journal_load(&jnl, &dev->env));
+	ut_asserteq(2 * JNL_ALIGN, jnl.tail);
+	ut_asserteq_str("3", env_get("jtest_a"));
+	ut_assertnull(env_get("jtest_b"));
+	ut_asserteq_str("4", env_get("jtest_c"));
+
+	/* Fill up the journal, which then starts again */
+	for (i = 0; dev->compactions == 1; i++) {
+		ut_assert(i < JNL_SIZE / JNL_ALIGN);
+		ut_assertok(env_set_ulong("jtest_a", i));
+		tail = jnl.tail;
+		ut_assertok(jnl_test_save(uts, &jnl, env_new));
+	}
+	ut_asserteq(JNL_SIZE / JNL_ALIGN - 1, i);
+	ut_asserteq(JNL_SIZE, tail);
+	ut_asserteq(JNL_ALIGN, jnl.tail);
+
+	ut_assertok(env_import((char *)&dev->env, 1, H_EXTERNAL));
+	ut_assertok(env_journal_load(&jnl, &dev->env));
+	ut_asserteq(i - 1, env_get_ulong("jtest_a", 10, 0));
+
+	/* A journal which does not match the environment is ignored */
+	ut_assertok(env_set("jtest_a", "5"));
+	ut_assertok(jnl_test_save(uts, &jnl, env_new));
+	dev->env.data[0] ^= 1;
+	dev->env.crc = crc32(0, dev->env.data, ENV_SIZE);
+	ut_assertok(env_import((char *)&dev->env, 1, H_EXTERNAL));
+	ut_assertok(env_journal_load(&jnl, &dev->env));
+	ut_asserteq(i - 1, env_get_ulong("jtest_a", 10, 0));
+	ut_asserteq(JNL_SIZE, jnl.tail);
+
+	/* A torn record at the tail cannot be written over on flash */
+	ut_assertok(jnl_test_save(uts, &jnl, env_new));
+	ut_asserteq(3, dev->compactions);
+	tail = jnl.tail;
+	dev->area[tail + 8] = 0;
+	ut_assertok(env_import((char *)&dev->env, 1, H_EXTERNAL));
+	ut_assertok(env_journal_load(&jnl, &dev->env));
+	ut_asserteq(JNL_SIZE, jnl.tail);
+
+	/* but can on a device which does not need erasing */
+	jnl.erased = false;
+	ut_assertok(env_import((char *)&dev->env, 1, H_EXTERNAL));
+	ut_assertok(env_journal_load(&jnl, &dev->env));
+	ut_asserteq(tail, jnl.tail);
+
+	free(jnl.saved);
+
+	return 0;
+}
+
+static int env_test_journal(struct unit_test_state *uts)
+{
+	struct jnl_test_dev *dev;
+	env_t *orig, *env_new;
+	int ret;
+
+	dev = malloc(sizeof(*dev));
+	orig = malloc(sizeof(*orig));
+	env_new = malloc(sizeof(*env_new));
+	ut_assertnonnull(dev);
+	ut_assertnonnull(orig);
+	ut_assertnonnull(env_new);
+
+	ut_assertok(env_export(orig));
+	ret = env_test_journal_run(uts, dev, env_new);
+	ut_asserteq(1, himport_r(&env_htab, (char *)orig->data, ENV_SIZE, '\0',
+				 0, 0, 0, NULL));
+
+	free(env_new);
+	free(orig);
+	free(dev);
+
+	return ret;
+}
+
+ENV_TEST(env_test_journal, 0);
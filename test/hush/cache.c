@@ -0,0 +1,153 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Tests for the cache of parsed scripts run with 'run'
+ */
+
+#include <cli_hush.h>
+#include <command.h>
+#include <env.h>
+#include <time.h>
+#include <test/hush.h>
+#include <test/ut.h>
+#include <asm/global_data.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+static int hush_test_cache_reuse(struct unit_test_state *uts)
+{
+	struct hush_parse_cache_stats before, after;
+	int pass;
+
+	if (!(gd->flags & GD_FLG_HUSH_OLD_PARSER))
+		return -EAGAIN;
+
+	ut_assertok(env_set("cache_script",
+			    "for cache_i in a b; do echo $cache_i; done; "
+			    "if test -n \"$cache_arg\"; then echo $cache_arg; fi"));
+	ut_assertok(env_set("cache_arg", "one"));
+	hush_parse_cache_get_stats(&before);
+
+	console_record_reset_enable();
+	for (pass = 0; pass < 3; pass++) {
+		ut_assertok(run_command("run cache_script", 0));
+		ut_assert_nextline("a");
+		ut_assert_nextline("b");
+		ut_assert_nextline("one");
+		ut_assert_console_end();
+	}
+
+	/* Variables used by the script are expanded on each run */
+	ut_assertok(env_set("cache_arg", "two"));
+	ut_assertok(run_command("run cache_script", 0));
+	ut_assert_nextline("a");
+	ut_assert_nextline("b");
+	ut_assert_nextline("two");
+	ut_assert_console_end();
+
+	hush_parse_cache_get_stats(&after);
+	ut_asserteq(before.misses + 1, after.misses);
+	ut_asserteq(before.hits + 3, after.hits);
+
+	ut_assertok(env_set("cache_script", NULL));
+	ut_assertok(env_set("cache_arg", NULL));
+	puts("Beware: this test set local variable cache_i and it cannot be unset!");
+
+	return 0;
+}
+HUSH_TEST(hush_test_cache_reuse, 0);
+
+static int hush_test_cache_change(struct unit_test_state *uts)
+{
+	struct hush_parse_cache_stats before, after;
+
+	if (!(gd->flags & GD_FLG_HUSH_OLD_PARSER))
+		return -EAGAIN;
+
+	hush_parse_cache_get_stats(&before);
+	console_record_reset_enable();
+
+	ut_assertok(env_set("cache_script", "echo first"));
+	ut_assertok(run_command("run cache_script", 0));
+	ut_assert_nextline("first");
+
+	/* Changing the variable must not run the old script */
+	ut_assertok(env_set("cache_script", "echo second; false"));
+	ut_asserteq(1, run_command("run cache_script", 0));
+	ut_assert_nextline("second");
+
+	/* A script which changes and runs itself is not shared */
+	ut_assertok(env_set("cache_script",
+			    "setenv cache_script echo inner; run cache_script"));
+	ut_assertok(run_command("run cache_script", 0));
+	ut_assert_nextline("inner");
+	ut_assert_console_end();
+
+	hush_parse_cache_get_stats(&after);
+	ut_assert(after.stale >= before.stale + 2);
+
+	ut_assertok(env_set("cache_script", NULL));
+	hush_parse_cache_flush();
+
+	return 0;
+}
+HUSH_TEST(hush_test_cache_change, 0);
+
+/* Compare a chain of boot scripts run with and without the cache */
+static int hush_test_cache_bench(struct unit_test_state *uts)
+{
+	static const char *const vars[][2] = {
+		{ "bench_boot", "run bench_find; if test -n \"$bench_dev\"; "
+		  "then run bench_load; else run bench_fail; fi" },
+		{ "bench_find", "for bench_d in mmc0 mmc1 usb0; do "
+		  "if test \"$bench_d\" = \"$bench_want\"; then "
+		  "setenv bench_dev $bench_d; fi; done" },
+		{ "bench_load", "if test \"$bench_dev\" = mmc1 && "
+		  "test -n \"$bench_want\"; then setenv bench_addr 0x1000; "
+		  "elif test \"$bench_dev\" = usb0; then "
+		  "setenv bench_addr 0x2000; else false; fi" },
+		{ "bench_fail", "setenv bench_addr; false" },
+		{ "bench_want", "mmc1" },
+	};
+	struct hush_parse_cache_stats before, after;
+	ulong start, cached_us, uncached_us;
+	const int loops = 200;
+	const char *boot;
+	int i;
+
+	if (!(gd->flags & GD_FLG_HUSH_OLD_PARSER))
+		return -EAGAIN;
+
+	for (i = 0; i < ARRAY_SIZE(vars); i++)
+		ut_assertok(env_set(vars[i][0], vars[i][1]));
+	boot = env_get("bench_boot");
+
+	hush_parse_cache_get_stats(&before);
+	start = timer_get_us();
+	for (i = 0; i < loops; i++)
+		ut_assertok(run_command("run bench_boot", 0));
+	cached_us = timer_get_us() - start;
+	hush_parse_cache_get_stats(&after);
+	ut_asserteq_str("0x1000", env_get("bench_addr"));
+	ut_assert(after.hits - before.hits >= (loops - 1) * 3);
+
+	/* Each 'run' inside still goes through the cache, so flush it */
+	start = timer_get_us();
+	for (i = 0; i < loops; i++) {
+		hush_parse_cache_flush();
+		ut_assertok(run_command(boot, CMD_FLAG_ENV));
+	}
+	uncached_us = timer_get_us() - start;
+	ut_asserteq_str("0x1000", env_get("bench_addr"));
+
+	printf("%d boot script runs: cached %lu us, uncached %lu us\n", loops,
+	       cached_us, uncached_us);
+
+	for (i = 0; i < ARRAY_SIZE(vars); i++)
+		ut_assertok(env_set(vars[i][0], NULL));
+	ut_assertok(env_set("bench_dev", NULL));
+	ut_assertok(env_set("bench_addr", NULL));
+	hush_parse_cache_flush();
+
+	return 0;
+}
+HUSH_TEST(hush_test_cache_bench, 0);
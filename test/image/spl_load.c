@@ -6,6 +6,7 @@
 #include <common.h>
 #include <image.h>
 #include <imx_container.h>
+#include <malloc.h>
 #include <mapmem.h>
 #include <memalign.h>
 #include <rand.h>
@@ -370,6 +371,315 @@ SPL_IMG_TEST(spl_test_image, IMX8, 0);
 SPL_IMG_TEST(spl_test_image, FIT_INTERNAL, 0);
 SPL_IMG_TEST(spl_test_image, FIT_EXTERNAL, 0);
 
+/**
+ * struct spl_test_fit_image - image in the FIT for spl_test_fit_read_plan()
+ *
+ * @name: Image name
+ * @offset: Offset of the data after the FIT
+ * @size: Size of the data
+ * @load: Load address, relative to CONFIG_TEXT_BASE
+ */
+struct spl_test_fit_image {
+	const char *name;
+	int offset;
+	int size;
+	int load;
+};
+
+/*
+ * Three images close together and one further away. The load addresses are
+ * not aligned, so none can be read straight to its load address.
+ */
+static const struct spl_test_fit_image plan_images[] = {
+	{ "firmware", 0, 1500, 0x4 },
+	{ "tee", 1500, 700, 0x10004 },
+	{ "atf", 3224, 3000, 0x20004 },
+	{ "far", 0x11000, 1000, 0x30004 },
+};
+
+static int spl_test_reads;
+
+static ulong spl_test_read_count(struct spl_load_info *load, ulong offset,
+				 ulong count, void *buf)
+{
+	spl_test_reads++;
+	return spl_test_read(load, offset, count, buf);
+}
+
+static int create_plan_fit(struct unit_test_state *uts, void *dst,
+			   size_t size)
+{
+	const struct spl_test_fit_image *img;
+	int i;
+
+	ut_assertok(fdt_create(dst, size));
+	ut_assertok(fdt_finish_reservemap(dst));
+	ut_assertok(fdt_begin_node(dst, ""));
+	ut_assertok(fdt_property_u32(dst, "#address-cells", ADDRESS_CELLS));
+
+	ut_assertok(fdt_begin_node(dst, "images"));
+	for (i = 0; i < ARRAY_SIZE(plan_images); i++) {
+		img = &plan_images[i];
+		ut_assertok(fdt_begin_node(dst, img->name));
+		ut_assertok(fdt_property_string(dst, FIT_TYPE_PROP,
+						"firmware"));
+		ut_assertok(fdt_property_string(dst, FIT_OS_PROP, "tee"));
+		ut_assertok(fdt_property_string(dst, FIT_COMP_PROP, "none"));
+		ut_assertok(fdt_property_u32(dst, FIT_DATA_OFFSET_PROP,
+					     img->offset));
+		ut_assertok(fdt_property_u32(dst, FIT_DATA_SIZE_PROP,
+					     img->size));
+		ut_assertok(fdt_property_addr(dst, FIT_LOAD_PROP,
+					      CONFIG_TEXT_BASE + img->load));
+		ut_assertok(fdt_end_node(dst));
+	}
+	ut_assertok(fdt_end_node(dst)); /* images */
+
+	ut_assertok(fdt_begin_node(dst, "configurations"));
+	ut_assertok(fdt_property_string(dst, FIT_DEFAULT_PROP, "config-1"));
+	ut_assertok(fdt_begin_node(dst, "config-1"));
+	ut_assertok(fdt_property_string(dst, FIT_DESC_PROP, "plan"));
+	ut_assertok(fdt_property_string(dst, FIT_FIRMWARE_PROP, "firmware"));
+	ut_assertok(fdt_property(dst, FIT_LOADABLE_PROP, "tee\0atf\0far",
+				 sizeof("tee\0atf\0far")));
+	ut_assertok(fdt_end_node(dst)); /* config-1 */
+	ut_assertok(fdt_end_node(dst)); /* configurations */
+
+	ut_assertok(fdt_end_node(dst)); /* root */
+	ut_assertok(fdt_finish(dst));
+
+	return 0;
+}
+
+/* Test that images close together in a FIT are read together */
+static int spl_test_fit_read_plan(struct unit_test_state *uts)
+{
+	const struct spl_test_fit_image *img;
+	struct spl_image_info info_read = { };
+	struct spl_load_info load;
+	size_t fit_size = 2048, data_start;
+	char *fit;
+	ulong mark;
+	int i;
+
+	if (!IS_ENABLED(CONFIG_SPL_LOAD_FIT))
+		return -EAGAIN;
+
+	img = &plan_images[ARRAY_SIZE(plan_images) - 1];
+	fit = calloc(fit_size + img->offset + img->size + 512, 1);
+	ut_assertnonnull(fit);
+	ut_assertok(create_plan_fit(uts, fit, fit_size));
+
+	data_start = ALIGN(fdt_totalsize(fit), 4);
+	for (i = 0; i < ARRAY_SIZE(plan_images); i++) {
+		img = &plan_images[i];
+		generate_data(fit + data_start + img->offset, img->size,
+			      img->name);
+	}
+
+	spl_set_bl_len(&load, 512);
+	load.priv = fit;
+	load.read = spl_test_read_count;
+	spl_test_reads = 0;
+	mark = malloc_simple_mark();
+	ut_assertok(spl_load_simple_fit(&info_read, &load, 0, fit));
+	/*
+	 * Only the FIT itself is left in the early malloc() pool, not the
+	 * buffer which the first three images were read into
+	 */
+	img = &plan_images[2];
+	ut_assert(malloc_simple_mark() - mark < img->offset + img->size);
+
+	for (i = 0; i < ARRAY_SIZE(plan_images); i++) {
+		img = &plan_images[i];
+		ut_asserteq_mem(fit + data_start + img->offset,
+				map_sysmem(CONFIG_TEXT_BASE + img->load,
+					   img->size),
+				img->size);
+	}
+	ut_asserteq(CONFIG_TEXT_BASE + plan_images[0].load,
+		    info_read.load_addr);
+
+	/* The FIT, then the first three images together, then the last */
+	ut_asserteq(IS_ENABLED(CONFIG_SPL_FIT_READ_PLAN) ? 3 : 5,
+		    spl_test_reads);
+
+	free(fit);
+	return 0;
+}
+SPL_TEST(spl_test_fit_read_plan, 0);
+
+/*
+ * 144KiB of a 64-byte pattern from generate_data(..., "lz4"), compressed with
+ * lz4 --no-frame-crc -B4 -5 as binman does
+ */
+static const char lz4_compressed[] = {
+	0x04, 0x22, 0x4d, 0x18, 0x60, 0x40, 0x82, 0x4b, 0x01, 0x00, 0x00, 0xff,
+	0x31, 0x0e, 0x1f, 0x2b, 0x33, 0x4a, 0x5e, 0x69, 0x7e, 0x8e, 0x90, 0xad,
+	0xb3, 0xc0, 0xda, 0xee, 0xf3, 0x07, 0x11, 0x2c, 0x38, 0x49, 0x55, 0x69,
+	0x76, 0x85, 0x90, 0xab, 0xb4, 0xcb, 0xd2, 0xea, 0xf2, 0x03, 0x19, 0x2b,
+	0x38, 0x46, 0x53, 0x6a, 0x7e, 0x88, 0x90, 0xa2, 0xb2, 0xc6, 0xdd, 0xe3,
+	0xf4, 0x09, 0x11, 0x2e, 0x38, 0x4c, 0x5b, 0x63, 0x70, 0x89, 0x97, 0xa6,
+	0xbc, 0xc1, 0xd5, 0xe3, 0xf5, 0x40, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xa8,
+	0x50, 0xbc, 0xc1, 0xd5, 0xe3, 0xf5, 0x4b, 0x01, 0x00, 0x00, 0xff, 0x31,
+	0x0e, 0x1f, 0x2b, 0x33, 0x4a, 0x5e, 0x69, 0x7e, 0x8e, 0x90, 0xad, 0xb3,
+	0xc0, 0xda, 0xee, 0xf3, 0x07, 0x11, 0x2c, 0x38, 0x49, 0x55, 0x69, 0x76,
+	0x85, 0x90, 0xab, 0xb4, 0xcb, 0xd2, 0xea, 0xf2, 0x03, 0x19, 0x2b, 0x38,
+	0x46, 0x53, 0x6a, 0x7e, 0x88, 0x90, 0xa2, 0xb2, 0xc6, 0xdd, 0xe3, 0xf4,
+	0x09, 0x11, 0x2e, 0x38, 0x4c, 0x5b, 0x63, 0x70, 0x89, 0x97, 0xa6, 0xbc,
+	0xc1, 0xd5, 0xe3, 0xf5, 0x40, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xa8, 0x50,
+	0xbc, 0xc1, 0xd5, 0xe3, 0xf5, 0x8a, 0x00, 0x00, 0x00, 0xff, 0x31, 0x0e,
+	0x1f, 0x2b, 0x33, 0x4a, 0x5e, 0x69, 0x7e, 0x8e, 0x90, 0xad, 0xb3, 0xc0,
+	0xda, 0xee, 0xf3, 0x07, 0x11, 0x2c, 0x38, 0x49, 0x55, 0x69, 0x76, 0x85,
+	0x90, 0xab, 0xb4, 0xcb, 0xd2, 0xea, 0xf2, 0x03, 0x19, 0x2b, 0x38, 0x46,
+	0x53, 0x6a, 0x7e, 0x88, 0x90, 0xa2, 0xb2, 0xc6, 0xdd, 0xe3, 0xf4, 0x09,
+	0x11, 0x2e, 0x38, 0x4c, 0x5b, 0x63, 0x70, 0x89, 0x97, 0xa6, 0xbc, 0xc1,
+	0xd5, 0xe3, 0xf5, 0x40, 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+	0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xe7, 0x50, 0xbc, 0xc1,
+	0xd5, 0xe3, 0xf5, 0x00, 0x00, 0x00, 0x00,
+};
+
+#define LZ4_PLAIN_SIZE		0x24000
+#define LZ4_PATTERN_SIZE	64
+/* Margin worked out by binman for lz4_compressed with fit,decomp-inplace */
+#define LZ4_DECOMP_MARGIN	(178 + FIT_DECOMP_READ_SLACK)
+
+static void *spl_test_last_buf;
+static ulong spl_test_last_count;
+
+static ulong spl_test_read_buf(struct spl_load_info *load, ulong offset,
+			       ulong count, void *buf)
+{
+	spl_test_last_buf = buf;
+	spl_test_last_count = count;
+	return spl_test_read(load, offset, count, buf);
+}
+
+/* Test that an lz4 image is decompressed in place */
+static int spl_test_fit_lz4_inplace(struct unit_test_state *uts)
+{
+	struct spl_image_info info_read = { };
+	size_t fit_size = 1024, data_start;
+	struct spl_load_info load;
+	char *fit, *plain, *dst;
+	int i, node;
+
+	if (!IS_ENABLED(CONFIG_SPL_LOAD_FIT) || !IS_ENABLED(CONFIG_SPL_LZ4))
+		return -EAGAIN;
+
+	fit = calloc(fit_size + sizeof(lz4_compressed) + 512, 1);
+	ut_assertnonnull(fit);
+	ut_assertok(fdt_create(fit, fit_size));
+	ut_assertok(fdt_finish_reservemap(fit));
+	ut_assertok(fdt_begin_node(fit, ""));
+	ut_assertok(fdt_property_u32(fit, "#address-cells", ADDRESS_CELLS));
+
+	ut_assertok(fdt_begin_node(fit, "images"));
+	ut_assertok(fdt_begin_node(fit, "firmware"));
+	ut_assertok(fdt_property_string(fit, FIT_TYPE_PROP, "firmware"));
+	ut_assertok(fdt_property_string(fit, FIT_OS_PROP, "tee"));
+	ut_assertok(fdt_property_string(fit, FIT_COMP_PROP, "lz4"));
+	ut_assertok(fdt_property_u32(fit, FIT_DATA_OFFSET_PROP, 0));
+	ut_assertok(fdt_property_u32(fit, FIT_DATA_SIZE_PROP,
+				     sizeof(lz4_compressed)));
+	ut_assertok(fdt_property_u32(fit, FIT_UNCOMP_SIZE_PROP,
+				     LZ4_PLAIN_SIZE));
+	ut_assertok(fdt_property_u32(fit, FIT_DECOMP_MARGIN_PROP,
+				     LZ4_DECOMP_MARGIN));
+	ut_assertok(fdt_property_addr(fit, FIT_LOAD_PROP, CONFIG_TEXT_BASE));
+	ut_assertok(fdt_end_node(fit)); /* firmware */
+	ut_assertok(fdt_end_node(fit)); /* images */
+
+	ut_assertok(fdt_begin_node(fit, "configurations"));
+	ut_assertok(fdt_property_string(fit, FIT_DEFAULT_PROP, "config-1"));
+	ut_assertok(fdt_begin_node(fit, "config-1"));
+	ut_assertok(fdt_property_string(fit, FIT_DESC_PROP, "lz4"));
+	ut_assertok(fdt_property_string(fit, FIT_FIRMWARE_PROP, "firmware"));
+	ut_assertok(fdt_end_node(fit)); /* config-1 */
+	ut_assertok(fdt_end_node(fit)); /* configurations */
+
+	ut_assertok(fdt_end_node(fit)); /* root */
+	ut_assertok(fdt_finish(fit));
+
+	data_start = ALIGN(fdt_totalsize(fit), 4);
+	memcpy(fit + data_start, lz4_compressed, sizeof(lz4_compressed));
+
+	spl_set_bl_len(&load, 512);
+	load.priv = fit;
+	load.read = spl_test_read_buf;
+	ut_assertok(spl_load_simple_fit(&info_read, &load, 0, fit));
+	ut_asserteq(LZ4_PLAIN_SIZE, info_read.size);
+
+	/* The compressed data was read to the end of the load area itself */
+	dst = map_sysmem(CONFIG_TEXT_BASE, LZ4_PLAIN_SIZE);
+	ut_assert((char *)spl_test_last_buf > dst);
+	ut_assert((char *)spl_test_last_buf + spl_test_last_count <=
+		  dst + LZ4_PLAIN_SIZE + LZ4_DECOMP_MARGIN);
+
+	plain = malloc(LZ4_PATTERN_SIZE);
+	ut_assertnonnull(plain);
+	generate_data(plain, LZ4_PATTERN_SIZE, "lz4");
+	for (i = 0; i < LZ4_PLAIN_SIZE; i += LZ4_PATTERN_SIZE)
+		ut_asserteq_mem(plain, dst + i, LZ4_PATTERN_SIZE);
+
+	/* Nothing is written past uncomp-size */
+	node = fdt_path_offset(fit, "/images/firmware");
+	ut_assertok(fdt_setprop_inplace_u32(fit, node, FIT_UNCOMP_SIZE_PROP,
+					    LZ4_PLAIN_SIZE - 1));
+	ut_asserteq(-EIO, spl_load_simple_fit(&info_read, &load, 0, fit));
+
+	free(plain);
+	free(fit);
+	return 0;
+}
+SPL_TEST(spl_test_fit_lz4_inplace, 0);
+
 /*
  * LZMA is too complex to generate on the fly, so let's use some data I put in
  * the oven^H^H^H^H compressed earlier
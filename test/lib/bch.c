@@ -0,0 +1,217 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the software BCH encoder and decoder
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <rand.h>
+#include <time.h>
+#include <linux/bch.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define NUM_SECTORS	256
+
+/**
+ * struct bch_test_code - BCH code to test
+ *
+ * @m: Galois field order
+ * @t: Number of bit errors which can be corrected
+ * @len: Bytes of data protected by each code word
+ */
+struct bch_test_code {
+	int m;
+	int t;
+	int len;
+};
+
+/* The usual codes for 512- and 1024-byte NAND sectors */
+static const struct bch_test_code bch_test_codes[] = {
+	{ 13, 4, 512 },
+	{ 13, 8, 512 },
+	{ 14, 24, 1024 },
+};
+
+/* Flip @count different bits among the data and whole bytes of the ecc */
+static void flip_bits(struct bch_control *bch, u8 *data, u8 *ecc, int len,
+		      int count, uint *pos)
+{
+	uint nbits = 8 * len + (bch->ecc_bits & ~7);
+	int i, j;
+
+	for (i = 0; i < count; i++) {
+		do {
+			pos[i] = rand() % nbits;
+			for (j = 0; j < i && pos[j] != pos[i]; j++)
+				;
+		} while (j < i);
+		if (pos[i] < 8 * len)
+			data[pos[i] / 8] ^= 1 << (pos[i] % 8);
+		else
+			ecc[pos[i] / 8 - len] ^= 1 << (pos[i] % 8);
+	}
+}
+
+/* Check that @count errors are found at the positions in @pos */
+static int check_errors(struct unit_test_state *uts, uint *errloc, uint *pos,
+			int count)
+{
+	int i, j;
+
+	for (i = 0; i < count; i++) {
+		for (j = 0; j < count && errloc[j] != pos[i]; j++)
+			;
+		ut_assert(j < count);
+	}
+
+	return 0;
+}
+
+static int test_bch_code(struct unit_test_state *uts,
+			 const struct bch_test_code *code)
+{
+	uint errloc[64], pos[64];
+	struct bch_control *bch;
+	u8 *data, *ecc, *calc;
+	int count, i;
+
+	bch = init_bch(code->m, code->t, 0);
+	ut_assertnonnull(bch);
+	data = malloc(code->len);
+	ecc = calloc(1, bch->ecc_bytes);
+	calc = calloc(1, bch->ecc_bytes);
+	ut_assertnonnull(data);
+	ut_assertnonnull(ecc);
+	ut_assertnonnull(calc);
+
+	for (i = 0; i < code->len; i++)
+		data[i] = rand();
+	encode_bch(bch, data, code->len, ecc);
+	ut_asserteq(0, decode_bch(bch, data, code->len, ecc, NULL, NULL,
+				  errloc));
+
+	for (count = 1; count <= code->t; count++) {
+		flip_bits(bch, data, ecc, code->len, count, pos);
+
+		/* Errors in the data and the ecc are both found */
+		ut_asserteq(count, decode_bch(bch, data, code->len, ecc, NULL,
+					      NULL, errloc));
+		ut_assertok(check_errors(uts, errloc, pos, count));
+
+		/* Likewise when the caller has calculated the ecc */
+		memset(calc, '\0', bch->ecc_bytes);
+		encode_bch(bch, data, code->len, calc);
+		ut_asserteq(count, decode_bch(bch, NULL, code->len, ecc, calc,
+					      NULL, errloc));
+		ut_assertok(check_errors(uts, errloc, pos, count));
+
+		/* Put things right again */
+		for (i = 0; i < count; i++) {
+			if (errloc[i] < 8 * code->len)
+				data[errloc[i] / 8] ^= 1 << (errloc[i] % 8);
+			else
+				ecc[errloc[i] / 8 - code->len] ^=
+					1 << (errloc[i] % 8);
+		}
+		ut_asserteq(0, decode_bch(bch, data, code->len, ecc, NULL,
+					  NULL, errloc));
+	}
+
+	/* The ecc of the data can be XORed with the ecc read back */
+	memset(calc, '\0', bch->ecc_bytes);
+	encode_bch(bch, data, code->len, calc);
+	for (i = 0; i < bch->ecc_bytes; i++)
+		calc[i] ^= ecc[i];
+	ut_asserteq(0, decode_bch(bch, NULL, code->len, NULL, calc, NULL,
+				  errloc));
+	calc[0] ^= 0x10;
+	ut_asserteq(1, decode_bch(bch, NULL, code->len, NULL, calc, NULL,
+				  errloc));
+	ut_asserteq(8 * code->len + 4, errloc[0]);
+
+	free(calc);
+	free(ecc);
+	free(data);
+	free_bch(bch);
+
+	return 0;
+}
+
+/* Test that errors are found for each code */
+static int lib_test_bch(struct unit_test_state *uts)
+{
+	int i;
+
+	srand(0x5eed);
+	for (i = 0; i < ARRAY_SIZE(bch_test_codes); i++)
+		ut_assertok(test_bch_code(uts, &bch_test_codes[i]));
+
+	return 0;
+}
+LIB_TEST(lib_test_bch, 0);
+
+/* Time decoding of sectors without errors, and with half the errors allowed */
+static int lib_test_bch_bench(struct unit_test_state *uts)
+{
+	const struct bch_test_code *code;
+	uint errloc[64], pos[64];
+	ulong start, clean_us, bad_us;
+	struct bch_control *bch;
+	u8 *data, *ecc, *bad;
+	int i, j, n;
+
+	srand(0x5eed);
+	for (n = 0; n < ARRAY_SIZE(bch_test_codes); n++) {
+		code = &bch_test_codes[n];
+		bch = init_bch(code->m, code->t, 0);
+		ut_assertnonnull(bch);
+		data = malloc(code->len * NUM_SECTORS);
+		ecc = calloc(NUM_SECTORS, bch->ecc_bytes);
+		bad = malloc(bch->ecc_bytes * NUM_SECTORS);
+		ut_assertnonnull(data);
+		ut_assertnonnull(ecc);
+		ut_assertnonnull(bad);
+
+		for (i = 0; i < code->len * NUM_SECTORS; i++)
+			data[i] = rand();
+		for (i = 0; i < NUM_SECTORS; i++)
+			encode_bch(bch, data + i * code->len, code->len,
+				   ecc + i * bch->ecc_bytes);
+		memcpy(bad, ecc, bch->ecc_bytes * NUM_SECTORS);
+
+		start = timer_get_us();
+		for (i = 0; i < NUM_SECTORS; i++)
+			ut_asserteq(0, decode_bch(bch, data + i * code->len,
+						  code->len,
+						  ecc + i * bch->ecc_bytes,
+						  NULL, NULL, errloc));
+		clean_us = timer_get_us() - start;
+
+		for (i = 0; i < NUM_SECTORS; i++)
+			flip_bits(bch, data + i * code->len,
+				  bad + i * bch->ecc_bytes, code->len,
+				  code->t / 2, pos);
+		start = timer_get_us();
+		for (i = 0; i < NUM_SECTORS; i++) {
+			j = decode_bch(bch, data + i * code->len, code->len,
+				       bad + i * bch->ecc_bytes, NULL, NULL,
+				       errloc);
+			ut_asserteq(code->t / 2, j);
+		}
+		bad_us = timer_get_us() - start;
+
+		printf("BCH m=%d t=%d: %d x %d bytes: %lu us clean, %lu us with %d errors each\n",
+		       code->m, code->t, NUM_SECTORS, code->len, clean_us,
+		       bad_us, code->t / 2);
+
+		free(bad);
+		free(ecc);
+		free(data);
+		free_bch(bch);
+	}
+
+	return 0;
+}
+LIB_TEST(lib_test_bch_bench, 0);
@@ -0,0 +1,206 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the EFI memory map
+ */
+
+#include <common.h>
+#include <efi_loader.h>
+#include <malloc.h>
+#include <time.h>
+#include <asm/cache.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define NUM_ALLOCS	64
+#define NUM_CYCLES	10000
+#define NUM_LIVE	256
+#define NUM_POOLS	1000
+
+/**
+ * get_map() - Get a copy of the memory map and check that it is in order
+ *
+ * Entries must be in ascending order, must not overlap, and adjacent entries
+ * with the same type and attributes must have been merged.
+ *
+ * @uts: Test state
+ * @mapp: Returns the map, which the caller must free
+ * @countp: Returns the number of entries
+ */
+static int get_map(struct unit_test_state *uts, struct efi_mem_desc **mapp,
+		   int *countp)
+{
+	struct efi_mem_desc *map;
+	efi_uintn_t size = 0, desc_size;
+	int i, count;
+
+	ut_asserteq_64(EFI_BUFFER_TOO_SMALL,
+		       efi_get_memory_map(&size, NULL, NULL, &desc_size, NULL));
+	ut_asserteq(sizeof(*map), desc_size);
+	map = malloc(size);
+	ut_assertnonnull(map);
+	ut_assertok(efi_get_memory_map(&size, map, NULL, NULL, NULL));
+	count = size / sizeof(*map);
+
+	for (i = 1; i < count; i++) {
+		struct efi_mem_desc *prev = &map[i - 1];
+		u64 prev_end = prev->physical_start +
+			(prev->num_pages << EFI_PAGE_SHIFT);
+
+		ut_assert(prev_end <= map[i].physical_start);
+		ut_assert(prev_end != map[i].physical_start ||
+			  prev->type != map[i].type ||
+			  prev->attribute != map[i].attribute);
+	}
+	*mapp = map;
+	*countp = count;
+
+	return 0;
+}
+
+/* Test that allocating and freeing pages keeps the map in order */
+static int lib_test_efi_memory_map(struct unit_test_state *uts)
+{
+	struct efi_mem_desc *orig, *map;
+	u64 addr[NUM_ALLOCS], mem;
+	int orig_count, count, i;
+
+	ut_assertok(get_map(uts, &orig, &orig_count));
+
+	for (i = 0; i < NUM_ALLOCS; i++)
+		ut_assertok(efi_allocate_pages(EFI_ALLOCATE_ANY_PAGES,
+					       i & 1 ? EFI_LOADER_DATA :
+					       EFI_BOOT_SERVICES_DATA,
+					       1 + i % 3, &addr[i]));
+	ut_assertok(get_map(uts, &map, &count));
+	ut_assert(count > orig_count);
+	free(map);
+
+	/* Pages which are in use cannot be allocated again */
+	mem = addr[5];
+	ut_asserteq_64(EFI_NOT_FOUND,
+		       efi_allocate_pages(EFI_ALLOCATE_ADDRESS,
+					  EFI_BOOT_SERVICES_DATA, 1, &mem));
+
+	/* Free every other allocation, then the rest */
+	for (i = 0; i < NUM_ALLOCS; i += 2)
+		ut_assertok(efi_free_pages(addr[i], 1 + i % 3));
+	ut_assertok(get_map(uts, &map, &count));
+	free(map);
+	ut_asserteq_64(EFI_NOT_FOUND, efi_free_pages(addr[0], 1));
+
+	/* A freed range can be allocated at its address */
+	mem = addr[2];
+	ut_assertok(efi_allocate_pages(EFI_ALLOCATE_ADDRESS,
+				       EFI_BOOT_SERVICES_DATA, 3, &mem));
+	ut_assertok(efi_free_pages(mem, 3));
+
+	for (i = 1; i < NUM_ALLOCS; i += 2)
+		ut_assertok(efi_free_pages(addr[i], 1 + i % 3));
+
+	/* Everything is merged back into the original map */
+	ut_assertok(get_map(uts, &map, &count));
+	ut_asserteq(orig_count, count);
+	ut_asserteq_mem(orig, map, count * sizeof(*map));
+	free(map);
+	free(orig);
+
+	return 0;
+}
+LIB_TEST(lib_test_efi_memory_map, 0);
+
+/* Test that small pool allocations share pages and are checked on free */
+static int lib_test_efi_pool(struct unit_test_state *uts)
+{
+	struct efi_mem_desc *orig, *map;
+	int orig_count, count, i, j;
+	void **bufs;
+
+	bufs = calloc(NUM_POOLS, sizeof(*bufs));
+	ut_assertnonnull(bufs);
+	ut_assertok(get_map(uts, &orig, &orig_count));
+
+	for (i = 0; i < NUM_POOLS; i++) {
+		efi_uintn_t size = 1 + i % 300;
+
+		ut_assertok(efi_allocate_pool(i & 1 ? EFI_LOADER_DATA :
+					      EFI_BOOT_SERVICES_DATA, size,
+					      &bufs[i]));
+		ut_asserteq(0, (uintptr_t)bufs[i] % ARCH_DMA_MINALIGN);
+		memset(bufs[i], i, size);
+	}
+
+	/* Allocations share pages, so the map stays small */
+	ut_assertok(get_map(uts, &map, &count));
+	ut_assert(count < orig_count + NUM_POOLS / 10);
+	free(map);
+
+	for (i = 0; i < NUM_POOLS; i++) {
+		u8 *p = bufs[i];
+
+		for (j = 0; j < 1 + i % 300; j++)
+			ut_asserteq((u8)i, p[j]);
+	}
+
+	/* Bad and duplicate frees are caught */
+	ut_asserteq_64(EFI_INVALID_PARAMETER,
+		       efi_free_pool(bufs[1] + ARCH_DMA_MINALIGN));
+	ut_assertok(efi_free_pool(bufs[0]));
+	ut_asserteq_64(EFI_INVALID_PARAMETER, efi_free_pool(bufs[0]));
+	for (i = 2; i < NUM_POOLS; i += 2)
+		ut_assertok(efi_free_pool(bufs[i]));
+	for (i = 1; i < NUM_POOLS; i += 2)
+		ut_assertok(efi_free_pool(bufs[i]));
+
+	/* Pages are returned once they are empty */
+	ut_assertok(get_map(uts, &map, &count));
+	ut_asserteq(orig_count, count);
+	ut_asserteq_mem(orig, map, count * sizeof(*map));
+	free(map);
+	free(orig);
+	free(bufs);
+
+	return 0;
+}
+LIB_TEST(lib_test_efi_pool, 0);
+
+/* Time allocation cycles with many allocations alive at once */
+static int lib_test_efi_memory_bench(struct unit_test_state *uts)
+{
+	u64 addr[NUM_LIVE] = {}, pages[NUM_LIVE] = {};
+	struct efi_mem_desc *map;
+	ulong start, alloc_us, map_us;
+	efi_uintn_t size;
+	int i, count;
+
+	start = timer_get_us();
+	for (i = 0; i < NUM_CYCLES; i++) {
+		int slot = i % NUM_LIVE;
+
+		if (addr[slot])
+			ut_assertok(efi_free_pages(addr[slot], pages[slot]));
+		pages[slot] = 1 + i % 5;
+		ut_assertok(efi_allocate_pages(EFI_ALLOCATE_ANY_PAGES,
+					       i & 1 ? EFI_LOADER_DATA :
+					       EFI_BOOT_SERVICES_DATA,
+					       pages[slot], &addr[slot]));
+	}
+	alloc_us = timer_get_us() - start;
+
+	ut_assertok(get_map(uts, &map, &count));
+	size = count * sizeof(*map);
+	start = timer_get_us();
+	for (i = 0; i < NUM_CYCLES; i++)
+		ut_assertok(efi_get_memory_map(&size, map, NULL, NULL, NULL));
+	map_us = timer_get_us() - start;
+	free(map);
+
+	for (i = 0; i < NUM_LIVE; i++)
+		ut_assertok(efi_free_pages(addr[i], pages[i]));
+
+	printf("%d allocation cycles: %lu us, %d map entries: %lu us for %d GetMemoryMap calls\n",
+	       NUM_CYCLES, alloc_us, count, map_us, NUM_CYCLES);
+
+	return 0;
+}
+LIB_TEST(lib_test_efi_memory_bench, 0);
@@ -0,0 +1,185 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for the libfdt lookup index
+ */
+
+#include <common.h>
+#include <malloc.h>
+#include <time.h>
+#include <linux/libfdt.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+
+#define NUM_DEVS	1024
+#define FDT_SIZE	(256 << 10)
+
+/**
+ * make_index_fdt() - Create a large FDT to look things up in
+ *
+ * This has NUM_DEVS nodes under /soc, each with a few properties, roughly
+ * the size of the tree of a large SoC
+ *
+ * @uts: Test state
+ * @fdt: Place to write FDT
+ * @size: Size of space for fdt
+ */
+static int make_index_fdt(struct unit_test_state *uts, void *fdt, int size)
+{
+	char name[20];
+	int i;
+
+	ut_assertok(fdt_create(fdt, size));
+	ut_assertok(fdt_finish_reservemap(fdt));
+	ut_assertok(fdt_begin_node(fdt, ""));
+	ut_assertok(fdt_property_string(fdt, "model", "fdt index test"));
+	ut_assertok(fdt_begin_node(fdt, "soc"));
+	ut_assertok(fdt_property_u32(fdt, "#address-cells", 1));
+	for (i = 0; i < NUM_DEVS; i++) {
+		snprintf(name, sizeof(name), "dev@%x", 0x1000 * i);
+		ut_assertok(fdt_begin_node(fdt, name));
+		ut_assertok(fdt_property_string(fdt, "compatible",
+						"u-boot,fdt-index"));
+		ut_assertok(fdt_property_u32(fdt, "reg", 0x1000 * i));
+		ut_assertok(fdt_property_u32(fdt, "interrupts", i));
+		ut_assertok(fdt_property_u32(fdt, "clocks", i + 1));
+		ut_assertok(fdt_property_string(fdt, "clock-names", "bus"));
+		ut_assertok(fdt_property_string(fdt, "status", "okay"));
+		ut_assertok(fdt_begin_node(fdt, "port"));
+		ut_assertok(fdt_property_u32(fdt, "id", i));
+		ut_assertok(fdt_end_node(fdt));
+		ut_assertok(fdt_end_node(fdt));
+	}
+	ut_assertok(fdt_end_node(fdt));
+	ut_assertok(fdt_begin_node(fdt, "chosen"));
+	ut_assertok(fdt_end_node(fdt));
+	ut_assertok(fdt_end_node(fdt));
+	ut_assertok(fdt_finish(fdt));
+	ut_assertok(fdt_open_into(fdt, fdt, size));
+
+	return 0;
+}
+
+/* Look up a device and one of its properties, returning the value */
+static int lookup_dev(const void *fdt, int i, const char *prop)
+{
+	char path[30];
+	const fdt32_t *val;
+	int node, len;
+
+	snprintf(path, sizeof(path), "/soc/dev@%x", 0x1000 * i);
+	node = fdt_path_offset(fdt, path);
+	if (node < 0)
+		return node;
+	if (fdt_subnode_offset(fdt, node, "port") < 0)
+		return -1;
+	val = fdt_getprop(fdt, node, prop, &len);
+	if (!val)
+		return len;
+
+	return len == sizeof(*val) ? fdt32_to_cpu(*val) : -1;
+}
+
+/* Test that lookups give the same results with and without the index */
+static int lib_test_fdt_index(struct unit_test_state *uts)
+{
+	int node, soc, len, i;
+	void *fdt;
+
+	fdt = malloc(FDT_SIZE);
+	ut_assertnonnull(fdt);
+	ut_assertok(make_index_fdt(uts, fdt, FDT_SIZE));
+
+	ut_assertok(fdt_index_attach(fdt));
+	for (i = 0; i < NUM_DEVS; i++) {
+		ut_asserteq(0x1000 * i, lookup_dev(fdt, i, "reg"));
+		ut_asserteq(i + 1, lookup_dev(fdt, i, "clocks"));
+		ut_asserteq(-FDT_ERR_NOTFOUND, lookup_dev(fdt, i, "missing"));
+	}
+	ut_asserteq(-FDT_ERR_NOTFOUND, fdt_path_offset(fdt, "/soc/dev@1"));
+	ut_asserteq(-FDT_ERR_NOTFOUND, fdt_path_offset(fdt, "/dev@0"));
+
+	/* The unit address may be left out, giving the first match */
+	soc = fdt_path_offset(fdt, "/soc");
+	ut_assert(soc > 0);
+	ut_asserteq(fdt_first_subnode(fdt, soc),
+		    fdt_path_offset(fdt, "/soc/dev"));
+	ut_asserteq_str("okay", fdt_getprop(fdt, fdt_path_offset(fdt,
+					    "/soc/dev"), "status", NULL));
+
+	/* Offsets which are not nodes are still reported by libfdt */
+	ut_asserteq(-FDT_ERR_BADOFFSET, fdt_subnode_offset(fdt, soc + 4,
+							   "dev"));
+	ut_assertnull(fdt_getprop(fdt, soc + 4, "reg", &len));
+	ut_asserteq(-FDT_ERR_BADOFFSET, len);
+
+	/* Changes move things around, so lookups must still find them */
+	node = fdt_path_offset(fdt, "/chosen");
+	ut_assertok(fdt_setprop_string(fdt, node, "bootargs", "console=ttyS0"));
+	node = fdt_path_offset(fdt, "/soc/dev@3000");
+	ut_assertok(fdt_setprop_u32(fdt, node, "added", 42));
+	ut_assertok(fdt_del_node(fdt, fdt_path_offset(fdt, "/soc/dev@2000")));
+	ut_asserteq(42, lookup_dev(fdt, 3, "added"));
+
+	/* Index the changed tree again */
+	ut_assertok(fdt_index_attach(fdt));
+	ut_asserteq(42, lookup_dev(fdt, 3, "added"));
+	ut_asserteq(-FDT_ERR_NOTFOUND, lookup_dev(fdt, 2, "reg"));
+
+	/* A rename which keeps the same length does not move anything */
+	node = fdt_path_offset(fdt, "/soc/dev@4000");
+	ut_assertok(fdt_set_name(fdt, node, "dev@4001"));
+	for (i = 0; i < 64; i++) {
+		ut_asserteq(node, fdt_path_offset(fdt, "/soc/dev@4001"));
+		ut_asserteq(-FDT_ERR_NOTFOUND,
+			    fdt_path_offset(fdt, "/soc/dev@4000"));
+		ut_asserteq(42, lookup_dev(fdt, 3, "added"));
+		ut_asserteq(-FDT_ERR_NOTFOUND, lookup_dev(fdt, 2, "reg"));
+		ut_asserteq(0x1000 * 40, lookup_dev(fdt, 40, "reg"));
+		ut_asserteq_str("console=ttyS0",
+				fdt_getprop(fdt, fdt_path_offset(fdt, "/chosen"),
+					    "bootargs", NULL));
+	}
+	fdt_index_detach(fdt);
+
+	/* Same answers from libfdt alone */
+	ut_asserteq(node, fdt_path_offset(fdt, "/soc/dev@4001"));
+	ut_asserteq(42, lookup_dev(fdt, 3, "added"));
+	ut_asserteq(-FDT_ERR_NOTFOUND, lookup_dev(fdt, 2, "reg"));
+	ut_asserteq(0x1000 * 40, lookup_dev(fdt, 40, "reg"));
+	free(fdt);
+
+	return 0;
+}
+LIB_TEST(lib_test_fdt_index, 0);
+
+/* Compare the time taken by lookups with and without the index */
+static int lib_test_fdt_index_bench(struct unit_test_state *uts)
+{
+	ulong start, scan_us, index_us;
+	void *fdt;
+	int i;
+
+	fdt = malloc(FDT_SIZE);
+	ut_assertnonnull(fdt);
+	ut_assertok(make_index_fdt(uts, fdt, FDT_SIZE));
+
+	start = timer_get_us();
+	for (i = 0; i < NUM_DEVS; i++)
+		ut_asserteq(i, lookup_dev(fdt, i, "interrupts"));
+	scan_us = timer_get_us() - start;
+
+	start = timer_get_us();
+	ut_assertok(fdt_index_attach(fdt));
+	for (i = 0; i < NUM_DEVS; i++)
+		ut_asserteq(i, lookup_dev(fdt, i, "interrupts"));
+	index_us = timer_get_us() - start;
+	fdt_index_detach(fdt);
+
+	printf("%d lookups in %d-byte tree: scan %lu us, index %lu us\n",
+	       NUM_DEVS, fdt_size_dt_struct(fdt), scan_us, index_us);
+	free(fdt);
+
+	return 0;
+}
+LIB_TEST(lib_test_fdt_index_bench, 0);
@@ -0,0 +1,90 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Tests for RELR relocation tables
+ */
+
+#include <common.h>
+#include <rand.h>
+#include <test/lib.h>
+#include <test/test.h>
+#include <test/ut.h>
+#include <u-boot/relr.h>
+
+/* Link address used for the test image */
+#define LINK_BASE	0x10000
+#define RELOC_OFF	0x123450
+
+#define NUM_WORDS	1024
+
+/* Test encoding a few relocations */
+static int lib_test_relr_encode(struct unit_test_state *uts)
+{
+	const uint64_t addr[] = {
+		0x1000, 0x1008, 0x1018,		/* address, then a bitmap */
+		0x1008 + 62 * 8,		/* last word in the bitmap */
+		0x1008 + 63 * 8,		/* first word in the next one */
+		0x2000,				/* too far away */
+	};
+	const uint64_t expect[] = {
+		0x1000, 0x8000000000000000 | 0xb, 0x3, 0x2000,
+	};
+	const uint64_t bad[] = { 0x1000, 0x1000 };
+	const uint64_t unaligned[] = { 0x1004 };
+	uint64_t relr[ARRAY_SIZE(addr)];
+
+	ut_asserteq(ARRAY_SIZE(expect),
+		    relr_encode(addr, ARRAY_SIZE(addr), relr));
+	ut_asserteq_mem(expect, relr, sizeof(expect));
+
+	ut_asserteq(-EINVAL, relr_encode(bad, ARRAY_SIZE(bad), relr));
+	ut_asserteq(-EINVAL, relr_encode(unaligned, 1, relr));
+	ut_asserteq(0, relr_encode(addr, 0, relr));
+
+	return 0;
+}
+LIB_TEST(lib_test_relr_encode, 0);
+
+/* Test that applying an encoded table updates just the listed words */
+static int lib_test_relr_apply(struct unit_test_state *uts)
+{
+	uint64_t *buf, *addr, *relr;
+	int i, count, n;
+	bool *listed;
+
+	buf = calloc(NUM_WORDS, sizeof(*buf));
+	addr = calloc(NUM_WORDS, sizeof(*addr));
+	relr = calloc(NUM_WORDS, sizeof(*relr));
+	listed = calloc(NUM_WORDS, sizeof(*listed));
+	ut_assertnonnull(buf);
+	ut_assertnonnull(addr);
+	ut_assertnonnull(relr);
+	ut_assertnonnull(listed);
+
+	/* Mix dense runs, as in a table of pointers, with scattered words */
+	srand(0x4e1a);
+	for (i = 0, count = 0; i < NUM_WORDS; i++) {
+		buf[i] = LINK_BASE + i;
+		if (i % 256 < 96 ? rand() % 8 : !(rand() % 40)) {
+			listed[i] = true;
+			addr[count++] = LINK_BASE + i * sizeof(*buf);
+		}
+	}
+
+	n = relr_encode(addr, count, relr);
+	ut_assert(n > 0);
+	ut_assert(n < count / 4);
+	ut_asserteq(count, relr_apply(relr, n, (ulong)buf - LINK_BASE,
+				      RELOC_OFF));
+
+	for (i = 0; i < NUM_WORDS; i++)
+		ut_asserteq(LINK_BASE + i + (listed[i] ? RELOC_OFF : 0),
+			    buf[i]);
+
+	free(listed);
+	free(relr);
+	free(addr);
+	free(buf);
+
+	return 0;
+}
+LIB_TEST(lib_test_relr_apply, 0);
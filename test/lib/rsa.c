@@ -9,10 +9,13 @@
 #include <common.h>
 #include <command.h>
 #include <image.h>
+#include <time.h>
 #include <test/lib.h>
 #include <test/test.h>
 #include <test/ut.h>
+#include <u-boot/rsa-mod-exp.h>
 #include <u-boot/rsa.h>
+#include <u-boot/sha256.h>
 
 #ifdef CONFIG_RSA_VERIFY_WITH_PKEY
 /*
@@ -203,4 +206,291 @@ static int lib_rsa_verify_invalid(struct unit_test_state *uts)
 }
 
 LIB_TEST(lib_rsa_verify_invalid, 0);
+
+#ifdef CONFIG_RSA_SOFTWARE_EXP
+/*
+ * openssl genrsa -out private.pem 3072
+ * openssl rsa -in private.pem -RSAPublicKey_out -outform der -out public.der
+ */
+static unsigned char public_key_3072[] = {
+	0x30, 0x82, 0x01, 0x8a, 0x02, 0x82, 0x01, 0x81, 0x00, 0x90, 0x23, 0x29,
+	0x28, 0x89, 0x5d, 0xf4, 0x33, 0x3f, 0x75, 0x02, 0x17, 0x70, 0x7c, 0xab,
+	0x09, 0xf6, 0x9b, 0xe5, 0x1f, 0xd1, 0x79, 0x69, 0x66, 0xc3, 0x25, 0xd8,
+	0x75, 0xae, 0xf6, 0x3d, 0xbe, 0x54, 0xe2, 0x7b, 0xd0, 0xb2, 0xde, 0x85,
+	0x0d, 0x77, 0x80, 0xb9, 0xb7, 0xe6, 0xdc, 0xaf, 0xb7, 0x98, 0x9f, 0xe4,
+	0x8e, 0x33, 0x78, 0x33, 0xa5, 0x61, 0xdc, 0x2a, 0x35, 0xa5, 0xbb, 0x3b,
+	0x3c, 0x8a, 0xb9, 0x9c, 0xbf, 0xe3, 0x86, 0x31, 0x96, 0x22, 0x6d, 0xbb,
+	0x18, 0x40, 0x4e, 0x79, 0x93, 0xd7, 0x90, 0x4e, 0x40, 0xa1, 0xbf, 0xef,
+	0xba, 0x72, 0xa0, 0x32, 0xae, 0x57, 0x4e, 0x11, 0xc4, 0x01, 0x7e, 0x3a,
+	0x5f, 0x7a, 0x08, 0x38, 0xfd, 0x83, 0x5e, 0x16, 0x71, 0x95, 0x7f, 0x91,
+	0x92, 0x5a, 0x2b, 0xde, 0x62, 0x29, 0x6f, 0x58, 0x77, 0x5b, 0xca, 0x95,
+	0x57, 0x9f, 0xa5, 0xc9, 0x69, 0x65, 0x79, 0x5a, 0xe2, 0xf5, 0x10, 0xfb,
+	0x68, 0x96, 0xf5, 0x50, 0xe7, 0x52, 0x00, 0x52, 0x66, 0x7d, 0xc0, 0x3f,
+	0xbf, 0x87, 0xf0, 0x87, 0x55, 0xbc, 0x26, 0x08, 0x69, 0xea, 0x91, 0x74,
+	0xb5, 0x59, 0xb1, 0x86, 0x9f, 0xd5, 0x47, 0x18, 0xaa, 0x45, 0x85, 0x3f,
+	0x63, 0x34, 0xd9, 0xfe, 0x3c, 0x8a, 0x7e, 0x50, 0xdc, 0x70, 0xa7, 0xfd,
+	0xd7, 0xf9, 0x45, 0x38, 0x76, 0x3c, 0xfb, 0x93, 0x9f, 0xf2, 0xf3, 0xab,
+	0xec, 0xb4, 0x4b, 0xf9, 0x2d, 0xf9, 0xa7, 0xa8, 0x4d, 0xcd, 0xf7, 0x86,
+	0xed, 0x55, 0xf8, 0x98, 0xb4, 0x24, 0xf5, 0x08, 0x6b, 0x61, 0xee, 0xa1,
+	0x82, 0xb5, 0x2c, 0x77, 0xed, 0x67, 0x34, 0x7e, 0x4a, 0x37, 0x01, 0x13,
+	0x7c, 0xc0, 0xa7, 0x22, 0x28, 0x26, 0x6f, 0xf3, 0x01, 0x6e, 0xbe, 0xf3,
+	0x12, 0x01, 0x8d, 0xf6, 0xaa, 0x47, 0x99, 0x34, 0x13, 0xd5, 0x8e, 0x8f,
+	0x86, 0x76, 0xec, 0xcc, 0x89, 0xe6, 0x9b, 0x8f, 0x18, 0xd4, 0x76, 0x09,
+	0xdc, 0xf0, 0x4c, 0x76, 0x89, 0x98, 0x66, 0x73, 0xb3, 0xc4, 0xed, 0xe5,
+	0x60, 0x0a, 0x09, 0x85, 0x65, 0x2e, 0xd9, 0x72, 0xf4, 0xc0, 0x0b, 0x09,
+	0x39, 0x81, 0x1c, 0x94, 0x86, 0xa8, 0x1d, 0x67, 0x9e, 0x76, 0x55, 0x45,
+	0xed, 0xd4, 0x3a, 0xf2, 0x34, 0xec, 0xc6, 0xce, 0xd7, 0xad, 0xf0, 0x2a,
+	0xca, 0xcf, 0xd3, 0x82, 0x65, 0x36, 0x1a, 0xfa, 0x50, 0x05, 0xf5, 0x8f,
+	0xb2, 0xb6, 0x5f, 0x0a, 0x22, 0x82, 0x7a, 0x4b, 0xa0, 0x53, 0x7b, 0x2a,
+	0x38, 0x81, 0xca, 0xe4, 0xea, 0x2b, 0xec, 0xeb, 0x82, 0xba, 0x9b, 0x60,
+	0x1b, 0x57, 0x6d, 0x59, 0xb8, 0xb2, 0xb9, 0x98, 0x31, 0x17, 0xcd, 0x5b,
+	0x1f, 0x25, 0xe4, 0x53, 0xf1, 0x78, 0x48, 0xa3, 0x84, 0x7e, 0x2e, 0x0d,
+	0xde, 0xd7, 0x24, 0x6b, 0xfc, 0x79, 0x09, 0x43, 0x99, 0x02, 0x03, 0x01,
+	0x00, 0x01
+};
+
+/*
+ * openssl dgst -sha256 -sign private.pem -out data.enc data.raw
+ */
+static unsigned char data_enc_3072[] = {
+	0x79, 0xd2, 0x03, 0x2a, 0xee, 0x39, 0x28, 0xd9, 0x4e, 0xff, 0x9e, 0x47,
+	0x26, 0xf5, 0x06, 0xa6, 0xee, 0xdd, 0x6c, 0xaf, 0x32, 0xa1, 0x1c, 0x37,
+	0xb7, 0xff, 0xc1, 0xa8, 0xf9, 0x6f, 0xae, 0xf6, 0xc6, 0xb9, 0xd5, 0x9b,
+	0xfe, 0xe1, 0x0e, 0x35, 0x9c, 0xea, 0xc9, 0x41, 0x62, 0x24, 0x11, 0x56,
+	0xd6, 0x1d, 0x39, 0xdc, 0x1f, 0x7e, 0xf8, 0x03, 0xfb, 0x02, 0x5e, 0xc1,
+	0x0c, 0x84, 0xce, 0xcb, 0x7f, 0xbf, 0x08, 0x29, 0x3d, 0x73, 0x30, 0x0b,
+	0x9e, 0xe6, 0xaa, 0xf1, 0xb7, 0x9a, 0x0b, 0xb4, 0xe7, 0x3b, 0x79, 0x72,
+	0x2d, 0x94, 0x3a, 0x91, 0x48, 0xa9, 0x57, 0xd7, 0x35, 0x90, 0xe0, 0xa8,
+	0x7c, 0xcf, 0x09, 0x87, 0x6e, 0x53, 0x0e, 0x74, 0xa0, 0x3f, 0x1d, 0x27,
+	0x64, 0x6a, 0xa6, 0xcc, 0xe3, 0xa6, 0x02, 0xa1, 0xd4, 0x4d, 0x4b, 0x55,
+	0x7b, 0xbf, 0x00, 0x30, 0x1e, 0x18, 0xbc, 0x26, 0x07, 0xb2, 0xa9, 0x64,
+	0x60, 0x31, 0xf9, 0xc0, 0x57, 0x4b, 0x27, 0x13, 0x90, 0x78, 0xf8, 0xf7,
+	0x87, 0x5b, 0x10, 0x36, 0xe7, 0xb4, 0x6d, 0xe1, 0x6f, 0xea, 0x32, 0x6a,
+	0xc1, 0xa6, 0xf9, 0x1a, 0x05, 0x15, 0xec, 0x5e, 0x5e, 0xc9, 0x6a, 0xd5,
+	0x02, 0x1f, 0x12, 0x6e, 0xab, 0x07, 0x60, 0xec, 0xab, 0x95, 0xb0, 0x8a,
+	0x90, 0x77, 0xd7, 0x6c, 0x9f, 0xc3, 0x32, 0x46, 0x8d, 0x91, 0x2f, 0x28,
+	0x08, 0xbd, 0xfd, 0x19, 0xad, 0xc9, 0x81, 0x3f, 0x2b, 0xb8, 0xe6, 0x4a,
+	0xd6, 0xac, 0x1d, 0xfe, 0xb1, 0xfd, 0xaa, 0xeb, 0xa7, 0xde, 0x63, 0xe9,
+	0x1b, 0x25, 0x66, 0x21, 0x01, 0x5b, 0x67, 0xb3, 0x40, 0x15, 0x1c, 0xce,
+	0xf1, 0xef, 0xff, 0x9f, 0x9b, 0xd6, 0x82, 0xe6, 0x41, 0xd1, 0x9b, 0x8e,
+	0xbe, 0x7c, 0x6d, 0xac, 0xb1, 0x46, 0xfe, 0x43, 0x75, 0x32, 0xa7, 0x7e,
+	0x5d, 0x19, 0x46, 0xbf, 0xc2, 0xbd, 0xdd, 0x42, 0x19, 0x95, 0x9c, 0x0a,
+	0xe0, 0x68, 0x76, 0x8a, 0xe8, 0x43, 0xf3, 0x11, 0xc3, 0x29, 0xe2, 0x6b,
+	0xd5, 0xfb, 0x48, 0xe0, 0xe9, 0x2f, 0x65, 0xb0, 0x78, 0x5d, 0xd5, 0xd2,
+	0x99, 0xf3, 0x27, 0x5b, 0xcd, 0xc8, 0xb5, 0x01, 0xbb, 0xd0, 0x4b, 0x84,
+	0x38, 0x54, 0x09, 0xea, 0xfa, 0xc8, 0x52, 0xc7, 0x84, 0x05, 0xed, 0xa7,
+	0x6f, 0x8a, 0xec, 0x2d, 0xfd, 0x49, 0x00, 0xbe, 0xf7, 0xc0, 0xcc, 0xc9,
+	0x37, 0xd1, 0xbc, 0x8f, 0x59, 0xb8, 0x9b, 0x70, 0x90, 0xda, 0xe4, 0x2f,
+	0x4c, 0x9f, 0x2f, 0x08, 0x2b, 0x4e, 0x7a, 0x3f, 0xb4, 0x9f, 0x73, 0xd7,
+	0x6f, 0x01, 0x56, 0x62, 0x57, 0x57, 0x07, 0x98, 0xa1, 0x02, 0x19, 0x29,
+	0x46, 0xb0, 0x00, 0x8e, 0x95, 0x8b, 0x13, 0x70, 0x7c, 0x9b, 0x90, 0x45,
+	0x6a, 0x3b, 0xec, 0x87, 0xb6, 0x9f, 0xe6, 0x00, 0x2b, 0x27, 0xdb, 0x8c
+};
+
+/*
+ * openssl genrsa -out private.pem 4096
+ * openssl rsa -in private.pem -RSAPublicKey_out -outform der -out public.der
+ */
+static unsigned char public_key_4096[] = {
+	0x30, 0x82, 0x02, 0x0a, 0x02, 0x82, 0x02, 0x01, 0x00, 0xac, 0xc5, 0x5e,
+	0x44, 0x2d, 0xae, 0x27, 0xaf, 0x8c, 0x2f, 0x5f, 0x76, 0xe2, 0x45, 0xfa,
+	0x5e, 0x57, 0xa8, 0x5b, 0xc6, 0xd3, 0x5d, 0x9e, 0x78, 0x14, 0x7e, 0x76,
+	0xe1, 0xc5, 0xda, 0xda, 0xa7, 0xce, 0xd8, 0x40, 0xb6, 0x28, 0x7a, 0x5a,
+	0x62, 0x4c, 0xbd, 0x7d, 0xe6, 0x84, 0x99, 0xee, 0xe1, 0xc3, 0x7f, 0xfb,
+	0x8f, 0x77, 0x1e, 0x58, 0x44, 0xc9, 0x93, 0xa0, 0x82, 0x7e, 0x4c, 0xe7,
+	0x71, 0x9c, 0x93, 0x66, 0xd4, 0x82, 0x27, 0x6c, 0xe3, 0xa1, 0x0f, 0x4f,
+	0xae, 0xab, 0x0f, 0x14, 0xe2, 0x19, 0x0b, 0xda, 0x79, 0x1d, 0x66, 0x21,
+	0xe3, 0xcf, 0x86, 0x07, 0x7d, 0x01, 0x77, 0x17, 0x43, 0x1f, 0x40, 0x3e,
+	0x93, 0x63, 0xb5, 0xd4, 0xe7, 0xd5, 0xa3, 0x44, 0x34, 0xc1, 0x17, 0x7d,
+	0xe1, 0x29, 0xb5, 0xcc, 0x78, 0xa4, 0xe1, 0xcc, 0x57, 0x4f, 0xf4, 0x20,
+	0xd4, 0xf3, 0x6b, 0xfe, 0xfd, 0x06, 0x02, 0x00, 0x2c, 0xaf, 0x4c, 0x9a,
+	0xfe, 0x6c, 0x9c, 0xc7, 0x1f, 0x72, 0xb6, 0x33, 0x28, 0xdf, 0xc0, 0x5f,
+	0x72, 0x3b, 0x91, 0x0f, 0xcd, 0xd3, 0x20, 0x0d, 0x4c, 0x27, 0x8c, 0x4b,
+	0xf7, 0x22, 0xa2, 0x19, 0x8d, 0xb0, 0xe2, 0x68, 0xc4, 0x0a, 0x0a, 0xba,
+	0x4f, 0xbd, 0xf3, 0x25, 0x7d, 0x41, 0x42, 0x1c, 0xdd, 0x97, 0x17, 0xc4,
+	0xd6, 0xa9, 0x38, 0x1b, 0x90, 0xeb, 0xfb, 0x4e, 0xe7, 0x5d, 0xde, 0x6d,
+	0x81, 0x14, 0x51, 0x06, 0xf9, 0x08, 0x16, 0xe9, 0xc0, 0x00, 0xcd, 0xe6,
+	0x7f, 0xe6, 0x1c, 0xe4, 0x6b, 0x38, 0xed, 0x58, 0x1d, 0xa5, 0xe5, 0xc8,
+	0x6d, 0x89, 0x7f, 0x9a, 0x4a, 0x40, 0xd9, 0xa4, 0xba, 0xfa, 0x20, 0x3d,
+	0x31, 0x8c, 0xe1, 0x61, 0x50, 0x80, 0xe9, 0xd6, 0x90, 0x05, 0xed, 0x23,
+	0x62, 0xbe, 0xeb, 0x36, 0x4a, 0x1e, 0xf7, 0x2e, 0xaf, 0xa9, 0x8c, 0xfb,
+	0x18, 0x4e, 0xc1, 0xd6, 0x2f, 0x4c, 0x67, 0x3b, 0xec, 0x44, 0x51, 0x1b,
+	0xbd, 0xfe, 0x9f, 0xc3, 0x30, 0x83, 0x53, 0xd9, 0x92, 0x62, 0x5c, 0x6c,
+	0x7e, 0x4d, 0xb2, 0x75, 0xb5, 0x50, 0x78, 0x36, 0xc8, 0xf7, 0xcb, 0x16,
+	0x0f, 0xbb, 0x78, 0x1d, 0x78, 0xfa, 0x03, 0xe2, 0xa4, 0x60, 0x95, 0x47,
+	0x63, 0x44, 0x46, 0x7c, 0x89, 0xbc, 0xd8, 0xa1, 0xdd, 0x18, 0x2c, 0xa0,
+	0x90, 0xc7, 0xf5, 0xc4, 0x3b, 0xfc, 0xc3, 0x6d, 0x55, 0xa7, 0xf0, 0x69,
+	0x6c, 0xb0, 0x84, 0xa5, 0x3e, 0x21, 0xef, 0xb7, 0x37, 0x8c, 0x0d, 0x2b,
+	0x28, 0x20, 0xd4, 0x6f, 0x18, 0xbd, 0xab, 0x27, 0x4b, 0x04, 0x77, 0x33,
+	0x08, 0x7b, 0x0a, 0xc2, 0xd1, 0x71, 0x23, 0xfb, 0x19, 0x8e, 0xd3, 0xb3,
+	0xc9, 0x30, 0x98, 0x5f, 0x69, 0x43, 0xe2, 0x2d, 0x24, 0xe7, 0xf3, 0xa0,
+	0x05, 0xd9, 0xe9, 0x77, 0x51, 0x93, 0x6d, 0xd7, 0xcd, 0xe2, 0x8c, 0x7d,
+	0x14, 0xfe, 0xa4, 0xf5, 0xed, 0x44, 0xf1, 0xe8, 0xb0, 0x00, 0x58, 0x23,
+	0x82, 0xcf, 0xee, 0x51, 0xae, 0x25, 0xc2, 0x5f, 0x9e, 0x03, 0x26, 0x4d,
+	0x30, 0x60, 0xe1, 0xed, 0xc4, 0x55, 0xf6, 0xb7, 0xa7, 0xbf, 0x8d, 0xfc,
+	0xc5, 0x54, 0xc0, 0x73, 0x87, 0x44, 0x5d, 0x42, 0x56, 0xe6, 0xfe, 0xe1,
+	0x89, 0xe2, 0x72, 0x37, 0xc9, 0x75, 0x8c, 0x32, 0xfe, 0xdc, 0x85, 0xb2,
+	0xb0, 0x7f, 0x9f, 0x87, 0x24, 0x9c, 0xdc, 0xe6, 0x95, 0xa9, 0xcc, 0xca,
+	0x40, 0x34, 0x59, 0x17, 0x0a, 0x29, 0x44, 0xfc, 0xa7, 0xa6, 0xd3, 0x97,
+	0x8e, 0xcf, 0xa4, 0xf5, 0x81, 0x14, 0xe1, 0x33, 0x85, 0x90, 0xa0, 0xbd,
+	0xbb, 0x15, 0x28, 0x5c, 0x33, 0x98, 0xe1, 0x35, 0x8e, 0x1b, 0x13, 0x10,
+	0x18, 0x50, 0x99, 0x04, 0xd4, 0xca, 0xbe, 0x40, 0x97, 0x1c, 0xcb, 0x2b,
+	0xb8, 0x30, 0xec, 0xc6, 0xc1, 0x02, 0x03, 0x01, 0x00, 0x01
+};
+
+/*
+ * openssl dgst -sha256 -sign private.pem -out data.enc data.raw
+ */
+static unsigned char data_enc_4096[] = {
+	0x4c, 0xae, 0x0f, 0xf2, 0x2d, 0xf0, 0xae, 0x1f, 0x3e, 0xa6, 0x00, 0xe3,
+	0xf8, 0x19, 0x9c, 0xb6, 0x26, 0x08, 0x6a, 0x6e, 0xb5, 0xaf, 0x29, 0x6b,
+	0xa0, 0x4e, 0xa8, 0x99, 0xa5, 0xb7, 0xfa, 0xac, 0x84, 0xe5, 0x31, 0x27,
+	0xba, 0xaf, 0x28, 0x7f, 0x18, 0xc7, 0x19, 0xab, 0xaa, 0x79, 0x7e, 0xb5,
+	0x26, 0xb6, 0x21, 0x86, 0x15, 0xa6, 0xb3, 0xc8, 0x2d, 0xf4, 0xc9, 0x4b,
+	0x8c, 0x47, 0xbe, 0x76, 0x7e, 0x98, 0x7f, 0xba, 0xfd, 0xcc, 0x57, 0x19,
+	0xb1, 0x65, 0xf2, 0xea, 0x79, 0xb9, 0x2d, 0x93, 0x28, 0xf5, 0x4e, 0x32,
+	0x39, 0xc8, 0x80, 0x20, 0xf9, 0xe5, 0x28, 0xa0, 0x68, 0x7b, 0x78, 0x5e,
+	0xa4, 0x3b, 0x5b, 0x58, 0x6c, 0xbe, 0x34, 0x14, 0x16, 0x8c, 0x80, 0x19,
+	0x40, 0xf4, 0xc9, 0x88, 0x02, 0x48, 0x1e, 0x1a, 0x8b, 0x82, 0x57, 0xdc,
+	0x55, 0x95, 0xd5, 0x4e, 0x43, 0x01, 0x18, 0x97, 0x1b, 0xb6, 0x7b, 0x9b,
+	0x93, 0xb4, 0xe9, 0x1b, 0x5c, 0x18, 0xc1, 0x20, 0xda, 0x13, 0xba, 0x40,
+	0xaf, 0x9e, 0x7c, 0x8b, 0x81, 0x0d, 0x38, 0x22, 0x3c, 0x4a, 0x6d, 0x64,
+	0xe3, 0xe4, 0xd9, 0xcf, 0x22, 0x95, 0x56, 0xe5, 0x1e, 0xde, 0x30, 0x7d,
+	0x57, 0x54, 0xa6, 0xdb, 0x1e, 0x0d, 0xda, 0x8c, 0xc4, 0x0c, 0x77, 0xa7,
+	0x9e, 0x2b, 0xf9, 0xd2, 0x65, 0x25, 0xea, 0xc6, 0xc5, 0x87, 0xe2, 0x18,
+	0x7d, 0x8c, 0xee, 0xc8, 0x5d, 0x2e, 0x2d, 0x4b, 0x9b, 0x2a, 0x50, 0x31,
+	0x81, 0x0b, 0xa8, 0x33, 0x0e, 0x68, 0xe0, 0x3b, 0x78, 0xae, 0xa6, 0x87,
+	0x4c, 0x92, 0xab, 0x7e, 0x0a, 0x82, 0xe6, 0x76, 0x89, 0xf6, 0xe5, 0xd9,
+	0x5c, 0x6e, 0xca, 0xbc, 0x39, 0x4c, 0xc3, 0x41, 0x05, 0x89, 0x37, 0x5f,
+	0x79, 0xa6, 0x96, 0x25, 0x46, 0xb2, 0xc2, 0xa8, 0x47, 0xb1, 0xf1, 0xbe,
+	0x1b, 0xa3, 0x1f, 0xbd, 0x82, 0x3b, 0x65, 0x1b, 0x80, 0x4e, 0x9a, 0x48,
+	0x6a, 0x6e, 0xf9, 0x3b, 0xf4, 0x42, 0x5f, 0x65, 0xca, 0xd0, 0x84, 0xe2,
+	0xe5, 0x7a, 0x35, 0x02, 0xc3, 0x15, 0x32, 0x1b, 0x43, 0x78, 0xb4, 0x9d,
+	0xa9, 0x1e, 0x23, 0xa2, 0xc2, 0xb6, 0x37, 0x5b, 0x40, 0xcd, 0xd7, 0x54,
+	0x2c, 0x62, 0x83, 0xa2, 0x6d, 0x89, 0x58, 0xd3, 0x4f, 0x2a, 0xef, 0xb2,
+	0xf9, 0xab, 0x26, 0x57, 0x4b, 0x70, 0x77, 0x8d, 0x4d, 0x7f, 0x91, 0xa7,
+	0x8a, 0x83, 0x0d, 0x29, 0x69, 0xeb, 0x6d, 0xf2, 0xe7, 0xa2, 0xb7, 0xd2,
+	0xa3, 0x38, 0x07, 0xb4, 0xdc, 0xfd, 0x78, 0xf7, 0xd0, 0xd1, 0x33, 0xd9,
+	0xd1, 0xf4, 0x86, 0xeb, 0xf1, 0x98, 0xa4, 0x14, 0xf0, 0x2c, 0x33, 0x1f,
+	0x44, 0x2a, 0x27, 0xaf, 0x99, 0x88, 0x09, 0xa0, 0x5d, 0x34, 0x67, 0x15,
+	0xa6, 0xa4, 0x13, 0x8b, 0xb4, 0xbd, 0x87, 0x8d, 0x53, 0xc0, 0xcb, 0xac,
+	0x2e, 0xb1, 0x0d, 0xd6, 0x21, 0x18, 0x1c, 0x48, 0xd4, 0x44, 0xef, 0x75,
+	0x2b, 0xb4, 0xd2, 0x3d, 0x7d, 0x84, 0xe3, 0x86, 0xff, 0x53, 0xbb, 0x5a,
+	0x69, 0x76, 0x54, 0x36, 0x88, 0xe1, 0xb6, 0xbc, 0x39, 0x75, 0x06, 0x6d,
+	0x4a, 0x36, 0x66, 0x8e, 0xa3, 0xc5, 0xd9, 0x84, 0x6c, 0xab, 0x8e, 0xc5,
+	0xe0, 0x3b, 0xf5, 0xd9, 0xfb, 0xd4, 0x44, 0xa2, 0x34, 0xd8, 0xc2, 0x0d,
+	0x3d, 0xdf, 0x69, 0xb7, 0x93, 0x8f, 0xa9, 0xf8, 0x91, 0xa0, 0x37, 0x08,
+	0x0d, 0xb9, 0xee, 0xac, 0xb2, 0xcc, 0xfa, 0x7d, 0x06, 0xfd, 0xef, 0x78,
+	0x25, 0xb8, 0x6c, 0xe4, 0x11, 0xe7, 0xfe, 0xe3, 0xc2, 0xb0, 0xbe, 0x1c,
+	0x0f, 0xc6, 0xfc, 0x97, 0x23, 0x31, 0x9b, 0x62, 0x32, 0x93, 0x78, 0x56,
+	0xa0, 0x24, 0xa6, 0x64, 0xdb, 0x15, 0x6f, 0xa8, 0x0b, 0x90, 0xf1, 0x2b,
+	0xad, 0x4b, 0xbe, 0xb3, 0x7a, 0x13, 0xe0, 0x0e
+};
+
+#define NUM_VERIFY	100
+
+/**
+ * struct rsa_test_key - RSA public key with a signature of data_raw
+ *
+ * @key:	Public key in DER format
+ * @key_len:	Length of @key in bytes
+ * @sig:	SHA256 PKCS#1 v1.5 signature of data_raw
+ */
+struct rsa_test_key {
+	const unsigned char *key;
+	int key_len;
+	const unsigned char *sig;
+};
+
+static const struct rsa_test_key rsa_test_keys[] = {
+	{ public_key, sizeof(public_key), data_enc },
+	{ public_key_3072, sizeof(public_key_3072), data_enc_3072 },
+	{ public_key_4096, sizeof(public_key_4096), data_enc_4096 },
+};
+
+/* Decrypt @sig and check whether it holds @hash */
+static bool sig_matches(struct key_prop *prop, const unsigned char *sig,
+			const u8 *hash)
+{
+	int len = prop->num_bits / 8;
+	u8 out[RSA_MAX_KEY_BITS / 8];
+
+	if (rsa_mod_exp_sw(sig, len, prop, out))
+		return false;
+
+	return !out[0] && out[1] == 1 &&
+		!memcmp(hash, out + len - SHA256_SUM_LEN, SHA256_SUM_LEN);
+}
+
+/* Test that exponentiation works with each key size and prepared keys */
+static int lib_rsa_mod_exp(struct unit_test_state *uts)
+{
+	u8 hash[SHA256_SUM_LEN], modulus[RSA_MAX_KEY_BITS / 8];
+	const struct rsa_test_key *tkey;
+	struct key_prop *prop;
+	const void *orig;
+	int i;
+
+	sha256_csum_wd(data_raw, data_raw_len, hash, CHUNKSZ_SHA256);
+	for (i = 0; i < ARRAY_SIZE(rsa_test_keys); i++) {
+		tkey = &rsa_test_keys[i];
+		ut_assertok(rsa_gen_key_prop(tkey->key, tkey->key_len, &prop));
+		ut_asserteq(2048 + i * 1024, prop->num_bits);
+
+		/* The second time uses the prepared key */
+		ut_assert(sig_matches(prop, tkey->sig, hash));
+		ut_assert(sig_matches(prop, tkey->sig, hash));
+
+		/* A key which has changed in place is prepared again */
+		orig = prop->modulus;
+		memcpy(modulus, orig, prop->num_bits / 8);
+		prop->modulus = modulus;
+		ut_assert(sig_matches(prop, tkey->sig, hash));
+		modulus[prop->num_bits / 16] ^= 0x10;
+		ut_assert(!sig_matches(prop, tkey->sig, hash));
+		modulus[prop->num_bits / 16] ^= 0x10;
+		ut_assert(sig_matches(prop, tkey->sig, hash));
+		prop->modulus = orig;
+
+		/* The signature must match the key size */
+		ut_asserteq(-EINVAL, rsa_mod_exp_sw(tkey->sig,
+						    prop->num_bits / 8 - 8,
+						    prop, modulus));
+		rsa_free_key_prop(prop);
+	}
+
+	return 0;
+}
+LIB_TEST(lib_rsa_mod_exp, 0);
+
+/* Time signature checks with each key size */
+static int lib_rsa_mod_exp_bench(struct unit_test_state *uts)
+{
+	u8 hash[SHA256_SUM_LEN], out[RSA_MAX_KEY_BITS / 8];
+	const struct rsa_test_key *tkey;
+	struct key_prop *prop;
+	ulong start, us;
+	int i, j;
+
+	sha256_csum_wd(data_raw, data_raw_len, hash, CHUNKSZ_SHA256);
+	for (i = 0; i < ARRAY_SIZE(rsa_test_keys); i++) {
+		tkey = &rsa_test_keys[i];
+		ut_assertok(rsa_gen_key_prop(tkey->key, tkey->key_len, &prop));
+		ut_assert(sig_matches(prop, tkey->sig, hash));
+
+		start = timer_get_us();
+		for (j = 0; j < NUM_VERIFY; j++)
+			ut_assertok(rsa_mod_exp_sw(tkey->sig, prop->num_bits / 8,
+						   prop, out));
+		us = max(timer_get_us() - start, 1UL);
+		printf("RSA-%d: %d verifications in %lu us (%lu/s)\n",
+		       prop->num_bits, NUM_VERIFY, us,
+		       NUM_VERIFY * 1000000UL / us);
+		rsa_free_key_prop(prop);
+	}
+
+	return 0;
+}
+LIB_TEST(lib_rsa_mod_exp_bench, 0);
+#endif /* RSA_SOFTWARE_EXP */
 #endif /* RSA_VERIFY_WITH_PKEY */
@@ -12,9 +12,12 @@
 #include <common.h>
 #include <command.h>
 #include <log.h>
+#include <malloc.h>
+#include <time.h>
 #include <test/lib.h>
 #include <test/test.h>
 #include <test/ut.h>
+#include <linux/sizes.h>
 
 /* Xor mask used for marking memory regions */
 #define MASK 0xA5
@@ -25,6 +28,14 @@
 
 #define TEST_STR	"hello"
 
+/* Allow for comparing and searching up to 256 bytes */
+#define LONGLEN (SWEEP + 256)
+
+/* Total bytes processed for each function and size in lib_string_bench() */
+#define BENCH_TOTAL	SZ_16M
+/* Largest size used by lib_string_bench() */
+#define BENCH_MAX	SZ_4M
+
 /**
  * init_buffer() - initialize buffer
  *
@@ -225,3 +236,244 @@ static int lib_memdup(struct unit_test_state *uts)
 	return 0;
 }
 LIB_TEST(lib_memdup, 0);
+
+/*
+ * Lengths used for memcmp(), memchr() and strlen(), covering the small cases
+ * and the loops of the architecture dependent implementations
+ */
+static const int long_lens[] = {
+	0, 1, 3, 4, 5, 7, 8, 9, 15, 16, 17, 31, 32, 33, 63, 64, 65, 127, 128,
+	129, 200, 255,
+};
+
+/**
+ * lib_memcmp() - unit test for memcmp()
+ *
+ * Test memcmp() with varied alignment and length, and a difference at each
+ * position in turn.
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_memcmp(struct unit_test_state *uts)
+{
+	u8 buf1[LONGLEN], buf2[LONGLEN];
+	int offset, i, j, len, pos;
+
+	for (i = 0; i < LONGLEN; ++i)
+		buf1[i] = i ^ MASK;
+
+	for (offset = 0; offset <= SWEEP; ++offset) {
+		for (i = 0; i < ARRAY_SIZE(long_lens); ++i) {
+			len = long_lens[i];
+			for (j = 0; j < LONGLEN - offset; ++j)
+				buf2[j] = buf1[offset + j];
+
+			/* A difference after the end does not matter */
+			buf2[len] ^= 0xff;
+			ut_asserteq(0, memcmp(buf1 + offset, buf2, len));
+			buf2[len] ^= 0xff;
+
+			/* Bytes are compared as unsigned */
+			for (pos = 0; pos < len; ++pos) {
+				buf2[pos] ^= 0x80;
+				if (buf1[offset + pos] < buf2[pos]) {
+					ut_assert(memcmp(buf1 + offset, buf2,
+							 len) < 0);
+					ut_assert(memcmp(buf2, buf1 + offset,
+							 len) > 0);
+				} else {
+					ut_assert(memcmp(buf1 + offset, buf2,
+							 len) > 0);
+					ut_assert(memcmp(buf2, buf1 + offset,
+							 len) < 0);
+				}
+				buf2[pos] ^= 0x80;
+			}
+		}
+	}
+	return 0;
+}
+
+LIB_TEST(lib_memcmp, 0);
+
+/**
+ * lib_memchr() - unit test for memchr()
+ *
+ * Test memchr() with varied alignment and length, with the character at each
+ * position in turn and just outside the region.
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_memchr(struct unit_test_state *uts)
+{
+	u8 buf[LONGLEN + 1];
+	int offset, i, len, pos;
+
+	memset(buf, MASK, sizeof(buf));
+	for (offset = 1; offset <= SWEEP; ++offset) {
+		for (i = 0; i < ARRAY_SIZE(long_lens); ++i) {
+			len = long_lens[i];
+			buf[offset - 1] = 0;
+			buf[offset + len] = 0;
+			ut_assertnull(memchr(buf + offset, 0, len));
+
+			for (pos = 0; pos < len; ++pos) {
+				buf[offset + pos] = 0;
+				ut_asserteq_ptr(buf + offset + pos,
+						memchr(buf + offset, 0, len));
+				buf[offset + pos] = MASK;
+			}
+
+			/* The first match is found */
+			if (len > 1) {
+				buf[offset + len - 1] = 0;
+				buf[offset + len / 2] = 0;
+				ut_asserteq_ptr(buf + offset + len / 2,
+						memchr(buf + offset, 0, len));
+				buf[offset + len - 1] = MASK;
+				buf[offset + len / 2] = MASK;
+			}
+			buf[offset - 1] = MASK;
+			buf[offset + len] = MASK;
+		}
+	}
+	return 0;
+}
+
+LIB_TEST(lib_memchr, 0);
+
+/**
+ * lib_strlen() - unit test for strlen()
+ *
+ * Test strlen() with varied alignment and length.
+ *
+ * @uts:	unit test state
+ * Return:	0 = success, 1 = failure
+ */
+static int lib_strlen(struct unit_test_state *uts)
+{
+	char buf[LONGLEN + 1];
+	int offset, i, len;
+
+	for (offset = 1; offset <= SWEEP; ++offset) {
+		for (i = 0; i < ARRAY_SIZE(long_lens); ++i) {
+			len = long_lens[i];
+			memset(buf, 'a', sizeof(buf));
+			/* A terminator before the string is not seen */
+			buf[offset - 1] = '\0';
+			buf[offset + len] = '\0';
+			ut_asserteq(len, strlen(buf + offset));
+		}
+	}
+	return 0;
+}
+
+LIB_TEST(lib_strlen, 0);
+
+enum string_bench_func {
+	BENCH_MEMCPY,
+	BENCH_MEMMOVE,
+	BENCH_MEMSET,
+	BENCH_MEMCMP,
+	BENCH_MEMCHR,
+	BENCH_STRLEN,
+
+	BENCH_COUNT,
+};
+
+static const char *const string_bench_names[BENCH_COUNT] = {
+	"memcpy", "memmove", "memset", "memcmp", "memchr", "strlen",
+};
+
+/**
+ * string_bench() - time one string function
+ *
+ * @buf1:	source, filled with non-zero bytes with a NUL at @size - 1
+ * @buf2:	destination, @size + 1 bytes, equal to @buf1 for memcmp()
+ * @size:	number of bytes for each call
+ * @func:	function to time
+ * Return:	throughput in hundredths of GB/s
+ */
+static ulong string_bench(u8 *buf1, u8 *buf2, size_t size,
+			  enum string_bench_func func)
+{
+	volatile ulong sink = 0;
+	int i, count = BENCH_TOTAL / size;
+	ulong start, us;
+
+	start = timer_get_us();
+	for (i = 0; i < count; i++) {
+		switch (func) {
+		case BENCH_MEMCPY:
+			memcpy(buf2, buf1, size);
+			break;
+		case BENCH_MEMMOVE:
+			memmove(buf2 + (i & 1), buf2 + !(i & 1), size);
+			break;
+		case BENCH_MEMSET:
+			memset(buf2, i, size);
+			break;
+		case BENCH_MEMCMP:
+			sink += memcmp(buf1, buf2, size);
+			break;
+		case BENCH_MEMCHR:
+			sink += (ulong)memchr(buf1, '\0', size);
+			break;
+		case BENCH_STRLEN:
+			sink += strlen((char *)buf1);
+			break;
+		case BENCH_COUNT:
+			break;
+		}
+	}
+	us = max(timer_get_us() - start, 1UL);
+
+	return (ulong)count * size / (us * 10);
+}
+
+/* Report the throughput of each string function for a range of sizes */
+static int lib_string_bench(struct unit_test_state *uts)
+{
+	static const size_t sizes[] = {
+		16, 256, SZ_4K, SZ_64K, SZ_1M, BENCH_MAX,
+	};
+	ulong rate[BENCH_COUNT];
+	u8 *buf1, *buf2;
+	int i, func;
+
+	buf1 = malloc(BENCH_MAX);
+	buf2 = malloc(BENCH_MAX + 1);
+	ut_assertnonnull(buf1);
+	ut_assertnonnull(buf2);
+
+	printf("%8s", "size");
+	for (func = 0; func < BENCH_COUNT; func++)
+		printf(" %8s", string_bench_names[func]);
+	printf(" (GB/s)\n");
+
+	for (i = 0; i < ARRAY_SIZE(sizes); i++) {
+		size_t size = sizes[i];
+
+		memset(buf1, 'a', size - 1);
+		buf1[size - 1] = '\0';
+		for (func = 0; func < BENCH_COUNT; func++) {
+			if (func == BENCH_MEMCMP)
+				memcpy(buf2, buf1, size);
+			rate[func] = string_bench(buf1, buf2, size, func);
+		}
+
+		printf("%8zu", size);
+		for (func = 0; func < BENCH_COUNT; func++)
+			printf(" %5lu.%02lu", rate[func] / 100, rate[func] % 100);
+		printf("\n");
+	}
+
+	free(buf2);
+	free(buf1);
+
+	return 0;
+}
+
+LIB_TEST(lib_string_bench, 0);
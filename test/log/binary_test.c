@@ -0,0 +1,85 @@
+// SPDX-License-Identifier: GPL-2.0+
+/*
+ * Test the binary log driver, which formats messages only when dumped
+ */
+
+#include <common.h>
+#include <console.h>
+#include <test/log.h>
+#include <test/test.h>
+#include <test/suites.h>
+#include <test/ut.h>
+#include <asm/global_data.h>
+
+DECLARE_GLOBAL_DATA_PTR;
+
+#define BUFFSIZE 256
+
+#define TEST_FMT "int %d long %ld llong %llx str '%s' '%-6s|' '%.*s' %*d " \
+	"pct %% ptr %p mac %pM\n"
+#define TEST_ARGS -3, -1234567L, 0x123456789abcULL, "abc", "xy", 2, \
+	"truncate", 5, 42, (void *)0x1234, mac
+
+static int log_test_binary(struct unit_test_state *uts)
+{
+	const u8 mac[] = { 0x12, 0x34, 0x56, 0x78, 0x9a, 0xbc };
+	char expect[BUFFSIZE], name[] = "before";
+	char file[] = "file.c", func[] = "func";
+	char big[BUFFSIZE + 1];
+	int log_fmt;
+
+	log_fmt = gd->log_fmt;
+	snprintf(expect, sizeof(expect), TEST_FMT, TEST_ARGS);
+	expect[strlen(expect) - 1] = '\0';
+	memset(big, 'a', BUFFSIZE);
+	big[BUFFSIZE] = '\0';
+
+	/* Drop anything recorded so far */
+	console_record_reset_enable();
+	log_binary_dump(true);
+
+	/* Debug records are kept, but not shown on the console */
+	gd->log_fmt = BIT(LOGF_LEVEL) | BIT(LOGF_CAT) | BIT(LOGF_MSG);
+	console_record_reset_enable();
+	log(LOGC_ARCH, LOGL_DEBUG, TEST_FMT, TEST_ARGS);
+	log(LOGC_EFI, LOGL_DEBUG, "name %s\n", name);
+	strcpy(name, "after");
+	log(LOGC_BOOT, LOGL_DEBUG, "big %s %d\n", big, 1);
+	gd->flags &= ~GD_FLG_RECORD;
+	ut_assertok(ut_check_console_end(uts));
+
+	/* The messages are formatted when dumped */
+	console_record_reset_enable();
+	ut_assertok(log_binary_dump(true));
+	gd->log_fmt = log_fmt;
+	gd->flags &= ~GD_FLG_RECORD;
+	ut_assertok(ut_check_console_line(uts, "DEBUG.arch, %s", expect));
+	ut_assertok(ut_check_console_line(uts, "DEBUG.efi, name before"));
+	ut_assertok(ut_check_console_linen(uts, "DEBUG.boot, big aaaa"));
+	ut_assertok(ut_check_console_end(uts));
+
+	/* The records have been removed */
+	console_record_reset_enable();
+	ut_assertok(log_binary_dump(false));
+	gd->flags &= ~GD_FLG_RECORD;
+	ut_assertok(ut_check_console_end(uts));
+
+	/* The file and function names are copied too, e.g. from 'log rec' */
+	gd->log_fmt = BIT(LOGF_FILE) | BIT(LOGF_FUNC) | BIT(LOGF_MSG);
+	_log(LOGC_BOOT, LOGL_DEBUG, file, 12, func, "%s\n", "rec");
+	_log(LOGC_BOOT, LOGL_DEBUG, NULL, 0, NULL, "%s\n", "none");
+	strcpy(file, "gone.c");
+	strcpy(func, "gone");
+	console_record_reset_enable();
+	ut_assertok(log_binary_dump(true));
+	gd->log_fmt = log_fmt;
+	gd->flags &= ~GD_FLG_RECORD;
+	ut_assertok(ut_check_console_line(uts, "file.c:%*s() rec",
+					  CONFIG_LOGF_FUNC_PAD, "func"));
+	ut_assertok(ut_check_console_line(uts, "<NULL>:%*s() none",
+					  CONFIG_LOGF_FUNC_PAD, "<NULL>"));
+	ut_assertok(ut_check_console_end(uts));
+
+	return 0;
+}
+LOG_TEST(log_test_binary);
@@ -8,9 +8,12 @@
 This test verifies fat specific file system behaviour.
 """
 
+import os
 import pytest
 import re
 
+from tests import fs_helper
+
 @pytest.mark.boardspec('sandbox')
 @pytest.mark.slow
 class TestFsFat(object):
@@ -23,3 +26,98 @@ class TestFsFat(object):
                 'host bind 0 %s' % fs_img,
                 'fatinfo host 0:0'])
             assert(re.search('Filesystem: %s' % fs_type.upper(), ''.join(output)))
+
+    def test_fs_fat2(self, u_boot_console, fs_obj_fat):
+        """Test reading a fragmented file, in full and at offsets."""
+        fs_type,fs_img = fs_obj_fat
+        with u_boot_console.log.section('Test Case 2 - fragmented file'):
+            # Interleave the parts of 'frag' with other files
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'mw.l 2000000 11111111 4000',
+                'mw.l 2010000 22222222 4000',
+                'mw.l 2020000 33333333 4000',
+                'mw.l 2030000 44444444 4000',
+                'mw.b 2011234 55 1',
+                'fatwrite host 0:0 2000000 frag 10000 0',
+                'fatwrite host 0:0 2000000 spacer1 800',
+                'fatwrite host 0:0 2010000 frag 10000 10000',
+                'fatwrite host 0:0 2000000 spacer2 800',
+                'fatwrite host 0:0 2020000 frag 10000 20000',
+                'fatwrite host 0:0 2000000 spacer3 800',
+                'fatwrite host 0:0 2030000 frag 10000 30000'])
+            assert('Error' not in ''.join(output))
+
+            output = u_boot_console.run_command_list([
+                'load host 0:0 3000000 frag',
+                'cmp.b 2000000 3000000 40000',
+                'load host 0:0 4000000 frag 15000 fffe',
+                'cmp.b 200fffe 4000000 15000',
+                'load host 0:0 4000000 frag 3 11233',
+                'cmp.b 2011233 4000000 3'])
+            assert('262144 bytes read' in ''.join(output))
+            assert('Total of 262144 byte(s) were the same' in ''.join(output))
+            assert('Total of 86016 byte(s) were the same' in ''.join(output))
+            assert('Total of 3 byte(s) were the same' in ''.join(output))
+
+    def test_fs_fat3(self, u_boot_console, fs_obj_fat):
+        """Test writing a file to a filesystem with holes in it."""
+        fs_type,fs_img = fs_obj_fat
+        with u_boot_console.log.section('Test Case 3 - write around holes'):
+            output = u_boot_console.run_command_list([
+                'host bind 0 %s' % fs_img,
+                'mw.l 2000000 66666666 20000',
+                'mw.b 2012345 77 1',
+                'fatwrite host 0:0 2000000 hole0 10000',
+                'fatwrite host 0:0 2000000 hole1 10000',
+                'fatwrite host 0:0 2000000 hole2 10000',
+                'fatwrite host 0:0 2000000 hole3 10000',
+                'fatrm host 0:0 hole0',
+                'fatrm host 0:0 hole2',
+                'fatwrite host 0:0 2000000 big 80000',
+                'fatwrite host 0:0 2000000 hole0 30000'])
+            assert('Error' not in ''.join(output))
+
+            output = u_boot_console.run_command_list([
+                'load host 0:0 3000000 big',
+                'cmp.b 2000000 3000000 80000',
+                'load host 0:0 3000000 hole0',
+                'cmp.b 2000000 3000000 30000',
+                'load host 0:0 3000000 hole3',
+                'cmp.b 2000000 3000000 10000'])
+            assert('Total of 524288 byte(s) were the same' in ''.join(output))
+            assert('Total of 196608 byte(s) were the same' in ''.join(output))
+            assert('Total of 65536 byte(s) were the same' in ''.join(output))
+
+    def test_fs_fat4(self, u_boot_console):
+        """Time writing 1MB, 64MB and 512MB files to a 1GB filesystem."""
+        fs_img = fs_helper.mk_fs(u_boot_console.config, 'fat32', 0x40000000,
+                                 'fatbench')
+        try:
+            with u_boot_console.log.section('Test Case 4 - write speed'):
+                u_boot_console.run_command_list([
+                    'host bind 0 %s' % fs_img,
+                    'mw.l 2000000 88888888 1000000'])
+                with u_boot_console.temporary_timeout(600000):
+                    output = u_boot_console.run_command_list([
+                        'time fatwrite host 0:0 2000000 f1m 100000',
+                        'time fatwrite host 0:0 2000000 f64m 4000000'])
+                    # 512MB does not fit in memory, so write it in parts
+                    for part in range(8):
+                        output += u_boot_console.run_command_list([
+                            'time fatwrite host 0:0 2000000 f512m 4000000 %x' %
+                            (part * 0x4000000)])
+                assert('Error' not in ''.join(output))
+                assert(''.join(output).count('time:') == 10)
+
+                output = u_boot_console.run_command_list([
+                    'fatls host 0:0',
+                    'load host 0:0 6000000 f512m 100000 1ff00000',
+                    'cmp.b 2000000 6000000 100000'])
+                assert('1048576   f1m' in ''.join(output))
+                assert('67108864   f64m' in ''.join(output))
+                assert('536870912   f512m' in ''.join(output))
+                assert('Total of 1048576 byte(s) were the same' in
+                       ''.join(output))
+        finally:
+            os.remove(fs_img)
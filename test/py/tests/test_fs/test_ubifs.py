@@ -0,0 +1,110 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Test reading UBIFS from a UBI volume on the sandbox NAND
+
+import os
+import pytest
+import shutil
+import subprocess
+
+UBIFS_SRC_DIR = 'ubifs_src_dir'
+UBIFS_IMAGE_NAME = 'ubifs.img'
+
+# Geometry of nand@1 in test.dts with the VID header at 4096
+UBIFS_MIN_IO = 4096
+UBIFS_LEB_SIZE = 516096
+UBIFS_MAX_LEBS = 64
+
+def make_ubifs_image(build_dir):
+    """
+    Makes the UBIFS image used for the test.
+
+    The image holds a 64KiB file, which spans enough data nodes for the
+    bulk-read path to be taken, and a small one.
+    """
+    root = os.path.join(build_dir, UBIFS_SRC_DIR)
+    os.makedirs(root)
+
+    with open(os.path.join(root, 'big'), 'wb') as fd:
+        fd.write(os.urandom(64 * 1024))
+    with open(os.path.join(root, 'small'), 'w') as fd:
+        fd.write('small\n')
+
+    output_path = os.path.join(build_dir, UBIFS_IMAGE_NAME)
+    subprocess.run(['mkfs.ubifs', '-m', str(UBIFS_MIN_IO),
+                    '-e', str(UBIFS_LEB_SIZE), '-c', str(UBIFS_MAX_LEBS),
+                    '-x', 'none', '-r', root, '-o', output_path],
+                   check=True, stdout=subprocess.DEVNULL)
+
+def clean_ubifs_image(build_dir):
+    """
+    Deletes the image and src_dir at build_dir.
+    """
+    shutil.rmtree(os.path.join(build_dir, UBIFS_SRC_DIR))
+    os.remove(os.path.join(build_dir, UBIFS_IMAGE_NAME))
+
+def ubifs_load_file(u_boot_console, name, address):
+    """
+    Loads a file and asserts its checksum, returning the command output.
+    """
+    build_dir = u_boot_console.config.build_dir
+    path = os.path.join(build_dir, UBIFS_SRC_DIR, name)
+    size = os.path.getsize(path)
+
+    out = u_boot_console.run_command('ubifsload {} {}'.format(address, name))
+    assert 'Done' in out
+
+    md5 = u_boot_console.run_command('md5sum {} {:x}'.format(address, size))
+    u_boot_checksum = md5.split()[-1]
+
+    res = subprocess.run(['md5sum', path], check=True, capture_output=True,
+                         text=True)
+    assert u_boot_checksum == res.stdout.split()[0]
+    return out
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_ubi')
+@pytest.mark.buildconfigspec('cmd_ubifs')
+@pytest.mark.buildconfigspec('ubifs_bulk_read')
+@pytest.mark.buildconfigspec('log')
+@pytest.mark.requiredtool('mkfs.ubifs')
+@pytest.mark.requiredtool('md5sum')
+def test_ubifs(u_boot_console):
+    """
+    Writes a UBIFS image to a UBI volume, then mounts it and reads it back,
+    checking that file data is read with bulk-read.
+    """
+    build_dir = u_boot_console.config.build_dir
+    image_path = os.path.join(build_dir, UBIFS_IMAGE_NAME)
+
+    u_boot_console.restart_uboot()
+
+    try:
+        make_ubifs_image(build_dir)
+        size = UBIFS_LEB_SIZE * UBIFS_MAX_LEBS
+
+        with u_boot_console.temporary_timeout(120000):
+            u_boot_console.run_command_list([
+                'setenv mtdids nand1=nand1',
+                'setenv mtdparts mtdparts=nand1:256m(ubifs)',
+                'ubi part ubifs {}'.format(UBIFS_MIN_IO),
+                'ubi create rootfs {:x}'.format(size),
+                'host load hostfs - $kernel_addr_r {}'.format(image_path),
+                'ubi write $kernel_addr_r rootfs $filesize'])
+            u_boot_console.run_command('ubifsmount ubi0:rootfs')
+            out = u_boot_console.run_command('ubifsls')
+            assert 'big' in out
+            assert 'small' in out
+
+            # The bulk-read path reports itself at debug level
+            u_boot_console.run_command('log level 7')
+            try:
+                out = ubifs_load_file(u_boot_console, 'big', '$kernel_addr_r')
+            finally:
+                u_boot_console.run_command('log level 6')
+            assert 'bulk-read' in out
+
+            ubifs_load_file(u_boot_console, 'small', '$kernel_addr_r')
+            u_boot_console.run_command('ubifsumount')
+    finally:
+        clean_ubifs_image(build_dir)
@@ -0,0 +1,69 @@
+# SPDX-License-Identifier: GPL-2.0+
+#
+# Test selecting UBI partitions on the sandbox NAND
+
+import pytest
+
+def ubi_part(u_boot_console, name, vid_offset=4096):
+    """Select a UBI partition, returning the output and the return code"""
+    out = u_boot_console.run_command('ubi part {} {}'.format(name, vid_offset))
+    ret = u_boot_console.run_command('echo $?')
+    return out, int(ret)
+
+@pytest.mark.boardspec('sandbox')
+@pytest.mark.buildconfigspec('cmd_ubi')
+@pytest.mark.buildconfigspec('cmd_ubi_part_cache')
+def test_ubi_part_cache(u_boot_console):
+    """
+    Checks that partitions stay attached when another one is selected, and
+    that a partition is attached again when another VID header offset is
+    requested
+    """
+    u_boot_console.restart_uboot()
+
+    with u_boot_console.temporary_timeout(120000):
+        u_boot_console.run_command_list([
+            'setenv mtdids nand1=nand1',
+            'setenv mtdparts mtdparts=nand1:128m(ubi_a),128m(ubi_b)'])
+
+        out, ret = ubi_part(u_boot_console, 'ubi_a')
+        assert ret == 0
+        assert 'attached mtd' in out
+        u_boot_console.run_command('ubi create vol_a 100000')
+
+        out, ret = ubi_part(u_boot_console, 'ubi_b')
+        assert ret == 0
+        assert 'attached mtd' in out
+
+        # Selecting an attached partition again does not scan it
+        out, ret = ubi_part(u_boot_console, 'ubi_a')
+        assert ret == 0
+        assert 'attaching' not in out
+        out = u_boot_console.run_command('ubi part')
+        assert 'Device 0: ubi0, MTD partition ubi_a' in out
+        u_boot_console.run_command('ubi check vol_a')
+        assert u_boot_console.run_command('echo $?') == '0'
+
+        # Another VID header offset attaches the partition again, which
+        # fails here as the flash was formatted with the other one. The
+        # selected partition must be left alone.
+        out, ret = ubi_part(u_boot_console, 'ubi_b', 2048)
+        assert ret != 0
+        assert 'detaching' in out
+        out = u_boot_console.run_command('ubi part')
+        assert 'Device 0: ubi0, MTD partition ubi_a' in out
+
+        out, ret = ubi_part(u_boot_console, 'ubi_b')
+        assert ret == 0
+        assert 'attached mtd' in out
+        out = u_boot_console.run_command('ubi part')
+        assert 'Device 0: ubi0, MTD partition ubi_b' in out
+
+        # Detaching drops every partition, so the next one is scanned
+        out = u_boot_console.run_command('ubi detach')
+        assert out.count('is detached') == 2
+        out, ret = ubi_part(u_boot_console, 'ubi_a')
+        assert ret == 0
+        assert 'attached mtd' in out
+        u_boot_console.run_command('ubi check vol_a')
+        assert u_boot_console.run_command('echo $?') == '0'
@@ -5,6 +5,8 @@
 
 """Entry-type module for producing a FIT"""
 
+import struct
+
 import libfdt
 
 from binman.entry import Entry, EntryArg
@@ -16,11 +18,64 @@ from u_boot_pylib import tools
 
 # Supported operations, with the fit,operation property
 OP_GEN_FDT_NODES, OP_SPLIT_ELF = range(2)
+# lz4 frames, as produced by the lz4 tool
+LZ4_MAGIC = 0x184d2204
+LZ4_BLOCK_UNCOMPRESSED = 1 << 31
+
+# Bytes which the lz4 decoder may write beyond the output of a block
+LZ4_INPLACE_SLACK = 32
+
+# Bytes which SPL may read after the data, since it reads whole blocks of up to
+# 4KiB to an address aligned to up to 128 bytes (FIT_DECOMP_READ_SLACK)
+LZ4_INPLACE_READ_SLACK = 4096 + 128
+
 OPERATIONS = {
     'gen-fdt-nodes': OP_GEN_FDT_NODES,
     'split-elf': OP_SPLIT_ELF,
     }
 
+def lz4_inplace_margin(data, uncomp_size):
+    """Work out the margin needed to decompress an lz4 frame in place
+
+    The compressed data is placed at the end of a buffer of uncomp_size +
+    margin bytes and decompressed to the start of it. This is safe as long as
+    the output of each block stays below the start of that block in the input,
+    so that nothing is overwritten before it is read.
+
+    All blocks in a frame are full-sized except the last, so the end of each
+    block's output is known without decompressing it.
+
+    Args:
+        data (bytes): lz4 frame
+        uncomp_size (int): Size of the uncompressed data
+
+    Returns:
+        int: Number of bytes needed after the uncompressed data
+
+    Raises:
+        ValueError: data is not a valid lz4 frame
+    """
+    if len(data) < 7 or struct.unpack('<I', data[:4])[0] != LZ4_MAGIC:
+        raise ValueError('Not an lz4 frame')
+    flags, block_desc = data[4], data[5]
+    block_max = 1 << (8 + 2 * ((block_desc >> 4) & 7))
+    pos = 7 + (8 if flags & 8 else 0) + (4 if flags & 1 else 0)
+    out = 0
+    need = 0
+    while True:
+        if pos + 4 > len(data):
+            raise ValueError('Truncated lz4 frame')
+        size = struct.unpack('<I', data[pos:pos + 4])[0]
+        size &= ~LZ4_BLOCK_UNCOMPRESSED
+        if not size:
+            break
+        out = min(out + block_max, uncomp_size)
+        need = max(need, out - pos)
+        pos += 4 + size + (4 if flags & 0x10 else 0)
+    return (max(0, need + len(data) - uncomp_size + LZ4_INPLACE_SLACK) +
+            LZ4_INPLACE_READ_SLACK)
+
+
 class Entry_fit(Entry_section):
 
     """Flat Image Tree (FIT)
@@ -87,6 +142,22 @@ class Entry_fit(Entry_section):
 
                 fit,fdt-list-val = "dtb1", "dtb2";
 
+    Properties (in image nodes)
+    ~~~~~~~~~~~~~~~~~~~~~~~~~~~
+
+    Image nodes support the following special property:
+
+        fit,decomp-inplace
+            Indicates that the image is decompressed in place by SPL. The image
+            must hold a single entry with `compress = "lz4"` and have
+            `compression = "lz4"`. Binman adds an `uncomp-size` property with
+            the size of the uncompressed data and a `decomp-margin` property
+            with the number of bytes needed after it, so that the compressed
+            data can be read to the end of the load area and decompressed to
+            its start without overwriting data which has not been read yet.
+            The margin includes 4224 bytes for SPL reading whole blocks of up
+            to 4KiB.
+
     Substitutions
     ~~~~~~~~~~~~~
 
@@ -483,6 +554,32 @@ class Entry_fit(Entry_section):
         rel_path = node.path[len(self._node.path) + 1:]
         self.Raise(f"subnode '{rel_path}': {msg}")
 
+    def _add_inplace_props(self, fsw, node, entry, data):
+        """Add the properties needed to decompress an image in place
+
+        Args:
+            fsw (libfdt.FdtSw): Object to use for writing
+            node (Node): Image node
+            entry (Entry_section): Section holding the image data
+            data (bytes): Image data
+        """
+        comp = fdt_util.GetString(node, 'compression')
+        subentries = list(entry.GetEntries().values())
+        if (comp != 'lz4' or len(subentries) != 1 or
+                subentries[0].compress != 'lz4'):
+            self._raise_subnode(
+                node, 'fit,decomp-inplace requires a single lz4-compressed entry')
+        sub = subentries[0]
+        if sub.uncomp_size is None or not sub.comp_bintool.is_present():
+            # The data is faked, so there is nothing to work out
+            return
+        try:
+            margin = lz4_inplace_margin(data, sub.uncomp_size)
+        except ValueError as exc:
+            self._raise_subnode(node, str(exc))
+        fsw.property_u32('uncomp-size', sub.uncomp_size)
+        fsw.property_u32('decomp-margin', margin)
+
     def _build_input(self):
         """Finish the FIT by adding the 'data' properties to it
 
@@ -736,6 +833,8 @@ class Entry_fit(Entry_section):
                 entry = self._priv_entries[image_name]
                 data = entry.GetData()
                 fsw.property('data', bytes(data))
+                if 'fit,decomp-inplace' in node.props:
+                    self._add_inplace_props(fsw, node, entry, data)
 
             for subnode in node.subnodes:
                 subnode_path = f'{rel_path}/{subnode.name}'
@@ -32,6 +32,7 @@ from binman import state
 from dtoc import fdt
 from dtoc import fdt_util
 from binman.etype import fdtmap
+from binman.etype import fit
 from binman.etype import image_header
 from binman.image import Image
 from u_boot_pylib import command
@@ -7460,5 +7461,49 @@ fdt         fdtmap                Extract the devicetree blob from the fdtmap
         with self.assertRaises(ValueError) as e:
             self._DoReadFile('323_capsule_accept_revert_missing.dts')
 
+    def testFitDecompInplace(self):
+        """Test working out how to decompress a FIT image in place"""
+        self._CheckLz4()
+        data = self._DoReadFile('326_fit_decomp_inplace.dts')
+        dtb = fdt.Fdt.FromData(data)
+        dtb.Scan()
+        node = dtb.GetNode('/images/u-boot')
+        comp_data = node.props['data'].bytes
+        self.assertEqual(COMPRESS_DATA_BIG, self._decompress(comp_data))
+
+        uncomp_size = fdt_util.fdt32_to_cpu(node.props['uncomp-size'].value)
+        self.assertEqual(len(COMPRESS_DATA_BIG), uncomp_size)
+        self.assertEqual(
+            fit.lz4_inplace_margin(comp_data, uncomp_size),
+            fdt_util.fdt32_to_cpu(node.props['decomp-margin'].value))
+
+    def testFitDecompInplaceMargin(self):
+        """Test the margin needed to decompress an lz4 frame in place"""
+        # Frame header, then blocks of 100 and 50 bytes and the end mark
+        frame = (struct.pack('<IBBB', fit.LZ4_MAGIC, 0x60, 0x40, 0) +
+                 struct.pack('<I', 100) + tools.get_bytes(0, 100) +
+                 struct.pack('<I', 50) + tools.get_bytes(0, 50) +
+                 struct.pack('<I', 0))
+
+        # The second block ends 100000 bytes into the output, but starts
+        # only 111 bytes into the input
+        self.assertEqual(100000 - 111 + len(frame) - 100000 + 32 + 4224,
+                         fit.lz4_inplace_margin(frame, 100000))
+
+        with self.assertRaises(ValueError) as exc:
+            fit.lz4_inplace_margin(tools.get_bytes(0, 16), 100)
+        self.assertIn('Not an lz4 frame', str(exc.exception))
+        with self.assertRaises(ValueError) as exc:
+            fit.lz4_inplace_margin(frame[:-4], 100000)
+        self.assertIn('Truncated lz4 frame', str(exc.exception))
+
+    def testFitDecompInplaceBad(self):
+        """Test that fit,decomp-inplace needs an lz4-compressed entry"""
+        with self.assertRaises(ValueError) as exc:
+            self._DoReadFile('327_fit_decomp_inplace_bad.dts')
+        self.assertIn(
+            "subnode 'images/u-boot': fit,decomp-inplace requires a single lz4-compressed entry",
+            str(exc.exception))
+
 if __name__ == "__main__":
     unittest.main()
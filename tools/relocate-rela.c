@@ -15,6 +15,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "compiler.h"
+#include <u-boot/relr.h>
 
 #ifndef EM_AARCH64
 #define EM_AARCH64		183
@@ -74,6 +75,9 @@ static int machine;
 
 static uint64_t rela_start, rela_end, text_base, dyn_start;
 
+/* Replace the rela entries with a RELR table, see write_relr() */
+static bool relr;
+
 static const bool debug_en;
 
 static void debug(const char *fmt, ...)
@@ -451,9 +455,70 @@ static int decode_elf(char **argv)
 	return decode_elf32(felf, argv);
 }
 
+static int compare_addr(const void *a, const void *b)
+{
+	uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * The addends have already been written to the locations they apply to, so
+ * all that U-Boot needs is the list of locations. Write that as a RELR table
+ * in place of the rela entries; it is much smaller, so it always fits.
+ */
+static int write_relr(char **argv, FILE *f, uint64_t *addr, int count)
+{
+	uint64_t *table;
+	int i, n, ret = 0;
+
+	qsort(addr, count, sizeof(*addr), compare_addr);
+	for (i = 1, n = count ? 1 : 0; i < count; i++) {
+		if (addr[i] != addr[n - 1])
+			addr[n++] = addr[i];
+	}
+	count = n;
+
+	table = calloc(count + 1, sizeof(*table));
+	if (!table) {
+		fprintf(stderr, "%s: out of memory\n", argv[0]);
+		return 4;
+	}
+
+	n = relr_encode(addr, count, table + 1);
+	if (n < 0) {
+		fprintf(stderr, "%s: %s: cannot encode RELR table\n", argv[0],
+			argv[1]);
+		ret = 4;
+		goto out;
+	}
+	if ((n + 1) * sizeof(*table) > rela_end - rela_start) {
+		fprintf(stderr, "%s: %s: RELR table does not fit\n", argv[0],
+			argv[1]);
+		ret = 4;
+		goto out;
+	}
+	debug("RELR: %d relocations in %d entries\n", count, n);
+
+	table[0] = (uint64_t)n << 32 | RELR_MAGIC;
+	for (i = 0; i <= n; i++)
+		table[i] = cpu_to_le64(table[i]);
+	if (fseek(f, rela_start, SEEK_SET) < 0 ||
+	    fwrite(table, sizeof(*table), n + 1, f) != n + 1) {
+		fprintf(stderr, "%s: %s: write RELR table failed\n", argv[0],
+			argv[1]);
+		ret = 4;
+	}
+out:
+	free(table);
+
+	return ret;
+}
+
 static int rela_elf64(char **argv, FILE *f)
 {
-	int i, num;
+	uint64_t *relocs = NULL;
+	int i, num, count = 0, ret = 0;
 
 	if ((rela_end - rela_start) % sizeof(Elf64_Rela)) {
 		fprintf(stderr, "%s: rela size isn't a multiple of Elf64_Rela\n", argv[0]);
@@ -461,6 +526,13 @@ static int rela_elf64(char **argv, FILE *f)
 	}
 
 	num = (rela_end - rela_start) / sizeof(Elf64_Rela);
+	if (relr) {
+		relocs = calloc(num ? num : 1, sizeof(*relocs));
+		if (!relocs) {
+			fprintf(stderr, "%s: out of memory\n", argv[0]);
+			return 4;
+		}
+	}
 
 	for (i = 0; i < num; i++) {
 		Elf64_Rela rela, swrela;
@@ -477,7 +549,8 @@ static int rela_elf64(char **argv, FILE *f)
 			fprintf(stderr, "%s: %s: read rela failed at %"
 					PRIx64 "\n",
 				argv[0], argv[1], pos);
-			return 4;
+			ret = 4;
+			goto out;
 		}
 
 		swrela.r_offset = le64_to_cpu(rela.r_offset);
@@ -493,7 +566,8 @@ static int rela_elf64(char **argv, FILE *f)
 		if (swrela.r_offset < text_base) {
 			fprintf(stderr, "%s: %s: bad rela at %" PRIx64 "\n",
 				argv[0], argv[1], pos);
-			return 4;
+			ret = 4;
+			goto out;
 		}
 
 		addr = swrela.r_offset - text_base;
@@ -507,11 +581,19 @@ static int rela_elf64(char **argv, FILE *f)
 		if (fwrite(&rela.r_addend, sizeof(rela.r_addend), 1, f) != 1) {
 			fprintf(stderr, "%s: %s: write failed at %" PRIx64 "\n",
 				argv[0], argv[1], addr);
-			return 4;
+			ret = 4;
+			goto out;
 		}
+		if (relocs)
+			relocs[count++] = swrela.r_offset;
 	}
 
-	return 0;
+	if (count)
+		ret = write_relr(argv, f, relocs, count);
+out:
+	free(relocs);
+
+	return ret;
 }
 
 static bool supported_rela32(Elf32_Rela *rela, uint32_t *type)
@@ -707,10 +789,17 @@ int main(int argc, char **argv)
 	int ret;
 	uint64_t file_size;
 
+	if (argc == 4 && !strcmp(argv[1], "-r")) {
+		relr = true;
+		argv[1] = argv[0];
+		argv++;
+		argc--;
+	}
 	if (argc != 3) {
 		fprintf(stderr, "Statically apply ELF rela relocations\n");
-		fprintf(stderr, "Usage: %s <bin file> <u-boot ELF>\n",
+		fprintf(stderr, "Usage: %s [-r] <bin file> <u-boot ELF>\n",
 			argv[0]);
+		fprintf(stderr, "  -r  replace the rela entries with a RELR table\n");
 		return 1;
 	}
 